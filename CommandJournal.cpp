@@ -0,0 +1,261 @@
+#include "CommandJournal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using CommandJournal::Record;
+
+    constexpr uint32_t kMagic = 0x4c4a4843; // "CHJL"
+    constexpr uint32_t kVersion = 1;
+
+    // A batch is written once it is this old or this large, whichever comes first. Edits come in
+    // bursts (gizmo drags, undo spam), so this turns many tiny fsyncs into a few larger ones.
+    constexpr auto kGroupCommitWindow = std::chrono::milliseconds(200);
+    constexpr size_t kMaxBatch = 256;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t scenePathLength; // followed by the path bytes, then the records
+    };
+
+    std::thread s_writer;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+
+    // Guarded by s_mutex.
+    std::vector<Record> s_pending;
+    bool s_truncateRequested = false;
+    std::string s_truncateScenePath;
+    uint32_t s_truncateSequence = 0;
+    bool s_stopping = false;
+
+    // Writer thread only (or the main thread before the writer starts).
+    std::string s_path;
+    FILE* s_file = nullptr;
+
+    // Main thread only.
+    uint32_t s_sequence = 0;
+    bool s_enabled = true;
+
+    uint32_t checksum(const Record& record)
+    {
+        // FNV-1a over everything but the checksum itself.
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record);
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < offsetof(Record, checksum); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void syncFile(FILE* file)
+    {
+        std::fflush(file);
+#ifdef _WIN32
+        _commit(_fileno(file));
+#else
+        fsync(fileno(file));
+#endif
+    }
+
+    // Replaces the journal with a fresh header for scenePath and the records newer than keepAfter
+    // and older than dropFrom.
+    bool rewrite(const std::string& scenePath, uint32_t keepAfter, uint32_t dropFrom = UINT32_MAX)
+    {
+        if (s_file)
+        {
+            std::fclose(s_file);
+            s_file = nullptr;
+        }
+
+        std::string previousScene;
+        std::vector<Record> existing;
+        CommandJournal::read(s_path, previousScene, existing);
+
+        const std::string tempPath = s_path + ".tmp";
+        FILE* file = std::fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "Failed to write command journal: " << tempPath << std::endl;
+            return false;
+        }
+        const Header header = { kMagic, kVersion, uint32_t(sizeof(Record)), uint32_t(scenePath.size()) };
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fwrite(scenePath.data(), 1, scenePath.size(), file);
+        for (const Record& record : existing)
+        {
+            if (record.sequence > keepAfter && record.sequence < dropFrom)
+                std::fwrite(&record, sizeof(record), 1, file);
+        }
+        syncFile(file);
+        std::fclose(file);
+
+        std::error_code error;
+        std::filesystem::rename(tempPath, s_path, error);
+        if (error)
+        {
+            std::cerr << "Failed to replace command journal: " << error.message() << std::endl;
+            return false;
+        }
+        s_file = std::fopen(s_path.c_str(), "ab");
+        return s_file != nullptr;
+    }
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return !s_pending.empty() || s_truncateRequested || s_stopping; });
+
+            // Group commit: give the rest of the burst a moment to arrive.
+            if (!s_stopping && !s_truncateRequested)
+                s_wake.wait_for(lock, kGroupCommitWindow, [] { return s_pending.size() >= kMaxBatch || s_truncateRequested || s_stopping; });
+
+            std::vector<Record> batch;
+            batch.swap(s_pending);
+            const bool truncateRequested = s_truncateRequested;
+            const std::string truncateScenePath = s_truncateScenePath;
+            const uint32_t truncateSequence = s_truncateSequence;
+            s_truncateRequested = false;
+            const bool stopping = s_stopping;
+            lock.unlock();
+
+            // Records are written before truncating, the truncation keeps the ones it does not cover.
+            if (s_file && !batch.empty())
+            {
+                std::fwrite(batch.data(), sizeof(Record), batch.size(), s_file);
+                syncFile(s_file);
+            }
+            if (truncateRequested)
+                rewrite(truncateScenePath, truncateSequence);
+
+            lock.lock();
+            if (stopping && s_pending.empty() && !s_truncateRequested)
+                break;
+        }
+        if (s_file)
+        {
+            std::fclose(s_file);
+            s_file = nullptr;
+        }
+    }
+}
+
+namespace CommandJournal
+{
+    bool read(const std::string& path, std::string& scenePath, std::vector<Record>& records)
+    {
+        records.clear();
+        scenePath.clear();
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+
+        Header header{};
+        bool valid = std::fread(&header, sizeof(header), 1, file) == 1
+            && header.magic == kMagic && header.recordSize == sizeof(Record) && header.scenePathLength < 4096;
+        if (valid)
+        {
+            scenePath.resize(header.scenePathLength);
+            valid = header.scenePathLength == 0 || std::fread(scenePath.data(), 1, scenePath.size(), file) == scenePath.size();
+        }
+        if (valid)
+        {
+            // A crash can leave a partial last record behind, stop at the first one that does not check out.
+            Record record;
+            while (std::fread(&record, sizeof(record), 1, file) == 1 && record.checksum == checksum(record))
+                records.push_back(record);
+        }
+        std::fclose(file);
+        return valid;
+    }
+
+    bool open(const std::string& path, const std::string& scenePath, uint32_t dropFrom)
+    {
+        shutdown();
+        s_path = path;
+        std::error_code ignored;
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        if (!directory.empty())
+            std::filesystem::create_directories(directory, ignored);
+
+        std::string previousScene;
+        std::vector<Record> existing;
+        read(path, previousScene, existing);
+        for (const Record& record : existing)
+            s_sequence = std::max(s_sequence, record.sequence);
+
+        if (!rewrite(scenePath, 0, dropFrom)) // also drops a torn tail
+            return false;
+        s_stopping = false;
+        s_writer = std::thread(writerLoop);
+        return true;
+    }
+
+    void setEnabled(bool enabled)
+    {
+        s_enabled = enabled;
+    }
+
+    void append(Record record)
+    {
+        if (!s_enabled || !s_writer.joinable())
+            return;
+        record.sequence = ++s_sequence;
+        record.checksum = checksum(record);
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_pending.push_back(record);
+        }
+        s_wake.notify_one();
+    }
+
+    uint32_t sequence()
+    {
+        return s_sequence;
+    }
+
+    void truncate(const std::string& scenePath, uint32_t sequence)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_truncateRequested = true;
+            s_truncateScenePath = scenePath;
+            s_truncateSequence = sequence;
+        }
+        s_wake.notify_one();
+    }
+
+    void shutdown()
+    {
+        if (!s_writer.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stopping = true;
+        }
+        s_wake.notify_one();
+        s_writer.join();
+    }
+}
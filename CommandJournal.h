@@ -0,0 +1,63 @@
+#ifndef COMMAND_JOURNAL_H
+#define COMMAND_JOURNAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Crash recovery for edits made since the last full save. Every executed, undone or redone
+// command appends the state it leaves behind as a small fixed-size record; a background writer
+// flushes them in groups (one write + fsync per batch). A full save truncates the journal, so on
+// startup replaying it on top of the scene named in its header restores the last session.
+//
+// A new instance does not fit in a record (type, mesh, textures, text), so creating one (or undoing
+// or redoing that) is recorded as RECORD_CREATE and replay stops there: edits after a create are
+// only safe once the next full save has been made.
+namespace CommandJournal
+{
+    enum RecordKind : uint16_t
+    {
+        RECORD_POSITION = 1,
+        RECORD_ROTATION = 2,
+        RECORD_SCALE = 3,
+        RECORD_PROPERTY = 4,  // field = property id, value = the property's floats
+        RECORD_DELETE = 5,
+        RECORD_REPARENT = 6,  // value[0] = new parent id, -1 for top-level
+        RECORD_RESTORE = 7,   // undone delete, value[0] = parent id (-1 for top-level), value[1] = sibling index
+        RECORD_CREATE = 8,    // replay barrier, see above
+    };
+
+    // Absolute values, so replay never depends on the state before the edit.
+    struct Record
+    {
+        uint32_t sequence = 0;  // assigned by append()
+        uint16_t kind = 0;      // RecordKind
+        uint16_t field = 0;
+        int32_t instanceId = -1;
+        float value[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        uint32_t checksum = 0;  // assigned by append(), detects a torn last write
+    };
+
+    // Reads the scene path from the header and every intact record. Returns false when there is
+    // no journal (or it is not one).
+    bool read(const std::string& path, std::string& scenePath, std::vector<Record>& records);
+
+    // Starts the writer. Records already in the file are kept, they are not in any snapshot yet,
+    // except those from sequence dropFrom on (the ones a replay stopped short of).
+    bool open(const std::string& path, const std::string& scenePath, uint32_t dropFrom = UINT32_MAX);
+
+    // Main thread only. append() drops records while the journal is disabled (a streamed scene has
+    // no single file to replay onto).
+    void setEnabled(bool enabled);
+    void append(Record record);
+    uint32_t sequence(); // sequence number of the last appended record
+
+    // Called once the scene up to `sequence` is safely on disk as scenePath: drops the records it
+    // covers and makes scenePath the base for replay.
+    void truncate(const std::string& scenePath, uint32_t sequence);
+
+    // Flushes what is queued and stops the writer.
+    void shutdown();
+}
+
+#endif // COMMAND_JOURNAL_H
@@ -32,7 +32,11 @@ namespace fs = std::filesystem;
 #include <bx/string.h>
 
 #include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <deque>
 #include <string>
+#include <unordered_set>
 
 //include embedded shaders
 
@@ -53,6 +57,7 @@ namespace fs = std::filesystem;
 #include "Logger.h"
 
 #include "Light.h"
+#include "FrameMath.h"
 //#include "DebugDraw.h"
 #include <ImGuizmo.h>
 #include <cmath> // for rad2deg, deg2rad, etc.
@@ -66,6 +71,20 @@ namespace fs = std::filesystem;
 #include "stb_image_write.h"
 
 #include "TextRenderer.h" // for text element
+#include "TonalArtMap.h"
+#include "DeferredRenderer.h"
+#include "DynamicResolution.h"
+#include "SceneSerializer.h"
+#include "SceneSaver.h"
+#include "CommandJournal.h"
+#include "SceneStreamer.h"
+#include "SceneGenerator.h"
+#include "ScreenshotCapture.h"
+#include "ShaderLoader.h"
+#include "PosterRenderer.h"
+#include "SequenceExporter.h"
+#include "Trace.h"
+#include "PerformancePanel.h"
 
 std::vector<Camera> cameras;
 int currentCameraIndex = 0;
@@ -79,6 +98,8 @@ static ImGuizmo::MODE currentGizmoMode = ImGuizmo::WORLD;
 #define WNDW_HEIGHT 900
 
 static bool s_showStats = false;
+static bool s_showPerformance = false;
+static bool s_showSceneGenerator = false;
 bgfx::UniformHandle u_lightDir;
 bgfx::UniformHandle u_lightColor;
 bgfx::UniformHandle u_viewPos;
@@ -86,6 +107,16 @@ bgfx::UniformHandle u_viewPos;
 // Define the picking render target dimensions.
 #define PICKING_DIM 128
 
+// Scene views, executed by bgfx in ascending id order. Picking uses view 0 (+ blit view 2)
+// in its own frame and ImGui renders last in view 255.
+#define VIEW_DEPTH_PREPASS 9
+#define VIEW_GBUFFER 10
+#define VIEW_DEFERRED_LIGHT 11
+#define VIEW_SCENE 12
+#define VIEW_UPSCALE 13
+#define VIEW_EXPORT_READBACK 14
+#define VIEW_VIDEO 15 // main menu video, YUV planes to RGBA
+
 static bool useGlobalCrosshatchSettings = true;
 // (Define TAU in C++ too)
 const float TAU = 6.28318530718f;
@@ -118,6 +149,108 @@ static bgfx::UniformHandle u_albedoFactor = BGFX_INVALID_HANDLE;
 // Global uniform for the diffuse texture (put this at file scope or as a static variable)
 static bgfx::UniformHandle u_diffuseTex = BGFX_INVALID_HANDLE;
 
+// Tonal art map path: baked hatch layers replace the texh() loop for Crosshatch Ver 1.1 - 1.3.
+static bool useTonalArtMaps = true;
+static bgfx::ProgramHandle tamProgram = BGFX_INVALID_HANDLE;
+static bgfx::UniformHandle u_tamTex = BGFX_INVALID_HANDLE;
+static bgfx::UniformHandle u_tamParams = BGFX_INVALID_HANDLE;
+static bgfx::UniformHandle u_tamLod = BGFX_INVALID_HANDLE;
+
+// Text instances as glyph quads over the shared SDF atlas (see SdfText). Without the shader
+// binary each text instance falls back to its own createTextTexture bitmap.
+static bgfx::ProgramHandle sdfTextProgram = BGFX_INVALID_HANDLE;
+
+// Deferred path: opaque hatched objects fill a G-buffer, one fullscreen pass shades them.
+static bool useDeferredShading = false;
+
+// Forward vs deferred frame-time comparison on the currently loaded scene.
+struct RenderModeComparison
+{
+    int phase = -1;               // -1 idle, 0 measuring forward, 1 measuring deferred
+    int frame = 0;
+    double cpuMs[2] = { 0.0, 0.0 };
+    double gpuMs[2] = { 0.0, 0.0 };
+    bool restoreDeferred = false;
+};
+static RenderModeComparison s_modeComparison;
+static const int COMPARE_WARMUP_FRAMES = 30;
+static const int COMPARE_FRAMES = 300;
+
+// Depth pre-pass: opaque hatched objects first write depth with a position-only stream, then
+// the main pass runs f_out28 with a depth-equal test so every pixel is hatched once.
+// Saved with the scene (see saveSceneToFile).
+static bool useDepthPrepass = false;
+static bool s_depthPrepassFrame = false;   // prepass active for the frame being built
+static bgfx::ProgramHandle depthPrepassProgram = BGFX_INVALID_HANDLE;
+static std::unordered_map<uint16_t, bgfx::VertexBufferHandle> s_positionStreams; // keyed by full vertex buffer idx
+
+// Hatch level of detail: below these projected sizes (bounding sphere diameter in pixels) an
+// instance drops to the single-layer hatch (mode 1), then to tone-only shading (mode 5).
+// Saved with the scene, instances can override the thresholds.
+struct MeshBounds
+{
+    float center[3];
+    float radius;
+};
+static bool useHatchLod = true;
+static float hatchLodSingleLayerPx = 160.0f;
+static float hatchLodToneOnlyPx = 40.0f;
+static float s_lodEyePos[3] = { 0.0f, 0.0f, 0.0f };
+static float s_lodPixelsPerUnit = 0.0f;     // pixels covered by one world unit at distance 1
+static int s_hatchLodCounts[FrameMath::HATCH_LOD_COUNT] = { 0, 0, 0 };
+static std::unordered_map<uint16_t, MeshBounds> s_meshBounds; // keyed by vertex buffer idx
+
+// Triangle count and buffer sizes of every registered mesh, for the performance panel.
+struct MeshSize
+{
+    uint32_t triangles;
+    uint64_t bytes; // vertices, indices and the position stream
+};
+static std::unordered_map<uint16_t, MeshSize> s_meshSizes; // keyed by vertex buffer idx
+
+// Buffers created for imported meshes belong to the instances drawing them and are destroyed
+// with the last one. Instances parked in the undo history (deleted, or created and undone) keep
+// their reference. Built-in meshes are never registered and live for the whole session.
+struct SharedMesh
+{
+    bgfx::VertexBufferHandle vbh;
+    bgfx::IndexBufferHandle ibh;
+    int refs;
+};
+static std::unordered_map<uint16_t, SharedMesh> s_sharedMeshes; // keyed by vertex buffer idx
+
+void registerSharedMesh(bgfx::VertexBufferHandle vbh, bgfx::IndexBufferHandle ibh)
+{
+    s_sharedMeshes[vbh.idx] = { vbh, ibh, 0 };
+}
+
+bool retainSharedMesh(bgfx::VertexBufferHandle vbh)
+{
+    auto it = s_sharedMeshes.find(vbh.idx);
+    if (it == s_sharedMeshes.end())
+        return false;
+    it->second.refs++;
+    return true;
+}
+
+void releaseSharedMesh(bgfx::VertexBufferHandle vbh)
+{
+    auto it = s_sharedMeshes.find(vbh.idx);
+    if (it == s_sharedMeshes.end() || --it->second.refs > 0)
+        return;
+    auto positions = s_positionStreams.find(vbh.idx);
+    if (positions != s_positionStreams.end())
+    {
+        bgfx::destroy(positions->second);
+        s_positionStreams.erase(positions);
+    }
+    s_meshBounds.erase(vbh.idx);
+    s_meshSizes.erase(vbh.idx);
+    bgfx::destroy(it->second.vbh);
+    bgfx::destroy(it->second.ibh);
+    s_sharedMeshes.erase(it);
+}
+
 static bgfx::TextureHandle s_pickingRT = BGFX_INVALID_HANDLE;
 static bgfx::TextureHandle s_pickingRTDepth = BGFX_INVALID_HANDLE;
 static bgfx::FrameBufferHandle s_pickingFB = BGFX_INVALID_HANDLE;
@@ -224,6 +357,19 @@ struct Instance
 
     // for comic bubble text
     std::string textContent;
+    TextMesh textMesh; // glyph quads, used instead of diffuseTexture on the SDF path
+
+    // Hatch LOD thresholds (projected size in pixels), used instead of the global ones when overridden.
+    bool overrideHatchLod = false;
+    float lodSingleLayerPx = 160.0f;
+    float lodToneOnlyPx = 40.0f;
+
+    // Imported mesh buffers this instance holds a reference on (see SharedMesh).
+    bgfx::VertexBufferHandle sharedMesh = BGFX_INVALID_HANDLE;
+
+    // Streamed scenes: the grid cell a top-level instance is written back to (see SceneStreamer.h).
+    bool inStreamCell = false;
+    SceneStreamer::CellCoord streamCell;
 
     Instance(int instanceId, const std::string& instanceName, const std::string& instanceType, float x, float y, float z, bgfx::VertexBufferHandle vbh, bgfx::IndexBufferHandle ibh)
         : id(instanceId), name(instanceName), type(instanceType), vertexBuffer(vbh), indexBuffer(ibh), textContent("A")
@@ -251,7 +397,16 @@ struct Instance
         noiseTexture = availableNoiseTextures[0].handle;
         // Store base position for animation.
         basePosition[0] = x; basePosition[1] = y; basePosition[2] = z;
+
+        if (retainSharedMesh(vbh))
+            sharedMesh = vbh;
     }
+    ~Instance() {
+        releaseSharedMesh(sharedMesh);
+        SdfText::destroyMesh(textMesh);
+    }
+    Instance(const Instance&) = delete;
+    Instance& operator=(const Instance&) = delete;
     void addChild(Instance* child) {
         children.push_back(child);
         child->parent = this;
@@ -259,37 +414,200 @@ struct Instance
 };
 static Instance* selectedInstance = nullptr;
 
+void deleteInstance(Instance* instance);
+
+// Fixed-size free lists for commands. A gizmo drag or slider edit creates one per release, so
+// keeping them out of the general heap avoids fragmenting it with thousands of tiny blocks.
+// Blocks are carved out of chunks that are never returned; sizes above the largest class fall
+// back to operator new. Main thread only.
+class CommandPool {
+    static constexpr size_t CLASS_COUNT = 3;      // 64, 128 and 256 byte blocks
+    static constexpr size_t BLOCKS_PER_CHUNK = 64;
+    std::vector<void*> freeBlocks[CLASS_COUNT];
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+
+    static size_t blockSize(size_t sizeClass) { return size_t(64) << sizeClass; }
+    static int sizeClassFor(size_t size) {
+        for (size_t c = 0; c < CLASS_COUNT; c++) {
+            if (size <= blockSize(c))
+                return int(c);
+        }
+        return -1;
+    }
+public:
+    void* allocate(size_t size) {
+        const int sizeClass = sizeClassFor(size);
+        if (sizeClass < 0)
+            return ::operator new(size);
+        std::vector<void*>& blocks = freeBlocks[sizeClass];
+        if (blocks.empty()) {
+            const size_t stride = blockSize(sizeClass);
+            chunks.push_back(std::make_unique<std::byte[]>(stride * BLOCKS_PER_CHUNK));
+            for (size_t i = BLOCKS_PER_CHUNK; i-- > 0;)
+                blocks.push_back(chunks.back().get() + i * stride);
+        }
+        void* block = blocks.back();
+        blocks.pop_back();
+        return block;
+    }
+    void release(void* block, size_t size) {
+        const int sizeClass = sizeClassFor(size);
+        if (sizeClass < 0)
+            ::operator delete(block);
+        else
+            freeBlocks[sizeClass].push_back(block);
+    }
+};
+// Defined before gCmdManager so it outlives the history it backs.
+static CommandPool s_commandPool;
+
 class ICommand {
 public:
     virtual ~ICommand() = default;
     virtual void execute() = 0;
     virtual void undo() = 0;
+    // Describes the state the last execute()/undo() left behind for the autosave journal.
+    virtual bool journalRecord(CommandJournal::Record&) const { return false; }
+    // Folds `next` (already executed) into this command when both edit the same thing, so a
+    // series of nudges to one object undoes as a single step.
+    virtual bool mergeWith(const ICommand&) { return false; }
+    // Bytes this command keeps alive, counted against the history budget.
+    virtual size_t memoryUsage() const = 0;
+    // Whether the command points at any of these instances, see CommandManager::forget().
+    virtual bool references(const std::unordered_set<const Instance*>& set) const = 0;
+    // The instance the command keeps out of the scene (deleted, or a creation that was undone).
+    virtual Instance* detachedInstance() const { return nullptr; }
+
+    // The virtual destructor makes delete pass the size of the most derived class.
+    static void* operator new(size_t size) { return s_commandPool.allocate(size); }
+    static void operator delete(void* block, size_t size) { s_commandPool.release(block, size); }
 };
 
 class CommandManager {
-    std::vector<std::unique_ptr<ICommand>> undoStack, redoStack;
+    struct Entry {
+        std::unique_ptr<ICommand> cmd;
+        size_t bytes;
+    };
+    std::deque<Entry> undoStack;
+    std::vector<Entry> redoStack;
+    size_t usedBytes = 0;
+    size_t budgetBytes = 8 * 1024 * 1024;
+    // Cleared by undo/redo so a new edit never merges into a step the user just walked back to.
+    bool mergeAllowed = false;
+    // Edits further apart than this stay separate steps even when they touch the same thing.
+    static constexpr std::chrono::milliseconds MERGE_WINDOW{ 1000 };
+    std::chrono::steady_clock::time_point lastRecorded;
+
+    static void journal(const ICommand& cmd) {
+        CommandJournal::Record record;
+        if (cmd.journalRecord(record))
+            CommandJournal::append(record);
+    }
+    Entry makeEntry(std::unique_ptr<ICommand> cmd) {
+        const size_t bytes = cmd->memoryUsage();
+        usedBytes += bytes;
+        return { std::move(cmd), bytes };
+    }
+    // Returns the command and stops counting it, memory usage can change with execute()/undo().
+    std::unique_ptr<ICommand> takeEntry(Entry& entry) {
+        usedBytes -= entry.bytes;
+        return std::move(entry.cmd);
+    }
+    void clearRedo() {
+        for (Entry& entry : redoStack)
+            usedBytes -= entry.bytes;
+        redoStack.clear();
+    }
+    // Drops the oldest steps until the history fits; the newest one is always kept.
+    void enforceBudget() {
+        while (usedBytes > budgetBytes && undoStack.size() > 1) {
+            usedBytes -= undoStack.front().bytes;
+            undoStack.pop_front();
+        }
+    }
 public:
     void executeCommand(std::unique_ptr<ICommand> cmd) {
         cmd->execute();
-        undoStack.push_back(std::move(cmd));
-        redoStack.clear();
+        recordCommand(std::move(cmd));
+    }
+    // For edits that were already applied when the command was made (spawning, widget edits).
+    void recordCommand(std::unique_ptr<ICommand> cmd) {
+        journal(*cmd);
+        clearRedo();
+        const auto now = std::chrono::steady_clock::now();
+        const bool recent = now - lastRecorded < MERGE_WINDOW;
+        lastRecorded = now;
+        if (mergeAllowed && recent && !undoStack.empty() && undoStack.back().cmd->mergeWith(*cmd))
+            return;
+        undoStack.push_back(makeEntry(std::move(cmd)));
+        mergeAllowed = true;
+        enforceBudget();
     }
     void undo() {
         if (undoStack.empty()) return;
-        auto cmd = std::move(undoStack.back());
+        auto cmd = takeEntry(undoStack.back());
         undoStack.pop_back();
         cmd->undo();
-        redoStack.push_back(std::move(cmd));
+        journal(*cmd);
+        redoStack.push_back(makeEntry(std::move(cmd)));
+        mergeAllowed = false;
     }
     void redo() {
         if (redoStack.empty()) return;
-        auto cmd = std::move(redoStack.back());
+        auto cmd = takeEntry(redoStack.back());
         redoStack.pop_back();
         cmd->execute();
-        undoStack.push_back(std::move(cmd));
+        journal(*cmd);
+        undoStack.push_back(makeEntry(std::move(cmd)));
+        mergeAllowed = false;
+        enforceBudget();
+    }
+    // Drops all history. Needed before instances are deleted outside of commands.
+    void clear() {
+        redoStack.clear();
+        undoStack.clear();
+        usedBytes = 0;
+        mergeAllowed = false;
     }
     bool canUndo() const { return !undoStack.empty(); }
     bool canRedo() const { return !redoStack.empty(); }
+    size_t historySize() const { return undoStack.size() + redoStack.size(); }
+    size_t memoryUsed() const { return usedBytes; }
+    size_t memoryBudget() const { return budgetBytes; }
+    void setMemoryBudget(size_t bytes) {
+        budgetBytes = bytes;
+        enforceBudget();
+    }
+    // Drops every step that references one of these instances, and every step that depends on
+    // one of those: older undo steps and newer redo steps. Called before instances are deleted
+    // outside of commands (scene streaming unloading a cell).
+    void forget(const std::unordered_set<const Instance*>& set) {
+        const auto referencing = [&set](const Entry& entry) { return entry.cmd->references(set); };
+        auto lastUndo = std::find_if(undoStack.rbegin(), undoStack.rend(), referencing);
+        if (lastUndo != undoStack.rend()) {
+            const auto end = lastUndo.base();
+            for (auto it = undoStack.begin(); it != end; ++it)
+                usedBytes -= it->bytes;
+            undoStack.erase(undoStack.begin(), end);
+        }
+        auto lastRedo = std::find_if(redoStack.rbegin(), redoStack.rend(), referencing);
+        if (lastRedo != redoStack.rend()) {
+            const auto end = lastRedo.base();
+            for (auto it = redoStack.begin(); it != end; ++it)
+                usedBytes -= it->bytes;
+            redoStack.erase(redoStack.begin(), end);
+        }
+    }
+    // Calls fn for every instance an undo or redo would put back into the scene.
+    template <typename Fn>
+    void forEachDetached(Fn fn) const {
+        for (const Entry& entry : undoStack)
+            if (Instance* inst = entry.cmd->detachedInstance())
+                fn(inst);
+        for (const Entry& entry : redoStack)
+            if (Instance* inst = entry.cmd->detachedInstance())
+                fn(inst);
+    }
 };
 
 class MoveCommand : public ICommand {
@@ -326,6 +644,21 @@ public:
         /*std::cout << "MoveCommand undone: " << inst->name << " to ("
             << oldPos[0] << ", " << oldPos[1] << ", " << oldPos[2] << ")\n";*/
     }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        record.kind = CommandJournal::RECORD_POSITION;
+        record.instanceId = inst->id;
+        std::copy(inst->position, inst->position + 3, record.value);
+        return true;
+    }
+    bool mergeWith(const ICommand& next) override {
+        const MoveCommand* other = dynamic_cast<const MoveCommand*>(&next);
+        if (!other || other->inst != inst)
+            return false;
+        std::copy(other->newPos, other->newPos + 3, newPos);
+        return true;
+    }
+    size_t memoryUsage() const override { return sizeof(*this); }
+    bool references(const std::unordered_set<const Instance*>& set) const override { return set.count(inst) != 0; }
 };
 
 class RotateCommand : public ICommand {
@@ -362,6 +695,21 @@ public:
         /*std::cout << "RotateCommand undone: " << inst->name << " to ("
             << oldRot[0] << ", " << oldRot[1] << ", " << oldRot[2] << ")\n";*/
     }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        record.kind = CommandJournal::RECORD_ROTATION;
+        record.instanceId = inst->id;
+        std::copy(inst->rotation, inst->rotation + 3, record.value);
+        return true;
+    }
+    bool mergeWith(const ICommand& next) override {
+        const RotateCommand* other = dynamic_cast<const RotateCommand*>(&next);
+        if (!other || other->inst != inst)
+            return false;
+        std::copy(other->newRot, other->newRot + 3, newRot);
+        return true;
+    }
+    size_t memoryUsage() const override { return sizeof(*this); }
+    bool references(const std::unordered_set<const Instance*>& set) const override { return set.count(inst) != 0; }
 };
 
 class ScaleCommand : public ICommand {
@@ -398,10 +746,280 @@ public:
         /*std::cout << "ScaleCommand undone: " << inst->name << " to ("
             << oldScale[0] << ", " << oldScale[1] << ", " << oldScale[2] << ")\n";*/
     }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        record.kind = CommandJournal::RECORD_SCALE;
+        record.instanceId = inst->id;
+        std::copy(inst->scale, inst->scale + 3, record.value);
+        return true;
+    }
+    bool mergeWith(const ICommand& next) override {
+        const ScaleCommand* other = dynamic_cast<const ScaleCommand*>(&next);
+        if (!other || other->inst != inst)
+            return false;
+        std::copy(other->newScale, other->newScale + 3, newScale);
+        return true;
+    }
+    size_t memoryUsage() const override { return sizeof(*this); }
+    bool references(const std::unordered_set<const Instance*>& set) const override { return set.count(inst) != 0; }
+};
+
+// Where an instance sat in the hierarchy, so it can be put back exactly.
+struct InstanceSlot {
+    Instance* parent = nullptr;
+    size_t index = 0;
+};
+
+static bool isSelfOrDescendant(const Instance* root, const Instance* instance) {
+    for (; instance != nullptr; instance = instance->parent) {
+        if (instance == root)
+            return true;
+    }
+    return false;
+}
+
+static InstanceSlot detachInstance(std::vector<Instance*>& instances, Instance* inst) {
+    InstanceSlot slot;
+    slot.parent = inst->parent;
+    std::vector<Instance*>& siblings = inst->parent ? inst->parent->children : instances;
+    auto it = std::find(siblings.begin(), siblings.end(), inst);
+    slot.index = size_t(it - siblings.begin());
+    if (it != siblings.end())
+        siblings.erase(it);
+    if (isSelfOrDescendant(inst, selectedInstance))
+        selectedInstance = nullptr;
+    inst->parent = nullptr;
+    return slot;
+}
+
+static void attachInstance(std::vector<Instance*>& instances, Instance* inst, const InstanceSlot& slot) {
+    std::vector<Instance*>& siblings = slot.parent ? slot.parent->children : instances;
+    siblings.insert(siblings.begin() + std::min(slot.index, siblings.size()), inst);
+    inst->parent = slot.parent;
+}
+
+static size_t subtreeMemoryUsage(const Instance* inst) {
+    size_t bytes = sizeof(Instance) + inst->name.capacity() + inst->type.capacity() + inst->textContent.capacity();
+    for (const Instance* child : inst->children)
+        bytes += subtreeMemoryUsage(child);
+    return bytes;
+}
+
+// Records a spawn or import that already happened. Undo takes the instance out of the scene and
+// keeps it (with its mesh reference) alive until the command is redone or dropped.
+class CreateCommand : public ICommand {
+    std::vector<Instance*>& instances;
+    Instance* inst;
+    InstanceSlot slot;
+    bool detached = false;
+public:
+    CreateCommand(std::vector<Instance*>& sceneInstances, Instance* i)
+        : instances(sceneInstances), inst(i) {
+        slot.parent = i->parent;
+        const std::vector<Instance*>& siblings = i->parent ? i->parent->children : sceneInstances;
+        slot.index = size_t(std::find(siblings.begin(), siblings.end(), i) - siblings.begin());
+    }
+    ~CreateCommand() override {
+        if (detached)
+            deleteInstance(inst);
+    }
+    void execute() override {
+        if (!detached) return;
+        attachInstance(instances, inst, slot);
+        detached = false;
+    }
+    void undo() override {
+        if (detached) return;
+        slot = detachInstance(instances, inst);
+        detached = true;
+    }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        // The instance does not fit in a record, replay stops here (see CommandJournal.h).
+        record.kind = CommandJournal::RECORD_CREATE;
+        record.instanceId = inst->id;
+        return true;
+    }
+    size_t memoryUsage() const override {
+        return sizeof(*this) + (detached ? subtreeMemoryUsage(inst) : 0);
+    }
+    bool references(const std::unordered_set<const Instance*>& set) const override {
+        return set.count(inst) != 0 || set.count(slot.parent) != 0;
+    }
+    Instance* detachedInstance() const override { return detached ? inst : nullptr; }
+};
+
+class DeleteCommand : public ICommand {
+    std::vector<Instance*>& instances;
+    Instance* inst;
+    InstanceSlot slot;
+    bool detached = false;
+public:
+    DeleteCommand(std::vector<Instance*>& sceneInstances, Instance* i)
+        : instances(sceneInstances), inst(i) {}
+    ~DeleteCommand() override {
+        if (detached)
+            deleteInstance(inst);
+    }
+    void execute() override {
+        if (detached) return;
+        slot = detachInstance(instances, inst);
+        detached = true;
+    }
+    void undo() override {
+        if (!detached) return;
+        attachInstance(instances, inst, slot);
+        detached = false;
+    }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        record.instanceId = inst->id;
+        if (detached) {
+            record.kind = CommandJournal::RECORD_DELETE;
+            return true;
+        }
+        // Undone: replay keeps deleted instances around, so the slot is enough to put it back.
+        record.kind = CommandJournal::RECORD_RESTORE;
+        record.value[0] = slot.parent ? float(slot.parent->id) : -1.0f;
+        record.value[1] = float(slot.index);
+        return true;
+    }
+    size_t memoryUsage() const override {
+        return sizeof(*this) + (detached ? subtreeMemoryUsage(inst) : 0);
+    }
+    bool references(const std::unordered_set<const Instance*>& set) const override {
+        return set.count(inst) != 0 || set.count(slot.parent) != 0;
+    }
+    Instance* detachedInstance() const override { return detached ? inst : nullptr; }
+};
+
+// Moves an instance under another one (nullptr for top-level), keeping its local transform.
+class ReparentCommand : public ICommand {
+    std::vector<Instance*>& instances;
+    Instance* inst;
+    InstanceSlot oldSlot;
+    Instance* newParent;
+public:
+    ReparentCommand(std::vector<Instance*>& sceneInstances, Instance* i, Instance* parent)
+        : instances(sceneInstances), inst(i), newParent(parent) {}
+    void execute() override {
+        Instance* selected = selectedInstance;
+        oldSlot = detachInstance(instances, inst);
+        InstanceSlot slot;
+        slot.parent = newParent;
+        slot.index = (newParent ? newParent->children : instances).size();
+        attachInstance(instances, inst, slot);
+        selectedInstance = selected;
+    }
+    void undo() override {
+        Instance* selected = selectedInstance;
+        detachInstance(instances, inst);
+        attachInstance(instances, inst, oldSlot);
+        selectedInstance = selected;
+    }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        record.kind = CommandJournal::RECORD_REPARENT;
+        record.instanceId = inst->id;
+        record.value[0] = inst->parent ? float(inst->parent->id) : -1.0f;
+        return true;
+    }
+    size_t memoryUsage() const override { return sizeof(*this); }
+    bool references(const std::unordered_set<const Instance*>& set) const override {
+        return set.count(inst) != 0 || set.count(oldSlot.parent) != 0 || set.count(newParent) != 0;
+    }
+};
+
+// Inspector properties that go through the undo history, the values are also journal field ids.
+enum InstanceProperty : uint16_t {
+    PROPERTY_OBJECT_COLOR,
+    PROPERTY_INK_COLOR,
+    PROPERTY_EPSILON,
+    PROPERTY_STROKE_MULTIPLIER,
+    PROPERTY_LINE_ANGLE1,
+    PROPERTY_LINE_ANGLE2,
+    PROPERTY_PATTERN_SCALE,
+    PROPERTY_LINE_THICKNESS,
+    PROPERTY_TRANSPARENCY,
+    PROPERTY_LAYER_PATTERN_SCALE,
+    PROPERTY_LAYER_STROKE_MULT,
+    PROPERTY_LAYER_ANGLE,
+    PROPERTY_LAYER_LINE_THICKNESS,
+    PROPERTY_COUNT
+};
+
+static float* instancePropertyField(Instance* inst, InstanceProperty property, int& count) {
+    count = 1;
+    switch (property) {
+    case PROPERTY_OBJECT_COLOR: count = 4; return inst->objectColor;
+    case PROPERTY_INK_COLOR: count = 4; return inst->inkColor;
+    case PROPERTY_EPSILON: return &inst->epsilonValue;
+    case PROPERTY_STROKE_MULTIPLIER: return &inst->strokeMultiplier;
+    case PROPERTY_LINE_ANGLE1: return &inst->lineAngle1;
+    case PROPERTY_LINE_ANGLE2: return &inst->lineAngle2;
+    case PROPERTY_PATTERN_SCALE: return &inst->patternScale;
+    case PROPERTY_LINE_THICKNESS: return &inst->lineThickness;
+    case PROPERTY_TRANSPARENCY: return &inst->transparencyValue;
+    case PROPERTY_LAYER_PATTERN_SCALE: return &inst->layerPatternScale;
+    case PROPERTY_LAYER_STROKE_MULT: return &inst->layerStrokeMult;
+    case PROPERTY_LAYER_ANGLE: return &inst->layerAngle;
+    case PROPERTY_LAYER_LINE_THICKNESS: return &inst->layerLineThickness;
+    default: count = 0; return nullptr;
+    }
+}
+
+class PropertyCommand : public ICommand {
+    Instance* inst;
+    InstanceProperty property;
+    float oldValue[4] = {};
+    float newValue[4] = {};
+    void apply(const float* value) {
+        int count = 0;
+        float* field = instancePropertyField(inst, property, count);
+        std::copy(value, value + count, field);
+    }
+public:
+    PropertyCommand(Instance* i, InstanceProperty p, const float* oldValues, const float* newValues)
+        : inst(i), property(p) {
+        int count = 0;
+        instancePropertyField(inst, property, count);
+        std::copy(oldValues, oldValues + count, oldValue);
+        std::copy(newValues, newValues + count, newValue);
+    }
+    void execute() override { apply(newValue); }
+    void undo() override { apply(oldValue); }
+    bool mergeWith(const ICommand& next) override {
+        const PropertyCommand* other = dynamic_cast<const PropertyCommand*>(&next);
+        if (!other || other->inst != inst || other->property != property)
+            return false;
+        std::copy(other->newValue, other->newValue + 4, newValue);
+        return true;
+    }
+    bool journalRecord(CommandJournal::Record& record) const override {
+        int count = 0;
+        const float* field = instancePropertyField(inst, property, count);
+        record.kind = CommandJournal::RECORD_PROPERTY;
+        record.field = property;
+        record.instanceId = inst->id;
+        std::copy(field, field + count, record.value);
+        return true;
+    }
+    size_t memoryUsage() const override { return sizeof(*this); }
+    bool references(const std::unordered_set<const Instance*>& set) const override { return set.count(inst) != 0; }
 };
 
 CommandManager gCmdManager;
 
+// Call right after an inspector widget bound to `property`: remembers the value when the widget
+// is grabbed and records one undo step with the before/after values when it is released.
+static void trackPropertyEdit(Instance* inst, InstanceProperty property) {
+    static float editStart[4];
+    int count = 0;
+    float* field = instancePropertyField(inst, property, count);
+    if (ImGui::IsItemActivated())
+        std::copy(field, field + count, editStart);
+    if (ImGui::IsItemDeactivatedAfterEdit())
+        gCmdManager.recordCommand(std::make_unique<PropertyCommand>(inst, property, editStart, field));
+}
+// Unsaved edits, replayed on the next start (see CommandJournal.h).
+static const char* COMMAND_JOURNAL_PATH = "saves\\autosave.journal";
+
 struct MeshData {
     std::vector<PosColorVertex> vertices;
     std::vector<uint32_t> indices;
@@ -732,7 +1350,7 @@ std::string openFileDialog(bool save) {
     ZeroMemory(&ofn, sizeof(ofn));
     ofn.lStructSize = sizeof(ofn);
     ofn.hwndOwner = NULL;
-    ofn.lpstrFilter = "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+    ofn.lpstrFilter = "Scene Files (*.txt;*.chscene)\0*.txt;*.chscene\0Text Files (*.txt)\0*.txt\0Binary Scenes (*.chscene)\0*.chscene\0All Files (*.*)\0*.*\0";
     ofn.lpstrFile = filePath;
     ofn.nMaxFile = MAX_PATH;
     ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST | OFN_NOCHANGEDIR;
@@ -971,6 +1589,62 @@ MeshData loadMesh2(const std::string& filePath) {
     return { vertices, indices };
 }
 
+// Creates the position-only copy of a vertex buffer used by the depth pre-pass and records
+// the bounding sphere used by the hatch LOD.
+void registerMeshGeometry(bgfx::VertexBufferHandle vbh, const PosColorVertex* vertices, size_t count, size_t indexCount, size_t indexSize = sizeof(uint16_t))
+{
+    if (count == 0)
+        return;
+
+    s_meshSizes[vbh.idx] = { uint32_t(indexCount / 3), count * (sizeof(PosColorVertex) + 3 * sizeof(float)) + indexCount * indexSize };
+
+    static bgfx::VertexLayout positionLayout;
+    if (positionLayout.getStride() == 0) {
+        positionLayout.begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .end();
+    }
+
+    const bgfx::Memory* mem = bgfx::alloc(uint32_t(count * 3 * sizeof(float)));
+    float* dst = reinterpret_cast<float*>(mem->data);
+    for (size_t i = 0; i < count; i++) {
+        dst[i * 3 + 0] = vertices[i].x;
+        dst[i * 3 + 1] = vertices[i].y;
+        dst[i * 3 + 2] = vertices[i].z;
+    }
+    s_positionStreams[vbh.idx] = bgfx::createVertexBuffer(mem, positionLayout);
+
+    float minP[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    float maxP[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+    for (size_t i = 1; i < count; i++) {
+        const float p[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+        for (int a = 0; a < 3; a++) {
+            minP[a] = std::min(minP[a], p[a]);
+            maxP[a] = std::max(maxP[a], p[a]);
+        }
+    }
+    MeshBounds bounds;
+    float radiusSq = 0.0f;
+    for (int a = 0; a < 3; a++)
+        bounds.center[a] = 0.5f * (minP[a] + maxP[a]);
+    for (size_t i = 0; i < count; i++) {
+        const float dx = vertices[i].x - bounds.center[0];
+        const float dy = vertices[i].y - bounds.center[1];
+        const float dz = vertices[i].z - bounds.center[2];
+        radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+    }
+    bounds.radius = std::sqrt(radiusSq);
+    s_meshBounds[vbh.idx] = bounds;
+}
+
+bgfx::VertexBufferHandle positionStreamFor(bgfx::VertexBufferHandle vbh)
+{
+    auto it = s_positionStreams.find(vbh.idx);
+    if (it == s_positionStreams.end())
+        return BGFX_INVALID_HANDLE;
+    return it->second;
+}
+
 void createMeshBuffers(const MeshData& meshData, bgfx::VertexBufferHandle& vbh, bgfx::IndexBufferHandle& ibh) {
     bgfx::VertexLayout layout;
     layout.begin()
@@ -984,9 +1658,11 @@ void createMeshBuffers(const MeshData& meshData, bgfx::VertexBufferHandle& vbh,
         bgfx::copy(meshData.vertices.data(), sizeof(PosColorVertex) * meshData.vertices.size()),
         layout
     );
-
     // Detect if we need 32-bit indices
-    if (meshData.vertices.size() > std::numeric_limits<uint16_t>::max()) {
+    const bool index32 = meshData.vertices.size() > std::numeric_limits<uint16_t>::max();
+    registerMeshGeometry(vbh, meshData.vertices.data(), meshData.vertices.size(), meshData.indices.size(), index32 ? sizeof(uint32_t) : sizeof(uint16_t));
+
+    if (index32) {
         std::cout << "Using 32-bit index buffer due to high poly count.\n";
         ibh = bgfx::createIndexBuffer(
             bgfx::copy(meshData.indices.data(), sizeof(uint32_t) * meshData.indices.size()),
@@ -1029,27 +1705,6 @@ float getRandomFloat()
     return dist(gen);
 }
 
-bgfx::ShaderHandle loadShader(const char* shaderPath)
-{
-    std::ifstream file(shaderPath, std::ios::binary);
-    if (!file)
-    {
-        std::cerr << "Failed to load shader: " << shaderPath << std::endl;
-        return BGFX_INVALID_HANDLE;
-    }
-
-    file.seekg(0, std::ios::end);
-    std::streampos fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<char> buffer(static_cast<size_t>(fileSize));
-    file.read(buffer.data(), fileSize);
-
-    const bgfx::Memory* mem = bgfx::copy(buffer.data(), static_cast<uint32_t>(fileSize));
-    //std::cout << "Shader loaded: " << shaderPath << std::endl;
-    return bgfx::createShader(mem);
-}
-
 const bgfx::Memory* loadMem(const char* _filePath)
 {
     std::ifstream file(_filePath, std::ios::binary | std::ios::ate);
@@ -1089,6 +1744,7 @@ bgfx::TextureHandle loadTextureDDS(const char* _filePath)
 // The new function that checks extension and calls either your DDS loader or stb_image.
 bgfx::TextureHandle loadTextureFile(const char* filePath)
 {
+    TRACE_ZONE("loadTextureFile");
     fs::path p(filePath);
     std::string ext = p.extension().string();
     // Convert extension to lowercase
@@ -1222,21 +1878,87 @@ bool IsWhite(const float color[4], float epsilon = 0.001f)
         std::fabs(color[2] - 1.0f) < epsilon &&
         std::fabs(color[3] - 1.0f) < epsilon;
 }
+// Returns the baked hatch layers for this instance, or an invalid handle if the
+// procedural shader has to be used (mode without a TAM path, not baked yet, unsupported).
+bgfx::TextureHandle requestTonalArtMap(const Instance* instance, bgfx::TextureHandle noise)
+{
+    if (!useTonalArtMaps || !bgfx::isValid(tamProgram))
+        return BGFX_INVALID_HANDLE;
+
+    const int mode = useGlobalCrosshatchSettings ? crosshatchMode : instance->crosshatchMode;
+    if (mode < 1 || mode > 3)
+        return BGFX_INVALID_HANDLE;
+
+    TamParams params;
+    params.noise = noise;
+    if (useGlobalCrosshatchSettings) {
+        params.strokeMultiplier = strokeMultiplier;
+        params.lineThickness = lineThickness;
+        params.epsilon = epsilonValue;
+        params.layerStrokeMult = layerStrokeMult;
+        params.layerLineThickness = layerLineThickness;
+    }
+    else {
+        params.strokeMultiplier = instance->strokeMultiplier;
+        params.lineThickness = instance->lineThickness;
+        params.epsilon = instance->epsilonValue;
+        params.layerStrokeMult = instance->layerStrokeMult;
+        params.layerLineThickness = instance->layerLineThickness;
+    }
+    return TonalArtMap::request(params);
+}
+
+// Packs the values f_out28 would read from uniforms for this instance.
+DeferredObjectParams makeDeferredParams(const Instance* instance, const float* effectiveColor, const float* tint)
+{
+    DeferredObjectParams params;
+    std::memcpy(params.objectColor, effectiveColor, sizeof(params.objectColor));
+    std::memcpy(params.tint, tint, sizeof(params.tint));
+    if (useGlobalCrosshatchSettings) {
+        std::memcpy(params.inkColor, inkColor, sizeof(params.inkColor));
+        const float hatch[4] = { epsilonValue, strokeMultiplier, lineAngle1, lineAngle2 };
+        const float extra[4] = { patternScale, lineThickness, transparencyValue, float(crosshatchMode) };
+        const float layer[4] = { layerPatternScale, layerStrokeMult, layerAngle, layerLineThickness };
+        std::memcpy(params.hatch, hatch, sizeof(hatch));
+        std::memcpy(params.extra, extra, sizeof(extra));
+        std::memcpy(params.layer, layer, sizeof(layer));
+    }
+    else {
+        std::memcpy(params.inkColor, instance->inkColor, sizeof(params.inkColor));
+        const float hatch[4] = { instance->epsilonValue, instance->strokeMultiplier, instance->lineAngle1, instance->lineAngle2 };
+        const float extra[4] = { instance->patternScale, instance->lineThickness, instance->transparencyValue, float(instance->crosshatchMode) };
+        const float layer[4] = { instance->layerPatternScale, instance->layerStrokeMult, instance->layerAngle, instance->layerLineThickness };
+        std::memcpy(params.hatch, hatch, sizeof(hatch));
+        std::memcpy(params.extra, extra, sizeof(extra));
+        std::memcpy(params.layer, layer, sizeof(layer));
+    }
+    return params;
+}
+
+// Picks the hatch LOD of a hatched instance and rewrites its resolved parameters, see
+// FrameMath::hatchLod().
+int applyHatchLod(DeferredObjectParams& params, const Instance* instance, const float* world)
+{
+    if (!useHatchLod || instance->type == "light" || instance->type == "text"
+        || instance->type == "comicborder" || instance->type.rfind("comicbubble", 0) == 0)
+        return FrameMath::HATCH_LOD_FULL;
+    auto it = s_meshBounds.find(instance->vertexBuffer.idx);
+    if (it == s_meshBounds.end())
+        return FrameMath::HATCH_LOD_FULL;
+
+    const MeshBounds& bounds = it->second;
+    const float singleLayerPx = instance->overrideHatchLod ? instance->lodSingleLayerPx : hatchLodSingleLayerPx;
+    const float toneOnlyPx = instance->overrideHatchLod ? instance->lodToneOnlyPx : hatchLodToneOnlyPx;
+    return FrameMath::hatchLod(bounds.center, bounds.radius, world, s_lodEyePos, s_lodPixelsPerUnit,
+        singleLayerPx, toneOnlyPx, params.hatch, params.extra, params.layer);
+}
+
 // Recursive draw function for hierarchy.
 void drawInstance(Instance* instance, bgfx::ProgramHandle defaultProgram, bgfx::ProgramHandle lightDebugProgram, bgfx::ProgramHandle textProgram, bgfx::ProgramHandle comicProgram, bgfx::UniformHandle u_comicColor, bgfx::UniformHandle u_noiseTex, bgfx::UniformHandle u_diffuseTex, bgfx::UniformHandle u_objectColor, bgfx::UniformHandle u_tint, bgfx::UniformHandle u_inkColor, bgfx::UniformHandle u_e, bgfx::UniformHandle u_params, bgfx::UniformHandle u_extraParams, bgfx::UniformHandle u_paramsLayer,
     bgfx::TextureHandle defaultWhiteTexture, bgfx::TextureHandle inheritedNoiseTex, bgfx::TextureHandle inheritedTexture, const float* parentColor = nullptr, const float* parentTransform = nullptr)
 {
-    float local[16];
-    bx::mtxSRT(local,
-        instance->scale[0], instance->scale[1], instance->scale[2],
-        instance->rotation[0], instance->rotation[1], instance->rotation[2],
-        instance->position[0], instance->position[1], instance->position[2]);
-
     float world[16];
-    if (parentTransform)
-        bx::mtxMul(world, local, parentTransform);
-    else
-        std::memcpy(world, local, sizeof(world));
+    FrameMath::worldMatrix(world, instance->scale, instance->rotation, instance->position, parentTransform);
 
     instance->worldPosition[0] = world[12];
     instance->worldPosition[1] = world[13];
@@ -1268,12 +1990,8 @@ void drawInstance(Instance* instance, bgfx::ProgramHandle defaultProgram, bgfx::
     bgfx::setUniform(u_albedoFactor, instance->material.albedo);
     const float tintBasic[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
     const float tintHighlighted[4] = { 0.3f, 0.3f, 2.0f, 0.1f };
-    if (selectedInstance == instance && highlightVisible) {
-        bgfx::setUniform(u_tint, tintHighlighted);
-    }
-    else {
-        bgfx::setUniform(u_tint, tintBasic);
-    }
+    const float* tint = (selectedInstance == instance && highlightVisible) ? tintHighlighted : tintBasic;
+    bgfx::setUniform(u_tint, tint);
     if (!useGlobalCrosshatchSettings) {
         bgfx::setUniform(u_inkColor, instance->inkColor);
         // Set epsilon uniform:
@@ -1296,12 +2014,43 @@ void drawInstance(Instance* instance, bgfx::ProgramHandle defaultProgram, bgfx::
         // Set the uniform for extra parameters.
         bgfx::setUniform(u_paramsLayer, paramsLayerUniform);
     }
+    // The LOD rewrites the resolved parameters, so they are uploaded for every draw while it is on
+    // (uniforms stick across submits).
+    DeferredObjectParams hatchParams = makeDeferredParams(instance, effectiveColor, tint);
+    int hatchLod = FrameMath::HATCH_LOD_FULL;
+    if (useHatchLod) {
+        hatchLod = applyHatchLod(hatchParams, instance, world);
+        const float epsilonUniform[4] = { hatchParams.hatch[0], 0.0f, 0.0f, 0.0f };
+        const float paramsUniform[4] = { 0.0f, hatchParams.hatch[1], hatchParams.hatch[2], hatchParams.hatch[3] };
+        bgfx::setUniform(u_e, epsilonUniform);
+        bgfx::setUniform(u_params, paramsUniform);
+        bgfx::setUniform(u_extraParams, hatchParams.extra);
+        bgfx::setUniform(u_paramsLayer, hatchParams.layer);
+    }
     const bgfx::VertexBufferHandle invalidVbh = BGFX_INVALID_HANDLE;
     const bgfx::IndexBufferHandle invalidIbh = BGFX_INVALID_HANDLE;
     // Draw geometry if valid.
     if (instance->vertexBuffer.idx != invalidVbh.idx &&
         instance->indexBuffer.idx != invalidIbh.idx)
     {
+        // Depth pre-pass: lay down depth with the position-only stream before the real draw.
+        const bool hatchedDraw = instance->type != "light" && instance->type != "text"
+            && instance->type != "comicborder" && instance->type.rfind("comicbubble", 0) != 0;
+        bool prepassed = false;
+        if (s_depthPrepassFrame && hatchedDraw)
+        {
+            bgfx::VertexBufferHandle positions = positionStreamFor(instance->vertexBuffer);
+            if (bgfx::isValid(positions))
+            {
+                bgfx::setTransform(world);
+                bgfx::setVertexBuffer(0, positions);
+                bgfx::setIndexBuffer(instance->indexBuffer);
+                bgfx::setState(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS | BGFX_STATE_CULL_CW | BGFX_STATE_MSAA);
+                bgfx::submit(VIEW_DEPTH_PREPASS, depthPrepassProgram);
+                prepassed = true;
+            }
+        }
+
         bgfx::setTransform(world);
         bgfx::setVertexBuffer(0, instance->vertexBuffer);
         bgfx::setIndexBuffer(instance->indexBuffer);
@@ -1358,21 +2107,54 @@ void drawInstance(Instance* instance, bgfx::ProgramHandle defaultProgram, bgfx::
                 // Enable alpha blending for text rendering
                 bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A |
                     BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA));
-                bgfx::submit(0, textProgram);
+                if (bgfx::isValid(instance->textMesh.vertices))
+                {
+                    // Glyph quads replace the text quad and its texture bound above.
+                    if (SdfText::bind(instance->textMesh, 1, u_diffuseTex))
+                        bgfx::submit(VIEW_SCENE, sdfTextProgram);
+                    else
+                        bgfx::discard(); // empty text
+                }
+                else
+                {
+                    bgfx::submit(VIEW_SCENE, textProgram);
+                }
             }
             else if (instance->type == "comicborder" || instance->type == "comicbubble") {
                 bgfx::setState(BGFX_STATE_DEFAULT);
 
                 // Set the comic color uniform (see below for how it's updated via ImGui).
                 bgfx::setUniform(u_comicColor, comicColor);
-                bgfx::submit(0, comicProgram);
+                bgfx::submit(VIEW_SCENE, comicProgram);
             }
             else
             {
                 // Use default or debug shader
-                bgfx::setState(BGFX_STATE_DEFAULT);
-
-                bgfx::submit(0, (instance->type == "light") ? lightDebugProgram : defaultProgram);
+                // Pre-passed geometry already has its depth, only the visible surface is shaded.
+                bgfx::setState(prepassed
+                    ? (BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_DEPTH_TEST_EQUAL | BGFX_STATE_CULL_CW | BGFX_STATE_MSAA)
+                    : BGFX_STATE_DEFAULT);
+
+                bgfx::ProgramHandle program = defaultProgram;
+                bgfx::ViewId viewId = VIEW_SCENE;
+                if (instance->type == "light") {
+                    program = lightDebugProgram;
+                }
+                else if (useDeferredShading && DeferredRenderer::isAvailable() && noiseTextureToUse.idx == noiseTexture.idx
+                    && DeferredRenderer::bindObject(hatchParams)) {
+                    // The fullscreen pass binds a single noise texture, objects with their own noise stay forward.
+                    program = DeferredRenderer::gbufferProgram();
+                    viewId = VIEW_GBUFFER;
+                }
+                else if (hatchLod != FrameMath::HATCH_LOD_TONE_ONLY) {
+                    bgfx::TextureHandle tam = requestTonalArtMap(instance, noiseTextureToUse);
+                    if (bgfx::isValid(tam)) {
+                        bgfx::setTexture(2, u_tamTex, tam);
+                        program = tamProgram;
+                    }
+                }
+                s_hatchLodCounts[hatchLod]++;
+                bgfx::submit(viewId, program);
             }
         }
     }
@@ -1410,6 +2192,11 @@ void deleteInstance(Instance* instance)
     }
     delete instance;
 }
+// A drop onto a tree node is applied once the whole tree is drawn, the tree iterates the very
+// child lists a reparent changes.
+static Instance* s_pendingReparentChild = nullptr;
+static Instance* s_pendingReparentParent = nullptr;
+
 // Recursive function to show the instance hierarchy in a tree view.
 void ShowInstanceTree(Instance* instance, Instance*& selectedInstance, std::vector<Instance*>& instances)
 {
@@ -1520,25 +2307,11 @@ void ShowInstanceTree(Instance* instance, Instance*& selectedInstance, std::vect
         {
             // Get the instance being dragged
             Instance* dropped = *(Instance**)payload->Data;
-            if (dropped != instance)
+            // Dropping a node onto itself or one of its own children would make a cycle.
+            if (!isSelfOrDescendant(dropped, instance))
             {
-                // Remove the dropped instance from its current parent's children list
-                if (dropped->parent)
-                {
-                    auto it = std::find(dropped->parent->children.begin(),
-                        dropped->parent->children.end(), dropped);
-                    if (it != dropped->parent->children.end())
-                        dropped->parent->children.erase(it);
-                }
-                else
-                {
-                    // If it's top-level, remove it from the global instances vector.
-                    auto it = std::find(instances.begin(), instances.end(), dropped);
-                    if (it != instances.end())
-                        instances.erase(it);
-                }
-                // Add the dropped instance as a child of the current node.
-                instance->addChild(dropped);
+                s_pendingReparentChild = dropped;
+                s_pendingReparentParent = instance;
             }
         }
         ImGui::EndDragDropTarget();
@@ -1554,136 +2327,88 @@ void ShowInstanceTree(Instance* instance, Instance*& selectedInstance, std::vect
     }
 }
 
-// Helper function to quote strings for output
-std::string quote_if_needed(const std::string& s) {
-    // Simple check for spaces, or always quote strings
-    // For more robust quoting, you might check for other special characters too
-    // or just always quote.
-    if (s.find(' ') != std::string::npos || s.find('\t') != std::string::npos || s.find('"') != std::string::npos) {
-        std::string quoted_s = "\"";
-        for (char c : s) {
-            if (c == '"') {
-                quoted_s += "\\\""; // Escape existing quotes
-            }
-            else if (c == '\\') {
-                quoted_s += "\\\\"; // Escape backslashes
-            }
-            else {
-                quoted_s += c;
-            }
-        }
-        quoted_s += "\"";
-        return quoted_s;
-    }
-    return s;
-}
-
-// Helper function to read a potentially quoted string from an istringstream
-std::string read_quoted_string(std::istringstream& iss) {
-    std::string token;
-    iss >> token; // Read the first part
-
-    if (!token.empty() && token.front() == '"') {
-        std::string result = token.substr(1); // Remove leading quote
-        bool in_escape = false;
-        // If the token didn't end with a quote (and it wasn't an escaped quote)
-        while (result.empty() || result.back() != '"' || (result.length() > 1 && result[result.length() - 2] == '\\' && !in_escape)) {
-            if (iss.eof()) { // Reached end of stream unexpectedly
-                // Handle error: unclosed quote
-                throw std::runtime_error("Unclosed quote in input stream");
-            }
-            std::string next_part;
-            iss >> next_part;
-            if (!result.empty()) result += " "; // Add back the space delimiter
-            result += next_part;
-        }
+// Texture handle index -> name, built once per save instead of scanning the texture lists per instance.
+using TextureNameMap = std::unordered_map<uint16_t, std::string>;
 
-        // Remove trailing quote if it's not escaped
-        if (!result.empty() && result.back() == '"') {
-            // Check if it's an escaped quote (e.g., "abc\\\"")
-            int trailing_backslashes = 0;
-            for (auto it = result.rbegin() + 1; it != result.rend() && *it == '\\'; ++it) {
-                trailing_backslashes++;
-            }
-            if (trailing_backslashes % 2 == 0) { // Not an escaped quote
-                result.pop_back();
-            }
-        }
-
-
-        // Unescape characters
-        std::string unescaped_result;
-        unescaped_result.reserve(result.length());
-        for (size_t i = 0; i < result.length(); ++i) {
-            if (result[i] == '\\' && i + 1 < result.length()) {
-                if (result[i + 1] == '"' || result[i + 1] == '\\') {
-                    unescaped_result += result[i + 1];
-                    i++; // Skip the escaped character
-                }
-                else {
-                    unescaped_result += result[i]; // Not a recognized escape sequence, keep the backslash
-                }
-            }
-            else {
-                unescaped_result += result[i];
-            }
-        }
-        return unescaped_result;
-
-    }
-    else {
-        // Not a quoted string, or an empty string if that's how you write it
-        return token;
-    }
+TextureNameMap buildTextureNameMap(const std::vector<TextureOption>& textures)
+{
+    TextureNameMap names;
+    names.reserve(textures.size());
+    for (const auto& tex : textures)
+        names.emplace(tex.handle.idx, tex.name); // first entry wins, like the old linear search
+    return names;
 }
 
-void saveInstance(std::ofstream& file, const Instance* instance,
-    const std::vector<TextureOption>& availableTextures, int parentID = -1)
+const std::string& lookupTextureName(const TextureNameMap& names, bgfx::TextureHandle handle)
 {
-    std::string textureName = "none";
-    for (const auto& tex : availableTextures)
-    {
-        if (instance->diffuseTexture.idx == tex.handle.idx)
-        {
-            textureName = tex.name;
-            break;
-        }
-    }
-
-    std::string noiseTextureName = "none";
-    for (const auto& tex : availableNoiseTextures)
-    {
-        if (instance->noiseTexture.idx == tex.handle.idx)
-        {
-            noiseTextureName = tex.name;
-            break;
-        }
-    }
+    static const std::string none = "none";
+    auto it = names.find(handle.idx);
+    return it != names.end() ? it->second : none;
+}
 
-    file << instance->id << " " << quote_if_needed(instance->type) << " " << quote_if_needed(instance->name) << " " << instance->meshNumber << " "
-        << instance->position[0] << " " << instance->position[1] << " " << instance->position[2] << " "
-        << instance->rotation[0] << " " << instance->rotation[1] << " " << instance->rotation[2] << " "
-        << instance->scale[0] << " " << instance->scale[1] << " " << instance->scale[2] << " "
-        << instance->objectColor[0] << " " << instance->objectColor[1] << " " << instance->objectColor[2] << " " << instance->objectColor[3] << " "
-        << quote_if_needed(textureName) << " " << quote_if_needed(noiseTextureName) << " " << parentID << " " << static_cast<int>(instance->lightProps.type) << " " << instance->lightProps.direction[0] << " "
-        << instance->lightProps.direction[1] << " " << instance->lightProps.direction[2] << " " << instance->lightProps.intensity << " "
-        << instance->lightProps.range << " " << instance->lightProps.coneAngle << " " << instance->lightProps.color[0] << " "
-        << instance->lightProps.color[1] << " " << instance->lightProps.color[2] << " " << instance->lightProps.color[3] << " "
-        << instance->inkColor[0] << " " << instance->inkColor[1] << " " << instance->inkColor[2] << " " << instance->inkColor[3] << " "
-        << instance->epsilonValue << " " << instance->strokeMultiplier << " " << instance->lineAngle1 << " " << instance->lineAngle2 << " "
-        << instance->patternScale << " " << instance->lineThickness << " " << instance->transparencyValue << " " << instance->crosshatchMode << " "
-        << instance->layerPatternScale << " " << instance->layerStrokeMult << " " << instance->layerAngle << " " << instance->layerLineThickness << " "
-        << instance->centerX << " " << instance->centerZ << " " << instance->radius << " " << instance->rotationSpeed << " " << instance->instanceAngle << " "
-        << instance->basePosition[0] << " " << instance->basePosition[1] << " " << instance->basePosition[2] << " "
-        << instance->lightAnim.amplitude[0] << " " << instance->lightAnim.amplitude[1] << " " << instance->lightAnim.amplitude[2] << " "
-        << instance->lightAnim.frequency[0] << " " << instance->lightAnim.frequency[1] << " " << instance->lightAnim.frequency[2] << " "
-        << instance->lightAnim.phase[0] << " " << instance->lightAnim.phase[1] << " " << instance->lightAnim.phase[2] << " "
-        << static_cast<int>(instance->lightAnim.enabled) << " " << quote_if_needed(instance->textContent) << "\n"; // Save `type` and parentID
+// Adds the instance and its children depth-first, so parents always come before their children.
+void addInstanceRecords(SceneSerializer::SceneData& scene, const Instance* instance,
+    const TextureNameMap& textureNames, const TextureNameMap& noiseTextureNames, int parentID = -1)
+{
+    SceneSerializer::SceneRecord r;
+    r.id = instance->id;
+    r.parentId = parentID;
+    r.meshNumber = instance->meshNumber;
+    r.lightType = static_cast<int32_t>(instance->lightProps.type);
+    r.crosshatchMode = instance->crosshatchMode;
+    if (instance->lightAnim.enabled)
+        r.flags |= SceneSerializer::RECORD_ANIMATION_ENABLED;
+    if (instance->overrideHatchLod)
+        r.flags |= SceneSerializer::RECORD_OVERRIDE_HATCH_LOD;
+
+    r.type = scene.addString(instance->type);
+    r.name = scene.addString(instance->name);
+    r.texture = scene.addString(lookupTextureName(textureNames, instance->diffuseTexture));
+    r.noiseTexture = scene.addString(lookupTextureName(noiseTextureNames, instance->noiseTexture));
+    r.textContent = scene.addString(instance->textContent);
+
+    std::copy(instance->position, instance->position + 3, r.position);
+    std::copy(instance->rotation, instance->rotation + 3, r.rotation);
+    std::copy(instance->scale, instance->scale + 3, r.scale);
+    std::copy(instance->objectColor, instance->objectColor + 4, r.objectColor);
+
+    std::copy(instance->lightProps.direction, instance->lightProps.direction + 3, r.lightDirection);
+    r.lightIntensity = instance->lightProps.intensity;
+    r.lightRange = instance->lightProps.range;
+    r.lightConeAngle = instance->lightProps.coneAngle;
+    std::copy(instance->lightProps.color, instance->lightProps.color + 4, r.lightColor);
+
+    std::copy(instance->inkColor, instance->inkColor + 4, r.inkColor);
+    r.epsilonValue = instance->epsilonValue;
+    r.strokeMultiplier = instance->strokeMultiplier;
+    r.lineAngle1 = instance->lineAngle1;
+    r.lineAngle2 = instance->lineAngle2;
+    r.patternScale = instance->patternScale;
+    r.lineThickness = instance->lineThickness;
+    r.transparencyValue = instance->transparencyValue;
+    r.layerPatternScale = instance->layerPatternScale;
+    r.layerStrokeMult = instance->layerStrokeMult;
+    r.layerAngle = instance->layerAngle;
+    r.layerLineThickness = instance->layerLineThickness;
+
+    r.centerX = instance->centerX;
+    r.centerZ = instance->centerZ;
+    r.radius = instance->radius;
+    r.rotationSpeed = instance->rotationSpeed;
+    r.instanceAngle = instance->instanceAngle;
+    std::copy(instance->basePosition, instance->basePosition + 3, r.basePosition);
+    std::copy(instance->lightAnim.amplitude, instance->lightAnim.amplitude + 3, r.animAmplitude);
+    std::copy(instance->lightAnim.frequency, instance->lightAnim.frequency + 3, r.animFrequency);
+    std::copy(instance->lightAnim.phase, instance->lightAnim.phase + 3, r.animPhase);
+
+    r.lodSingleLayerPx = instance->lodSingleLayerPx;
+    r.lodToneOnlyPx = instance->lodToneOnlyPx;
+    scene.addRecord(r);
 
     // Recursively save children
     for (const Instance* child : instance->children)
     {
-        saveInstance(file, child, availableTextures, instance->id);
+        addInstanceRecords(scene, child, textureNames, noiseTextureNames, instance->id);
     }
 }
 void SaveImportedObjMap(const std::unordered_map<std::string, std::string>& map, const std::string& filePath)
@@ -1733,21 +2458,24 @@ void saveSceneToFile(std::vector<Instance*>& instances, const std::vector<Textur
     std::string saveFilePath = openFileDialog(true); // Open save dialog
     if (saveFilePath.empty()) return; // Exit if no file was chosen
 
-    std::ofstream file(saveFilePath);
-    if (!file.is_open())
-    {
-        std::cerr << "Failed to save scene!" << std::endl;
-        return;
-    }
-
+    TRACE_ZONE("saveScene snapshot");
+    // Snapshot the scene here, the worker thread only ever sees the copy.
+    auto scene = std::make_unique<SceneSerializer::SceneData>();
+    scene->settings.depthPrepass = useDepthPrepass;
+    scene->settings.hatchLod = useHatchLod;
+    scene->settings.hatchLodSingleLayerPx = hatchLodSingleLayerPx;
+    scene->settings.hatchLodToneOnlyPx = hatchLodToneOnlyPx;
+    const TextureNameMap textureNames = buildTextureNameMap(availableTextures);
+    const TextureNameMap noiseTextureNames = buildTextureNameMap(availableNoiseTextures);
     for (const Instance* instance : instances)
     {
         // Ensure top-level instances are saved first (with no parent)
-        saveInstance(file, instance, availableTextures, -1);
+        addInstanceRecords(*scene, instance, textureNames, noiseTextureNames, -1);
     }
 
-    file.close();
-    std::cout << "Scene saved to " << saveFilePath << std::endl;
+    // The extension picks the format, text stays the default for anything else.
+    SceneSaver::saveAsync(std::move(scene), saveFilePath, CommandJournal::sequence());
+    std::cout << "Saving scene to " << saveFilePath << std::endl;
 
     std::filesystem::path scenePath = saveFilePath;
     std::filesystem::path sceneDirectory = scenePath.parent_path();
@@ -1776,6 +2504,7 @@ struct ImportedMesh {
     MeshData meshData;
     aiMatrix4x4 transform; // Global transform (accumulated from the scene hierarchy)
     bgfx::TextureHandle diffuseTexture; // Diffuse texture for this mesh, if available.
+    std::string diffuseTexturePath;     // File it was (or, when not loaded yet, will be) loaded from.
     float diffuseColor[4]; // To store Kd from MTL
     bool hasDiffuseColor;  // Flag to indicate if diffuseColor was loaded
 
@@ -1787,9 +2516,11 @@ struct ImportedMesh {
 
 // Recursive function to traverse the scene graph.
 // The additional 'baseDir' parameter lets us resolve relative texture paths.
+// Without loadTextures only the texture paths are recorded, so it can run off the main thread.
 void processNode(const aiScene* scene, aiNode* node, const aiMatrix4x4& parentTransform,
-    const std::string& baseDir, std::vector<ImportedMesh>& importedMeshes)
+    const std::string& baseDir, std::vector<ImportedMesh>& importedMeshes, bool loadTextures)
 {
+    TRACE_ZONE("processNode");
     aiMatrix4x4 globalTransform = parentTransform * node->mTransformation;
 
     // Process each mesh referenced by this node.
@@ -1872,12 +2603,15 @@ void processNode(const aiScene* scene, aiNode* node, const aiMatrix4x4& parentTr
                 fs::path fullTexPath = fs::path(baseDir) / textureFile;
                 std::string normalizedTexPath = ConvertBackslashesToForward(fullTexPath.string());
                 std::cout << "[DEBUG] Found baseColor texture: " << normalizedTexPath << std::endl;
-                bgfx::TextureHandle texHandle = loadTextureFile(normalizedTexPath.c_str());
+                impMesh.diffuseTexturePath = normalizedTexPath;
+                bgfx::TextureHandle texHandle = BGFX_INVALID_HANDLE;
+                if (loadTextures)
+                    texHandle = loadTextureFile(normalizedTexPath.c_str());
                 if (bgfx::isValid(texHandle)) {
                     std::cout << "[DEBUG] Successfully loaded texture: " << normalizedTexPath << std::endl;
                     impMesh.diffuseTexture = texHandle;
                 }
-                else {
+                else if (loadTextures) {
                     std::cout << "[DEBUG] FAILED to load texture: " << normalizedTexPath << std::endl;
                 }
             }
@@ -1887,12 +2621,15 @@ void processNode(const aiScene* scene, aiNode* node, const aiMatrix4x4& parentTr
                 fs::path fullTexPath = fs::path(baseDir) / textureFile;
                 std::string normalizedTexPath = ConvertBackslashesToForward(fullTexPath.string());
                 std::cout << "[DEBUG] Found diffuse texture (fallback): " << normalizedTexPath << std::endl;
-                bgfx::TextureHandle texHandle = loadTextureFile(normalizedTexPath.c_str());
+                impMesh.diffuseTexturePath = normalizedTexPath;
+                bgfx::TextureHandle texHandle = BGFX_INVALID_HANDLE;
+                if (loadTextures)
+                    texHandle = loadTextureFile(normalizedTexPath.c_str());
                 if (bgfx::isValid(texHandle)) {
                     std::cout << "[DEBUG] Successfully loaded texture: " << normalizedTexPath << std::endl;
                     impMesh.diffuseTexture = texHandle;
                 }
-                else {
+                else if (loadTextures) {
                     std::cout << "[DEBUG] FAILED to load texture: " << normalizedTexPath << std::endl;
                 }
             }
@@ -1931,26 +2668,29 @@ void processNode(const aiScene* scene, aiNode* node, const aiMatrix4x4& parentTr
 
     // Recursively process child nodes.
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(scene, node->mChildren[i], globalTransform, baseDir, importedMeshes);
+        processNode(scene, node->mChildren[i], globalTransform, baseDir, importedMeshes, loadTextures);
     }
 }
 
 // Load the file and extract all meshes, their transforms, and diffuse textures.
 // The baseDir is computed from the model file path.
-std::vector<ImportedMesh> loadImportedMeshes(const std::string& filePath) {
+std::vector<ImportedMesh> loadImportedMeshes(const std::string& filePath, bool loadTextures = true) {
+    TRACE_ZONE("loadImportedMeshes");
     Assimp::Importer importer;
+    Trace::Zone readZone("Assimp::ReadFile");
     const aiScene* scene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_PreTransformVertices);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cerr << "Error: Assimp - " << importer.GetErrorString() << std::endl;
         return {};
     }
+    readZone.end();
 
     std::vector<ImportedMesh> importedMeshes;
     aiMatrix4x4 identity; // Identity matrix
     // Determine the base directory from the model file path.
     fs::path modelPath(filePath);
     std::string baseDir = modelPath.parent_path().string();
-    processNode(scene, scene->mRootNode, identity, baseDir, importedMeshes);
+    processNode(scene, scene->mRootNode, identity, baseDir, importedMeshes, loadTextures);
 
     // ---- Per–Mesh Recentering (as before) ----
     for (auto& impMesh : importedMeshes) {
@@ -1994,6 +2734,9 @@ void findMaxInstanceId(const Instance* instance, int& maxId) {
 
 // for comic bubble text
 void updateTextTexture(Instance* textInst) {
+    // Editing the text only rebuilds its glyph quads; the atlas is shared by all text.
+    if (SdfText::updateMesh(textInst->textMesh, textInst->textContent))
+        return;
     bgfx::TextureHandle newTex = createTextTexture(textInst->textContent);
     if (bgfx::isValid(newTex)) {
         // If an old texture exists, destroy it.
@@ -2004,207 +2747,555 @@ void updateTextTexture(Instance* textInst) {
     }
 }
 
-std::unordered_map<std::string, std::string> loadSceneFromFile(std::vector<Instance*>& instances,
+// Builds an instance from a scene record. Mesh buffers are resolved by the caller (built-in,
+// imported or streamed), parents are linked once all records of the scene exist.
+Instance* createInstanceFromRecord(const SceneSerializer::SceneData& scene, const SceneSerializer::SceneRecord& r,
+    bgfx::VertexBufferHandle vbh, bgfx::IndexBufferHandle ibh, bgfx::TextureHandle diffuseTexture,
     const std::vector<TextureOption>& availableTextures,
     const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap)
 {
-    selectedInstance = nullptr;
-    std::string loadFilePath = openFileDialog(false);
-    std::string importedObjMapPath = fs::path(loadFilePath).parent_path().string() + "\\" + (fs::path(loadFilePath).stem().string() + "_imp_obj_map.txt");
-    std::unordered_map<std::string, std::string> importedObjMap = LoadImportedObjMap(importedObjMapPath);
-    if (loadFilePath.empty()) return importedObjMap;
+    const std::string type(scene.string(r.type));
+    const std::string textureName(scene.string(r.texture));
+    const std::string noiseTextureName(scene.string(r.noiseTexture));
+    Instance* instance = new Instance(r.id, std::string(scene.string(r.name)), type, r.position[0], r.position[1], r.position[2], vbh, ibh);
+    instance->meshNumber = r.meshNumber;
+    std::copy(r.rotation, r.rotation + 3, instance->rotation);
+    std::copy(r.scale, r.scale + 3, instance->scale);
+    std::copy(r.objectColor, r.objectColor + 4, instance->objectColor);
+    instance->lightProps.type = static_cast<LightType>(r.lightType);
+    std::copy(r.lightDirection, r.lightDirection + 3, instance->lightProps.direction);
+    instance->lightProps.intensity = r.lightIntensity;
+    instance->lightProps.range = r.lightRange;
+    instance->lightProps.coneAngle = r.lightConeAngle;
+    std::copy(r.lightColor, r.lightColor + 4, instance->lightProps.color);
+    if (instance->type == "light") {
+        instance->isLight = true;
+        if (instance->lightProps.type == LightType::Spot || instance->lightProps.type == LightType::Directional) {
+            auto it = bufferMap.find("cone");
+            if (it != bufferMap.end())
+            {
+                instance->vertexBuffer = it->second.first;
+                instance->indexBuffer = it->second.second;
+            }
+        }
+    }
+    std::copy(r.inkColor, r.inkColor + 4, instance->inkColor);
+    instance->epsilonValue = r.epsilonValue;
+    instance->strokeMultiplier = r.strokeMultiplier;
+    instance->lineAngle1 = r.lineAngle1;
+    instance->lineAngle2 = r.lineAngle2;
+    instance->patternScale = r.patternScale;
+    instance->lineThickness = r.lineThickness;
+    instance->transparencyValue = r.transparencyValue;
+    instance->crosshatchMode = r.crosshatchMode;
+    instance->layerPatternScale = r.layerPatternScale;
+    instance->layerStrokeMult = r.layerStrokeMult;
+    instance->layerAngle = r.layerAngle;
+    instance->layerLineThickness = r.layerLineThickness;
+    instance->centerX = r.centerX;
+    instance->centerZ = r.centerZ;
+    instance->radius = r.radius;
+    instance->rotationSpeed = r.rotationSpeed;
+    instance->instanceAngle = r.instanceAngle;
+    std::copy(r.basePosition, r.basePosition + 3, instance->basePosition);
+    std::copy(r.animAmplitude, r.animAmplitude + 3, instance->lightAnim.amplitude);
+    std::copy(r.animFrequency, r.animFrequency + 3, instance->lightAnim.frequency);
+    std::copy(r.animPhase, r.animPhase + 3, instance->lightAnim.phase);
+    instance->lightAnim.enabled = (r.flags & SceneSerializer::RECORD_ANIMATION_ENABLED) != 0;
+    instance->textContent = std::string(scene.string(r.textContent));
+    instance->overrideHatchLod = (r.flags & SceneSerializer::RECORD_OVERRIDE_HATCH_LOD) != 0;
+    instance->lodSingleLayerPx = r.lodSingleLayerPx;
+    instance->lodToneOnlyPx = r.lodToneOnlyPx;
+
+    // Assign texture
+    if (textureName != "none")
+    {
+        for (const auto& tex : availableTextures)
+        {
+            if (tex.name == textureName)
+            {
+                instance->diffuseTexture = tex.handle;
+                break;
+            }
+        }
+    }
+    else {
+        instance->diffuseTexture = diffuseTexture;
+    }
+
+    if (instance->type == "text") {
+        // Immediately generate its text texture.
+        updateTextTexture(instance);
+    }
 
-    std::ifstream file(loadFilePath);
-    if (!file.is_open())
+    // Assign noise texture
+    if (noiseTextureName != "none")
     {
-        std::cerr << "Failed to load scene!" << std::endl;
-        return importedObjMap;
+        for (const auto& tex : availableNoiseTextures)
+        {
+            if (tex.name == noiseTextureName)
+            {
+                instance->noiseTexture = tex.handle;
+                break;
+            }
+        }
     }
+    return instance;
+}
 
-    // Clear existing instances
-    for (Instance* inst : instances)
+// Restores parent-child relationships of instances created from scene records; the record index
+// doubles as the parent reference. Parents come before their children in a SceneData, so anything
+// else (missing parent, corrupt index) becomes a root and the hierarchy cannot loop.
+void linkSceneRecords(const SceneSerializer::SceneData& scene, const std::vector<Instance*>& loaded, std::vector<Instance*>& roots)
+{
+    for (size_t index = 0; index < scene.size(); index++)
     {
-        deleteInstance(inst);
+        const int32_t parentIndex = scene[index].parentIndex;
+        if (parentIndex >= 0 && size_t(parentIndex) < index)
+            loaded[parentIndex]->addChild(loaded[index]);
+        else
+            roots.push_back(loaded[index]);
     }
-    instances.clear();
+}
 
-    std::unordered_map<int, Instance*> instanceMap; // Stores instances by their IDs
-    std::vector<std::pair<int, int>> parentAssignments; // Stores parent-child assignments
+// ========================
+// SCENE STREAMING
+// ========================
+// Cells of a .chstream scene are loaded and dropped as the camera moves (see SceneStreamer.h).
+// Imported assets are parsed on the streamer's thread; their GPU buffers are created here once per
+// asset and shared by every cell that uses it.
+struct StreamedAsset
+{
+    std::vector<std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>> meshes;
+    std::vector<bgfx::TextureHandle> textures;
+    int cells = 0;
+};
 
-    std::vector<ImportedMesh> importedMeshes;
-    std::string importedMeshesName = "";
+struct StreamedCell
+{
+    std::vector<std::string> assets; // paths of the StreamedAssets it holds
+    bool readable = true;            // false when the cell file failed to load, it is never written back then
+};
 
-    std::string line;
-    while (std::getline(file, line))
+static std::unordered_map<std::string, StreamedAsset> s_streamedAssets; // by model path
+static std::unordered_map<uint64_t, StreamedCell> s_streamedCells;
+// Textures are small next to the meshes and often shared between assets, they stay for the session.
+static std::unordered_map<std::string, bgfx::TextureHandle> s_streamedTextures;
+
+static uint64_t streamedCellKey(SceneStreamer::CellCoord coord)
+{
+    return (uint64_t(uint32_t(coord.x)) << 32) | uint32_t(coord.z);
+}
+
+// Runs on the streamer's loader thread: geometry only, textures have to be created on this one.
+SceneStreamer::Asset parseStreamedAsset(const std::string& path)
+{
+    auto meshes = std::make_shared<std::vector<ImportedMesh>>(loadImportedMeshes(path, false));
+    SceneStreamer::Asset asset;
+    for (const ImportedMesh& mesh : *meshes)
+        asset.bytes += mesh.meshData.vertices.size() * sizeof(PosColorVertex) + mesh.meshData.indices.size() * sizeof(uint32_t);
+    asset.payload = meshes;
+    return asset;
+}
+
+static bgfx::TextureHandle streamedTexture(const std::string& path)
+{
+    if (path.empty())
+        return BGFX_INVALID_HANDLE;
+    auto it = s_streamedTextures.find(path);
+    if (it == s_streamedTextures.end())
+        it = s_streamedTextures.emplace(path, loadTextureFile(path.c_str())).first;
+    return it->second;
+}
+
+// parsed is what the loader thread produced; an asset the cell did not list (added by an edit
+// after the index was written) is parsed right here instead.
+static StreamedAsset& acquireStreamedAsset(const std::string& path, const SceneStreamer::Asset* parsed)
+{
+    StreamedAsset& asset = s_streamedAssets[path];
+    if (asset.cells++ > 0)
+        return asset;
+
+    std::shared_ptr<std::vector<ImportedMesh>> meshes;
+    if (parsed && parsed->payload)
+        meshes = std::static_pointer_cast<std::vector<ImportedMesh>>(parsed->payload);
+    else
+        meshes = std::make_shared<std::vector<ImportedMesh>>(loadImportedMeshes(path, false));
+    for (const ImportedMesh& mesh : *meshes)
     {
-        std::istringstream iss(line);
-        bgfx::TextureHandle diffuseTexture = BGFX_INVALID_HANDLE;
-        int id, meshNo, parentID, lightType, crosshatchMode, animationEnabled;
-        std::string type, name, textureName, noiseTextureName, textContent;
-        float pos[3], rot[3], scale[3], color[4], lightDirection[3], intensity, range, coneAngle, lightColor[4], inkColor[4], epsilonValue, strokeMultiplier, lineAngle1, lineAngle2, patternScale, lineThickness, transparencyValue, layerPatternScale, layerStrokeMult, layerAngle, layerLineThickness, centerX, centerZ, radius, rotationSpeed, instanceAngle, basePosition[3], amplitude[3], frequency[3], phase[3];
-
-        iss >> id;
-        type = read_quoted_string(iss);
-        name = read_quoted_string(iss);
-        iss >> meshNo
-            >> pos[0] >> pos[1] >> pos[2]
-            >> rot[0] >> rot[1] >> rot[2]
-            >> scale[0] >> scale[1] >> scale[2]
-            >> color[0] >> color[1] >> color[2] >> color[3];
-        textureName = read_quoted_string(iss);
-        noiseTextureName = read_quoted_string(iss);
-        iss >> parentID >> lightType
-            >> lightDirection[0] >> lightDirection[1] >> lightDirection[2]
-            >> intensity >> range >> coneAngle
-            >> lightColor[0] >> lightColor[1] >> lightColor[2] >> lightColor[3]
-            >> inkColor[0] >> inkColor[1] >> inkColor[2] >> inkColor[3]
-            >> epsilonValue >> strokeMultiplier >> lineAngle1 >> lineAngle2
-            >> patternScale >> lineThickness >> transparencyValue >> crosshatchMode
-            >> layerPatternScale >> layerStrokeMult >> layerAngle >> layerLineThickness
-            >> centerX >> centerZ >> radius >> rotationSpeed >> instanceAngle
-            >> basePosition[0] >> basePosition[1] >> basePosition[2]
-            >> amplitude[0] >> amplitude[1] >> amplitude[2]
-            >> frequency[0] >> frequency[1] >> frequency[2]
-            >> phase[0] >> phase[1] >> phase[2]
-            >> animationEnabled;
-        textContent = read_quoted_string(iss);
+        bgfx::VertexBufferHandle vbh = BGFX_INVALID_HANDLE;
+        bgfx::IndexBufferHandle ibh = BGFX_INVALID_HANDLE;
+        createMeshBuffers(mesh.meshData, vbh, ibh);
+        // The asset keeps a reference of its own, the buffers stay valid for cells loaded later
+        // even when every instance using them was deleted meanwhile.
+        registerSharedMesh(vbh, ibh);
+        retainSharedMesh(vbh);
+        asset.meshes.push_back({ vbh, ibh });
+        asset.textures.push_back(streamedTexture(mesh.diffuseTexturePath));
+    }
+    return asset;
+}
 
-        // Fetch correct buffers using `type`
+static void releaseStreamedAsset(const std::string& path)
+{
+    auto it = s_streamedAssets.find(path);
+    if (it == s_streamedAssets.end() || --it->second.cells > 0)
+        return;
+    for (const auto& mesh : it->second.meshes)
+        releaseSharedMesh(mesh.first);
+    s_streamedAssets.erase(it);
+}
+
+void instantiateStreamedCell(SceneStreamer::LoadedCell& cell, std::vector<Instance*>& instances,
+    const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap)
+{
+    StreamedCell& streamed = s_streamedCells[streamedCellKey(cell.coord)];
+    if (!cell.scene)
+    {
+        std::cerr << "Failed to read streamed cell " << cell.coord.x << "," << cell.coord.z << std::endl;
+        streamed.readable = false;
+        return;
+    }
+
+    const SceneSerializer::SceneData& scene = *cell.scene;
+    const std::unordered_map<std::string, std::string>& assetPaths = SceneStreamer::assetPaths();
+    std::vector<Instance*> loaded(scene.size(), nullptr);
+    for (size_t index = 0; index < scene.size(); index++)
+    {
+        const SceneSerializer::SceneRecord& r = scene[index];
+        const std::string type(scene.string(r.type));
         bgfx::VertexBufferHandle vbh = BGFX_INVALID_HANDLE;
         bgfx::IndexBufferHandle ibh = BGFX_INVALID_HANDLE;
+        bgfx::TextureHandle diffuseTexture = BGFX_INVALID_HANDLE;
 
-        auto it = bufferMap.find(type);
-        if (it != bufferMap.end())
+        auto builtIn = bufferMap.find(type);
+        auto imported = assetPaths.find(type);
+        if (builtIn != bufferMap.end())
         {
-            vbh = it->second.first;
-            ibh = it->second.second;
+            vbh = builtIn->second.first;
+            ibh = builtIn->second.second;
         }
-        else {
-            std::string meshType = type;
-            int meshNumber = meshNo;
-            auto i = importedObjMap.find(meshType);
-            if (i != importedObjMap.end())
+        else if (imported != assetPaths.end())
+        {
+            const std::string& path = imported->second;
+            if (std::find(streamed.assets.begin(), streamed.assets.end(), path) == streamed.assets.end())
             {
-                if (importedMeshesName != meshType)
-                {
-                    importedMeshes.clear();
-                    importedMeshes = loadImportedMeshes(i->second);
-                    importedMeshesName = meshType;
-                }
-                createMeshBuffers(importedMeshes[meshNumber].meshData, vbh, ibh);
-                diffuseTexture = importedMeshes[meshNumber].diffuseTexture;
+                auto parsed = cell.assets.find(path);
+                acquireStreamedAsset(path, parsed != cell.assets.end() ? &parsed->second : nullptr);
+                streamed.assets.push_back(path);
+            }
+            const StreamedAsset& asset = s_streamedAssets[path];
+            if (r.meshNumber >= 0 && size_t(r.meshNumber) < asset.meshes.size())
+            {
+                vbh = asset.meshes[r.meshNumber].first;
+                ibh = asset.meshes[r.meshNumber].second;
+                diffuseTexture = asset.textures[r.meshNumber];
             }
         }
+        loaded[index] = createInstanceFromRecord(scene, r, vbh, ibh, diffuseTexture, availableTextures, bufferMap);
+    }
 
-        // Create instance
-        Instance* instance = new Instance(id, name, type, pos[0], pos[1], pos[2], vbh, ibh);
-        instance->meshNumber = meshNo;
-        instance->rotation[0] = rot[0]; instance->rotation[1] = rot[1]; instance->rotation[2] = rot[2];
-        instance->scale[0] = scale[0]; instance->scale[1] = scale[1]; instance->scale[2] = scale[2];
-        instance->objectColor[0] = color[0]; instance->objectColor[1] = color[1];
-        instance->objectColor[2] = color[2]; instance->objectColor[3] = color[3];
-        instance->lightProps.type = static_cast<LightType>(lightType);
-        instance->lightProps.direction[0] = lightDirection[0]; instance->lightProps.direction[1] = lightDirection[1]; instance->lightProps.direction[2] = lightDirection[2];
-        instance->lightProps.intensity = intensity;
-        instance->lightProps.range = range;
-        instance->lightProps.coneAngle = coneAngle;
-        instance->lightProps.color[0] = lightColor[0]; instance->lightProps.color[1] = lightColor[1]; instance->lightProps.color[2] = lightColor[2]; instance->lightProps.color[3] = lightColor[3];
-        if (instance->type == "light") {
-            instance->isLight = true;
-            if (instance->lightProps.type == LightType::Spot || instance->lightProps.type == LightType::Directional) {
-                auto it = bufferMap.find("cone");
-                if (it != bufferMap.end())
-                {
-                    instance->vertexBuffer = it->second.first;
-                    instance->indexBuffer = it->second.second;
-                }
+    std::vector<Instance*> roots;
+    linkSceneRecords(scene, loaded, roots);
+    for (Instance* root : roots)
+    {
+        root->inStreamCell = true;
+        root->streamCell = cell.coord;
+    }
+    instances.insert(instances.end(), roots.begin(), roots.end());
+}
+
+// New top-level instances join the loaded cell they were placed in, or a new cell when the index
+// has none there. A cell that is not loaded cannot take them without losing its file's content:
+// they wait for it to load, and when saving (force) go to the nearest loaded cell instead.
+// Instances moved out of their cell follow to the new one when it is loaded and otherwise wait
+// like new ones, so they are neither unloaded with the old cell nor written back to it.
+// Returns how many are still without a cell.
+static size_t adoptStreamedInstances(const std::vector<Instance*>& instances, bool force)
+{
+    size_t waiting = 0;
+    for (Instance* instance : instances)
+    {
+        SceneStreamer::CellCoord at = SceneStreamer::cellAt(instance->position[0], instance->position[2]);
+        if (instance->inStreamCell)
+        {
+            if (instance->streamCell.x == at.x && instance->streamCell.z == at.z)
+                continue;
+            if (s_streamedCells.count(streamedCellKey(at)))
+            {
+                instance->streamCell = at;
+                continue;
             }
+            instance->inStreamCell = false;
         }
-        instance->inkColor[0] = inkColor[0]; instance->inkColor[1] = inkColor[1]; instance->inkColor[2] = inkColor[2]; instance->inkColor[3] = inkColor[3];
-        instance->epsilonValue = epsilonValue;
-        instance->strokeMultiplier = strokeMultiplier;
-        instance->lineAngle1 = lineAngle1;
-        instance->lineAngle2 = lineAngle2;
-        instance->patternScale = patternScale;
-        instance->lineThickness = lineThickness;
-        instance->transparencyValue = transparencyValue;
-        instance->crosshatchMode = crosshatchMode;
-        instance->layerPatternScale = layerPatternScale;
-        instance->layerStrokeMult = layerStrokeMult;
-        instance->layerAngle = layerAngle;
-        instance->layerLineThickness = layerLineThickness;
-        instance->centerX = centerX;
-        instance->centerZ = centerZ;
-        instance->radius = radius;
-        instance->rotationSpeed = rotationSpeed;
-        instance->instanceAngle = instanceAngle;
-        instance->basePosition[0] = basePosition[0]; instance->basePosition[1] = basePosition[1]; instance->basePosition[2] = basePosition[2];
-        instance->lightAnim.amplitude[0] = amplitude[0]; instance->lightAnim.amplitude[1] = amplitude[1]; instance->lightAnim.amplitude[2] = amplitude[2];
-        instance->lightAnim.frequency[0] = frequency[0]; instance->lightAnim.frequency[1] = frequency[1]; instance->lightAnim.frequency[2] = frequency[2];
-        instance->lightAnim.phase[0] = phase[0]; instance->lightAnim.phase[1] = phase[1]; instance->lightAnim.phase[2] = phase[2];
-        instance->lightAnim.enabled = static_cast<bool>(animationEnabled);
-        instance->textContent = textContent;
-
-        // Assign texture
-        if (textureName != "none")
+        if (!s_streamedCells.count(streamedCellKey(at)))
         {
-            for (const auto& tex : availableTextures)
+            if (SceneStreamer::addCell(at))
+                s_streamedCells[streamedCellKey(at)];
+            else
             {
-                if (tex.name == textureName)
+                const float half = SceneStreamer::cellSize() * 0.5f;
+                float nearest = -1.0f;
+                for (const auto& [key, cell] : s_streamedCells)
                 {
-                    instance->diffuseTexture = tex.handle;
-                    break;
+                    const SceneStreamer::CellCoord coord = { int32_t(uint32_t(key >> 32)), int32_t(uint32_t(key)) };
+                    const float dx = float(coord.x) * SceneStreamer::cellSize() + half - instance->position[0];
+                    const float dz = float(coord.z) * SceneStreamer::cellSize() + half - instance->position[2];
+                    if (nearest < 0.0f || dx * dx + dz * dz < nearest)
+                    {
+                        nearest = dx * dx + dz * dz;
+                        at = coord;
+                    }
+                }
+                if (!force || nearest < 0.0f)
+                {
+                    waiting++;
+                    continue;
                 }
             }
         }
-        else {
-            instance->diffuseTexture = diffuseTexture;
-        }
+        instance->inStreamCell = true;
+        instance->streamCell = at;
+    }
+    return waiting;
+}
+
+// Top-level instances that belong to the cell. Roots that were parented under another instance
+// travel with that one.
+static std::vector<Instance*> streamedCellMembers(SceneStreamer::CellCoord coord, const std::vector<Instance*>& instances)
+{
+    std::vector<Instance*> members;
+    for (Instance* instance : instances)
+    {
+        if (instance->inStreamCell && instance->streamCell.x == coord.x && instance->streamCell.z == coord.z)
+            members.push_back(instance);
+    }
+    return members;
+}
+
+static bool writeStreamedCell(SceneStreamer::CellCoord coord, const std::vector<Instance*>& members,
+    const TextureNameMap& textureNames, const TextureNameMap& noiseTextureNames,
+    const std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    SceneSerializer::SceneData scene;
+    for (const Instance* instance : members)
+        addInstanceRecords(scene, instance, textureNames, noiseTextureNames, -1);
+    return SceneStreamer::writeCell(coord, scene, importedObjMap);
+}
+
+static void collectSubtree(const Instance* instance, std::unordered_set<const Instance*>& set)
+{
+    set.insert(instance);
+    for (const Instance* child : instance->children)
+        collectSubtree(child, set);
+}
+
+// Writes the cell back and deletes its instances. Undo steps that point at them are dropped, the
+// cell's instances the history keeps deleted come back as new ones (see adoptStreamedInstances).
+void unloadStreamedCell(SceneStreamer::CellCoord coord, std::vector<Instance*>& instances,
+    const TextureNameMap& textureNames, const TextureNameMap& noiseTextureNames,
+    const std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    auto cell = s_streamedCells.find(streamedCellKey(coord));
+    const bool readable = cell == s_streamedCells.end() || cell->second.readable;
+    const std::vector<Instance*> members = streamedCellMembers(coord, instances);
+    if (readable)
+        writeStreamedCell(coord, members, textureNames, noiseTextureNames, importedObjMap);
+
+    std::unordered_set<const Instance*> unloading;
+    for (const Instance* instance : members)
+        collectSubtree(instance, unloading);
+    if (!unloading.empty())
+    {
+        gCmdManager.forget(unloading);
+        if (unloading.count(selectedInstance))
+            selectedInstance = nullptr;
+        instances.erase(std::remove_if(instances.begin(), instances.end(),
+            [&unloading](const Instance* instance) { return unloading.count(instance) != 0; }), instances.end());
+        for (Instance* instance : members)
+            deleteInstance(instance);
+    }
+    gCmdManager.forEachDetached([coord](Instance* instance) {
+        if (instance->inStreamCell && instance->streamCell.x == coord.x && instance->streamCell.z == coord.z)
+            instance->inStreamCell = false;
+    });
+
+    if (cell != s_streamedCells.end())
+    {
+        for (const std::string& path : cell->second.assets)
+            releaseStreamedAsset(path);
+        s_streamedCells.erase(cell);
+    }
+    SceneStreamer::unloaded(coord);
+}
+
+// Once per frame: drops the cells the camera left and adds the ones that finished loading.
+void updateSceneStream(const Camera& camera, std::vector<Instance*>& instances,
+    const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap,
+    const std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    if (!SceneStreamer::isOpen())
+        return;
+    std::vector<SceneStreamer::LoadedCell> loadedCells;
+    std::vector<SceneStreamer::CellCoord> evictedCells;
+    const float eye[3] = { camera.position.x, camera.position.y, camera.position.z };
+    adoptStreamedInstances(instances, false);
+    SceneStreamer::update(eye, loadedCells, evictedCells);
+
+    if (!evictedCells.empty())
+    {
+        const TextureNameMap textureNames = buildTextureNameMap(availableTextures);
+        const TextureNameMap noiseTextureNames = buildTextureNameMap(availableNoiseTextures);
+        for (SceneStreamer::CellCoord coord : evictedCells)
+            unloadStreamedCell(coord, instances, textureNames, noiseTextureNames, importedObjMap);
+    }
+    for (SceneStreamer::LoadedCell& cell : loadedCells)
+        instantiateStreamedCell(cell, instances, availableTextures, bufferMap);
+}
+
+// Writes every loaded cell back without unloading it.
+void saveSceneStream(const std::vector<Instance*>& instances, const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    const size_t unsaved = adoptStreamedInstances(instances, true);
+    const TextureNameMap textureNames = buildTextureNameMap(availableTextures);
+    const TextureNameMap noiseTextureNames = buildTextureNameMap(availableNoiseTextures);
+    int written = 0;
+    for (const auto& [key, cell] : s_streamedCells)
+    {
+        if (!cell.readable)
+            continue;
+        const SceneStreamer::CellCoord coord = { int32_t(uint32_t(key >> 32)), int32_t(uint32_t(key)) };
+        written += writeStreamedCell(coord, streamedCellMembers(coord, instances), textureNames, noiseTextureNames, importedObjMap) ? 1 : 0;
+    }
+    std::cout << "Saved " << written << " streamed cell(s) of " << SceneStreamer::indexPath() << std::endl;
+    if (unsaved > 0)
+        std::cerr << unsaved << " new instance(s) not saved, no cell of the stream is loaded" << std::endl;
+}
+
+void closeSceneStream(std::vector<Instance*>& instances, const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    if (!SceneStreamer::isOpen())
+        return;
+    const size_t unsaved = adoptStreamedInstances(instances, true);
+    if (unsaved > 0)
+        std::cerr << unsaved << " new instance(s) not saved, no cell of the stream is loaded" << std::endl;
+    const TextureNameMap textureNames = buildTextureNameMap(availableTextures);
+    const TextureNameMap noiseTextureNames = buildTextureNameMap(availableNoiseTextures);
+    while (!s_streamedCells.empty())
+    {
+        const uint64_t key = s_streamedCells.begin()->first;
+        unloadStreamedCell({ int32_t(uint32_t(key >> 32)), int32_t(uint32_t(key)) }, instances, textureNames, noiseTextureNames, importedObjMap);
+    }
+    SceneStreamer::close();
+    CommandJournal::setEnabled(true);
+}
+
+// Replaces the current scene with the streamed one, cells arrive over the next frames.
+bool openSceneStream(const std::string& indexPath, std::vector<Instance*>& instances,
+    const std::vector<TextureOption>& availableTextures, std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    closeSceneStream(instances, availableTextures, importedObjMap);
+    gCmdManager.clear();
+    selectedInstance = nullptr;
+    for (Instance* inst : instances)
+    {
+        deleteInstance(inst);
+    }
+    instances.clear();
+
+    if (!SceneStreamer::open(indexPath, parseStreamedAsset))
+        return false;
+    importedObjMap = SceneStreamer::assetPaths();
+    instanceCounter = SceneStreamer::maxInstanceId() + 1;
+    // Cells are written back as they unload, the journal has no single scene to replay onto.
+    CommandJournal::truncate("", CommandJournal::sequence());
+    CommandJournal::setEnabled(false);
+    std::cout << "Streaming scene from " << indexPath << std::endl;
+    return true;
+}
+
+std::unordered_map<std::string, std::string> loadScene(const std::string& loadFilePath, std::vector<Instance*>& instances,
+    const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap)
+{
+    selectedInstance = nullptr;
+    std::string importedObjMapPath = fs::path(loadFilePath).parent_path().string() + "\\" + (fs::path(loadFilePath).stem().string() + "_imp_obj_map.txt");
+    std::unordered_map<std::string, std::string> importedObjMap = LoadImportedObjMap(importedObjMapPath);
+    if (loadFilePath.empty()) return importedObjMap;
+
+    TRACE_ZONE("loadScene");
+    SceneSerializer::SceneData scene;
+    Trace::Zone parseZone("SceneData::load");
+    if (!scene.load(loadFilePath))
+    {
+        std::cerr << "Failed to load scene!" << std::endl;
+        return importedObjMap;
+    }
+    parseZone.end();
+
+    // Clear existing instances, and the history that points at them
+    closeSceneStream(instances, availableTextures, SceneStreamer::assetPaths());
+    gCmdManager.clear();
+    for (Instance* inst : instances)
+    {
+        deleteInstance(inst);
+    }
+    instances.clear();
+
+    std::vector<ImportedMesh> importedMeshes;
+    std::string importedMeshesName = "";
+
+    // Scenes saved before render settings existed keep the defaults.
+    useDepthPrepass = scene.settings.depthPrepass;
+    useHatchLod = scene.settings.hatchLod;
+    hatchLodSingleLayerPx = scene.settings.hatchLodSingleLayerPx;
+    hatchLodToneOnlyPx = scene.settings.hatchLodToneOnlyPx;
+
+    // One instance per record, the record index doubles as the parent reference.
+    std::vector<Instance*> loaded(scene.size(), nullptr);
+    for (size_t index = 0; index < scene.size(); index++)
+    {
+        const SceneSerializer::SceneRecord& r = scene[index];
+        const std::string type(scene.string(r.type));
+        bgfx::TextureHandle diffuseTexture = BGFX_INVALID_HANDLE;
 
-        if (instance->type == "text") {
-            // Immediately generate its text texture.
-            updateTextTexture(instance);
-        }
+        // Fetch correct buffers using `type`
+        bgfx::VertexBufferHandle vbh = BGFX_INVALID_HANDLE;
+        bgfx::IndexBufferHandle ibh = BGFX_INVALID_HANDLE;
 
-        // Assign noise texture
-        if (noiseTextureName != "none")
+        auto it = bufferMap.find(type);
+        if (it != bufferMap.end())
         {
-            for (const auto& tex : availableNoiseTextures)
+            vbh = it->second.first;
+            ibh = it->second.second;
+        }
+        else {
+            std::string meshType = type;
+            int meshNumber = r.meshNumber;
+            auto i = importedObjMap.find(meshType);
+            if (i != importedObjMap.end())
             {
-                if (tex.name == noiseTextureName)
+                if (importedMeshesName != meshType)
                 {
-                    instance->noiseTexture = tex.handle;
-                    break;
+                    importedMeshes.clear();
+                    importedMeshes = loadImportedMeshes(i->second);
+                    importedMeshesName = meshType;
                 }
+                createMeshBuffers(importedMeshes[meshNumber].meshData, vbh, ibh);
+                registerSharedMesh(vbh, ibh);
+                diffuseTexture = importedMeshes[meshNumber].diffuseTexture;
             }
         }
 
-        instanceMap[id] = instance;
-
-        // If it has a parent, store the relationship
-        if (parentID != -1)
-        {
-            parentAssignments.push_back({ id, parentID });
-        }
-        else
-        {
-            // If it has no parent, it's a top-level instance
-            instances.push_back(instance);
-        }
+        loaded[index] = createInstanceFromRecord(scene, r, vbh, ibh, diffuseTexture, availableTextures, bufferMap);
     }
 
-    // Restore parent-child relationships
-    for (const auto& [childID, parentID] : parentAssignments)
-    {
-        auto childIt = instanceMap.find(childID);
-        auto parentIt = instanceMap.find(parentID);
-        if (childIt != instanceMap.end() && parentIt != instanceMap.end())
-        {
-            parentIt->second->addChild(childIt->second);
-        }
-    }
+    linkSceneRecords(scene, loaded, instances);
 
-    file.close();
     std::cout << "Scene loaded from " << loadFilePath << std::endl;
     // Replace the existing code with this
     int maxId = 0;
@@ -2215,6 +3306,92 @@ std::unordered_map<std::string, std::string> loadSceneFromFile(std::vector<Insta
     return importedObjMap;
 }
 
+std::unordered_map<std::string, std::string> loadSceneFromFile(std::vector<Instance*>& instances,
+    const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap)
+{
+    std::string loadFilePath = openFileDialog(false);
+    std::unordered_map<std::string, std::string> importedObjMap = loadScene(loadFilePath, instances, availableTextures, bufferMap);
+    // The journal holds edits on top of the scene on disk, a freshly loaded one has none yet.
+    if (!loadFilePath.empty() && fs::exists(loadFilePath))
+        CommandJournal::truncate(loadFilePath, CommandJournal::sequence());
+    return importedObjMap;
+}
+
+
+
+// Meshes of an imported model the scene uses, from the highest mesh number among its instances.
+static void countImportedMeshes(const Instance* instance, const std::string& type, uint32_t& meshes)
+{
+    if (instance->type == type)
+        meshes = std::max(meshes, uint32_t(instance->meshNumber) + 1);
+    for (const Instance* child : instance->children)
+        countImportedMeshes(child, type, meshes);
+}
+
+// File > Generate Stress Scene: writes saves/<name>.txt and .chscene, then opens the text copy.
+// Instances use the built-in primitives or one of the models imported into the current scene.
+void drawSceneGenerator(bool* open, std::vector<Instance*>& instances, const std::vector<TextureOption>& availableTextures,
+    const std::unordered_map<std::string, std::pair<bgfx::VertexBufferHandle, bgfx::IndexBufferHandle>>& bufferMap,
+    std::unordered_map<std::string, std::string>& importedObjMap)
+{
+    static SceneGenerator::Params params;
+    static char name[64] = "stress";
+    static std::string model; // empty for the primitives
+
+    if (!ImGui::Begin("Generate Stress Scene", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::InputText("Name", name, sizeof(name));
+    ImGui::InputScalar("Seed", ImGuiDataType_U32, &params.seed);
+    ImGui::InputScalar("Instances", ImGuiDataType_U32, &params.instances);
+    ImGui::InputScalar("Hierarchy depth", ImGuiDataType_U32, &params.depth);
+    ImGui::InputScalar("Fan-out", ImGuiDataType_U32, &params.fanOut);
+    ImGui::InputScalar("Lights", ImGuiDataType_U32, &params.lights);
+    ImGui::SliderFloat("Animated lights", &params.animatedFraction, 0.0f, 1.0f, "%.2f");
+    ImGui::InputScalar("Text bubbles", ImGuiDataType_U32, &params.textBubbles);
+    ImGui::DragFloat("Spacing", &params.spacing, 0.1f, 0.5f, 100.0f);
+    params.depth = std::max(params.depth, 1u);
+    params.fanOut = std::max(params.fanOut, 1u);
+
+    if (!model.empty() && importedObjMap.find(model) == importedObjMap.end())
+        model.clear();
+    if (ImGui::BeginCombo("Meshes", model.empty() ? "Primitives" : model.c_str()))
+    {
+        if (ImGui::Selectable("Primitives", model.empty()))
+            model.clear();
+        for (const auto& [type, path] : importedObjMap)
+        {
+            if (ImGui::Selectable(type.c_str(), model == type))
+                model = type;
+        }
+        ImGui::EndCombo();
+    }
+
+    ImGui::Text("%u instances in total", params.instances + params.lights + params.textBubbles * 2);
+    if (ImGui::Button("Generate and Open") && name[0] != '\0')
+    {
+        params.importedType = model;
+        params.importedPath = model.empty() ? "" : importedObjMap[model];
+        params.importedMeshes = 0;
+        for (const Instance* instance : instances)
+            countImportedMeshes(instance, model, params.importedMeshes);
+        params.importedMeshes = std::max(params.importedMeshes, 1u);
+
+        std::filesystem::create_directory("saves");
+        const std::string basePath = "saves/" + std::string(name);
+        if (SceneGenerator::write(params, basePath))
+        {
+            closeSceneStream(instances, availableTextures, importedObjMap);
+            importedObjMap = loadScene(basePath + ".txt", instances, availableTextures, bufferMap);
+            CommandJournal::truncate(basePath + ".txt", CommandJournal::sequence());
+        }
+    }
+    ImGui::End();
+}
 
 void ShowTopLevelDropTarget(std::vector<Instance*>& instances)
 {
@@ -2233,20 +3410,8 @@ void ShowTopLevelDropTarget(std::vector<Instance*>& instances)
         if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("DND_INSTANCE"))
         {
             Instance* dropped = *(Instance**)payload->Data;
-            // Remove the dropped node from its current parent (if any)
             if (dropped->parent)
-            {
-                auto it = std::find(dropped->parent->children.begin(), dropped->parent->children.end(), dropped);
-                if (it != dropped->parent->children.end())
-                    dropped->parent->children.erase(it);
-                dropped->parent = nullptr;
-            }
-            // If the node isn't already top-level, add it to the global list.
-            auto it = std::find(instances.begin(), instances.end(), dropped);
-            if (it == instances.end())
-            {
-                instances.push_back(dropped);
-            }
+                gCmdManager.executeCommand(std::make_unique<ReparentCommand>(instances, dropped, nullptr));
         }
         ImGui::EndDragDropTarget();
     }
@@ -2296,6 +3461,70 @@ Instance* findInstanceById(const std::vector<Instance*>& instances, int id)
     return nullptr;
 }
 
+// Applies a journal record to the instance it names; instances that no longer exist are skipped.
+// Deleted instances are parked in `deleted` so a later restore can bring them back, the caller
+// frees what is left there once the replay is done.
+bool applyJournalRecord(std::vector<Instance*>& instances, std::vector<Instance*>& deleted, const CommandJournal::Record& record)
+{
+    if (record.kind == CommandJournal::RECORD_RESTORE)
+    {
+        auto it = std::find_if(deleted.begin(), deleted.end(), [&record](const Instance* d) { return d->id == record.instanceId; });
+        Instance* parent = record.value[0] < 0.0f ? nullptr : findInstanceById(instances, int(record.value[0]));
+        if (it == deleted.end() || (record.value[0] >= 0.0f && parent == nullptr))
+            return false;
+        Instance* restored = *it;
+        deleted.erase(it);
+        InstanceSlot slot;
+        slot.parent = parent;
+        slot.index = size_t(std::max(record.value[1], 0.0f));
+        attachInstance(instances, restored, slot);
+        return true;
+    }
+
+    Instance* instance = findInstanceById(instances, record.instanceId);
+    if (instance == nullptr)
+        return false;
+    switch (record.kind)
+    {
+    case CommandJournal::RECORD_POSITION:
+        std::copy(record.value, record.value + 3, instance->position);
+        return true;
+    case CommandJournal::RECORD_ROTATION:
+        std::copy(record.value, record.value + 3, instance->rotation);
+        return true;
+    case CommandJournal::RECORD_SCALE:
+        std::copy(record.value, record.value + 3, instance->scale);
+        return true;
+    case CommandJournal::RECORD_PROPERTY:
+    {
+        int count = 0;
+        float* field = record.field < PROPERTY_COUNT ? instancePropertyField(instance, InstanceProperty(record.field), count) : nullptr;
+        if (field == nullptr)
+            return false;
+        std::copy(record.value, record.value + count, field);
+        return true;
+    }
+    case CommandJournal::RECORD_DELETE:
+        detachInstance(instances, instance);
+        deleted.push_back(instance);
+        return true;
+    case CommandJournal::RECORD_REPARENT:
+    {
+        Instance* parent = record.value[0] < 0.0f ? nullptr : findInstanceById(instances, int(record.value[0]));
+        if (record.value[0] >= 0.0f && (parent == nullptr || isSelfOrDescendant(instance, parent)))
+            return false;
+        detachInstance(instances, instance);
+        InstanceSlot slot;
+        slot.parent = parent;
+        slot.index = (parent ? parent->children : instances).size();
+        attachInstance(instances, instance, slot);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 void renderInstancePickingRecursive(const Instance* instance, const float* parentTransform, uint32_t viewID)
 {
     // Compute the local transform.
@@ -2350,7 +3579,6 @@ void renderInstancePickingRecursive(const Instance* instance, const float* paren
 
 //-----------------------------------------------------------------------------
 // Uniforms for light data (for shader)
-const int MAX_LIGHTS = 16;
 static bgfx::UniformHandle u_lights;   // array of vec4's (MAX_LIGHTS*4)
 static bgfx::UniformHandle u_numLights;  // vec4 (x holds number of lights)
 
@@ -2359,79 +3587,15 @@ void collectLights(const Instance* inst, float* lightsData, int& numLights, cons
     if (!inst)
         return;
 
-    // Use local matrix for this instance
-    float local[16];
-    bx::mtxSRT(local,
-        inst->scale[0], inst->scale[1], inst->scale[2],
-        inst->rotation[0], inst->rotation[1], inst->rotation[2],
-        inst->position[0], inst->position[1], inst->position[2]);
-
     // Compute world matrix by combining with parent transform (if any)
     float world[16];
-    if (parentTransform) {
-        bx::mtxMul(world, local, parentTransform);
-    }
-    else {
-        std::memcpy(world, local, sizeof(world));
-    }
+    FrameMath::worldMatrix(world, inst->scale, inst->rotation, inst->position, parentTransform);
 
     if (inst->isLight)
     {
         if (numLights >= MAX_LIGHTS)
             return;
-
-        int base = numLights * 16;
-
-        // Type and intensity remain unchanged
-        lightsData[base + 0] = static_cast<float>(inst->lightProps.type); // type
-        lightsData[base + 1] = inst->lightProps.intensity;
-        lightsData[base + 2] = 0.0f;
-        lightsData[base + 3] = 0.0f;
-
-        // Transform position from local to world space
-        float worldPos[3] = { 0.0f, 0.0f, 0.0f };
-        worldPos[0] = world[12]; // Translation is stored in elements 12, 13, 14
-        worldPos[1] = world[13];
-        worldPos[2] = world[14];
-
-        lightsData[base + 4] = worldPos[0];
-        lightsData[base + 5] = worldPos[1];
-        lightsData[base + 6] = worldPos[2];
-        lightsData[base + 7] = 1.0f;
-
-        // For direction, we need to transform by the rotation part of the matrix only
-        // (without translation), and then normalize the result
-        float direction[3] = {
-            inst->lightProps.direction[0],
-            inst->lightProps.direction[1],
-            inst->lightProps.direction[2]
-        };
-
-        // Transform direction vector using the 3x3 rotation part of the world matrix
-        float worldDir[3] = { 0.0f, 0.0f, 0.0f };
-        worldDir[0] = world[0] * direction[0] + world[4] * direction[1] + world[8] * direction[2];
-        worldDir[1] = world[1] * direction[0] + world[5] * direction[1] + world[9] * direction[2];
-        worldDir[2] = world[2] * direction[0] + world[6] * direction[1] + world[10] * direction[2];
-
-        // Normalize the direction
-        float length = std::sqrt(worldDir[0] * worldDir[0] + worldDir[1] * worldDir[1] + worldDir[2] * worldDir[2]);
-        if (length > 0.0001f) {
-            worldDir[0] /= length;
-            worldDir[1] /= length;
-            worldDir[2] /= length;
-        }
-
-        lightsData[base + 8] = worldDir[0];
-        lightsData[base + 9] = worldDir[1];
-        lightsData[base + 10] = worldDir[2];
-        lightsData[base + 11] = inst->lightProps.coneAngle;
-
-        // Light color remains unchanged
-        lightsData[base + 12] = inst->lightProps.color[0];
-        lightsData[base + 13] = inst->lightProps.color[1];
-        lightsData[base + 14] = inst->lightProps.color[2];
-        lightsData[base + 15] = inst->lightProps.range;
-
+        packLight(inst->lightProps, world, lightsData + numLights * 16);
         numLights++;
     }
 
@@ -2444,6 +3608,20 @@ void collectLights(const Instance* inst, float* lightsData, int& numLights, cons
     }
 }
 
+// Scene totals for the performance panel, children included.
+void countScene(const Instance* instance, SceneCounts& counts)
+{
+    counts.instances++;
+    if (instance->isLight)
+        counts.lights++;
+    auto size = s_meshSizes.find(instance->vertexBuffer.idx);
+    if (size != s_meshSizes.end())
+        counts.triangles += size->second.triangles;
+    counts.triangles += uint64_t(instance->textMesh.glyphCount) * 2;
+    for (const Instance* child : instance->children)
+        countScene(child, counts);
+}
+
 // Add this to your code - preferably right before main() or in a utility file
 void updateRotatingLights(std::vector<Instance*>& instances, float deltaTime) {
     for (Instance* inst : instances) {
@@ -2494,76 +3672,99 @@ namespace Gallery {
     static int selectedImage = -1;
     static std::vector<bgfx::TextureHandle> textures;
     static std::vector<ImVec2> imgSizes;
+    static std::vector<std::string> fileNames;
+
+    // Adds the image, or replaces the one with the same file name (a screenshot saved again).
+    void AddImage(const std::string& path, int w, int h, const void* rgba) {
+        const std::string fileName = std::filesystem::path(path).filename().string();
+        const bgfx::Memory* mem = bgfx::copy(rgba, w * h * 4);
+        auto tex = bgfx::createTexture2D((uint16_t)w, (uint16_t)h, false, 1,
+            bgfx::TextureFormat::RGBA8, 0, mem);
+        if (!bgfx::isValid(tex)) return;
+        for (size_t i = 0; i < fileNames.size(); i++) {
+            if (fileNames[i] == fileName) {
+                bgfx::destroy(textures[i]);
+                textures[i] = tex;
+                imgSizes[i] = ImVec2((float)w, (float)h);
+                return;
+            }
+        }
+        textures.push_back(tex);
+        imgSizes.push_back(ImVec2((float)w, (float)h));
+        fileNames.push_back(fileName);
+    }
 
     // Call once at startup
     void LoadGallery(const std::string& folderPath) {
         textures.clear();
         imgSizes.clear();
+        fileNames.clear();
+        if (!std::filesystem::is_directory(folderPath)) return;
         for (auto& entry : std::filesystem::directory_iterator(folderPath)) {
             if (!entry.is_regular_file()) continue;
             auto path = entry.path().string();
             int w, h, channels;
             unsigned char* data = stbi_load(path.c_str(), &w, &h, &channels, 4);
             if (!data) continue;
-            const bgfx::Memory* mem = bgfx::copy(data, w * h * 4);
+            AddImage(path, w, h, data);
             stbi_image_free(data);
-            auto tex = bgfx::createTexture2D((uint16_t)w, (uint16_t)h, false, 1,
-                bgfx::TextureFormat::RGBA8, 0, mem);
-            if (bgfx::isValid(tex)) {
-                textures.push_back(tex);
-                imgSizes.push_back(ImVec2((float)w, (float)h));
-            }
+        }
+    }
+
+    // Main thread, once per frame: picks up the screenshots the capture workers finished.
+    void AddFinishedScreenshots() {
+        ScreenshotCapture::CapturedImage image;
+        while (ScreenshotCapture::popFinished(image)) {
+            AddImage(image.path, (int)image.width, (int)image.height, image.rgba.data());
         }
     }
 }
 void takeScreenshotAsPng(bgfx::FrameBufferHandle fb, const std::string& baseName) {
-    std::filesystem::create_directory("screenshots");
-
-    std::string normalPath = "screenshots/" + baseName;
-    std::string tgaPath = "screenshots/" + baseName + ".tga";
     std::string pngPath = "screenshots/" + baseName + ".png";
 
+    // bgfx hands the pixels to ScreenshotCapture's callback, its workers write the PNG
+    ScreenshotCapture::request(fb, pngPath);
+    std::cout << "[Screenshot] Requested .png: " << pngPath << std::endl;
+}
 
-    // Tell BGFX to save the framebuffer contents to a file
-    bgfx::requestScreenShot(fb, normalPath.c_str());
-    std::cout << "[Screenshot] Requested .tga: " << tgaPath << std::endl;
-
-    std::thread([tgaPath, pngPath]() {
-        namespace fs = std::filesystem;
-
-        const int maxWaitMs = 10000;
-        const int pollIntervalMs = 100;
-        int waitedMs = 0;
+void startRenderModeComparison()
+{
+    s_modeComparison = RenderModeComparison();
+    s_modeComparison.restoreDeferred = useDeferredShading;
+    s_modeComparison.phase = 0;
+    useDeferredShading = false;
+    std::cout << "Comparing forward and deferred shading over " << COMPARE_FRAMES << " frames each..." << std::endl;
+}
 
-        while (!fs::exists(tgaPath) && waitedMs < maxWaitMs) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(pollIntervalMs));
-            waitedMs += pollIntervalMs;
-        }
+// Accumulates bgfx frame timings while a comparison is running. Call after bgfx::frame().
+void updateRenderModeComparison()
+{
+    RenderModeComparison& cmp = s_modeComparison;
+    if (cmp.phase < 0)
+        return;
 
-        if (!fs::exists(tgaPath)) {
-            std::cerr << "[Screenshot] TGA file not found after waiting." << std::endl;
-            return;
-        }
+    // The first frames after a switch still resize targets and compile state, skip them.
+    if (++cmp.frame <= COMPARE_WARMUP_FRAMES)
+        return;
 
-        int width, height, channels;
-        unsigned char* data = stbi_load(tgaPath.c_str(), &width, &height, &channels, 4); // Force RGBA
+    const bgfx::Stats* stats = bgfx::getStats();
+    cmp.cpuMs[cmp.phase] += 1000.0 * double(stats->cpuTimeFrame) / double(stats->cpuTimerFreq);
+    cmp.gpuMs[cmp.phase] += 1000.0 * double(stats->gpuTimeEnd - stats->gpuTimeBegin) / double(stats->gpuTimerFreq);
 
-        if (!data) {
-            std::cerr << "[Screenshot] Failed to load .tga: " << tgaPath << std::endl;
-            return;
-        }
+    if (cmp.frame < COMPARE_WARMUP_FRAMES + COMPARE_FRAMES)
+        return;
 
-        if (stbi_write_png(pngPath.c_str(), width, height, 4, data, width * 4)) {
-            std::cout << "[Screenshot] Converted to .png: " << pngPath << std::endl;
-            fs::remove(tgaPath); // Clean up
-        }
-        else {
-            std::cerr << "[Screenshot] Failed to save .png: " << pngPath << std::endl;
-        }
+    if (cmp.phase == 0) {
+        cmp.phase = 1;
+        cmp.frame = 0;
+        useDeferredShading = true;
+        return;
+    }
 
-        stbi_image_free(data);
-        Gallery::LoadGallery("./screenshots");
-        }).detach(); // Detach the thread so it runs independently
+    std::cout << "Forward:  " << cmp.cpuMs[0] / COMPARE_FRAMES << " ms CPU, " << cmp.gpuMs[0] / COMPARE_FRAMES << " ms GPU" << std::endl;
+    std::cout << "Deferred: " << cmp.cpuMs[1] / COMPARE_FRAMES << " ms CPU, " << cmp.gpuMs[1] / COMPARE_FRAMES << " ms GPU" << std::endl;
+    useDeferredShading = cmp.restoreDeferred;
+    cmp.phase = -1;
 }
 
 void ResetCrosshatchSettings()
@@ -2634,6 +3835,7 @@ int main(void)
     bgfxinit.resolution.height = WNDW_HEIGHT;
     bgfxinit.resolution.reset = BGFX_RESET_VSYNC;
     bgfxinit.platformData.nwh = glfwGetWin32Window(window);
+    bgfxinit.callback = ScreenshotCapture::callback();
     if (!bgfx::init(bgfxinit)) {
         std::cerr << "Failed to initialize BGFX" << std::endl;
         glfwDestroyWindow(window);
@@ -2696,8 +3898,8 @@ int main(void)
 
     // Load the picking shader program.
     // (Assumes you have compiled picking shaders "vs_picking_shaded.bin" and "fs_picking_id.bin")
-    bgfx::ShaderHandle vsPick = loadShader("shaders\\vs_picking_shaded.bin");
-    bgfx::ShaderHandle fsPick = loadShader("shaders\\fs_picking_id.bin");
+    bgfx::ShaderHandle vsPick = ShaderLoader::loadShader("shaders\\vs_picking_shaded.bin");
+    bgfx::ShaderHandle fsPick = ShaderLoader::loadShader("shaders\\fs_picking_id.bin");
     pickingProgram = bgfx::createProgram(vsPick, fsPick, true);
 
     bgfx::VertexLayout layout;
@@ -2850,6 +4052,22 @@ int main(void)
         layout
     );
 
+    // Position-only streams for the depth pre-pass and bounds for the hatch LOD.
+    registerMeshGeometry(vbh_plane, planeVertices, std::size(planeVertices), std::size(planeIndices));
+    registerMeshGeometry(vbh_cube, cubeVertices, std::size(cubeVertices), std::size(cubeIndices));
+    registerMeshGeometry(vbh_capsule, capsuleVertices.data(), capsuleVertices.size(), capsuleIndices.size());
+    registerMeshGeometry(vbh_cylinder, cylinderVertices.data(), cylinderVertices.size(), cylinderIndices.size());
+    registerMeshGeometry(vbh_cone, coneVertices.data(), coneVertices.size(), coneIndices.size());
+    registerMeshGeometry(vbh_sphere, sphereVertices.data(), sphereVertices.size(), sphereIndices.size());
+    registerMeshGeometry(vbh_cornell, cornellBoxVertices, std::size(cornellBoxVertices), std::size(cornellBoxIndices));
+    registerMeshGeometry(vbh_innerCube, innerCubeVertices, std::size(innerCubeVertices), std::size(innerCubeIndices));
+    registerMeshGeometry(vbh_floor, cornellBoxFloorVertices, std::size(cornellBoxFloorVertices), std::size(cornellBoxFloorIndices));
+    registerMeshGeometry(vbh_ceiling, cornellBoxCeilingVertices, std::size(cornellBoxCeilingVertices), std::size(cornellBoxCeilingIndices));
+    registerMeshGeometry(vbh_back, cornellBoxBackVertices, std::size(cornellBoxBackVertices), std::size(cornellBoxBackIndices));
+    registerMeshGeometry(vbh_left, cornellBoxLeftVertices, std::size(cornellBoxLeftVertices), std::size(cornellBoxLeftIndices));
+    registerMeshGeometry(vbh_right, cornellBoxRightVertices, std::size(cornellBoxRightVertices), std::size(cornellBoxRightIndices));
+    registerMeshGeometry(vbh_arrow, arrowVertices, std::size(arrowVertices), std::size(arrowIndices));
+
     //mesh generation
     MeshData meshData = loadMesh2("meshes/suzanne.obj");
     bgfx::VertexBufferHandle vbh_mesh;
@@ -2975,8 +4193,8 @@ int main(void)
     //Enable debug output
     bgfx::setDebug(BGFX_DEBUG_TEXT); // <-- Add this line here
 
-    bgfx::setViewRect(0, 0, 0, WNDW_WIDTH, WNDW_HEIGHT);
-    bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
+    bgfx::setViewRect(VIEW_SCENE, 0, 0, WNDW_WIDTH, WNDW_HEIGHT);
+    bgfx::setViewClear(VIEW_SCENE, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
 
     InputManager::initialize(window);
 
@@ -3082,6 +4300,13 @@ int main(void)
         availableNoiseTextures.push_back(noiseTex);
     }
 
+    // The TAM baker decodes the same DDS files on the CPU.
+    TonalArtMap::initialize();
+    for (size_t i = 0; i < availableNoiseTextures.size(); i++)
+    {
+        TonalArtMap::registerNoiseSource(availableNoiseTextures[i].handle, "noise textures\\noise" + std::to_string(i + 1) + ".dds");
+    }
+
     noiseTexture = availableNoiseTextures[0].handle;
 
     // Texture
@@ -3277,24 +4502,71 @@ int main(void)
     }
 
     // Load the comic element shaders.
-    bgfx::ShaderHandle vsh_comic = loadShader("shaders\\v_comic.bin");
-    bgfx::ShaderHandle fsh_comic = loadShader("shaders\\f_comic.bin");
+    bgfx::ShaderHandle vsh_comic = ShaderLoader::loadShader("shaders\\v_comic.bin");
+    bgfx::ShaderHandle fsh_comic = ShaderLoader::loadShader("shaders\\f_comic.bin");
     bgfx::ProgramHandle comicProgram = bgfx::createProgram(vsh_comic, fsh_comic, true);
 
     // Load dedicated text shader.
-    bgfx::ShaderHandle vsh_text = loadShader("shaders\\v_text.bin");
-    bgfx::ShaderHandle fsh_text = loadShader("shaders\\f_text.bin");
+    bgfx::ShaderHandle vsh_text = ShaderLoader::loadShader("shaders\\v_text.bin");
+    bgfx::ShaderHandle fsh_text = ShaderLoader::loadShader("shaders\\f_text.bin");
     bgfx::ProgramHandle textProgram = bgfx::createProgram(vsh_text, fsh_text, true);
 
+    // SDF variant of the text shader; text instances fall back to bitmap textures without it.
+    bgfx::ShaderHandle fsh_textSdf = ShaderLoader::loadShader("shaders\\f_text_sdf.bin");
+    if (bgfx::isValid(fsh_textSdf))
+    {
+        sdfTextProgram = bgfx::createProgram(ShaderLoader::loadShader("shaders\\v_text.bin"), fsh_textSdf, true);
+    }
+    if (bgfx::isValid(sdfTextProgram))
+    {
+        SdfText::initialize();
+    }
+    else
+    {
+        std::cout << "SDF text shader not available, using text textures" << std::endl;
+    }
+
     // Load shaders and create program once
-    bgfx::ShaderHandle vsh = loadShader("shaders\\v_out21.bin");
-    bgfx::ShaderHandle fsh = loadShader("shaders\\f_out28.bin");
+    bgfx::ShaderHandle vsh = ShaderLoader::loadShader("shaders\\v_out21.bin");
+    bgfx::ShaderHandle fsh = ShaderLoader::loadShader("shaders\\f_out28.bin");
 
     bgfx::ProgramHandle defaultProgram = bgfx::createProgram(vsh, fsh, true);
 
+    // Same shader with the texh() loop replaced by tonal art map lookups.
+    // Falls back to defaultProgram if the binary is missing.
+    u_tamTex = bgfx::createUniform("u_tamTex", bgfx::UniformType::Sampler);
+    u_tamParams = bgfx::createUniform("u_tamParams", bgfx::UniformType::Vec4);
+    u_tamLod = bgfx::createUniform("u_tamLod", bgfx::UniformType::Vec4);
+    bgfx::ShaderHandle tamFsh = ShaderLoader::loadShader("shaders\\f_out28_tam.bin");
+    if (bgfx::isValid(tamFsh))
+    {
+        tamProgram = bgfx::createProgram(ShaderLoader::loadShader("shaders\\v_out21.bin"), tamFsh, true);
+    }
+    if (!bgfx::isValid(tamProgram))
+    {
+        std::cout << "Tonal art map shader not available, using procedural hatching" << std::endl;
+    }
+
+    DeferredRenderer::initialize();
+    DynamicResolution::initialize();
+
+    // Depth pre-pass program (position-only stream, no color output).
+    {
+        bgfx::ShaderHandle depthVsh = ShaderLoader::loadShader("shaders\\v_depth.bin");
+        bgfx::ShaderHandle depthFsh = ShaderLoader::loadShader("shaders\\f_depth.bin");
+        if (bgfx::isValid(depthVsh) && bgfx::isValid(depthFsh))
+        {
+            depthPrepassProgram = bgfx::createProgram(depthVsh, depthFsh, true);
+        }
+        else
+        {
+            std::cout << "Depth pre-pass shaders not found, pre-pass disabled" << std::endl;
+        }
+    }
+
     // Load the debug light shader:
-    bgfx::ShaderHandle debugVsh = loadShader("shaders\\v_lightdebug_out1.bin");
-    bgfx::ShaderHandle debugFsh = loadShader("shaders\\f_lightdebug_out1.bin");
+    bgfx::ShaderHandle debugVsh = ShaderLoader::loadShader("shaders\\v_lightdebug_out1.bin");
+    bgfx::ShaderHandle debugFsh = ShaderLoader::loadShader("shaders\\f_lightdebug_out1.bin");
     bgfx::ProgramHandle lightDebugProgram = bgfx::createProgram(debugVsh, debugFsh, true);
 
     //spawn plane
@@ -3369,6 +4641,43 @@ int main(void)
     spawnLight(camera, vbh_sphere, ibh_sphere, vbh_cone, ibh_cone, instances);
 
     Logger::GetInstance();
+    Trace::setThreadName("Main");
+
+    // Crash recovery: edits that never made it into a full save are replayed on top of the scene
+    // they were made on (the default scene above when the journal names none).
+    {
+        std::string journalScene;
+        std::vector<CommandJournal::Record> journalRecords;
+        uint32_t journalDropFrom = UINT32_MAX;
+        if (CommandJournal::read(COMMAND_JOURNAL_PATH, journalScene, journalRecords))
+        {
+            if (!journalScene.empty() && fs::exists(journalScene))
+                importedObjMap = loadScene(journalScene, instances, availableTextures, bufferMap);
+            else if (!journalScene.empty())
+            {
+                std::cerr << "Autosave journal refers to missing scene " << journalScene << ", discarding it" << std::endl;
+                journalScene.clear();
+                journalRecords.clear();
+            }
+            int replayed = 0;
+            size_t next = 0;
+            std::vector<Instance*> deleted;
+            for (; next < journalRecords.size() && journalRecords[next].kind != CommandJournal::RECORD_CREATE; next++)
+                replayed += applyJournalRecord(instances, deleted, journalRecords[next]) ? 1 : 0;
+            for (Instance* instance : deleted)
+                deleteInstance(instance);
+            if (!journalRecords.empty())
+                std::cout << "Recovered " << replayed << " of " << journalRecords.size() << " unsaved edits from the autosave journal" << std::endl;
+            if (next < journalRecords.size())
+            {
+                // Dropped from the journal too, or every later session would stop at the same create.
+                std::cerr << "Instances were created after the last save, the " << journalRecords.size() - next << " edits from there on cannot be recovered" << std::endl;
+                journalDropFrom = journalRecords[next].sequence;
+            }
+        }
+        if (!CommandJournal::open(COMMAND_JOURNAL_PATH, journalScene, journalDropFrom))
+            std::cerr << "Autosave journal disabled" << std::endl;
+    }
 
     static bgfx::FrameBufferHandle g_frameBuffer = BGFX_INVALID_HANDLE;
     static bgfx::TextureHandle g_frameBufferTex = BGFX_INVALID_HANDLE;
@@ -3399,23 +4708,34 @@ int main(void)
     bool takingScreenshot = false;
     static char screenshotName[256] = "screenshot";
     static bool openScreenshotPopup = false;
+    // Poster export settings, started from the render code once the camera matrices are known.
+    static int posterMultiplier = 4;
+    static int posterFormat = 0; // 0 = PNG, 1 = TIFF
+    static float posterDpi = 300.0f;
+    static bool posterRequested = false;
+    static SequenceExporter::Settings sequenceSettings;
+    static bool sequenceRequested = false;
+
+    // Main menu background, decoded on its own thread and uploaded as Y/U/V planes.
+    VideoPlayer videoPlayer;
+    videoPlayer.load("videos\\AnitoCrossHatchTrailer.mp4", VideoPlayer::UploadMode::YuvPlanes, VIEW_VIDEO);
 
     //MAIN LOOP
     while (!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
-
-        ImGuiViewport* viewport = ImGui::GetMainViewport();
-        static VideoPlayer videoPlayer;
-        static bool videoLoaded = false;
-        if (!videoLoaded)
+        TRACE_ZONE("Frame");
         {
-            videoLoaded = videoPlayer.load("videos\\AnitoCrossHatchTrailer.mp4");
+            Trace::PhaseZone inputZone(Trace::Phase::Input);
+            glfwPollEvents();
         }
+
+        ImGuiViewport* viewport = ImGui::GetMainViewport();
         static bool showMainMenu = true;
         static bool showCreditsPage = false;
         static bool showGallery = false;
 
+        // Everything up to ImGui::Render() builds the UI.
+        Trace::PhaseZone imguiZone(Trace::Phase::ImGui);
         ImGui_ImplGlfw_NewFrame();
         ImGui_Implbgfx_NewFrame();
         ImGui::NewFrame();
@@ -3431,9 +4751,16 @@ int main(void)
                 currentGizmoOperation = ImGuizmo::SCALE;
             }
         }
+        updateSceneStream(cameras[currentCameraIndex], instances, availableTextures, bufferMap, importedObjMap);
+        // The trailer only plays behind the main menu; its clock stands still elsewhere.
+        videoPlayer.setPaused(!showMainMenu);
         if (showMainMenu)
         {
-            // Update the video frame each frame.
+            // Decoded frames are scaled to the window's pixel size, not the file's.
+            const ImGuiIO& videoIo = ImGui::GetIO();
+            videoPlayer.setDisplaySize(int(videoIo.DisplaySize.x * videoIo.DisplayFramebufferScale.x),
+                int(videoIo.DisplaySize.y * videoIo.DisplayFramebufferScale.y));
+            // Shows the frame that is due, the decode thread keeps the next ones ready.
             videoPlayer.update();
             // Render the video background
             {
@@ -3449,7 +4776,8 @@ int main(void)
                     ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoInputs |
                     ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoBringToFrontOnFocus);
                 // Render the video texture to fill the background.
-                ImGui::Image((ImTextureID)(uintptr_t)(videoPlayer.texture.idx), ImGui::GetIO().DisplaySize);
+                if (bgfx::isValid(videoPlayer.texture))
+                    ImGui::Image((ImTextureID)(uintptr_t)(videoPlayer.texture.idx), ImGui::GetIO().DisplaySize);
                 ImGui::End();
             }
 
@@ -3713,14 +5041,29 @@ int main(void)
                         //std::string loadFilePath = openFileDialog(false); // Open load dialog
                         //if (!loadFilePath.empty())
                         //    loadSceneText(loadFilePath, instances, availableTextures);
+                        closeSceneStream(instances, availableTextures, importedObjMap);
                         importedObjMap = loadSceneFromFile(instances, availableTextures, bufferMap);
                     }
+                    if (ImGui::MenuItem("Open Streamed Scene.."))
+                    {
+                        const std::string indexPath = OpenFileDialog(glfwGetWin32Window(window), "Streamed Scenes (*.chstream)\0*.chstream\0All Files (*.*)\0*.*\0");
+                        if (!indexPath.empty())
+                            openSceneStream(indexPath, instances, availableTextures, importedObjMap);
+                    }
+                    if (ImGui::MenuItem("Close Streamed Scene", nullptr, false, SceneStreamer::isOpen()))
+                    {
+                        closeSceneStream(instances, availableTextures, importedObjMap);
+                    }
                     if (ImGui::MenuItem("Save", "Ctrl+S"))
                     {
                         //std::string saveFilePath = openFileDialog(true); // Open save dialog
                         //if (!saveFilePath.empty())
                         //    saveScene(saveFilePath, instances, availableTextures);
-                        saveSceneToFile(instances, availableTextures, importedObjMap);
+                        // A streamed scene saves into its cells, the rest of it is not loaded.
+                        if (SceneStreamer::isOpen())
+                            saveSceneStream(instances, availableTextures, importedObjMap);
+                        else
+                            saveSceneToFile(instances, availableTextures, importedObjMap);
                     }
                     // ========================
                     // UPDATED IMPORT MENU CODE
@@ -3784,6 +5127,7 @@ int main(void)
                                 bgfx::VertexBufferHandle vbh_imported;
                                 bgfx::IndexBufferHandle ibh_imported;
                                 createMeshBuffers(importedMeshes[i].meshData, vbh_imported, ibh_imported);
+                                registerSharedMesh(vbh_imported, ibh_imported);
 
                                 Instance* childInst = new Instance(instanceCounter++, fileName + "_" + std::to_string(i),
                                     fileName, 0.0f, 0.0f, 0.0f,
@@ -3820,6 +5164,7 @@ int main(void)
                             std::cout << "Imported OBJ spawned with " << importedMeshes.size()
                                 << " mesh(es) grouped under " << fileName << "_group" << std::endl;
                             importedObjMap[fileName] = normalizedRelPath;
+                            gCmdManager.recordCommand(std::make_unique<CreateCommand>(instances, parentInstance));
                         }
                     }
                     if (ImGui::MenuItem("Import Texture"))
@@ -3849,6 +5194,10 @@ int main(void)
                             }
                         }
                     }
+                    if (ImGui::MenuItem("Generate Stress Scene.."))
+                    {
+                        s_showSceneGenerator = true;
+                    }
                     if (ImGui::MenuItem("Back to Main Menu"))
                     {
                         showMainMenu = true;
@@ -3861,6 +5210,8 @@ int main(void)
                     //if (ImGui::MenuItem("Close", "Ctrl+W")) { /* Do stuff */ }
                     ImGui::EndMenu();
                 }
+                // Everything the Add menu spawns becomes an undoable step.
+                const size_t instancesBeforeAdd = instances.size();
                 if (ImGui::BeginMenu("Add"))
                 {
                     if (ImGui::BeginMenu("Objects"))
@@ -4107,6 +5458,7 @@ int main(void)
                                 bgfx::VertexBufferHandle vbh_imported;
                                 bgfx::IndexBufferHandle ibh_imported;
                                 createMeshBuffers(importedMeshes[i].meshData, vbh_imported, ibh_imported);
+                                registerSharedMesh(vbh_imported, ibh_imported);
 
                                 Instance* childInst = new Instance(instanceCounter++, fileName + "_" + std::to_string(i),
                                     fileName, 0.0f, 0.0f, 0.0f,
@@ -4148,33 +5500,79 @@ int main(void)
 
                     ImGui::EndMenu();
                 }
+                for (size_t i = instancesBeforeAdd; i < instances.size(); i++)
+                    gCmdManager.recordCommand(std::make_unique<CreateCommand>(instances, instances[i]));
                 if (ImGui::BeginMenu("Edit"))
                 {
                     if (ImGui::MenuItem("Undo", "Ctrl+Z", false, gCmdManager.canUndo()))
                         gCmdManager.undo();
                     if (ImGui::MenuItem("Redo", "Ctrl+Y", false, gCmdManager.canRedo()))
                         gCmdManager.redo();
-                    if (ImGui::MenuItem("Delete Last Instance"))
+                    if (ImGui::MenuItem("Delete Last Instance", nullptr, false, !instances.empty()))
                     {
-                        Instance* inst = instances.back();
-                        instances.pop_back();
-                        //instanceCounter--;
-                        delete inst;
-                        selectedInstance = nullptr;
+                        gCmdManager.executeCommand(std::make_unique<DeleteCommand>(instances, instances.back()));
                         std::cout << "Last Instance removed" << std::endl;
                     }
                     if (ImGui::MenuItem("Clear All Instances"))
                     {
+                        // Not undoable, the history may point at any of these.
+                        gCmdManager.clear();
                         for (Instance* inst : instances)
                         {
-                            delete inst;
+                            deleteInstance(inst);
                         }
                         instances.clear();
                         selectedInstance = nullptr;
                         std::cout << "All Instances cleared" << std::endl;
                     }
+                    ImGui::Separator();
+                    ImGui::Text("History: %zu steps, %.1f / %.0f KB", gCmdManager.historySize(),
+                        gCmdManager.memoryUsed() / 1024.0, gCmdManager.memoryBudget() / 1024.0);
+                    static int historyBudgetMB = int(gCmdManager.memoryBudget() / (1024 * 1024));
+                    if (ImGui::SliderInt("History Budget (MB)", &historyBudgetMB, 1, 256))
+                        gCmdManager.setMemoryBudget(size_t(historyBudgetMB) * 1024 * 1024);
+                    ImGui::EndMenu();
+                }
+
+                // Performance panel, and timing zones of every thread saved for Perfetto / chrome://tracing.
+                if (ImGui::BeginMenu("Debug"))
+                {
+                    ImGui::MenuItem("Performance", nullptr, &s_showPerformance);
+                    ImGui::Separator();
+                    if (ImGui::MenuItem("Start Trace Capture", nullptr, false, !Trace::isEnabled()))
+                        Trace::begin();
+                    if (ImGui::MenuItem("Stop and Save Trace", nullptr, false, Trace::isEnabled()))
+                    {
+                        std::filesystem::create_directory("traces");
+                        Trace::writeChromeJson("traces/trace_" + std::to_string(std::time(nullptr)) + ".json");
+                    }
                     ImGui::EndMenu();
                 }
+                if (Trace::isEnabled())
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Tracing");
+
+                // Background save progress, the editor keeps running while the file is written.
+                static uint32_t reportedSaves = 0;
+                const SceneSaver::Status saveStatus = SceneSaver::status();
+                const std::string saveFileName = fs::path(saveStatus.path).filename().string();
+                if (saveStatus.finishedSaves != reportedSaves)
+                {
+                    reportedSaves = saveStatus.finishedSaves;
+                    if (!saveStatus.lastSucceeded)
+                        std::cerr << "Failed to save scene to " << saveStatus.path << std::endl;
+                    else
+                    {
+                        std::cout << "Scene saved to " << saveStatus.path << " (" << saveStatus.milliseconds << " ms)" << std::endl;
+                        // Everything up to the snapshot is in the file now, the journal only keeps later edits.
+                        CommandJournal::truncate(saveStatus.path, saveStatus.tag);
+                    }
+                }
+                if (saveStatus.state == SceneSaver::State::Saving)
+                    ImGui::TextDisabled("Saving %s...", saveFileName.c_str());
+                else if (saveStatus.state == SceneSaver::State::Saved && saveStatus.secondsAgo < 5.0)
+                    ImGui::TextDisabled("Saved %s (%.0f ms)", saveFileName.c_str(), saveStatus.milliseconds);
+                else if (saveStatus.state == SceneSaver::State::Failed)
+                    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Save failed: %s", saveFileName.c_str());
 
                 ImGui::EndMenuBar();
             }
@@ -4352,6 +5750,7 @@ int main(void)
                         ImGui::Separator();
                         ImGui::Spacing(); ImGui::Spacing();
                         ImGui::ColorEdit3("Object Color", selectedInstance->objectColor);
+                        trackPropertyEdit(selectedInstance, PROPERTY_OBJECT_COLOR);
                         ImGui::Spacing(); ImGui::Spacing();
                         ImGui::Separator();
                         // --- Texture/Material Editor ---
@@ -4452,29 +5851,8 @@ int main(void)
                     ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing();
                     if (ImGui::Button("Delete Object"))
                     {
-                        // If the selected instance has a parent, remove it from the parent's children list.
-                        if (selectedInstance->parent)
-                        {
-                            Instance* parent = selectedInstance->parent;
-                            auto it = std::find(parent->children.begin(), parent->children.end(), selectedInstance);
-                            if (it != parent->children.end())
-                            {
-                                parent->children.erase(it);
-                            }
-                        }
-                        else
-                        {
-                            // Otherwise, it's top-level. Remove it from the global instances vector.
-                            auto it = std::find(instances.begin(), instances.end(), selectedInstance);
-                            if (it != instances.end())
-                            {
-                                instances.erase(it);
-                            }
-                        }
-
-                        // Delete the instance (which will recursively delete its children)
-                        deleteInstance(selectedInstance);
-                        selectedInstance = nullptr;
+                        // Takes it (and its children) out of the scene; the command owns them until it is dropped from history.
+                        gCmdManager.executeCommand(std::make_unique<DeleteCommand>(instances, selectedInstance));
                     }
                     bool highlighted = highlightVisible;
                     if (ImGui::Checkbox("Show highlight tint", &highlighted))
@@ -4490,6 +5868,11 @@ int main(void)
 
             Logger::GetInstance().DrawImGuiLogger();
 
+            if (s_showPerformance)
+                PerformancePanel::draw(&s_showPerformance);
+            if (s_showSceneGenerator)
+                drawSceneGenerator(&s_showSceneGenerator, instances, availableTextures, bufferMap, importedObjMap);
+
             ImGui::Begin("Object List", p_open, window_flags);
             static int selectedInstanceIndex = -1;
 
@@ -4502,6 +5885,11 @@ int main(void)
                     ShowInstanceTree(instance, selectedInstance, instances);
 
                 }
+                if (s_pendingReparentChild)
+                {
+                    gCmdManager.executeCommand(std::make_unique<ReparentCommand>(instances, s_pendingReparentChild, s_pendingReparentParent));
+                    s_pendingReparentChild = nullptr;
+                }
 
                 // Now, show the drop target region for reparenting to top-level.
                 ShowTopLevelDropTarget(instances);
@@ -4560,12 +5948,166 @@ int main(void)
             ImGui::Text("enter the filename that you want");
             ImGui::Text("then turn off the UI using F2");
             ImGui::Text("and press the screenshot button F3.");
+            ImGui::Separator();
+            ImGui::Text("Poster (N x viewport resolution)");
+            {
+                const PosterRenderer::Progress poster = PosterRenderer::progress();
+                ImGui::BeginDisabled(poster.active || SequenceExporter::isActive());
+                ImGui::SetNextItemWidth(100);
+                ImGui::SliderInt("Resolution Multiplier", &posterMultiplier, 2, 32);
+                const char* posterFormats[] = { "PNG", "TIFF" };
+                ImGui::SetNextItemWidth(100);
+                ImGui::Combo("Format", &posterFormat, posterFormats, IM_ARRAYSIZE(posterFormats));
+                ImGui::SetNextItemWidth(100);
+                ImGui::DragFloat("DPI", &posterDpi, 1.0f, 72.0f, 1200.0f, "%.0f");
+                const ImVec2 posterViewport = ImGui::GetMainViewport()->Size;
+                ImGui::Text("Output %d x %d", int(posterViewport.x) * posterMultiplier, int(posterViewport.y) * posterMultiplier);
+                if (ImGui::Button("Render Poster")) {
+                    posterRequested = true;
+                }
+                ImGui::EndDisabled();
+                if (poster.active) {
+                    ImGui::ProgressBar(poster.tileCount > 0 ? float(poster.tilesDone) / float(poster.tileCount) : 0.0f, ImVec2(200, 0));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Cancel")) {
+                        PosterRenderer::cancel();
+                    }
+                }
+            }
+            ImGui::Separator();
+            ImGui::Text("Animation Export");
+            {
+                const SequenceExporter::Stats sequence = SequenceExporter::stats();
+                ImGui::BeginDisabled(sequence.active || PosterRenderer::isActive());
+                const char* sequenceFormats[] = { "PNG Sequence", "H.264 (.mp4)", "ProRes (.mov)" };
+                int sequenceFormat = int(sequenceSettings.format);
+                ImGui::SetNextItemWidth(150);
+                if (ImGui::Combo("Video Format", &sequenceFormat, sequenceFormats, IM_ARRAYSIZE(sequenceFormats)))
+                    sequenceSettings.format = SequenceExporter::Format(sequenceFormat);
+                const char* sequenceMotions[] = { "Fixed", "Turntable", "Camera Path" };
+                int sequenceMotion = int(sequenceSettings.motion);
+                ImGui::SetNextItemWidth(150);
+                if (ImGui::Combo("Camera Motion", &sequenceMotion, sequenceMotions, IM_ARRAYSIZE(sequenceMotions)))
+                    sequenceSettings.motion = SequenceExporter::CameraMotion(sequenceMotion);
+                if (sequenceSettings.motion == SequenceExporter::CameraMotion::Turntable) {
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::DragFloat("Revolutions", &sequenceSettings.turntableRevolutions, 0.05f, -10.0f, 10.0f);
+                    ImGui::Text(selectedInstance ? "Orbits the selected object" : "Orbits the world origin");
+                }
+                else if (sequenceSettings.motion == SequenceExporter::CameraMotion::CameraPath) {
+                    ImGui::Text("Passes through %d cameras in order", int(cameras.size()));
+                }
+                int sequenceSize[2] = { int(sequenceSettings.width), int(sequenceSettings.height) };
+                ImGui::SetNextItemWidth(150);
+                if (ImGui::InputInt2("Frame Size", sequenceSize)) {
+                    sequenceSettings.width = uint32_t(std::clamp(sequenceSize[0], 16, 8192));
+                    sequenceSettings.height = uint32_t(std::clamp(sequenceSize[1], 16, 8192));
+                }
+                int sequenceFps = int(sequenceSettings.fps);
+                ImGui::SetNextItemWidth(100);
+                if (ImGui::SliderInt("Frame Rate", &sequenceFps, 12, 60))
+                    sequenceSettings.fps = uint32_t(sequenceFps);
+                ImGui::SetNextItemWidth(100);
+                ImGui::DragFloat("Duration (s)", &sequenceSettings.durationSeconds, 0.1f, 0.1f, 600.0f);
+                int sequenceInFlight = int(sequenceSettings.framesInFlight);
+                ImGui::SetNextItemWidth(100);
+                if (ImGui::SliderInt("Frames In Flight", &sequenceInFlight, 1, 8))
+                    sequenceSettings.framesInFlight = uint32_t(sequenceInFlight);
+                if (ImGui::Button("Export Animation")) {
+                    sequenceRequested = true;
+                }
+                ImGui::EndDisabled();
+                if (sequence.active) {
+                    ImGui::ProgressBar(sequence.frameCount > 0 ? float(sequence.encoded) / float(sequence.frameCount) : 0.0f, ImVec2(200, 0));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Stop")) {
+                        SequenceExporter::cancel();
+                    }
+                    ImGui::Text("%u/%u rendered, %.1f fps sustained (render %.1f fps), %zu queued", sequence.rendered, sequence.frameCount,
+                        sequence.sustainedFps, sequence.renderFps, sequence.queued);
+                }
+            }
+            {
+                const ScreenshotCapture::Stats shotStats = ScreenshotCapture::stats();
+                if (shotStats.saved > 0 || shotStats.pending > 0) {
+                    ImGui::Separator();
+                    ImGui::Text("Last capture %.1f ms (readback %.1f, encode %.1f)", shotStats.lastTotalMs, shotStats.lastReadbackMs, shotStats.lastEncodeMs);
+                    ImGui::Text("Average %.1f ms, max %.1f ms, %zu pending", shotStats.averageTotalMs, shotStats.maxTotalMs, shotStats.pending);
+                }
+            }
 
             ImGui::End();
 
 
             ImGui::Begin("Crosshatch Shader Settings");
             ImGui::Checkbox("Use Global Crosshatch Shader Settings", &useGlobalCrosshatchSettings);
+            ImGui::BeginDisabled(!bgfx::isValid(tamProgram) || !TonalArtMap::isSupported());
+            ImGui::Checkbox("Use Baked Hatch Textures", &useTonalArtMaps);
+            ImGui::EndDisabled();
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled))
+                ImGui::SetTooltip("Ver 1.1 - 1.3 sample precomputed tonal art maps instead of the per-pixel noise loop.");
+            if (useTonalArtMaps && TonalArtMap::pendingBakes() > 0)
+                ImGui::Text("Baking %d hatch texture(s)...", TonalArtMap::pendingBakes());
+            ImGui::BeginDisabled(!bgfx::isValid(depthPrepassProgram) || useDeferredShading);
+            ImGui::Checkbox("Depth Pre-pass (saved with scene)", &useDepthPrepass);
+            ImGui::EndDisabled();
+            ImGui::Checkbox("Hatch LOD (saved with scene)", &useHatchLod);
+            if (ImGui::IsItemHovered())
+                ImGui::SetTooltip("Small objects on screen switch to a single hatch layer, then to tone-only shading.");
+            if (useHatchLod) {
+                ImGui::SetNextItemWidth(100);
+                ImGui::DragFloat("Single Layer Below (px)", &hatchLodSingleLayerPx, 1.0f, 0.0f, 2000.0f);
+                ImGui::SetNextItemWidth(100);
+                ImGui::DragFloat("Tone Only Below (px)", &hatchLodToneOnlyPx, 1.0f, 0.0f, 2000.0f);
+                hatchLodToneOnlyPx = std::min(hatchLodToneOnlyPx, hatchLodSingleLayerPx);
+                ImGui::Text("Full %d / Single %d / Tone %d", s_hatchLodCounts[FrameMath::HATCH_LOD_FULL],
+                    s_hatchLodCounts[FrameMath::HATCH_LOD_SINGLE_LAYER], s_hatchLodCounts[FrameMath::HATCH_LOD_TONE_ONLY]);
+            }
+            ImGui::BeginDisabled(!DeferredRenderer::isAvailable() || s_modeComparison.phase >= 0);
+            ImGui::Checkbox("Deferred Shading", &useDeferredShading);
+            if (ImGui::Button("Compare Forward / Deferred")) {
+                startRenderModeComparison();
+            }
+            ImGui::EndDisabled();
+            if (s_modeComparison.phase >= 0)
+                ImGui::Text("Measuring %s...", s_modeComparison.phase == 0 ? "forward" : "deferred");
+            {
+                DynamicResolutionSettings& dynRes = DynamicResolution::settings();
+                ImGui::BeginDisabled(!DynamicResolution::isAvailable());
+                ImGui::Checkbox("Dynamic Resolution", &dynRes.enabled);
+                ImGui::EndDisabled();
+                if (dynRes.enabled && DynamicResolution::isAvailable()) {
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::DragFloat("Target Frame (ms)", &dynRes.targetFrameMs, 0.1f, 4.0f, 50.0f);
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::DragFloat("Min Scale", &dynRes.minScale, 0.01f, 0.25f, 1.0f);
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::DragFloat("Max Scale", &dynRes.maxScale, 0.01f, 0.25f, 1.0f);
+                    dynRes.minScale = std::min(dynRes.minScale, dynRes.maxScale);
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::DragFloat("Upscale Sharpness", &dynRes.sharpness, 0.01f, 0.0f, 1.0f);
+                    ImGui::Text("Render scale %.0f%% (%dx%d), %.2f ms", DynamicResolution::scale() * 100.0f,
+                        DynamicResolution::renderWidth(), DynamicResolution::renderHeight(), DynamicResolution::averageFrameMs());
+                }
+            }
+            if (SceneStreamer::isOpen()) {
+                SceneStreamer::Settings streamSettings = SceneStreamer::settings();
+                int budgetMb = int(streamSettings.memoryBudget / (1024 * 1024));
+                ImGui::SetNextItemWidth(100);
+                bool changed = ImGui::DragFloat("Load Radius", &streamSettings.loadRadius, 1.0f, 10.0f, 5000.0f);
+                ImGui::SetNextItemWidth(100);
+                changed |= ImGui::DragFloat("Prefetch Radius", &streamSettings.prefetchRadius, 1.0f, 0.0f, 5000.0f);
+                ImGui::SetNextItemWidth(100);
+                changed |= ImGui::SliderInt("Stream Budget (MB)", &budgetMb, 32, 8192);
+                if (changed) {
+                    streamSettings.memoryBudget = size_t(budgetMb) * 1024 * 1024;
+                    SceneStreamer::setSettings(streamSettings);
+                }
+                const SceneStreamer::Stats streamStats = SceneStreamer::stats();
+                ImGui::Text("Cells %zu/%zu resident, %zu loading, %.1f MB", streamStats.residentCells, streamStats.cellCount,
+                    streamStats.loadingCells, double(streamStats.residentBytes) / (1024.0 * 1024.0));
+            }
+            ImGui::Spacing(); ImGui::Separator(); ImGui::Spacing();
             if (useGlobalCrosshatchSettings) {
                 const char* modeItems[] = { "Crosshatch Ver 1.0", "Crosshatch Ver 1.1", "Crosshatch Ver 1.2", "Crosshatch Ver 1.3", "Simple Lighting" };
                 ImGui::Combo("Shader Mode", &crosshatchMode, modeItems, IM_ARRAYSIZE(modeItems));
@@ -4731,95 +6273,145 @@ int main(void)
                 {
                     ImGui::Text("Crosshatch Ver 1.0 Settings:");
                     ImGui::ColorEdit4("Hatch Color", selectedInstance->inkColor);
+                    trackPropertyEdit(selectedInstance, PROPERTY_INK_COLOR);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Line Smoothness", &selectedInstance->epsilonValue, 0.001f, 0.0f, 0.1f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_EPSILON);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Density", &selectedInstance->strokeMultiplier, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_STROKE_MULTIPLIER);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Primary Hatch Angle", &selectedInstance->lineAngle1, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_ANGLE1);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Secondary Hatch Angle", &selectedInstance->lineAngle2, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_ANGLE2);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Scale", &selectedInstance->patternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Line Weight", &selectedInstance->lineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Opacity", &selectedInstance->transparencyValue, 0.01f, 0.0f, 1.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_TRANSPARENCY);
                 }
                 else if (selectedInstance->crosshatchMode == 1)
                 {
                     ImGui::Text("Crosshatch Ver 1.1 Settings:");
                     ImGui::ColorEdit4("Hatch Color", selectedInstance->inkColor);
+                    trackPropertyEdit(selectedInstance, PROPERTY_INK_COLOR);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Line Smoothness", &selectedInstance->epsilonValue, 0.001f, 0.0f, 0.1f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_EPSILON);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Density", &selectedInstance->strokeMultiplier, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_STROKE_MULTIPLIER);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Angle", &selectedInstance->lineAngle1, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_ANGLE1);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Scale", &selectedInstance->patternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Line Weight", &selectedInstance->lineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Opacity", &selectedInstance->transparencyValue, 0.01f, 0.0f, 1.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_TRANSPARENCY);
                 }
                 else if (selectedInstance->crosshatchMode == 2)
                 {
                     ImGui::Text("Crosshatch Ver 1.2 Settings:");
                     ImGui::ColorEdit4("Hatch Color", selectedInstance->inkColor);
+                    trackPropertyEdit(selectedInstance, PROPERTY_INK_COLOR);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Line Smoothness", &selectedInstance->epsilonValue, 0.001f, 0.0f, 0.1f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_EPSILON);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Density", &selectedInstance->strokeMultiplier, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_STROKE_MULTIPLIER);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Angle", &selectedInstance->lineAngle1, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_ANGLE1);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Scale", &selectedInstance->patternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Weight", &selectedInstance->lineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     // Inner layer settings:
                     ImGui::DragFloat("Inner Hatch Scale", &selectedInstance->layerPatternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Density", &selectedInstance->layerStrokeMult, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_STROKE_MULT);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Angle", &selectedInstance->layerAngle, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_ANGLE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Weight", &selectedInstance->layerLineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Opacity", &selectedInstance->transparencyValue, 0.01f, 0.0f, 1.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_TRANSPARENCY);
                 }
                 else if (selectedInstance->crosshatchMode == 3)
                 {
                     ImGui::Text("Crosshatch Ver 1.3 Settings:");
                     ImGui::ColorEdit4("Hatch Color", selectedInstance->inkColor);
+                    trackPropertyEdit(selectedInstance, PROPERTY_INK_COLOR);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Line Smoothness", &selectedInstance->epsilonValue, 0.001f, 0.0f, 0.1f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_EPSILON);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Density", &selectedInstance->strokeMultiplier, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_STROKE_MULTIPLIER);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Angle", &selectedInstance->lineAngle1, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_ANGLE1);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Scale", &selectedInstance->patternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Outer Hatch Weight", &selectedInstance->lineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     // Inner layer settings:
                     ImGui::DragFloat("Inner Hatch Scale", &selectedInstance->layerPatternScale, 0.1f, 0.1f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_PATTERN_SCALE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Density", &selectedInstance->layerStrokeMult, 0.1f, 0.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_STROKE_MULT);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Angle", &selectedInstance->layerAngle, 0.1f, 0.0f, TAU);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_ANGLE);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Inner Hatch Weight", &selectedInstance->layerLineThickness, 0.1f, -10.0f, 10.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_LAYER_LINE_THICKNESS);
                     ImGui::SetNextItemWidth(100);
                     ImGui::DragFloat("Hatch Opacity", &selectedInstance->transparencyValue, 0.01f, 0.0f, 1.0f);
+                    trackPropertyEdit(selectedInstance, PROPERTY_TRANSPARENCY);
                 }
                 else if (selectedInstance->crosshatchMode == 4)
                 {
                     ImGui::Text("Simple Lighting (No Crosshatch)");
                 }
 
+                if (useHatchLod && selectedInstance->crosshatchMode != 4)
+                {
+                    ImGui::Checkbox("Override Hatch LOD", &selectedInstance->overrideHatchLod);
+                    if (selectedInstance->overrideHatchLod)
+                    {
+                        ImGui::SetNextItemWidth(100);
+                        ImGui::DragFloat("Single Layer Below (px)##instance", &selectedInstance->lodSingleLayerPx, 1.0f, 0.0f, 2000.0f);
+                        ImGui::SetNextItemWidth(100);
+                        ImGui::DragFloat("Tone Only Below (px)##instance", &selectedInstance->lodToneOnlyPx, 1.0f, 0.0f, 2000.0f);
+                        selectedInstance->lodToneOnlyPx = std::min(selectedInstance->lodToneOnlyPx, selectedInstance->lodSingleLayerPx);
+                    }
+                }
+
                 // New: noise texture selection
                 if (!availableNoiseTextures.empty() && selectedInstance->crosshatchMode != 4)
                 {
@@ -4936,13 +6528,15 @@ int main(void)
         // Always call these last — after all ImGui windows
         ImGui::Render();
         ImGui_Implbgfx_RenderDrawLists(ImGui::GetDrawData());
+        imguiZone.end();
 
         //handle inputs
         Camera& activeCamera = cameras[currentCameraIndex];
 
         //Don’t process movement input unless user is in the actual 3D editor
-        if (!showMainMenu && !showCreditsPage)
+        if (!showMainMenu && !showCreditsPage && !PosterRenderer::isActive() && !SequenceExporter::isActive())
         {
+            Trace::PhaseZone inputZone(Trace::Phase::Input);
             InputManager::update(activeCamera, 0.016f);
 
             if (InputManager::isKeyToggled(GLFW_KEY_F2))
@@ -4972,6 +6566,7 @@ int main(void)
         {
             if (InputManager::isMouseClicked(GLFW_MOUSE_BUTTON_LEFT) && !ImGui::GetIO().WantCaptureMouse)
             {
+                Trace::PhaseZone pickingZone(Trace::Phase::Picking);
                 if (InputManager::getSkipPickingPass) {
                     // Use a dedicated view ID for picking (choose one not used by your normal rendering)
                     const uint32_t PICKING_VIEW_ID = 0;
@@ -5091,34 +6686,117 @@ int main(void)
 
         float lightsData[MAX_LIGHTS * 16]; // 16 floats per light.
         int numLights = 0;
+        Trace::PhaseZone lightsZone(Trace::Phase::Lights);
         for (const Instance* inst : instances) {
             if (numLights >= MAX_LIGHTS)
                 break;
             collectLights(inst, lightsData, numLights);
         }
+        lightsZone.end();
         // Set u_lights uniform with (numLights * 4) vec4's.
         bgfx::setUniform(u_lights, lightsData, numLights * 4);
         float numLightsArr[4] = { static_cast<float>(numLights), 0, 0, 0 };
         bgfx::setUniform(u_numLights, numLightsArr);
 
         bgfx::reset(width, height, BGFX_RESET_VSYNC);
-        bgfx::setViewRect(0, 0, 0, uint16_t(width), uint16_t(height));
+
+        // With dynamic resolution the scene views render into a smaller target that is
+        // upscaled to the backbuffer at the end of the frame.
+        DynamicResolution::beginFrame(uint16_t(width), uint16_t(height));
+        bgfx::FrameBufferHandle sceneTarget = DynamicResolution::target();
+        uint16_t sceneWidth = DynamicResolution::renderWidth();
+        uint16_t sceneHeight = DynamicResolution::renderHeight();
 
         float view[16];
         bx::mtxLookAt(view, activeCamera.position, bx::add(activeCamera.position, activeCamera.front), activeCamera.up);
 
         float proj[16];
         bx::mtxProj(proj, activeCamera.fov, float(width) / float(height), activeCamera.nearClip, activeCamera.farClip, bgfx::getCaps()->homogeneousDepth);
-        bgfx::setViewTransform(0, view, proj);
+
+        // A poster export takes over the scene views for the frames that draw one of its tiles,
+        // with the matrices captured when it started (proj narrowed to the tile).
+        // Camera input is paused meanwhile, so the hatch LOD below still sees the same camera.
+        if (posterRequested) {
+            posterRequested = false;
+            const std::string posterName = screenshotName[0] != '\0' ? screenshotName : "poster";
+            const std::string posterPath = "posters/" + posterName + "_x" + std::to_string(posterMultiplier) + (posterFormat == 1 ? ".tif" : ".png");
+            if (!SequenceExporter::isActive())
+                PosterRenderer::start(posterPath, uint16_t(width), uint16_t(height), uint32_t(posterMultiplier), view, proj, posterDpi);
+        }
+        float fullProj[16];
+        std::memcpy(fullProj, proj, sizeof(fullProj));
+        uint16_t posterTileSize = 0;
+        const bool posterTileFrame = PosterRenderer::beginTile(sceneTarget, posterTileSize, view, proj);
+        if (posterTileFrame) {
+            sceneWidth = sceneHeight = posterTileSize;
+        }
+
+        // An animation export draws one frame into its own target whenever one is free, with the
+        // camera of that frame and the simulation stepped by exactly one frame time.
+        if (sequenceRequested) {
+            sequenceRequested = false;
+            const std::string sequenceName = screenshotName[0] != '\0' ? screenshotName : "animation";
+            const char* sequenceExtensions[] = { "", ".mp4", ".mov" };
+            const std::string sequencePath = "exports/" + sequenceName + sequenceExtensions[int(sequenceSettings.format)];
+            std::filesystem::create_directory("exports");
+            const float pivot[3] = {
+                selectedInstance ? selectedInstance->position[0] : 0.0f,
+                selectedInstance ? selectedInstance->position[1] : 0.0f,
+                selectedInstance ? selectedInstance->position[2] : 0.0f };
+            if (!PosterRenderer::isActive())
+                SequenceExporter::start(sequencePath, sequenceSettings, activeCamera, cameras, pivot);
+        }
+        Camera exportCamera;
+        uint16_t exportWidth = 0;
+        uint16_t exportHeight = 0;
+        float exportDeltaTime = 0.0f;
+        const bool exportFrame = !posterTileFrame && SequenceExporter::beginFrame(sceneTarget, exportWidth, exportHeight, exportCamera, exportDeltaTime);
+        if (exportFrame) {
+            sceneWidth = exportWidth;
+            sceneHeight = exportHeight;
+            bx::mtxLookAt(view, exportCamera.position, bx::add(exportCamera.position, exportCamera.front), exportCamera.up);
+            bx::mtxProj(proj, exportCamera.fov, float(exportWidth) / float(exportHeight), exportCamera.nearClip, exportCamera.farClip, bgfx::getCaps()->homogeneousDepth);
+            std::memcpy(fullProj, proj, sizeof(fullProj));
+        }
+        const Camera& renderCamera = exportFrame ? exportCamera : activeCamera;
+        bgfx::setViewFrameBuffer(VIEW_SCENE, sceneTarget);
+        bgfx::setViewRect(VIEW_SCENE, 0, 0, sceneWidth, sceneHeight);
+        bgfx::setViewTransform(VIEW_SCENE, view, proj);
+
+        // Projected size inputs for the hatch LOD (proj[5] = 1 / tan(fov / 2)). Measured in
+        // display pixels so the LOD does not change with the dynamic resolution scale.
+        s_lodEyePos[0] = renderCamera.position.x;
+        s_lodEyePos[1] = renderCamera.position.y;
+        s_lodEyePos[2] = renderCamera.position.z;
+        s_lodPixelsPerUnit = fullProj[5] * float(exportFrame ? exportHeight : height) * 0.5f;
+        s_hatchLodCounts[FrameMath::HATCH_LOD_FULL] = s_hatchLodCounts[FrameMath::HATCH_LOD_SINGLE_LAYER] = s_hatchLodCounts[FrameMath::HATCH_LOD_TONE_ONLY] = 0;
 
         // Set model matrix
         float mtx[16];
         bx::mtxSRT(mtx, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
         bgfx::setTransform(mtx);
 
-        bgfx::setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
+        const bool deferredFrame = useDeferredShading && DeferredRenderer::isAvailable();
+        s_depthPrepassFrame = useDepthPrepass && !deferredFrame && bgfx::isValid(depthPrepassProgram);
+        if (deferredFrame) {
+            // The lighting pass clears the backbuffer and writes depth, forward objects draw on top.
+            DeferredRenderer::beginFrame(VIEW_GBUFFER, sceneWidth, sceneHeight, view, proj);
+            bgfx::setViewClear(VIEW_SCENE, BGFX_CLEAR_NONE);
+        }
+        else if (s_depthPrepassFrame) {
+            // The pre-pass view clears, the main view keeps its depth.
+            bgfx::setViewFrameBuffer(VIEW_DEPTH_PREPASS, sceneTarget);
+            bgfx::setViewRect(VIEW_DEPTH_PREPASS, 0, 0, sceneWidth, sceneHeight);
+            bgfx::setViewTransform(VIEW_DEPTH_PREPASS, view, proj);
+            bgfx::setViewClear(VIEW_DEPTH_PREPASS, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
+            bgfx::touch(VIEW_DEPTH_PREPASS);
+            bgfx::setViewClear(VIEW_SCENE, BGFX_CLEAR_NONE);
+        }
+        else {
+            bgfx::setViewClear(VIEW_SCENE, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
+        }
 
-        bgfx::touch(0);
+        bgfx::touch(VIEW_SCENE);
 
 
         float viewPos[4] = { camera.position.x, camera.position.y, camera.position.z, 1.0f };
@@ -5128,7 +6806,7 @@ int main(void)
 
         bgfx::setUniform(u_viewPos, viewPos);
 
-        float cameraPos[4] = { cameras[currentCameraIndex].position.x, cameras[currentCameraIndex].position.y, cameras[currentCameraIndex].position.z, 1.0f };
+        float cameraPos[4] = { renderCamera.position.x, renderCamera.position.y, renderCamera.position.z, 1.0f };
         float epsilon[4] = { 0.02f, 0.0f, 0.0f, 0.0f }; // Pack the epsilon value into the first element; the other three can be 0.
 
         bgfx::setUniform(u_inkColor, inkColor);
@@ -5154,21 +6832,40 @@ int main(void)
         // Set the uniform for extra parameters.
         bgfx::setUniform(u_paramsLayer, paramsLayerUniform);
 
+        // Upload finished tonal art map bakes before anything requests them this frame.
+        TonalArtMap::update();
+        float tamParamsUniform[4] = { float(TonalArtMap::toneLevels()), 0.0f, TonalArtMap::kTileSpanX, TonalArtMap::kTileSpanY };
+        bgfx::setUniform(u_tamParams, tamParamsUniform);
+        // Poster tiles render scale times denser than the viewport, the bias keeps the strokes
+        // at the size they have on screen.
+        const float tamRenderScale = posterTileFrame ? PosterRenderer::scale() : (exportFrame ? 1.0f : DynamicResolution::scale());
+        float tamLodUniform[4] = { float(TonalArtMap::tileWidth()), float(TonalArtMap::tileHeight()), std::log2(tamRenderScale), 0.0f };
+        bgfx::setUniform(u_tamLod, tamLodUniform);
+
         // Enable stats or debug text
         bgfx::setDebug(s_showStats ? BGFX_DEBUG_STATS : BGFX_DEBUG_TEXT);
 
         // Calculate delta time
         static float lastFrameTime = 0.0f;
+        static float animationTime = 0.0f;
         float currentTime = glfwGetTime();
         float deltaTime = currentTime - lastFrameTime;
         lastFrameTime = currentTime;
+        // Every tile of a poster has to show the same moment, an animation export steps by its
+        // fixed frame time (0 while it waits for a free target).
+        if (PosterRenderer::isActive())
+            deltaTime = 0.0f;
+        else if (SequenceExporter::isActive())
+            deltaTime = exportDeltaTime;
+        animationTime += deltaTime;
         // Update rotating lights
         updateRotatingLights(instances, deltaTime);
 
         const float tintBasic[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
         bgfx::setUniform(u_tint, tintBasic);
-        bgfx::submit(0, defaultProgram);
+        bgfx::submit(VIEW_SCENE, defaultProgram);
 
+        Trace::PhaseZone traversalZone(Trace::Phase::Traversal);
         for (const auto& instance : instances)
         {
             float model[16];
@@ -5199,7 +6896,7 @@ int main(void)
             bgfx::setUniform(u_albedoFactor, instance->material.albedo);
 
             if (instance->isLight && instance->lightAnim.enabled) {
-                float time = static_cast<float>(glfwGetTime());
+                float time = animationTime;
                 // Update each axis (x, y, z) with a sine-based offset.
                 for (int i = 0; i < 3; i++) {
                     instance->position[i] = instance->basePosition[i] +
@@ -5209,6 +6906,7 @@ int main(void)
 
             drawInstance(instance, defaultProgram, lightDebugProgram, textProgram, comicProgram, u_comicColor, u_noiseTex, u_diffuseTex, u_objectColor, u_tint, u_inkColor, u_e, u_params, u_extraParams, u_paramsLayer, defaultWhiteTexture, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, instance->objectColor); // your usual shader program
         }
+        traversalZone.end();
 
         // Update your vertex layout to include normals
         bgfx::VertexLayout layout;
@@ -5220,28 +6918,45 @@ int main(void)
 
 
 
+        if (deferredFrame) {
+            DeferredRenderer::submitLighting(VIEW_DEFERRED_LIGHT, sceneTarget, u_noiseTex, noiseTexture);
+        }
+        DynamicResolution::submitUpscale(VIEW_UPSCALE, uint16_t(width), uint16_t(height));
+        PosterRenderer::submitReadback(VIEW_EXPORT_READBACK);
+        SequenceExporter::submitReadback(VIEW_EXPORT_READBACK);
+
         bx::mtxSRT(mtx, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
         bgfx::setTransform(mtx);
 
         // End frame
 
-        bgfx::frame();
+        Trace::PhaseZone frameZone(Trace::Phase::BgfxFrame);
+        const uint32_t frameNumber = bgfx::frame();
+        frameZone.end();
+        Trace::endFrame();
+        SceneCounts sceneCounts;
+        for (const Instance* instance : instances)
+            countScene(instance, sceneCounts);
+        for (const auto& [idx, size] : s_meshSizes)
+            sceneCounts.meshBytes += size.bytes;
+        PerformancePanel::endFrame(bgfx::getStats(), sceneCounts);
+
+        PosterRenderer::update(frameNumber);
+        SequenceExporter::update(frameNumber);
+        Gallery::AddFinishedScreenshots();
+        updateRenderModeComparison();
+        DynamicResolution::update(bgfx::getStats());
 
 
     }
+    closeSceneStream(instances, availableTextures, importedObjMap);
+    // Imported mesh buffers go with their last instance, built-in ones are destroyed below.
+    gCmdManager.clear();
     for (const auto& instance : instances)
     {
-        const bgfx::VertexBufferHandle invalidVbh = BGFX_INVALID_HANDLE;
-        const bgfx::IndexBufferHandle invalidIbh = BGFX_INVALID_HANDLE;
-        // Destroy the vertex and index buffers if they are valid.
-        if (instance->vertexBuffer.idx != invalidVbh.idx &&
-            instance->indexBuffer.idx != invalidIbh.idx)
-        {
-            bgfx::destroy(instance->vertexBuffer);
-            bgfx::destroy(instance->indexBuffer);
-        }
         deleteInstance(instance);
     }
+    instances.clear();
 
     bgfx::destroy(vbh_plane);
     bgfx::destroy(ibh_plane);
@@ -5261,9 +6976,31 @@ int main(void)
     bgfx::destroy(ibh_innerCube);
     bgfx::destroy(defaultProgram);
     bgfx::destroy(lightDebugProgram);
+    if (bgfx::isValid(tamProgram))
+        bgfx::destroy(tamProgram);
+    bgfx::destroy(u_tamTex);
+    bgfx::destroy(u_tamParams);
+    bgfx::destroy(u_tamLod);
+    if (bgfx::isValid(sdfTextProgram))
+        bgfx::destroy(sdfTextProgram);
+    SdfText::shutdown();
+    SceneSaver::shutdown(); // let a save that is still running finish
+    CommandJournal::shutdown();
+    TonalArtMap::shutdown();
+    DeferredRenderer::shutdown();
+    DynamicResolution::shutdown();
+    PosterRenderer::shutdown();
+    SequenceExporter::shutdown();
+    videoPlayer.shutdown();
+    for (auto& [idx, positions] : s_positionStreams)
+        bgfx::destroy(positions);
+    s_positionStreams.clear();
+    if (bgfx::isValid(depthPrepassProgram))
+        bgfx::destroy(depthPrepassProgram);
     ImGui_ImplGlfw_Shutdown();
 
     bgfx::shutdown();
+    ScreenshotCapture::shutdown(); // finish writing the last screenshots
     glfwDestroyWindow(window);
     glfwTerminate();
 
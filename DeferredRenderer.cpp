@@ -0,0 +1,201 @@
+#include "DeferredRenderer.h"
+#include "ShaderLoader.h"
+
+#include <bx/math.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    constexpr int kParamColumns = int(sizeof(DeferredObjectParams) / (4 * sizeof(float)));
+
+    bgfx::ProgramHandle s_gbufferProgram = BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle s_lightingProgram = BGFX_INVALID_HANDLE;
+
+    bgfx::FrameBufferHandle s_gbuffer = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle s_gbufferTex[3] = { BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE };
+    uint16_t s_width = 0;
+    uint16_t s_height = 0;
+
+    bgfx::TextureHandle s_paramTexture = BGFX_INVALID_HANDLE;
+    std::vector<DeferredObjectParams> s_params;
+
+    bgfx::VertexBufferHandle s_quadVbh = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle s_quadIbh = BGFX_INVALID_HANDLE;
+
+    bgfx::UniformHandle u_objectParams = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_gbufAlbedo = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_gbufNormal = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_gbufDepth = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_objectParamTex = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_gbufInvViewProj = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_deferredParams = BGFX_INVALID_HANDLE;
+
+    float s_invViewProj[16];
+
+    void destroyGBuffer()
+    {
+        if (bgfx::isValid(s_gbuffer))
+            bgfx::destroy(s_gbuffer); // also destroys the attachments
+        s_gbuffer = BGFX_INVALID_HANDLE;
+        for (auto& tex : s_gbufferTex)
+            tex = BGFX_INVALID_HANDLE;
+        s_width = 0;
+        s_height = 0;
+    }
+
+    void createGBuffer(uint16_t width, uint16_t height)
+    {
+        const uint64_t flags = BGFX_TEXTURE_RT | BGFX_SAMPLER_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+        s_gbufferTex[0] = bgfx::createTexture2D(width, height, false, 1, bgfx::TextureFormat::RGBA8, flags);   // albedo
+        s_gbufferTex[1] = bgfx::createTexture2D(width, height, false, 1, bgfx::TextureFormat::RGBA16F, flags); // normal + parameter row
+        s_gbufferTex[2] = bgfx::createTexture2D(width, height, false, 1, bgfx::TextureFormat::D24S8, flags);   // depth
+        s_gbuffer = bgfx::createFrameBuffer(3, s_gbufferTex, true);
+        s_width = width;
+        s_height = height;
+    }
+}
+
+namespace DeferredRenderer
+{
+    bool initialize()
+    {
+        const bgfx::Caps* caps = bgfx::getCaps();
+        if (caps->limits.maxFrameBufferAttachments < 2
+            || (caps->formats[bgfx::TextureFormat::RGBA16F] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER) == 0
+            || (caps->formats[bgfx::TextureFormat::RGBA32F] & BGFX_CAPS_FORMAT_TEXTURE_2D) == 0)
+        {
+            std::cout << "Deferred shading not supported by this renderer" << std::endl;
+            return false;
+        }
+
+        // G-buffer fill reuses the forward vertex shader so the varyings match f_out28 exactly.
+        s_gbufferProgram = ShaderLoader::loadProgram("shaders\\v_out21.bin", "shaders\\f_gbuffer.bin");
+        // The text vertex shader is a plain position + uv pass-through, enough for a fullscreen quad.
+        s_lightingProgram = ShaderLoader::loadProgram("shaders\\v_text.bin", "shaders\\f_deferred_hatch.bin");
+        if (!bgfx::isValid(s_gbufferProgram) || !bgfx::isValid(s_lightingProgram))
+        {
+            std::cout << "Deferred shading shaders not found, deferred mode disabled" << std::endl;
+            shutdown();
+            return false;
+        }
+
+        u_objectParams = bgfx::createUniform("u_objectParams", bgfx::UniformType::Vec4);
+        u_gbufAlbedo = bgfx::createUniform("u_gbufAlbedo", bgfx::UniformType::Sampler);
+        u_gbufNormal = bgfx::createUniform("u_gbufNormal", bgfx::UniformType::Sampler);
+        u_gbufDepth = bgfx::createUniform("u_gbufDepth", bgfx::UniformType::Sampler);
+        u_objectParamTex = bgfx::createUniform("u_objectParamTex", bgfx::UniformType::Sampler);
+        u_gbufInvViewProj = bgfx::createUniform("u_gbufInvViewProj", bgfx::UniformType::Mat4);
+        u_deferredParams = bgfx::createUniform("u_deferredParams", bgfx::UniformType::Vec4);
+
+        s_paramTexture = bgfx::createTexture2D(uint16_t(kParamColumns), uint16_t(kMaxObjects), false, 1, bgfx::TextureFormat::RGBA32F,
+            BGFX_SAMPLER_POINT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+        s_params.reserve(kMaxObjects);
+
+        ShaderLoader::createFullscreenQuad(s_quadVbh, s_quadIbh);
+        return true;
+    }
+
+    void shutdown()
+    {
+        destroyGBuffer();
+        auto destroyIfValid = [](auto& handle) {
+            if (bgfx::isValid(handle))
+                bgfx::destroy(handle);
+            handle = BGFX_INVALID_HANDLE;
+        };
+        destroyIfValid(s_gbufferProgram);
+        destroyIfValid(s_lightingProgram);
+        destroyIfValid(s_paramTexture);
+        destroyIfValid(s_quadVbh);
+        destroyIfValid(s_quadIbh);
+        destroyIfValid(u_objectParams);
+        destroyIfValid(u_gbufAlbedo);
+        destroyIfValid(u_gbufNormal);
+        destroyIfValid(u_gbufDepth);
+        destroyIfValid(u_objectParamTex);
+        destroyIfValid(u_gbufInvViewProj);
+        destroyIfValid(u_deferredParams);
+        s_params.clear();
+    }
+
+    bool isAvailable()
+    {
+        return bgfx::isValid(s_gbufferProgram) && bgfx::isValid(s_lightingProgram);
+    }
+
+    void beginFrame(bgfx::ViewId gbufferView, uint16_t width, uint16_t height, const float* view, const float* proj)
+    {
+        if (width != s_width || height != s_height)
+        {
+            destroyGBuffer();
+            createGBuffer(width, height);
+        }
+
+        float viewProj[16];
+        bx::mtxMul(viewProj, view, proj);
+        bx::mtxInverse(s_invViewProj, viewProj);
+
+        s_params.clear();
+
+        bgfx::setViewName(gbufferView, "G-buffer");
+        bgfx::setViewFrameBuffer(gbufferView, s_gbuffer);
+        bgfx::setViewRect(gbufferView, 0, 0, width, height);
+        bgfx::setViewTransform(gbufferView, view, proj);
+        bgfx::setViewClear(gbufferView, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x00000000, 1.0f, 0);
+        bgfx::touch(gbufferView);
+    }
+
+    bool bindObject(const DeferredObjectParams& params)
+    {
+        if (int(s_params.size()) >= kMaxObjects)
+            return false;
+
+        const float row[4] = { float(s_params.size()), 0.0f, 0.0f, 0.0f };
+        s_params.push_back(params);
+        bgfx::setUniform(u_objectParams, row);
+        return true;
+    }
+
+    bgfx::ProgramHandle gbufferProgram()
+    {
+        return s_gbufferProgram;
+    }
+
+    void submitLighting(bgfx::ViewId lightingView, bgfx::FrameBufferHandle target, bgfx::UniformHandle u_noiseTex, bgfx::TextureHandle noise)
+    {
+        if (!s_params.empty())
+        {
+            bgfx::updateTexture2D(s_paramTexture, 0, 0, 0, 0, uint16_t(kParamColumns), uint16_t(s_params.size()),
+                bgfx::copy(s_params.data(), uint32_t(s_params.size() * sizeof(DeferredObjectParams))));
+        }
+
+        bgfx::setViewName(lightingView, "Deferred hatch");
+        bgfx::setViewFrameBuffer(lightingView, target);
+        bgfx::setViewRect(lightingView, 0, 0, s_width, s_height);
+        bgfx::setViewTransform(lightingView, nullptr, nullptr);
+        bgfx::setViewClear(lightingView, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
+        bgfx::touch(lightingView);
+
+        const bgfx::Caps* caps = bgfx::getCaps();
+        const float deferredParams[4] = { caps->homogeneousDepth ? 1.0f : 0.0f, float(kMaxObjects), caps->originBottomLeft ? 1.0f : 0.0f, float(kParamColumns) };
+        bgfx::setUniform(u_deferredParams, deferredParams);
+        bgfx::setUniform(u_gbufInvViewProj, s_invViewProj);
+
+        bgfx::setTexture(0, u_noiseTex, noise);
+        bgfx::setTexture(1, u_gbufAlbedo, s_gbufferTex[0]);
+        bgfx::setTexture(2, u_gbufNormal, s_gbufferTex[1]);
+        bgfx::setTexture(3, u_gbufDepth, s_gbufferTex[2]);
+        bgfx::setTexture(4, u_objectParamTex, s_paramTexture);
+
+        float identity[16];
+        bx::mtxIdentity(identity);
+        bgfx::setTransform(identity);
+        bgfx::setVertexBuffer(0, s_quadVbh);
+        bgfx::setIndexBuffer(s_quadIbh);
+        bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_ALWAYS);
+        bgfx::submit(lightingView, s_lightingProgram);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <cstdint>
+#include <bgfx/bgfx.h>
+
+// Everything f_out28 reads per object, packed as rows of the parameter texture.
+struct DeferredObjectParams
+{
+    float objectColor[4];
+    float tint[4];
+    float inkColor[4];
+    float hatch[4];      // epsilon, stroke multiplier, angle 1, angle 2 (u_e.x + u_params.yzw)
+    float extra[4];      // same as u_extraParams
+    float layer[4];      // same as u_paramsLayer
+};
+
+// Optional deferred path for the crosshatch shader. Opaque geometry only writes a cheap
+// G-buffer (albedo, normal + parameter row, depth); one fullscreen pass then runs the lighting
+// and hatching once per pixel, so the cost no longer grows with overdraw.
+namespace DeferredRenderer
+{
+    constexpr int kMaxObjects = 2048; // parameter rows per frame, limited by the half-float index
+
+    bool initialize();
+    void shutdown();
+    bool isAvailable();
+
+    // Resizes the G-buffer if needed, binds it to gbufferView and clears the parameter table.
+    void beginFrame(bgfx::ViewId gbufferView, uint16_t width, uint16_t height, const float* view, const float* proj);
+
+    // Stores the parameters for one draw and binds its row; returns false when the table is full
+    // (the caller then draws the object forward).
+    bool bindObject(const DeferredObjectParams& params);
+    bgfx::ProgramHandle gbufferProgram();
+
+    // Uploads the parameter table and submits the fullscreen lighting + hatching pass into target
+    // (invalid = backbuffer). It also writes depth so forward-only objects drawn afterwards are
+    // still occluded correctly.
+    void submitLighting(bgfx::ViewId lightingView, bgfx::FrameBufferHandle target, bgfx::UniformHandle u_noiseTex, bgfx::TextureHandle noise);
+}
+
+#endif // DEFERRED_RENDERER_H
@@ -0,0 +1,222 @@
+#include "DynamicResolution.h"
+#include "ShaderLoader.h"
+
+#include <bx/math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // The controller only moves in 5% steps and waits a few frames after each change,
+    // GPU timer results arrive with some latency and resizing the target is not free.
+    constexpr float kScaleStep = 0.05f;
+    constexpr float kMaxChangePerStep = 0.1f;
+    constexpr int kCooldownFrames = 20;
+    constexpr float kUpperBand = 1.05f; // shrink above target * kUpperBand
+    constexpr float kLowerBand = 0.85f; // grow below target * kLowerBand
+
+    DynamicResolutionSettings s_settings;
+
+    bgfx::ProgramHandle s_upscaleProgram = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_sceneColor = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_upscaleParams = BGFX_INVALID_HANDLE;
+    bgfx::VertexBufferHandle s_quadVbh = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle s_quadIbh = BGFX_INVALID_HANDLE;
+
+    bgfx::FrameBufferHandle s_target = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle s_targetColor = BGFX_INVALID_HANDLE;
+    uint16_t s_width = 0;
+    uint16_t s_height = 0;
+    uint16_t s_displayWidth = 0;
+    uint16_t s_displayHeight = 0;
+    bool s_active = false;
+
+    float s_scale = 1.0f;
+    float s_avgFrameMs = 0.0f;
+    int s_cooldown = 0;
+
+    void destroyTarget()
+    {
+        if (bgfx::isValid(s_target))
+            bgfx::destroy(s_target); // also destroys the attachments
+        s_target = BGFX_INVALID_HANDLE;
+        s_targetColor = BGFX_INVALID_HANDLE;
+        s_width = 0;
+        s_height = 0;
+    }
+
+    void createTarget(uint16_t width, uint16_t height)
+    {
+        bgfx::TextureHandle attachments[2];
+        attachments[0] = bgfx::createTexture2D(width, height, false, 1, bgfx::TextureFormat::RGBA8,
+            BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+        attachments[1] = bgfx::createTexture2D(width, height, false, 1, bgfx::TextureFormat::D24S8,
+            BGFX_TEXTURE_RT_WRITE_ONLY);
+        s_target = bgfx::createFrameBuffer(2, attachments, true);
+        s_targetColor = attachments[0];
+        s_width = width;
+        s_height = height;
+    }
+}
+
+namespace DynamicResolution
+{
+    bool initialize()
+    {
+        s_upscaleProgram = ShaderLoader::loadProgram("shaders\\v_text.bin", "shaders\\f_upscale_sharpen.bin");
+        if (!bgfx::isValid(s_upscaleProgram))
+        {
+            std::cout << "Upscale shader not found, dynamic resolution disabled" << std::endl;
+            return false;
+        }
+
+        u_sceneColor = bgfx::createUniform("u_sceneColor", bgfx::UniformType::Sampler);
+        u_upscaleParams = bgfx::createUniform("u_upscaleParams", bgfx::UniformType::Vec4);
+
+        ShaderLoader::createFullscreenQuad(s_quadVbh, s_quadIbh);
+        return true;
+    }
+
+    void shutdown()
+    {
+        destroyTarget();
+        auto destroyIfValid = [](auto& handle) {
+            if (bgfx::isValid(handle))
+                bgfx::destroy(handle);
+            handle = BGFX_INVALID_HANDLE;
+        };
+        destroyIfValid(s_upscaleProgram);
+        destroyIfValid(u_sceneColor);
+        destroyIfValid(u_upscaleParams);
+        destroyIfValid(s_quadVbh);
+        destroyIfValid(s_quadIbh);
+        s_active = false;
+    }
+
+    bool isAvailable()
+    {
+        return bgfx::isValid(s_upscaleProgram);
+    }
+
+    DynamicResolutionSettings& settings()
+    {
+        return s_settings;
+    }
+
+    void beginFrame(uint16_t displayWidth, uint16_t displayHeight)
+    {
+        s_displayWidth = displayWidth;
+        s_displayHeight = displayHeight;
+        s_active = s_settings.enabled && isAvailable();
+        if (!s_active)
+        {
+            destroyTarget();
+            s_scale = 1.0f;
+            s_cooldown = 0;
+            return;
+        }
+
+        s_scale = std::clamp(s_scale, s_settings.minScale, s_settings.maxScale);
+        const uint16_t width = uint16_t(std::max(1.0f, std::round(displayWidth * s_scale)));
+        const uint16_t height = uint16_t(std::max(1.0f, std::round(displayHeight * s_scale)));
+        if (width != s_width || height != s_height)
+        {
+            destroyTarget();
+            createTarget(width, height);
+        }
+    }
+
+    bool isActive()
+    {
+        return s_active;
+    }
+
+    bgfx::FrameBufferHandle target()
+    {
+        if (!s_active)
+            return BGFX_INVALID_HANDLE;
+        return s_target;
+    }
+
+    uint16_t renderWidth()
+    {
+        return s_active ? s_width : s_displayWidth;
+    }
+
+    uint16_t renderHeight()
+    {
+        return s_active ? s_height : s_displayHeight;
+    }
+
+    float scale()
+    {
+        return s_active ? s_scale : 1.0f;
+    }
+
+    void submitUpscale(bgfx::ViewId view, uint16_t displayWidth, uint16_t displayHeight)
+    {
+        if (!s_active)
+            return;
+
+        bgfx::setViewName(view, "Upscale");
+        bgfx::setViewFrameBuffer(view, BGFX_INVALID_HANDLE);
+        bgfx::setViewRect(view, 0, 0, displayWidth, displayHeight);
+        bgfx::setViewTransform(view, nullptr, nullptr);
+        bgfx::setViewClear(view, BGFX_CLEAR_NONE);
+
+        const float upscaleParams[4] = { 1.0f / float(s_width), 1.0f / float(s_height), s_settings.sharpness, 0.0f };
+        bgfx::setUniform(u_upscaleParams, upscaleParams);
+        bgfx::setTexture(0, u_sceneColor, s_targetColor);
+
+        float identity[16];
+        bx::mtxIdentity(identity);
+        bgfx::setTransform(identity);
+        bgfx::setVertexBuffer(0, s_quadVbh);
+        bgfx::setIndexBuffer(s_quadIbh);
+        bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A);
+        bgfx::submit(view, s_upscaleProgram);
+    }
+
+    void update(const bgfx::Stats* stats)
+    {
+        if (!s_active || stats == nullptr)
+            return;
+
+        const double gpuMs = stats->gpuTimerFreq > 0
+            ? double(stats->gpuTimeEnd - stats->gpuTimeBegin) * 1000.0 / double(stats->gpuTimerFreq) : 0.0;
+        const double cpuMs = stats->cpuTimerFreq > 0
+            ? double(stats->cpuTimeEnd - stats->cpuTimeBegin) * 1000.0 / double(stats->cpuTimerFreq) : 0.0;
+        const float frameMs = float(std::max(gpuMs, cpuMs));
+        if (frameMs <= 0.0f)
+            return;
+        s_avgFrameMs = s_avgFrameMs <= 0.0f ? frameMs : s_avgFrameMs + (frameMs - s_avgFrameMs) * 0.1f;
+
+        if (s_cooldown > 0)
+        {
+            s_cooldown--;
+            return;
+        }
+
+        const float target = std::max(s_settings.targetFrameMs, 1.0f);
+        if (s_avgFrameMs <= target * kUpperBand && s_avgFrameMs >= target * kLowerBand)
+            return;
+
+        // Pixel cost grows with the area, so the linear scale follows the square root of the ratio.
+        float desired = s_scale * std::sqrt(target / s_avgFrameMs);
+        desired = std::clamp(desired, s_scale - kMaxChangePerStep, s_scale + kMaxChangePerStep);
+        desired = std::round(desired / kScaleStep) * kScaleStep;
+        desired = std::clamp(desired, s_settings.minScale, s_settings.maxScale);
+        if (desired != s_scale)
+        {
+            s_scale = desired;
+            s_cooldown = kCooldownFrames;
+        }
+    }
+
+    float averageFrameMs()
+    {
+        return s_avgFrameMs;
+    }
+}
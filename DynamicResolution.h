@@ -0,0 +1,43 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <cstdint>
+#include <bgfx/bgfx.h>
+
+struct DynamicResolutionSettings
+{
+    bool enabled = false;
+    float targetFrameMs = 16.6f; // budget for max(GPU frame, render thread CPU)
+    float minScale = 0.5f;       // render target size relative to the viewport
+    float maxScale = 1.0f;
+    float sharpness = 0.5f;      // 0 = plain bilinear upscale, 1 = strongest sharpening
+};
+
+// Optional dynamic resolution for the 3D viewport. The scene views render into an offscreen
+// target whose size follows the frame time measured by bgfx, and a fullscreen pass upscales it
+// to the backbuffer with a contrast-adaptive sharpen before ImGui draws on top.
+namespace DynamicResolution
+{
+    bool initialize();
+    void shutdown();
+    bool isAvailable();
+    DynamicResolutionSettings& settings();
+
+    // Sizes the offscreen target for this frame. When the feature is off (or unavailable) the
+    // scene renders straight into the backbuffer and target() is invalid.
+    void beginFrame(uint16_t displayWidth, uint16_t displayHeight);
+    bool isActive();
+    bgfx::FrameBufferHandle target();
+    uint16_t renderWidth();
+    uint16_t renderHeight();
+    float scale();
+
+    // Draws the scene target over the whole backbuffer.
+    void submitUpscale(bgfx::ViewId view, uint16_t displayWidth, uint16_t displayHeight);
+
+    // Feeds the timings of the frame that just finished into the scale controller.
+    void update(const bgfx::Stats* stats);
+    float averageFrameMs();
+}
+
+#endif // DYNAMIC_RESOLUTION_H
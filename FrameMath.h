@@ -0,0 +1,85 @@
+#ifndef FRAME_MATH_H
+#define FRAME_MATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <bx/math.h>
+
+// Per-instance math of the frame loop, shared by the editor and CrossHatchBench so the benchmark
+// measures the same work.
+namespace FrameMath
+{
+    // Scale-rotate-translate of one instance, then the parent's world matrix (nullptr at the top).
+    inline void worldMatrix(float* world, const float* scale, const float* rotation, const float* position, const float* parentWorld)
+    {
+        float local[16];
+        bx::mtxSRT(local,
+            scale[0], scale[1], scale[2],
+            rotation[0], rotation[1], rotation[2],
+            position[0], position[1], position[2]);
+        if (parentWorld)
+            bx::mtxMul(world, local, parentWorld);
+        else
+            std::memcpy(world, local, sizeof(local));
+    }
+
+    // World space center of an object space bounding sphere, returns its world radius.
+    inline float worldSphere(const float* center, float radius, const float* world, float* worldCenter)
+    {
+        for (int a = 0; a < 3; a++)
+            worldCenter[a] = center[0] * world[a] + center[1] * world[4 + a] + center[2] * world[8 + a] + world[12 + a];
+        float axisScale = 0.0f;
+        for (int row = 0; row < 3; row++)
+            axisScale = std::max(axisScale, std::sqrt(world[row * 4] * world[row * 4] + world[row * 4 + 1] * world[row * 4 + 1] + world[row * 4 + 2] * world[row * 4 + 2]));
+        return radius * axisScale;
+    }
+
+    // Diameter in pixels of an object space bounding sphere, or -1 when the eye is inside it.
+    // pixelsPerUnit is the projection's y scale times half the viewport height.
+    inline float projectedSizePx(const float* center, float radius, const float* world, const float* eye, float pixelsPerUnit)
+    {
+        float worldCenter[3];
+        const float worldRadius = worldSphere(center, radius, world, worldCenter);
+        const float dx = worldCenter[0] - eye[0];
+        const float dy = worldCenter[1] - eye[1];
+        const float dz = worldCenter[2] - eye[2];
+        const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (distance <= worldRadius)
+            return -1.0f;
+        return 2.0f * worldRadius * pixelsPerUnit / distance;
+    }
+
+    enum HatchLod { HATCH_LOD_FULL, HATCH_LOD_SINGLE_LAYER, HATCH_LOD_TONE_ONLY, HATCH_LOD_COUNT };
+
+    // Hatch level of detail of an object space bounding sphere, from its projected size against the
+    // thresholds (the scene's, or the instance's own when it overrides them). Rewrites the resolved
+    // u_e / u_extraParams / u_paramsLayer values: mode 1 (extra[3]) for single-layer, mode 5 for
+    // tone-only. The pattern scale shrinks with the object so stroke spacing stays roughly constant
+    // in pixels, and the single-layer variant takes over the inner layer's density so the overall
+    // tone holds. Mode 4 and a camera inside the bounds always keep the full hatch.
+    inline int hatchLod(const float* center, float radius, const float* world, const float* eye, float pixelsPerUnit,
+        float singleLayerPx, float toneOnlyPx, float* hatch, float* extra, float* layer)
+    {
+        const int mode = int(extra[3]);
+        if (pixelsPerUnit <= 0.0f || mode == 4)
+            return HATCH_LOD_FULL;
+        const float sizePx = projectedSizePx(center, radius, world, eye, pixelsPerUnit);
+        if (sizePx < 0.0f || sizePx >= singleLayerPx)
+            return HATCH_LOD_FULL;
+
+        const float factor = std::max(sizePx / std::max(singleLayerPx, 1.0f), 0.25f);
+        extra[0] *= factor;
+        layer[0] *= factor;
+        if (sizePx < toneOnlyPx) {
+            extra[3] = 5.0f;
+            return HATCH_LOD_TONE_ONLY;
+        }
+        if (mode >= 2)
+            hatch[1] += layer[1];
+        extra[3] = 1.0f;
+        return HATCH_LOD_SINGLE_LAYER;
+    }
+}
+
+#endif // FRAME_MATH_H
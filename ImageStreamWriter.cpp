@@ -0,0 +1,583 @@
+#include "ImageStreamWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "PngEncoder.h"
+
+namespace
+{
+    const uint32_t IDAT_CHUNK_SIZE = 1 << 16;
+    const uint32_t TIFF_STRIP_BYTES = 256 * 1024; // uncompressed bytes per strip, at least one row
+    const uint32_t ADLER_MOD = 65521;
+
+    // Deflate length codes 257..285.
+    const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+    enum TiffType : uint16_t
+    {
+        TIFF_SHORT = 3,
+        TIFF_LONG = 4,
+        TIFF_RATIONAL = 5,
+        TIFF_LONG8 = 16,
+    };
+
+    struct TiffEntry
+    {
+        uint16_t tag = 0;
+        uint16_t type = 0;
+        uint64_t count = 0;
+        std::vector<uint8_t> data; // little-endian values
+        uint64_t dataOffset = 0;   // when data does not fit in the entry
+    };
+
+    uint32_t crcTable[256];
+    bool crcTableReady = false;
+
+    uint32_t crc32(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        if (!crcTableReady)
+        {
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                crcTable[n] = c;
+            }
+            crcTableReady = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < size; ++i)
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void putBigEndian32(uint8_t* out, uint32_t value)
+    {
+        out[0] = uint8_t(value >> 24);
+        out[1] = uint8_t(value >> 16);
+        out[2] = uint8_t(value >> 8);
+        out[3] = uint8_t(value);
+    }
+
+    void appendLittleEndian(std::vector<uint8_t>& out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+            out.push_back(uint8_t(value >> (8 * i)));
+    }
+
+    uint8_t paeth(int a, int b, int c)
+    {
+        const int p = a + b - c;
+        const int pa = std::abs(p - a);
+        const int pb = std::abs(p - b);
+        const int pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc)
+            return uint8_t(a);
+        return uint8_t(pb <= pc ? b : c);
+    }
+
+    // One row, independently of the others as TIFF requires.
+    void packBits(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+    {
+        size_t i = 0;
+        while (i < size)
+        {
+            size_t run = 1;
+            while (i + run < size && run < 128 && src[i + run] == src[i])
+                ++run;
+            if (run >= 3)
+            {
+                out.push_back(uint8_t(257 - run));
+                out.push_back(src[i]);
+                i += run;
+                continue;
+            }
+            size_t end = i;
+            while (end < size && end - i < 128)
+            {
+                if (end + 2 < size && src[end] == src[end + 1] && src[end] == src[end + 2])
+                    break;
+                ++end;
+            }
+            out.push_back(uint8_t(end - i - 1));
+            out.insert(out.end(), src + i, src + end);
+            i = end;
+        }
+    }
+}
+
+ImageStreamWriter::~ImageStreamWriter()
+{
+    if (file)
+        close(); // incomplete, removes the file
+}
+
+bool ImageStreamWriter::open(const std::string& outputPath, uint32_t imageWidth, uint32_t imageHeight, float resolutionDpi)
+{
+    if (file)
+        close();
+    if (imageWidth == 0 || imageHeight == 0)
+        return false;
+
+    std::string extension = std::filesystem::path(outputPath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    if (extension == ".png")
+        format = Format::Png;
+    else if (extension == ".tif" || extension == ".tiff")
+        format = Format::Tiff;
+    else
+    {
+        std::cerr << "[ImageStreamWriter] Unsupported format: " << outputPath << std::endl;
+        return false;
+    }
+
+    std::error_code ec;
+    const std::filesystem::path parent = std::filesystem::path(outputPath).parent_path();
+    if (!parent.empty())
+        std::filesystem::create_directories(parent, ec);
+    file = std::fopen(outputPath.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "[ImageStreamWriter] Failed to create " << outputPath << std::endl;
+        return false;
+    }
+
+    path = outputPath;
+    width = imageWidth;
+    height = imageHeight;
+    dpi = resolutionDpi > 0.0f ? resolutionDpi : 300.0f;
+    writtenRows = 0;
+    failed = false;
+    offset = 0;
+    return format == Format::Png ? beginPng() : beginTiff();
+}
+
+bool ImageStreamWriter::writeRows(const uint8_t* rgb, uint32_t rowCount)
+{
+    if (!file || failed)
+        return false;
+    if (rowCount > height - writtenRows)
+    {
+        failed = true;
+        return false;
+    }
+
+    const size_t rowBytes = size_t(width) * 3;
+    if (format == Format::Png && parallelDeflate)
+    {
+        const bool last = writtenRows + rowCount == height;
+        if (!PngEncoder::deflateRows(idat, parallelAdler, rgb, writtenRows > 0 ? prevRow.data() : nullptr, rowCount,
+            width, 3, rowBytes, PngEncoder::Level::High, last))
+            failed = true;
+        if (rowCount > 0)
+            std::memcpy(prevRow.data(), rgb + (rowCount - 1) * rowBytes, rowBytes);
+        flushIdat(false);
+    }
+    else if (format == Format::Png)
+    {
+        // One fixed-Huffman block per call, never the final one.
+        putBits(0, 1);
+        putBits(1, 2);
+        for (uint32_t y = 0; y < rowCount; ++y)
+        {
+            filterRow(rgb + y * rowBytes);
+            deflateRun(filtered.data(), filtered.size());
+        }
+        putLiteral(256);
+        flushIdat(false);
+    }
+    else
+    {
+        stripRows.insert(stripRows.end(), rgb, rgb + rowCount * rowBytes);
+        const size_t stripBytes = rowsPerStrip * rowBytes;
+        size_t consumed = 0;
+        while (stripRows.size() - consumed >= stripBytes)
+        {
+            writeStrip(stripRows.data() + consumed, rowsPerStrip);
+            consumed += stripBytes;
+        }
+        stripRows.erase(stripRows.begin(), stripRows.begin() + consumed);
+    }
+    writtenRows += rowCount;
+    return !failed;
+}
+
+bool ImageStreamWriter::close()
+{
+    if (!file)
+        return false;
+    bool ok = !failed && writtenRows == height;
+    if (ok)
+        ok = format == Format::Png ? finishPng() : finishTiff();
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok)
+    {
+        std::cerr << "[ImageStreamWriter] Failed to write " << path << " (" << writtenRows << "/" << height << " rows)" << std::endl;
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::vector<uint8_t>().swap(prevRow);
+    std::vector<uint8_t>().swap(filtered);
+    std::vector<uint8_t>().swap(candidate);
+    std::vector<uint8_t>().swap(idat);
+    std::vector<uint8_t>().swap(stripRows);
+    std::vector<uint8_t>().swap(packed);
+    stripOffsets.clear();
+    stripByteCounts.clear();
+    return ok;
+}
+
+bool ImageStreamWriter::writeBytes(const void* data, size_t size)
+{
+    if (failed)
+        return false;
+    if (size > 0 && std::fwrite(data, 1, size, file) != size)
+        failed = true;
+    offset += size;
+    return !failed;
+}
+
+// --- PNG ---
+
+bool ImageStreamWriter::beginPng()
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    writeBytes(signature, sizeof(signature));
+
+    uint8_t header[13];
+    putBigEndian32(header, width);
+    putBigEndian32(header + 4, height);
+    header[8] = 8;  // bit depth
+    header[9] = 2;  // RGB
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // no interlace
+    writeChunk("IHDR", header, sizeof(header));
+
+    uint8_t physical[9];
+    const uint32_t pixelsPerMeter = uint32_t(std::lround(dpi / 0.0254f));
+    putBigEndian32(physical, pixelsPerMeter);
+    putBigEndian32(physical + 4, pixelsPerMeter);
+    physical[8] = 1; // meters
+    writeChunk("pHYs", physical, sizeof(physical));
+
+    prevRow.assign(size_t(width) * 3, 0);
+    filtered.resize(size_t(width) * 3 + 1);
+    candidate.resize(filtered.size());
+    idat.clear();
+    bitBuffer = 0;
+    bitCount = 0;
+    haveLastByte = false;
+    adlerA = 1;
+    adlerB = 0;
+    parallelDeflate = PngEncoder::isParallel();
+    parallelAdler = 1;
+
+    // zlib header: deflate, 32K window, fastest compression level
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    return !failed;
+}
+
+bool ImageStreamWriter::finishPng()
+{
+    if (!parallelDeflate) // the parallel stream was finished with the last band
+    {
+        putBits(1, 1); // final, empty block
+        putBits(1, 2);
+        putLiteral(256);
+        if (bitCount > 0)
+            putBits(0, 8 - bitCount);
+    }
+
+    uint8_t adler[4];
+    putBigEndian32(adler, parallelDeflate ? parallelAdler : (adlerB << 16) | adlerA);
+    idat.insert(idat.end(), adler, adler + 4);
+    flushIdat(true);
+    writeChunk("IEND", nullptr, 0);
+    return !failed;
+}
+
+// Picks the filter with the smallest sum of absolute values (the usual heuristic), keeps the
+// result in filtered and feeds it to the Adler-32 checksum.
+void ImageStreamWriter::filterRow(const uint8_t* row)
+{
+    const size_t rowBytes = size_t(width) * 3;
+    uint64_t bestSum = UINT64_MAX;
+    for (uint8_t type = 1; type <= 4; ++type)
+    {
+        if (type == 3)
+            continue; // Average rarely wins on hatching
+        candidate[0] = type;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < rowBytes; ++i)
+        {
+            const int left = i >= 3 ? row[i - 3] : 0;
+            const int up = prevRow[i];
+            const int upLeft = i >= 3 ? prevRow[i - 3] : 0;
+            uint8_t predicted = 0;
+            if (type == 1)
+                predicted = uint8_t(left);
+            else if (type == 2)
+                predicted = uint8_t(up);
+            else
+                predicted = paeth(left, up, upLeft);
+            const uint8_t value = uint8_t(row[i] - predicted);
+            candidate[i + 1] = value;
+            sum += value < 128 ? value : 256 - value;
+            if (sum >= bestSum)
+                break;
+        }
+        if (sum < bestSum)
+        {
+            bestSum = sum;
+            filtered.swap(candidate);
+        }
+    }
+    std::memcpy(prevRow.data(), row, rowBytes);
+
+    const uint8_t* data = filtered.data();
+    size_t remaining = filtered.size();
+    while (remaining > 0)
+    {
+        const size_t block = std::min<size_t>(remaining, 5552); // largest run without overflow
+        for (size_t i = 0; i < block; ++i)
+        {
+            adlerA += data[i];
+            adlerB += adlerA;
+        }
+        adlerA %= ADLER_MOD;
+        adlerB %= ADLER_MOD;
+        data += block;
+        remaining -= block;
+    }
+}
+
+void ImageStreamWriter::deflateRun(const uint8_t* data, size_t size)
+{
+    size_t i = 0;
+    while (i < size)
+    {
+        if (haveLastByte && data[i] == lastByte)
+        {
+            size_t run = 1;
+            while (i + run < size && run < 258 && data[i + run] == lastByte)
+                ++run;
+            if (run >= 3)
+            {
+                putMatch(uint32_t(run));
+                i += run;
+                continue;
+            }
+        }
+        putLiteral(data[i]);
+        lastByte = data[i];
+        haveLastByte = true;
+        ++i;
+    }
+    if (idat.size() >= IDAT_CHUNK_SIZE)
+        flushIdat(false);
+}
+
+void ImageStreamWriter::putBits(uint32_t bits, int count)
+{
+    bitBuffer |= uint64_t(bits) << bitCount;
+    bitCount += count;
+    while (bitCount >= 8)
+    {
+        idat.push_back(uint8_t(bitBuffer));
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+// Huffman codes are stored most significant bit first.
+void ImageStreamWriter::putHuffman(uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    putBits(reversed, length);
+}
+
+// Fixed Huffman literal/length alphabet (RFC 1951, 3.2.6).
+void ImageStreamWriter::putLiteral(uint32_t value)
+{
+    if (value < 144)
+        putHuffman(0x30 + value, 8);
+    else if (value < 256)
+        putHuffman(0x190 + value - 144, 9);
+    else if (value < 280)
+        putHuffman(value - 256, 7);
+    else
+        putHuffman(0xC0 + value - 280, 8);
+}
+
+// Repeats the previous byte: a length code followed by distance 1 (fixed distance code 0).
+void ImageStreamWriter::putMatch(uint32_t length)
+{
+    int code = 28;
+    while (LENGTH_BASE[code] > length)
+        --code;
+    putLiteral(257 + code);
+    if (LENGTH_EXTRA[code] > 0)
+        putBits(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+    putHuffman(0, 5);
+}
+
+bool ImageStreamWriter::flushIdat(bool all)
+{
+    if (idat.empty() || (!all && idat.size() < IDAT_CHUNK_SIZE))
+        return !failed;
+    writeChunk("IDAT", idat.data(), uint32_t(idat.size()));
+    idat.clear();
+    return !failed;
+}
+
+bool ImageStreamWriter::writeChunk(const char type[4], const uint8_t* data, uint32_t size)
+{
+    uint8_t length[4];
+    putBigEndian32(length, size);
+    uint32_t crc = crc32(0, reinterpret_cast<const uint8_t*>(type), 4);
+    if (size > 0)
+        crc = crc32(crc, data, size);
+    uint8_t crcBytes[4];
+    putBigEndian32(crcBytes, crc);
+
+    writeBytes(length, 4);
+    writeBytes(type, 4);
+    writeBytes(data, size);
+    return writeBytes(crcBytes, 4);
+}
+
+// --- TIFF ---
+
+bool ImageStreamWriter::beginTiff()
+{
+    const uint64_t rowBytes = uint64_t(width) * 3;
+    rowsPerStrip = uint32_t(std::clamp<uint64_t>(TIFF_STRIP_BYTES / rowBytes, 1, height));
+    const uint64_t strips = (uint64_t(height) + rowsPerStrip - 1) / rowsPerStrip;
+
+    // PackBits grows incompressible rows by one byte per 128, classic TIFF offsets are 32 bit.
+    const uint64_t worstCase = uint64_t(height) * (rowBytes + rowBytes / 128 + 1) + strips * 16 + 4096;
+    bigTiff = worstCase > 0xFFFFFFFFull;
+
+    stripOffsets.clear();
+    stripByteCounts.clear();
+    stripRows.clear();
+
+    std::vector<uint8_t> header = { 'I', 'I' };
+    if (bigTiff)
+    {
+        appendLittleEndian(header, 43, 2);
+        appendLittleEndian(header, 8, 2); // offset size
+        appendLittleEndian(header, 0, 2);
+        appendLittleEndian(header, 0, 8); // first IFD, patched by finishTiff
+    }
+    else
+    {
+        appendLittleEndian(header, 42, 2);
+        appendLittleEndian(header, 0, 4);
+    }
+    return writeBytes(header.data(), header.size());
+}
+
+bool ImageStreamWriter::writeStrip(const uint8_t* rgb, uint32_t rowCount)
+{
+    const size_t rowBytes = size_t(width) * 3;
+    packed.clear();
+    for (uint32_t y = 0; y < rowCount; ++y)
+        packBits(rgb + y * rowBytes, rowBytes, packed);
+    stripOffsets.push_back(offset);
+    stripByteCounts.push_back(packed.size());
+    return writeBytes(packed.data(), packed.size());
+}
+
+bool ImageStreamWriter::finishTiff()
+{
+    const size_t rowBytes = size_t(width) * 3;
+    if (!stripRows.empty())
+        writeStrip(stripRows.data(), uint32_t(stripRows.size() / rowBytes));
+
+    const uint16_t offsetType = bigTiff ? TIFF_LONG8 : TIFF_LONG;
+    const int offsetBytes = bigTiff ? 8 : 4;
+    const uint32_t dpiNumerator = uint32_t(std::lround(dpi * 100.0f));
+
+    std::vector<TiffEntry> entries;
+    auto addEntry = [&](uint16_t tag, uint16_t type, const std::vector<uint64_t>& values) {
+        TiffEntry entry;
+        entry.tag = tag;
+        entry.type = type;
+        entry.count = type == TIFF_RATIONAL ? values.size() / 2 : values.size();
+        const int bytes = type == TIFF_SHORT ? 2 : (type == TIFF_LONG8 ? 8 : 4);
+        for (uint64_t value : values)
+            appendLittleEndian(entry.data, value, bytes);
+        entries.push_back(std::move(entry));
+    };
+    addEntry(256, TIFF_LONG, { width });
+    addEntry(257, TIFF_LONG, { height });
+    addEntry(258, TIFF_SHORT, { 8, 8, 8 });
+    addEntry(259, TIFF_SHORT, { 32773 }); // PackBits
+    addEntry(262, TIFF_SHORT, { 2 });     // RGB
+    addEntry(273, offsetType, stripOffsets);
+    addEntry(277, TIFF_SHORT, { 3 });
+    addEntry(278, TIFF_LONG, { rowsPerStrip });
+    addEntry(279, offsetType, stripByteCounts);
+    addEntry(282, TIFF_RATIONAL, { dpiNumerator, 100 });
+    addEntry(283, TIFF_RATIONAL, { dpiNumerator, 100 });
+    addEntry(284, TIFF_SHORT, { 1 });     // chunky
+    addEntry(296, TIFF_SHORT, { 2 });     // inch
+
+    // Values that do not fit in their entry go first, word aligned.
+    const size_t inlineBytes = bigTiff ? 8 : 4;
+    for (TiffEntry& entry : entries)
+    {
+        if (entry.data.size() <= inlineBytes)
+            continue;
+        if (offset & 1)
+            writeBytes("", 1);
+        entry.dataOffset = offset;
+        writeBytes(entry.data.data(), entry.data.size());
+    }
+    if (offset & 1)
+        writeBytes("", 1);
+
+    const uint64_t ifdOffset = offset;
+    std::vector<uint8_t> ifd;
+    appendLittleEndian(ifd, entries.size(), bigTiff ? 8 : 2);
+    for (const TiffEntry& entry : entries)
+    {
+        appendLittleEndian(ifd, entry.tag, 2);
+        appendLittleEndian(ifd, entry.type, 2);
+        appendLittleEndian(ifd, entry.count, offsetBytes);
+        if (entry.data.size() <= inlineBytes)
+        {
+            ifd.insert(ifd.end(), entry.data.begin(), entry.data.end());
+            ifd.resize(ifd.size() + inlineBytes - entry.data.size(), 0);
+        }
+        else
+        {
+            appendLittleEndian(ifd, entry.dataOffset, offsetBytes);
+        }
+    }
+    appendLittleEndian(ifd, 0, offsetBytes); // no further IFD
+    writeBytes(ifd.data(), ifd.size());
+
+    std::vector<uint8_t> first;
+    appendLittleEndian(first, ifdOffset, offsetBytes);
+    if (failed || std::fseek(file, bigTiff ? 8 : 4, SEEK_SET) != 0 || std::fwrite(first.data(), 1, first.size(), file) != first.size())
+        failed = true;
+    return !failed;
+}
@@ -0,0 +1,90 @@
+#ifndef IMAGE_STREAM_WRITER_H
+#define IMAGE_STREAM_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes an 8-bit RGB image top to bottom, a band of rows at a time, so images far larger than
+// what fits in memory (print-size posters) can be produced. The format follows the extension:
+//   .png          filtered rows, one zlib stream over many IDAT chunks (parallel zlib deflate
+//                 through PngEncoder, or a built-in run-length deflate without zlib)
+//   .tif / .tiff  PackBits strips, BigTIFF once the file could pass 4 GB
+class ImageStreamWriter
+{
+public:
+    ImageStreamWriter() = default;
+    ~ImageStreamWriter();
+    ImageStreamWriter(const ImageStreamWriter&) = delete;
+    ImageStreamWriter& operator=(const ImageStreamWriter&) = delete;
+
+    // dpi only goes into the file's resolution tags.
+    bool open(const std::string& path, uint32_t width, uint32_t height, float dpi = 300.0f);
+    // rgb holds rowCount tightly packed rows. Returns false once a write failed.
+    bool writeRows(const uint8_t* rgb, uint32_t rowCount);
+    // Finishes the file. Fails if fewer rows than the height were written.
+    bool close();
+
+    bool isOpen() const { return file != nullptr; }
+    uint32_t rowsWritten() const { return writtenRows; }
+
+private:
+    enum class Format { Png, Tiff };
+
+    bool writeBytes(const void* data, size_t size);
+
+    // PNG
+    bool beginPng();
+    bool finishPng();
+    void filterRow(const uint8_t* row);
+    void deflateRun(const uint8_t* data, size_t size);
+    void putBits(uint32_t bits, int count);
+    void putHuffman(uint32_t code, int length);
+    void putLiteral(uint32_t value);
+    void putMatch(uint32_t length);
+    bool flushIdat(bool all);
+    bool writeChunk(const char type[4], const uint8_t* data, uint32_t size);
+
+    // TIFF
+    bool beginTiff();
+    bool finishTiff();
+    bool writeStrip(const uint8_t* rgb, uint32_t rowCount);
+
+    FILE* file = nullptr;
+    std::string path;
+    Format format = Format::Png;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float dpi = 300.0f;
+    uint32_t writtenRows = 0;
+    bool failed = false;
+
+    // PNG state. The deflate stream is a series of fixed-Huffman blocks whose only matches are
+    // distance-1 runs; filtered hatching is mostly long runs of zeros, so that is where the size goes.
+    std::vector<uint8_t> prevRow;
+    std::vector<uint8_t> filtered;    // filter type byte + row
+    std::vector<uint8_t> candidate;
+    std::vector<uint8_t> idat;        // compressed bytes not yet in a chunk
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+    bool haveLastByte = false;
+    uint8_t lastByte = 0;
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    // With zlib the rows go through PngEncoder instead: every band is filtered and deflated on
+    // all cores at level 9.
+    bool parallelDeflate = false;
+    uint32_t parallelAdler = 1;
+
+    // TIFF state
+    bool bigTiff = false;
+    uint32_t rowsPerStrip = 0;
+    uint64_t offset = 0;
+    std::vector<uint64_t> stripOffsets;
+    std::vector<uint64_t> stripByteCounts;
+    std::vector<uint8_t> stripRows;   // rows waiting for a full strip
+    std::vector<uint8_t> packed;
+};
+
+#endif // IMAGE_STREAM_WRITER_H
@@ -1,6 +1,8 @@
 // Light.h
 #pragma once
 
+#include <cmath>
+
 enum class LightType {
     Directional,
     Point,
@@ -16,3 +18,40 @@ struct LightProperties {
     float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 };
 
+const int MAX_LIGHTS = 16;
+
+// Writes one light as the 4 vec4's of the u_lights uniform: type and intensity, world position,
+// world direction and cone angle, color and range.
+inline void packLight(const LightProperties& light, const float* world, float* packed)
+{
+    packed[0] = static_cast<float>(light.type);
+    packed[1] = light.intensity;
+    packed[2] = 0.0f;
+    packed[3] = 0.0f;
+
+    // Translation is stored in elements 12, 13, 14
+    packed[4] = world[12];
+    packed[5] = world[13];
+    packed[6] = world[14];
+    packed[7] = 1.0f;
+
+    // The direction only goes through the 3x3 rotation part, then gets normalized.
+    float worldDir[3];
+    for (int a = 0; a < 3; a++)
+        worldDir[a] = world[a] * light.direction[0] + world[4 + a] * light.direction[1] + world[8 + a] * light.direction[2];
+    const float length = std::sqrt(worldDir[0] * worldDir[0] + worldDir[1] * worldDir[1] + worldDir[2] * worldDir[2]);
+    if (length > 0.0001f) {
+        worldDir[0] /= length;
+        worldDir[1] /= length;
+        worldDir[2] /= length;
+    }
+    packed[8] = worldDir[0];
+    packed[9] = worldDir[1];
+    packed[10] = worldDir[2];
+    packed[11] = light.coneAngle;
+
+    packed[12] = light.color[0];
+    packed[13] = light.color[1];
+    packed[14] = light.color[2];
+    packed[15] = light.range;
+}
@@ -1,12 +1,51 @@
 #include "Logger.h"
 #include <imgui.h>
 
-Logger::Logger() {
-    std::cout.rdbuf(this);  // Redirect std::cout to this class
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const ImVec4 WARNING_COLOR(1.0f, 0.8f, 0.3f, 1.0f);
+    const ImVec4 ERROR_COLOR(1.0f, 0.4f, 0.4f, 1.0f);
+
+    const std::chrono::steady_clock::time_point s_start = std::chrono::steady_clock::now();
+    ImGuiTextFilter s_filter;
+
+    // Per thread and stream, the line being written. Only the owning thread touches it.
+    thread_local std::string t_staging[2];
+
+    float secondsSinceStart()
+    {
+        return std::chrono::duration<float>(std::chrono::steady_clock::now() - s_start).count();
+    }
+
+    bool mentionsWarning(std::string_view line)
+    {
+        static const char word[] = "warning";
+        auto it = std::search(line.begin(), line.end(), word, word + sizeof(word) - 1,
+            [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+        return it != line.end();
+    }
+}
+
+Logger::Logger()
+    : ring(new Slot[RING_SIZE])
+    , coutStream(*this, Level::Info, 0)
+    , cerrStream(*this, Level::Error, 1)
+{
+    for (size_t i = 0; i < RING_SIZE; ++i)
+        ring[i].sequence.store(i, std::memory_order_relaxed);
+    originalCout = std::cout.rdbuf(&coutStream);  // Redirect std::cout to this class
+    originalCerr = std::cerr.rdbuf(&cerrStream);
 }
 
 Logger::~Logger() {
-    std::cout.rdbuf(nullptr);  // Reset redirection
+    std::cout.rdbuf(originalCout);  // Reset redirection
+    std::cerr.rdbuf(originalCerr);
+    delete[] ring;
 }
 
 Logger& Logger::GetInstance() {
@@ -14,40 +53,167 @@ Logger& Logger::GetInstance() {
     return instance;
 }
 
-int Logger::overflow(int c) {
-    std::lock_guard<std::mutex> lock(logMutex);
-    if (c != EOF) {
-        logBuffer.put(static_cast<char>(c));
+int Logger::Stream::overflow(int c) {
+    if (c == EOF)
+        return c;
+    std::string& staging = t_staging[index];
+    if (c == '\n') {
+        logger.Log(level == Level::Info && mentionsWarning(staging) ? Level::Warning : level, staging);
+        staging.clear();
+    }
+    else if (c != '\r') {
+        staging.push_back(static_cast<char>(c));
     }
     return c;
 }
 
+std::streamsize Logger::Stream::xsputn(const char* s, std::streamsize count) {
+    for (std::streamsize i = 0; i < count; ++i)
+        overflow(static_cast<unsigned char>(s[i]));
+    return count;
+}
+
+void Logger::Log(Level level, std::string_view line) {
+    const size_t slots = std::clamp<size_t>((line.size() + SLOT_TEXT - 1) / SLOT_TEXT, 1, MAX_LINE_SLOTS);
+    Publish(level, line.substr(0, slots * SLOT_TEXT), slots);
+}
+
+// Bounded MPSC queue (Vyukov): a slot whose sequence equals its position is free, the writer
+// fills it and advances the sequence by one to hand it to the main thread, which hands it back
+// one lap later. The main thread frees slots in order, so when the last slot of a claim is free
+// the whole run is, and a long line always occupies consecutive slots.
+void Logger::Publish(Level level, std::string_view text, size_t slots) {
+    uint64_t position = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        const uint64_t last = position + slots - 1;
+        const uint64_t sequence = ring[last & (RING_SIZE - 1)].sequence.load(std::memory_order_acquire);
+        const int64_t difference = int64_t(sequence) - int64_t(last);
+        if (difference == 0) {
+            if (tail.compare_exchange_weak(position, position + slots, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed); // full, the main thread is behind
+            return;
+        }
+        else {
+            position = tail.load(std::memory_order_relaxed);
+        }
+    }
+    const float time = secondsSinceStart();
+    for (size_t i = 0; i < slots; ++i) {
+        Slot& slot = ring[(position + i) & (RING_SIZE - 1)];
+        const std::string_view part = text.substr(std::min(text.size(), i * SLOT_TEXT), SLOT_TEXT);
+        slot.time = time;
+        slot.level = level;
+        slot.continued = i > 0;
+        slot.length = static_cast<uint16_t>(part.size());
+        std::memcpy(slot.text, part.data(), part.size());
+        slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+}
+
+void Logger::Drain() {
+    for (;;) {
+        Slot& slot = ring[head & (RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            break;
+        if (slot.continued && !history.empty()) {
+            Line& line = history.back();
+            line.text.append(slot.text, slot.length);
+            slot.sequence.store(head + RING_SIZE, std::memory_order_release);
+            head++;
+            if ((visible.empty() || visible.back() != line.number) && Passes(line))
+                visible.push_back(line.number);
+            continue;
+        }
+        Line line{ nextLine++, slot.time, slot.level, std::string(slot.text, slot.length) };
+        slot.sequence.store(head + RING_SIZE, std::memory_order_release);
+        head++;
+
+        if (Passes(line))
+            visible.push_back(line.number);
+        history.push_back(std::move(line));
+        if (history.size() > MAX_HISTORY) {
+            const uint64_t oldest = history.front().number;
+            history.pop_front();
+            if (!visible.empty() && visible.front() == oldest)
+                visible.pop_front();
+        }
+    }
+}
+
+bool Logger::Passes(const Line& line) const {
+    return showLevel[static_cast<int>(line.level)] &&
+        s_filter.PassFilter(line.text.data(), line.text.data() + line.text.size());
+}
+
+void Logger::RebuildFilter() {
+    visible.clear();
+    for (const Line& line : history) {
+        if (Passes(line))
+            visible.push_back(line.number);
+    }
+}
+
 void Logger::Clear() {
-    std::lock_guard<std::mutex> lock(logMutex);
-    logBuffer.str("");
-    logBuffer.clear();
+    Drain(); // lines already written belong to the cleared part
+    history.clear();
+    visible.clear();
 }
 
 void Logger::DrawImGuiLogger() {
-    std::lock_guard<std::mutex> lock(logMutex);
+    Drain();
 
     ImGui::Begin("Log Console");
-    
-    //not working
-    /*if (ImGui::Button("Clear")) {
+
+    if (ImGui::Button("Clear")) {
         Clear();
-    }*/
+    }
+    ImGui::SameLine();
+    bool filterChanged = false;
+    static const char* const levelNames[3] = { "Info", "Warnings", "Errors" };
+    for (int i = 0; i < 3; ++i) {
+        filterChanged |= ImGui::Checkbox(levelNames[i], &showLevel[i]);
+        ImGui::SameLine();
+    }
+    filterChanged |= s_filter.Draw("Filter (inc,-exc)", 200.0f);
+    ImGui::SameLine();
+    ImGui::Checkbox("Auto-scroll", &autoScroll);
+    if (filterChanged) {
+        RebuildFilter();
+    }
+    const uint64_t droppedLines = dropped.load(std::memory_order_relaxed);
+    if (droppedLines > 0) {
+        ImGui::SameLine();
+        ImGui::TextColored(WARNING_COLOR, "%llu lines dropped", static_cast<unsigned long long>(droppedLines));
+    }
 
     ImGui::Separator();
 
     ImGui::BeginChild("ScrollingRegion", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
 
-    ImGui::TextUnformatted(logBuffer.str().c_str());
+    // Only the rows in view are submitted, whatever the length of the log.
+    const uint64_t firstLine = history.empty() ? 0 : history.front().number;
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(visible.size()));
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            const Line& line = history[static_cast<size_t>(visible[row] - firstLine)];
+            const bool colored = line.level != Level::Info;
+            if (colored)
+                ImGui::PushStyleColor(ImGuiCol_Text, line.level == Level::Error ? ERROR_COLOR : WARNING_COLOR);
+            ImGui::TextUnformatted(line.text.data(), line.text.data() + line.text.size());
+            if (colored)
+                ImGui::PopStyleColor();
+        }
+    }
+    clipper.End();
 
-    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
+    if (autoScroll && ImGui::GetScrollY() >= ImGui::GetScrollMaxY()) {
         ImGui::SetScrollHereY(1.0f);
     }
 
     ImGui::EndChild();
     ImGui::End();
-}
\ No newline at end of file
+}
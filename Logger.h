@@ -2,27 +2,89 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <iostream>
-#include <sstream>
-#include <vector>
 #include <string>
-#include <mutex>
+#include <string_view>
 
-class Logger : public std::streambuf {
+// Captures std::cout (info, or warning when the line mentions one) and std::cerr (error) for
+// the "Log Console" window. Writers never lock: each thread collects characters in its own
+// staging line and publishes finished lines into a bounded lock-free ring. The main thread
+// drains the ring into a capped history once per frame, and the console only renders the rows
+// that are visible. When the ring is full, new lines are dropped and counted.
+class Logger {
 public:
+    enum class Level : uint8_t { Info, Warning, Error };
+
     Logger();
     ~Logger();
 
     static Logger& GetInstance();
+    // Any thread. Long lines are split across consecutive ring slots, and cut after MAX_LINE_SLOTS.
+    void Log(Level level, std::string_view line);
+
+    // Main thread only.
     void DrawImGuiLogger();
     void Clear();
 
-protected:
-    virtual int overflow(int c) override;
-
 private:
-    std::stringstream logBuffer;
-    std::mutex logMutex;
+    // One output stream (cout or cerr) feeding the ring.
+    class Stream : public std::streambuf {
+    public:
+        Stream(Logger& logger, Level level, int index) : logger(logger), level(level), index(index) {}
+    protected:
+        int overflow(int c) override;
+        std::streamsize xsputn(const char* s, std::streamsize count) override;
+    private:
+        Logger& logger;
+        Level level;
+        int index; // selects the thread's staging line
+    };
+
+    static constexpr size_t RING_SIZE = 4096;      // lines in flight between frames, power of two
+    static constexpr size_t SLOT_TEXT = 244;       // slot is 256 bytes
+    static constexpr size_t MAX_LINE_SLOTS = 64;   // longest line is about 15 KiB
+    static constexpr size_t MAX_HISTORY = 50000;   // lines kept for the console
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{ 0 };
+        float time = 0.0f;
+        Level level = Level::Info;
+        bool continued = false; // the rest of a line that did not fit the previous slot
+        uint16_t length = 0;
+        char text[SLOT_TEXT];
+    };
+
+    struct Line {
+        uint64_t number; // position in the whole log, keeps growing across Clear()
+        float time;
+        Level level;
+        std::string text;
+    };
+
+    void Publish(Level level, std::string_view text, size_t slots);
+    void Drain();
+    bool Passes(const Line& line) const;
+    void RebuildFilter();
+
+    Slot* ring;
+    alignas(64) std::atomic<uint64_t> tail{ 0 }; // next slot a writer claims
+    alignas(64) uint64_t head = 0;               // next slot the main thread reads
+    std::atomic<uint64_t> dropped{ 0 };
+
+    Stream coutStream;
+    Stream cerrStream;
+    std::streambuf* originalCout = nullptr;
+    std::streambuf* originalCerr = nullptr;
+
+    // Main thread state.
+    std::deque<Line> history;
+    std::deque<uint64_t> visible; // numbers of the history lines that pass the filter
+    uint64_t nextLine = 0;
+    bool showLevel[3] = { true, true, true };
+    bool autoScroll = true;
 };
 
-#endif // LOGGER_H
\ No newline at end of file
+#endif // LOGGER_H
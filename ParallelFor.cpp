@@ -0,0 +1,125 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Batch
+    {
+        const std::function<void(size_t)>* task = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        size_t workers = 0; // guarded by s_mutex, workers still inside runBatch
+    };
+
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    std::condition_variable s_finished;
+    std::deque<Batch*> s_batches;
+    bool s_stopping = false;
+
+    void runBatch(Batch& batch)
+    {
+        for (;;)
+        {
+            const size_t index = batch.next.fetch_add(1);
+            if (index >= batch.count)
+                return;
+            (*batch.task)(index);
+            batch.done.fetch_add(1);
+        }
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return s_stopping || !s_batches.empty(); });
+            if (s_stopping)
+                return;
+            Batch* batch = s_batches.front();
+            if (batch->next.load() >= batch->count)
+            {
+                s_batches.pop_front(); // every task is taken, the owner waits for the last ones
+                continue;
+            }
+            batch->workers++;
+            lock.unlock();
+            runBatch(*batch);
+            lock.lock();
+            batch->workers--;
+            s_finished.notify_all();
+        }
+    }
+
+    struct Pool
+    {
+        std::vector<std::thread> threads;
+
+        Pool()
+        {
+            const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+            for (size_t i = 1; i < hardware; ++i) // the caller is the last worker
+                threads.emplace_back(workerLoop);
+        }
+
+        ~Pool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_stopping = true;
+            }
+            s_wake.notify_all();
+            for (std::thread& thread : threads)
+                thread.join();
+        }
+    };
+
+    Pool& pool()
+    {
+        static Pool instance;
+        return instance;
+    }
+}
+
+namespace ParallelFor
+{
+    size_t threadCount()
+    {
+        return pool().threads.size() + 1;
+    }
+
+    void run(size_t count, const std::function<void(size_t)>& task)
+    {
+        if (count <= 1 || pool().threads.empty())
+        {
+            for (size_t i = 0; i < count; ++i)
+                task(i);
+            return;
+        }
+
+        Batch batch;
+        batch.task = &task;
+        batch.count = count;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_batches.push_back(&batch);
+        }
+        s_wake.notify_all();
+        runBatch(batch);
+
+        std::unique_lock<std::mutex> lock(s_mutex);
+        s_finished.wait(lock, [&] { return batch.done.load() == batch.count && batch.workers == 0; });
+        auto queued = std::find(s_batches.begin(), s_batches.end(), &batch);
+        if (queued != s_batches.end())
+            s_batches.erase(queued);
+    }
+}
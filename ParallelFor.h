@@ -0,0 +1,18 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <cstddef>
+#include <functional>
+
+// Worker threads shared by the CPU-heavy encoders and converters (PNG bands, video slices), one
+// per core besides the caller. The calling thread works on its own batch as well, so concurrent
+// or nested calls never wait on each other.
+namespace ParallelFor
+{
+    // Workers plus the caller.
+    size_t threadCount();
+    // Runs task(0) .. task(count - 1) spread over the pool and returns once all have finished.
+    void run(size_t count, const std::function<void(size_t)>& task);
+}
+
+#endif // PARALLEL_FOR_H
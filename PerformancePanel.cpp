@@ -0,0 +1,236 @@
+#include "PerformancePanel.h"
+#include "Trace.h"
+#include <imgui.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const size_t PHASE_COUNT = size_t(Trace::Phase::Count);
+    const size_t MAX_SAMPLES = 60000;  // 60 s at 1000 FPS
+    const int GRAPH_FRAMES = 300;
+    const double SUMMARY_SECONDS = 1.0;
+
+    struct Sample
+    {
+        double time;                // seconds since the first frame
+        float frameMs;              // CPU time from the previous frame end to this one
+        float phaseMs[PHASE_COUNT];
+        float gpuMs;                // -1 when the renderer has no GPU timer
+        float renderThreadMs;
+        uint32_t draws;
+        uint32_t computes;
+        uint32_t blits;
+        SceneCounts counts;
+        int64_t textureBytes;
+        int64_t renderTargetBytes;
+    };
+
+    std::deque<Sample> s_samples;
+    Clock::time_point s_firstFrame;
+    Clock::time_point s_lastFrame;
+    bool s_started = false;
+    int s_csvSeconds = 10;
+
+    // Frames of the last `seconds`, oldest first.
+    size_t firstSampleWithin(double seconds)
+    {
+        if (s_samples.empty())
+            return 0;
+        const double from = s_samples.back().time - seconds;
+        auto it = std::lower_bound(s_samples.begin(), s_samples.end(), from,
+            [](const Sample& sample, double time) { return sample.time < time; });
+        return size_t(it - s_samples.begin());
+    }
+
+    double megabytes(int64_t bytes)
+    {
+        return double(std::max<int64_t>(bytes, 0)) / (1024.0 * 1024.0);
+    }
+}
+
+namespace PerformancePanel
+{
+    void endFrame(const bgfx::Stats* stats, const SceneCounts& counts)
+    {
+        const Clock::time_point now = Clock::now();
+        if (!s_started) {
+            s_started = true;
+            s_firstFrame = s_lastFrame = now;
+            return; // the first frame has no start
+        }
+
+        Sample sample = {};
+        sample.time = std::chrono::duration<double>(now - s_firstFrame).count();
+        sample.frameMs = std::chrono::duration<float, std::milli>(now - s_lastFrame).count();
+        s_lastFrame = now;
+        for (size_t i = 0; i < PHASE_COUNT; ++i)
+            sample.phaseMs[i] = Trace::lastFrameMs(Trace::Phase(i));
+        sample.gpuMs = -1.0f;
+        if (stats) {
+            if (stats->gpuTimerFreq > 0 && stats->gpuTimeEnd > stats->gpuTimeBegin)
+                sample.gpuMs = float(double(stats->gpuTimeEnd - stats->gpuTimeBegin) * 1000.0 / double(stats->gpuTimerFreq));
+            if (stats->cpuTimerFreq > 0)
+                sample.renderThreadMs = float(double(stats->cpuTimeEnd - stats->cpuTimeBegin) * 1000.0 / double(stats->cpuTimerFreq));
+            sample.draws = stats->numDraw;
+            sample.computes = stats->numCompute;
+            sample.blits = stats->numBlit;
+            sample.textureBytes = stats->textureMemoryUsed;
+            sample.renderTargetBytes = stats->rtMemoryUsed;
+        }
+        sample.counts = counts;
+
+        s_samples.push_back(sample);
+        while (s_samples.size() > MAX_SAMPLES || sample.time - s_samples.front().time > HISTORY_SECONDS)
+            s_samples.pop_front();
+    }
+
+    void draw(bool* open)
+    {
+        if (!ImGui::Begin("Performance", open)) {
+            ImGui::End();
+            return;
+        }
+        if (s_samples.empty()) {
+            ImGui::TextDisabled("Waiting for frames...");
+            ImGui::End();
+            return;
+        }
+
+        const Sample& last = s_samples.back();
+
+        // Averages over the last second, the latest frame alone is too noisy to read.
+        const size_t summaryStart = firstSampleWithin(SUMMARY_SECONDS);
+        const size_t summaryCount = s_samples.size() - summaryStart;
+        float averageFrame = 0.0f;
+        float worstFrame = 0.0f;
+        float averagePhase[PHASE_COUNT] = {};
+        for (size_t i = summaryStart; i < s_samples.size(); ++i) {
+            const Sample& sample = s_samples[i];
+            averageFrame += sample.frameMs;
+            worstFrame = std::max(worstFrame, sample.frameMs);
+            for (size_t p = 0; p < PHASE_COUNT; ++p)
+                averagePhase[p] += sample.phaseMs[p];
+        }
+        averageFrame /= float(summaryCount);
+        for (float& phase : averagePhase)
+            phase /= float(summaryCount);
+
+        ImGui::Text("Frame %.2f ms, average %.2f ms (%.0f FPS), worst %.2f ms over the last second",
+            last.frameMs, averageFrame, averageFrame > 0.0f ? 1000.0f / averageFrame : 0.0f, worstFrame);
+
+        float graph[GRAPH_FRAMES];
+        const int graphCount = int(std::min<size_t>(s_samples.size(), GRAPH_FRAMES));
+        float graphMax = 33.3f;
+        for (int i = 0; i < graphCount; ++i) {
+            graph[i] = s_samples[s_samples.size() - size_t(graphCount) + size_t(i)].frameMs;
+            graphMax = std::max(graphMax, graph[i]);
+        }
+        ImGui::PlotLines("##FrameTime", graph, graphCount, 0, "CPU frame time (ms)", 0.0f, graphMax, ImVec2(-1.0f, 80.0f));
+
+        if (ImGui::CollapsingHeader("Main Loop Phases", ImGuiTreeNodeFlags_DefaultOpen)) {
+            if (ImGui::BeginTable("Phases", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+                ImGui::TableSetupColumn("Phase");
+                ImGui::TableSetupColumn("Last (ms)");
+                ImGui::TableSetupColumn("Average (ms)");
+                ImGui::TableHeadersRow();
+                float phaseTotal = 0.0f;
+                for (size_t p = 0; p < PHASE_COUNT; ++p) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(Trace::phaseName(Trace::Phase(p)));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", last.phaseMs[p]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f", averagePhase[p]);
+                    phaseTotal += averagePhase[p];
+                }
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextDisabled("Other");
+                ImGui::TableNextColumn();
+                ImGui::TableNextColumn();
+                ImGui::TextDisabled("%.3f", std::max(averageFrame - phaseTotal, 0.0f));
+                ImGui::EndTable();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Renderer", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Text("Draws %u, computes %u, blits %u", last.draws, last.computes, last.blits);
+            if (last.gpuMs >= 0.0f)
+                ImGui::Text("GPU %.2f ms, render thread %.2f ms", last.gpuMs, last.renderThreadMs);
+            else
+                ImGui::Text("GPU n/a, render thread %.2f ms", last.renderThreadMs);
+        }
+
+        if (ImGui::CollapsingHeader("Scene", ImGuiTreeNodeFlags_DefaultOpen)) {
+            ImGui::Text("Instances %u, lights %u, triangles %llu", last.counts.instances, last.counts.lights,
+                static_cast<unsigned long long>(last.counts.triangles));
+            ImGui::Text("Meshes %.1f MB, textures %.1f MB, render targets %.1f MB", megabytes(int64_t(last.counts.meshBytes)),
+                megabytes(last.textureBytes), megabytes(last.renderTargetBytes));
+        }
+
+        ImGui::Separator();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderInt("Seconds", &s_csvSeconds, 1, int(HISTORY_SECONDS));
+        ImGui::SameLine();
+        if (ImGui::Button("Save CSV")) {
+            std::filesystem::create_directory("perf");
+            writeCsv("perf/perf_" + std::to_string(std::time(nullptr)) + ".csv", double(s_csvSeconds));
+        }
+
+        ImGui::End();
+    }
+
+    bool writeCsv(const std::string& path, double seconds)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) {
+            std::cerr << "[Performance] Cannot write " << path << std::endl;
+            return false;
+        }
+
+        std::fputs("time_s,frame_ms", file);
+        for (size_t p = 0; p < PHASE_COUNT; ++p) {
+            // "Light collection" -> light_collection_ms, "bgfx::frame" -> bgfx_frame_ms
+            std::string column;
+            for (const char* c = Trace::phaseName(Trace::Phase(p)); *c; ++c) {
+                if (std::isalnum(static_cast<unsigned char>(*c)))
+                    column += char(std::tolower(static_cast<unsigned char>(*c)));
+                else if (!column.empty() && column.back() != '_')
+                    column += '_';
+            }
+            std::fprintf(file, ",%s_ms", column.c_str());
+        }
+        std::fputs(",gpu_ms,render_thread_ms,draws,computes,blits,instances,lights,triangles,mesh_bytes,texture_bytes,render_target_bytes\n", file);
+
+        const size_t start = firstSampleWithin(seconds);
+        for (size_t i = start; i < s_samples.size(); ++i) {
+            const Sample& sample = s_samples[i];
+            std::fprintf(file, "%.4f,%.3f", sample.time, sample.frameMs);
+            for (size_t p = 0; p < PHASE_COUNT; ++p)
+                std::fprintf(file, ",%.3f", sample.phaseMs[p]);
+            std::fprintf(file, ",%.3f,%.3f,%u,%u,%u,%u,%u,%llu,%llu,%lld,%lld\n",
+                sample.gpuMs, sample.renderThreadMs, sample.draws, sample.computes, sample.blits,
+                sample.counts.instances, sample.counts.lights,
+                static_cast<unsigned long long>(sample.counts.triangles), static_cast<unsigned long long>(sample.counts.meshBytes),
+                static_cast<long long>(sample.textureBytes), static_cast<long long>(sample.renderTargetBytes));
+        }
+
+        const bool written = std::fclose(file) == 0;
+        if (written)
+            std::cout << "[Performance] Wrote " << (s_samples.size() - start) << " frames to " << path << std::endl;
+        else
+            std::cerr << "[Performance] Failed writing " << path << std::endl;
+        return written;
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef PERFORMANCE_PANEL_H
+#define PERFORMANCE_PANEL_H
+
+#include <cstdint>
+#include <string>
+#include <bgfx/bgfx.h>
+
+// What the scene holds this frame, children included.
+struct SceneCounts
+{
+    uint32_t instances = 0;
+    uint32_t lights = 0;
+    uint64_t triangles = 0;  // of the meshes and text quads the instances draw
+    uint64_t meshBytes = 0;  // vertex and index buffers alive, built-in meshes included
+};
+
+// Dockable "Performance" window. Keeps the last HISTORY_SECONDS of frames: CPU frame time, the
+// main loop phases (Trace::Phase), bgfx's counters and GPU time, and the scene totals. Any part
+// of the history can be saved as CSV for a bug report. Main thread only.
+namespace PerformancePanel
+{
+    const double HISTORY_SECONDS = 60.0;
+
+    // Call once per frame after bgfx::frame() and Trace::endFrame().
+    void endFrame(const bgfx::Stats* stats, const SceneCounts& counts);
+    void draw(bool* open);
+
+    // One row per frame of the last `seconds`. False when the file cannot be written.
+    bool writeCsv(const std::string& path, double seconds);
+}
+
+#endif // PERFORMANCE_PANEL_H
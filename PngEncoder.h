@@ -0,0 +1,39 @@
+#ifndef PNG_ENCODER_H
+#define PNG_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// PNG encoding spread over all cores. The image is cut into bands of rows; every band is
+// filtered and deflated on its own (zlib, ending in a full flush so the next band starts with a
+// fresh window) and the pieces are joined into a single zlib stream with the Adler-32 checksums
+// combined. Built without zlib (CROSSHATCH_HAVE_ZLIB undefined) it falls back to stb_image_write.
+namespace PngEncoder
+{
+    enum class Level
+    {
+        Fast, // interactive screenshots: zlib level 1, Sub/Up filters
+        High, // final exports: zlib level 6, every filter tried per row
+    };
+
+    // False when this build uses the single-threaded stb fallback.
+    bool isParallel();
+    size_t threadCount();
+
+    // pixels: channels 3 (RGB) or 4 (RGBA), top row first, stride bytes between rows.
+    bool encode(std::vector<uint8_t>& png, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels,
+        size_t stride, Level level);
+    bool write(const std::string& path, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels,
+        size_t stride, Level level);
+
+    // For writers that produce rows over time (ImageStreamWriter). Appends the raw deflate data
+    // of rowCount filtered rows to out, ending in a full flush, or finishing the stream when last
+    // is set. previousRow is the row above the first one (nullptr at the top of the image).
+    // adler is updated over the filtered bytes. Needs isParallel().
+    bool deflateRows(std::vector<uint8_t>& out, uint32_t& adler, const uint8_t* rows, const uint8_t* previousRow,
+        uint32_t rowCount, uint32_t width, uint32_t channels, size_t stride, Level level, bool last);
+}
+
+#endif // PNG_ENCODER_H
@@ -0,0 +1,339 @@
+#include "PosterRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ImageStreamWriter.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint16_t MAX_TILE_SIZE = 2048;
+    const uint16_t MIN_TILE_SIZE = 256;
+    const size_t MAX_BAND_BYTES = size_t(64) * 1024 * 1024; // one row of tiles, RGB
+    const size_t MAX_QUEUED_BANDS = 2; // bounds memory when the disk is slower than the GPU
+
+    struct Band
+    {
+        std::vector<uint8_t> rgb;
+        uint32_t rows = 0;
+    };
+
+    bgfx::FrameBufferHandle s_tileTarget = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle s_tileColor = BGFX_INVALID_HANDLE;
+    bgfx::TextureHandle s_readbackTexture = BGFX_INVALID_HANDLE;
+    std::vector<uint8_t> s_readback;
+    uint32_t s_readbackFrame = 0;
+    bool s_readbackPending = false;
+    bool s_tileSubmitted = false;
+
+    bool s_active = false;
+    std::string s_path;
+    uint16_t s_tileSize = 0;
+    uint32_t s_width = 0;
+    uint32_t s_height = 0;
+    uint32_t s_multiplier = 1;
+    uint32_t s_columns = 0;
+    uint32_t s_rows = 0;
+    uint32_t s_nextTile = 0;
+    uint32_t s_tilesDone = 0;
+    float s_view[16];
+    float s_proj[16];
+    Band s_band; // the tile row being assembled
+    Clock::time_point s_startedAt;
+
+    // Writer thread, guarded by s_mutex.
+    std::thread s_writerThread;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    std::deque<Band> s_bands;
+    bool s_lastBandQueued = false;
+    bool s_writerFinished = false;
+    bool s_writerSucceeded = false;
+    ImageStreamWriter s_writer;
+
+    void writerLoop()
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        bool ok = true;
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return !s_bands.empty() || s_lastBandQueued; });
+            if (s_bands.empty())
+                break;
+            Band band = std::move(s_bands.front());
+            s_bands.pop_front();
+            lock.unlock();
+
+            ok = ok && s_writer.writeRows(band.rgb.data(), band.rows);
+
+            lock.lock();
+            s_wake.notify_all();
+        }
+        lock.unlock();
+        ok = s_writer.close() && ok;
+        lock.lock();
+        s_writerSucceeded = ok;
+        s_writerFinished = true;
+    }
+
+    void destroyResources()
+    {
+        if (bgfx::isValid(s_tileTarget))
+            bgfx::destroy(s_tileTarget); // also destroys the attachments
+        if (bgfx::isValid(s_readbackTexture))
+            bgfx::destroy(s_readbackTexture);
+        s_tileTarget = BGFX_INVALID_HANDLE;
+        s_tileColor = BGFX_INVALID_HANDLE;
+        s_readbackTexture = BGFX_INVALID_HANDLE;
+        std::vector<uint8_t>().swap(s_readback);
+        std::vector<uint8_t>().swap(s_band.rgb);
+    }
+
+    void stopWriter()
+    {
+        if (!s_writerThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_lastBandQueued = true;
+        }
+        s_wake.notify_all();
+        s_writerThread.join();
+    }
+
+    void finish(bool completed)
+    {
+        if (!completed)
+        {
+            // Closing early leaves the writer short of rows, it deletes the partial file.
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_bands.clear();
+        }
+        stopWriter();
+        destroyResources();
+        s_active = false;
+        s_readbackPending = false;
+        s_tileSubmitted = false;
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - s_startedAt).count();
+        if (completed && s_writerSucceeded)
+            std::cout << "[Poster] Saved " << s_path << " (" << s_width << "x" << s_height << ", " << s_columns * s_rows << " tiles) in " << seconds << " s" << std::endl;
+        else if (completed)
+            std::cerr << "[Poster] Failed to write " << s_path << std::endl;
+        else
+            std::cout << "[Poster] Cancelled " << s_path << std::endl;
+    }
+
+    // Narrows proj to the pixels [x0, x0 + size) x [y0, y0 + size) of the full image (y down):
+    // clip x' = sx * x + tx * w, same for y, which keeps every tile on the same projection.
+    void tileProjection(uint32_t x0, uint32_t y0, float* result)
+    {
+        const float size = float(s_tileSize);
+        const float left = 2.0f * float(x0) / float(s_width) - 1.0f;
+        const float right = 2.0f * (float(x0) + size) / float(s_width) - 1.0f;
+        const float top = 1.0f - 2.0f * float(y0) / float(s_height);
+        const float bottom = 1.0f - 2.0f * (float(y0) + size) / float(s_height);
+        const float sx = 2.0f / (right - left);
+        const float tx = -(right + left) / (right - left);
+        const float sy = 2.0f / (top - bottom);
+        const float ty = -(top + bottom) / (top - bottom);
+
+        std::memcpy(result, s_proj, sizeof(s_proj));
+        for (int row = 0; row < 4; ++row)
+        {
+            result[row * 4 + 0] = sx * s_proj[row * 4 + 0] + tx * s_proj[row * 4 + 3];
+            result[row * 4 + 1] = sy * s_proj[row * 4 + 1] + ty * s_proj[row * 4 + 3];
+        }
+    }
+
+    // Copies the visible part of the tile that was read back into the band.
+    void storeTile(uint32_t tile)
+    {
+        const uint32_t column = tile % s_columns;
+        const uint32_t x0 = column * s_tileSize;
+        const uint32_t y0 = (tile / s_columns) * s_tileSize;
+        const uint32_t copyWidth = std::min<uint32_t>(s_tileSize, s_width - x0);
+        const uint32_t copyHeight = std::min<uint32_t>(s_tileSize, s_height - y0);
+        const bool bottomUp = bgfx::getCaps()->originBottomLeft;
+
+        for (uint32_t y = 0; y < copyHeight; ++y)
+        {
+            const uint32_t srcRow = bottomUp ? s_tileSize - 1 - y : y;
+            const uint8_t* src = s_readback.data() + size_t(srcRow) * s_tileSize * 4;
+            uint8_t* dst = s_band.rgb.data() + (size_t(y) * s_width + x0) * 3;
+            for (uint32_t x = 0; x < copyWidth; ++x, src += 4, dst += 3)
+            {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+            }
+        }
+
+        if (column + 1 == s_columns)
+        {
+            Band band;
+            band.rows = copyHeight;
+            band.rgb.assign(s_band.rgb.begin(), s_band.rgb.begin() + size_t(copyHeight) * s_width * 3);
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                s_bands.push_back(std::move(band));
+            }
+            s_wake.notify_all();
+        }
+    }
+}
+
+namespace PosterRenderer
+{
+    bool start(const std::string& path, uint16_t displayWidth, uint16_t displayHeight, uint32_t multiplier,
+        const float view[16], const float proj[16], float dpi)
+    {
+        if (s_active)
+            cancel();
+        const bgfx::Caps* caps = bgfx::getCaps();
+        if ((caps->supported & (BGFX_CAPS_TEXTURE_BLIT | BGFX_CAPS_TEXTURE_READ_BACK)) != (BGFX_CAPS_TEXTURE_BLIT | BGFX_CAPS_TEXTURE_READ_BACK))
+        {
+            std::cerr << "[Poster] The renderer cannot read textures back" << std::endl;
+            return false;
+        }
+        if (displayWidth == 0 || displayHeight == 0 || multiplier == 0)
+            return false;
+
+        s_path = path;
+        s_multiplier = multiplier;
+        s_width = uint32_t(displayWidth) * multiplier;
+        s_height = uint32_t(displayHeight) * multiplier;
+        // Very wide posters get shorter tiles so a band of rows stays within MAX_BAND_BYTES.
+        const size_t bandRows = MAX_BAND_BYTES / (size_t(s_width) * 3);
+        const uint32_t tileLimit = std::min<uint32_t>(MAX_TILE_SIZE, caps->limits.maxTextureSize);
+        s_tileSize = uint16_t(std::max<uint32_t>(MIN_TILE_SIZE, std::min<uint32_t>(tileLimit, uint32_t(bandRows) / 256 * 256)));
+        s_columns = (s_width + s_tileSize - 1) / s_tileSize;
+        s_rows = (s_height + s_tileSize - 1) / s_tileSize;
+        s_nextTile = 0;
+        s_tilesDone = 0;
+        std::memcpy(s_view, view, sizeof(s_view));
+        std::memcpy(s_proj, proj, sizeof(s_proj));
+
+        if (!s_writer.open(path, s_width, s_height, dpi))
+            return false;
+
+        bgfx::TextureHandle attachments[2];
+        attachments[0] = bgfx::createTexture2D(s_tileSize, s_tileSize, false, 1, bgfx::TextureFormat::RGBA8,
+            BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+        attachments[1] = bgfx::createTexture2D(s_tileSize, s_tileSize, false, 1, bgfx::TextureFormat::D24S8,
+            BGFX_TEXTURE_RT_WRITE_ONLY);
+        s_tileTarget = bgfx::createFrameBuffer(2, attachments, true);
+        s_tileColor = attachments[0];
+        s_readbackTexture = bgfx::createTexture2D(s_tileSize, s_tileSize, false, 1, bgfx::TextureFormat::RGBA8,
+            BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+        if (!bgfx::isValid(s_tileTarget) || !bgfx::isValid(s_readbackTexture))
+        {
+            std::cerr << "[Poster] Failed to create the tile targets" << std::endl;
+            destroyResources();
+            s_writer.close();
+            return false;
+        }
+        s_readback.resize(size_t(s_tileSize) * s_tileSize * 4);
+        s_band.rgb.assign(size_t(s_width) * s_tileSize * 3, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_bands.clear();
+            s_lastBandQueued = false;
+            s_writerFinished = false;
+            s_writerSucceeded = false;
+        }
+        s_writerThread = std::thread(writerLoop);
+        s_active = true;
+        s_readbackPending = false;
+        s_tileSubmitted = false;
+        s_startedAt = Clock::now();
+        std::cout << "[Poster] Rendering " << s_width << "x" << s_height << " as " << s_columns << "x" << s_rows
+            << " tiles of " << s_tileSize << " px to " << path << std::endl;
+        return true;
+    }
+
+    void cancel()
+    {
+        if (s_active)
+            finish(false);
+    }
+
+    bool isActive()
+    {
+        return s_active;
+    }
+
+    Progress progress()
+    {
+        Progress result;
+        result.active = s_active;
+        result.path = s_path;
+        result.width = s_width;
+        result.height = s_height;
+        result.tilesDone = s_tilesDone;
+        result.tileCount = s_columns * s_rows;
+        return result;
+    }
+
+    bool beginTile(bgfx::FrameBufferHandle& target, uint16_t& size, float view[16], float proj[16])
+    {
+        if (!s_active || s_readbackPending || s_nextTile >= s_columns * s_rows)
+            return false;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_bands.size() >= MAX_QUEUED_BANDS)
+                return false;
+        }
+        target = s_tileTarget;
+        size = s_tileSize;
+        std::memcpy(view, s_view, sizeof(s_view));
+        tileProjection((s_nextTile % s_columns) * s_tileSize, (s_nextTile / s_columns) * s_tileSize, proj);
+        s_tileSubmitted = true;
+        return true;
+    }
+
+    float scale()
+    {
+        return float(s_multiplier);
+    }
+
+    void submitReadback(bgfx::ViewId view)
+    {
+        if (!s_tileSubmitted)
+            return;
+        bgfx::blit(view, s_readbackTexture, 0, 0, s_tileColor);
+        s_readbackFrame = bgfx::readTexture(s_readbackTexture, s_readback.data());
+        s_readbackPending = true;
+        s_tileSubmitted = false;
+    }
+
+    void update(uint32_t frameNumber)
+    {
+        if (!s_active)
+            return;
+        if (s_readbackPending && frameNumber >= s_readbackFrame)
+        {
+            storeTile(s_nextTile);
+            s_readbackPending = false;
+            s_nextTile++;
+            s_tilesDone++;
+        }
+        if (s_tilesDone == s_columns * s_rows)
+            finish(true);
+    }
+
+    void shutdown()
+    {
+        cancel();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef POSTER_RENDERER_H
+#define POSTER_RENDERER_H
+
+#include <cstdint>
+#include <string>
+
+#include <bgfx/bgfx.h>
+
+// Renders the viewport at N times its resolution for print. The image is split into square
+// tiles, each drawn offscreen with the part of the camera frustum it covers, read back, and
+// appended to a band of rows; finished bands go to an ImageStreamWriter on a writer thread, so
+// neither the GPU nor memory ever holds the whole image.
+namespace PosterRenderer
+{
+    struct Progress
+    {
+        bool active = false;
+        std::string path;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t tilesDone = 0;
+        uint32_t tileCount = 0;
+    };
+
+    // view/proj are the camera matrices of the viewport, kept for every tile so the poster is a
+    // single instant even if the camera moves meanwhile. The format follows the extension of path
+    // (.png, .tif, .tiff).
+    bool start(const std::string& path, uint16_t displayWidth, uint16_t displayHeight, uint32_t multiplier,
+        const float view[16], const float proj[16], float dpi);
+    void cancel();
+    bool isActive();
+    Progress progress();
+
+    // Main loop, before the scene views are set up. Returns true when this frame draws a tile:
+    // the scene views then render into target (size x size) with these matrices.
+    bool beginTile(bgfx::FrameBufferHandle& target, uint16_t& size, float view[16], float proj[16]);
+    // Render pixels per viewport pixel, for effects that are tuned in viewport pixels.
+    float scale();
+    // After the scene views of a tile frame. view must come after them.
+    void submitReadback(bgfx::ViewId view);
+    // After bgfx::frame(), with its return value.
+    void update(uint32_t frameNumber);
+
+    void shutdown();
+}
+
+#endif // POSTER_RENDERER_H
@@ -110,22 +110,22 @@ static const uint16_t cubeIndices[] = {
 
 static PosColorVertex arrowVertices[] = {
     // Shaft (rectangular prism)
-    {-0.5f, -0.05f,  0.05f, 0xff0000ff}, // Left bottom front (0)
-    {-0.5f, -0.05f, -0.05f, 0xff0000ff}, // Left bottom back (1)
-    {-0.5f,  0.05f, -0.05f, 0xff0000ff}, // Left top back (2)
-    {-0.5f,  0.05f,  0.05f, 0xff0000ff}, // Left top front (3)
+    {-0.5f, -0.05f,  0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Left bottom front (0)
+    {-0.5f, -0.05f, -0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Left bottom back (1)
+    {-0.5f,  0.05f, -0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Left top back (2)
+    {-0.5f,  0.05f,  0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Left top front (3)
 
-    { 0.3f, -0.05f,  0.05f, 0xff0000ff}, // Right bottom front (4)
-    { 0.3f, -0.05f, -0.05f, 0xff0000ff}, // Right bottom back (5)
-    { 0.3f,  0.05f, -0.05f, 0xff0000ff}, // Right top back (6)
-    { 0.3f,  0.05f,  0.05f, 0xff0000ff}, // Right top front (7)
+    { 0.3f, -0.05f,  0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Right bottom front (4)
+    { 0.3f, -0.05f, -0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Right bottom back (5)
+    { 0.3f,  0.05f, -0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Right top back (6)
+    { 0.3f,  0.05f,  0.05f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}, // Right top front (7)
 
     // Arrowhead (pyramid)
-    { 0.3f, -0.1f,  0.1f, 0xff0000ff},   // Base bottom front (8)
-    { 0.3f, -0.1f, -0.1f, 0xff0000ff},   // Base bottom back (9)
-    { 0.3f,  0.1f, -0.1f, 0xff0000ff},   // Base top back (10)
-    { 0.3f,  0.1f,  0.1f, 0xff0000ff},   // Base top front (11)
-    { 0.5f,  0.0f,  0.0f, 0xff0000ff}    // Tip (12)
+    { 0.3f, -0.1f,  0.1f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f},   // Base bottom front (8)
+    { 0.3f, -0.1f, -0.1f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f},   // Base bottom back (9)
+    { 0.3f,  0.1f, -0.1f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f},   // Base top back (10)
+    { 0.3f,  0.1f,  0.1f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f},   // Base top front (11)
+    { 0.5f,  0.0f,  0.0f, 1.0f, 0.0f, 0.0f, 0xff0000ff, 0.0f, 0.0f}    // Tip (12)
 };
 
 // Define the indices for triangles
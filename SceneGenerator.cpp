@@ -0,0 +1,207 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+using namespace SceneSerializer;
+
+namespace
+{
+    constexpr float kTau = 6.28318530718f;
+    constexpr float kChildScale = 0.6f;
+    const char* const kPrimitives[] = { "cube", "sphere", "cylinder", "capsule", "cone" };
+    constexpr uint32_t kComicBubbles = 8;  // comicbubble1 .. comicbubble8
+
+    // splitmix64: std:: distributions differ between standard libraries, this does not.
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : state(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        // [0, 1)
+        float unit() { return float(next() >> 40) * (1.0f / 16777216.0f); }
+        float range(float low, float high) { return low + (high - low) * unit(); }
+        uint32_t below(uint32_t count) { return uint32_t(next() % count); }
+
+    private:
+        uint64_t state;
+    };
+
+    struct Builder
+    {
+        const SceneGenerator::Params& params;
+        SceneData& scene;
+        Random random;
+        StringRef none, noise, empty;
+        int32_t nextId = 1;
+        uint32_t remaining;
+
+        Builder(const SceneGenerator::Params& params, SceneData& scene)
+            : params(params), scene(scene), random(params.seed), remaining(params.instances)
+        {
+            none = scene.addString("none");
+            noise = scene.addString("Noise1(Default)");
+            empty = scene.addString("");
+        }
+
+        SceneRecord record(const std::string& type, const std::string& name, int32_t parentId)
+        {
+            SceneRecord r;
+            r.id = nextId++;
+            r.parentId = parentId;
+            r.type = scene.addString(type);
+            r.name = scene.addString(name + "_" + std::to_string(r.id));
+            r.texture = none;
+            r.noiseTexture = noise;
+            r.textContent = empty;
+            return r;
+        }
+
+        // Mostly white, a few tinted objects whose color carries down to their children.
+        void color(SceneRecord& r)
+        {
+            if (random.unit() < 0.7f)
+                return;
+            for (int a = 0; a < 3; a++)
+                r.objectColor[a] = random.range(0.4f, 1.0f);
+        }
+
+        // Depth first, so every parent is added before its children.
+        void addNode(int32_t parentId, uint32_t level, const float* position, float scale)
+        {
+            if (remaining == 0)
+                return;
+            remaining--;
+
+            const bool imported = !params.importedType.empty();
+            const std::string type = imported ? params.importedType : kPrimitives[random.below(uint32_t(std::size(kPrimitives)))];
+            SceneRecord r = record(type, type, parentId);
+            if (imported)
+                r.meshNumber = int32_t(random.below(std::max(params.importedMeshes, 1u)));
+            std::copy(position, position + 3, r.position);
+            std::copy(position, position + 3, r.basePosition);
+            r.rotation[1] = random.range(0.0f, kTau);
+            std::fill(r.scale, r.scale + 3, scale);
+            color(r);
+            scene.addRecord(r);
+
+            if (level + 1 >= params.depth)
+                return;
+            for (uint32_t child = 0; child < params.fanOut && remaining > 0; child++)
+            {
+                // Around the parent in its own space, the parent's scale shrinks the whole subtree.
+                const float angle = kTau * (float(child) + random.unit() * 0.5f) / float(params.fanOut);
+                const float distance = random.range(1.5f, 2.5f);
+                const float offset[3] = { std::cos(angle) * distance, random.range(0.0f, 1.0f), std::sin(angle) * distance };
+                addNode(r.id, level + 1, offset, kChildScale);
+            }
+        }
+    };
+}
+
+namespace SceneGenerator
+{
+    void generate(const Params& params, SceneData& scene)
+    {
+        Builder b(params, scene);
+
+        // Trees are as large as depth and fan-out allow, the last one takes what is left.
+        uint64_t treeSize = 0;
+        uint64_t levelSize = 1;
+        for (uint32_t level = 0; level < std::max(params.depth, 1u) && treeSize < params.instances; level++)
+        {
+            treeSize += levelSize;
+            levelSize *= std::max(params.fanOut, 1u);
+        }
+        const uint32_t trees = treeSize ? uint32_t((uint64_t(params.instances) + treeSize - 1) / treeSize) : 0;
+        const uint32_t side = uint32_t(std::ceil(std::sqrt(double(trees))));
+        const float half = float(side > 0 ? side - 1 : 0) * params.spacing * 0.5f;
+
+        for (uint32_t tree = 0; tree < trees; tree++)
+        {
+            const float jitter = params.spacing * 0.2f;
+            const float position[3] = {
+                float(tree % side) * params.spacing - half + b.random.range(-jitter, jitter),
+                0.0f,
+                float(tree / side) * params.spacing - half + b.random.range(-jitter, jitter) };
+            b.addNode(-1, 0, position, b.random.range(0.5f, 1.0f));
+        }
+
+        // Lights above the grid, the first animatedFraction of them swinging around their base.
+        const uint32_t animatedLights = uint32_t(std::lround(std::clamp(params.animatedFraction, 0.0f, 1.0f) * float(params.lights)));
+        for (uint32_t light = 0; light < params.lights; light++)
+        {
+            SceneRecord r = b.record("light", "light", -1);
+            r.position[0] = b.random.range(-half - params.spacing, half + params.spacing);
+            r.position[1] = params.spacing * b.random.range(1.5f, 2.5f);
+            r.position[2] = b.random.range(-half - params.spacing, half + params.spacing);
+            std::copy(r.position, r.position + 3, r.basePosition);
+            std::fill(r.scale, r.scale + 3, 0.1f);
+            r.lightRange = params.spacing * 4.0f;
+            for (int a = 0; a < 3; a++)
+                r.lightColor[a] = b.random.range(0.7f, 1.0f);
+            if (light < animatedLights)
+            {
+                r.flags |= RECORD_ANIMATION_ENABLED;
+                for (int a = 0; a < 3; a++)
+                {
+                    r.animAmplitude[a] = b.random.range(0.2f, 0.5f) * (a == 1 ? 1.0f : params.spacing);
+                    r.animFrequency[a] = b.random.range(0.3f, 1.3f);
+                    r.animPhase[a] = b.random.range(0.0f, kTau);
+                }
+            }
+            scene.addRecord(r);
+        }
+
+        for (uint32_t bubble = 0; bubble < params.textBubbles; bubble++)
+        {
+            const std::string type = "comicbubble" + std::to_string(1 + b.random.below(kComicBubbles));
+            SceneRecord r = b.record(type, "comicbubbleobject", -1);
+            r.position[0] = b.random.range(-half, half);
+            r.position[1] = b.random.range(3.0f, 5.0f);
+            r.position[2] = b.random.range(-half, half);
+            std::copy(r.position, r.position + 3, r.basePosition);
+            scene.addRecord(r);
+
+            SceneRecord text = b.record("text", "comicBubble", r.id);
+            text.position[1] = 0.2f;
+            text.position[2] = 0.1f;
+            std::fill(text.scale, text.scale + 3, 0.25f);
+            text.textContent = scene.addString("Bubble " + std::to_string(bubble + 1));
+            scene.addRecord(text);
+        }
+    }
+
+    bool write(const Params& params, const std::string& basePath)
+    {
+        SceneData scene;
+        generate(params, scene);
+        if (!saveSceneFile(scene, basePath + ".txt") || !saveSceneFile(scene, basePath + ".chscene"))
+            return false;
+
+        if (!params.importedType.empty())
+        {
+            const std::string mapPath = basePath + "_imp_obj_map.txt";
+            std::ofstream map(mapPath);
+            map << quote_if_needed(params.importedType) << " " << quote_if_needed(params.importedPath) << "\n";
+            map.close();
+            if (!map)
+            {
+                std::cerr << "Failed to write imported object map: " << mapPath << std::endl;
+                return false;
+            }
+        }
+        std::cout << "Generated " << scene.size() << " instances (seed " << params.seed << ") to " << basePath << ".txt and .chscene" << std::endl;
+        return true;
+    }
+}
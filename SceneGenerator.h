@@ -0,0 +1,43 @@
+#ifndef SCENE_GENERATOR_H
+#define SCENE_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+#include "SceneSerializer.h"
+
+// Procedural stress scenes for scaling tests. The same parameters and seed always give the same
+// scene (the random numbers do not depend on the standard library), so generated files can serve
+// as standard workloads:
+//
+//   <name>.txt / <name>.chscene      the scene in both formats
+//   <name>_imp_obj_map.txt           the imported model, when the instances use one
+//
+// Instances are laid out as trees on a square grid of the XZ plane. Lights hover above the grid,
+// text bubbles are comic bubble objects with a text child.
+namespace SceneGenerator
+{
+    struct Params
+    {
+        uint32_t seed = 1;
+        uint32_t instances = 1000;       // mesh instances, lights and bubbles come on top
+        uint32_t depth = 1;              // levels per tree, 1 keeps every instance top-level
+        uint32_t fanOut = 4;             // children of every node above the last level
+        uint32_t lights = 4;
+        float animatedFraction = 0.25f;  // share of the lights that move, the only animation scenes store
+        uint32_t textBubbles = 0;
+        std::string importedType;        // empty for the built-in primitives
+        std::string importedPath;        // model file of importedType
+        uint32_t importedMeshes = 1;     // meshes in the model, every instance picks one of them
+        float spacing = 6.0f;            // distance between neighbouring trees
+    };
+
+    // Appends the scene to an empty SceneData.
+    void generate(const Params& params, SceneSerializer::SceneData& scene);
+
+    // Generates and writes <basePath>.txt, <basePath>.chscene and the imported object map.
+    // False when a file cannot be written.
+    bool write(const Params& params, const std::string& basePath);
+}
+
+#endif // SCENE_GENERATOR_H
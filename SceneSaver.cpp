@@ -0,0 +1,101 @@
+#include "SceneSaver.h"
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::thread s_worker;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    bool s_stopping = false;
+
+    // Guarded by s_mutex.
+    std::unique_ptr<SceneSerializer::SceneData> s_pendingScene;
+    std::string s_pendingPath;
+    uint32_t s_pendingTag = 0;
+    SceneSaver::Status s_status;
+    Clock::time_point s_finishedAt;
+
+    void workerLoop()
+    {
+        Trace::setThreadName("SceneSaver");
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return s_pendingScene != nullptr || s_stopping; });
+            if (s_pendingScene == nullptr)
+                return; // stopping with nothing left to write
+
+            std::unique_ptr<SceneSerializer::SceneData> scene = std::move(s_pendingScene);
+            const std::string path = std::move(s_pendingPath);
+            const uint32_t tag = s_pendingTag;
+            s_status.state = SceneSaver::State::Saving;
+            s_status.path = path;
+            lock.unlock();
+
+            Trace::Zone saveZone("saveSceneFile");
+            const Clock::time_point start = Clock::now();
+            const bool saved = SceneSerializer::saveSceneFile(*scene, path);
+            const Clock::time_point end = Clock::now();
+            scene.reset();
+            saveZone.end();
+
+            lock.lock();
+            s_status.state = saved ? SceneSaver::State::Saved : SceneSaver::State::Failed;
+            s_status.path = path;
+            s_status.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+            s_status.finishedSaves++;
+            s_status.lastSucceeded = saved;
+            s_status.tag = tag;
+            s_finishedAt = end;
+            if (s_pendingScene != nullptr)
+                s_status.state = SceneSaver::State::Saving;
+        }
+    }
+}
+
+namespace SceneSaver
+{
+    void saveAsync(std::unique_ptr<SceneSerializer::SceneData> scene, const std::string& path, uint32_t tag)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_pendingScene = std::move(scene);
+            s_pendingPath = path;
+            s_pendingTag = tag;
+            s_status.state = State::Saving;
+            s_status.path = path;
+            s_stopping = false;
+        }
+        if (!s_worker.joinable())
+            s_worker = std::thread(workerLoop);
+        s_wake.notify_one();
+    }
+
+    Status status()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Status result = s_status;
+        if (result.finishedSaves > 0)
+            result.secondsAgo = std::chrono::duration<double>(Clock::now() - s_finishedAt).count();
+        return result;
+    }
+
+    void shutdown()
+    {
+        if (!s_worker.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stopping = true;
+        }
+        s_wake.notify_one();
+        s_worker.join();
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SCENE_SAVER_H
+#define SCENE_SAVER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "SceneSerializer.h"
+
+// Writes scene snapshots on a background thread so saving never stalls the editor. The UI thread
+// builds a SceneData snapshot (cheap, no file I/O) and hands it over; the worker serializes it
+// with SceneSerializer::saveSceneFile (temp file + rename).
+namespace SceneSaver
+{
+    enum class State
+    {
+        Idle,
+        Saving,
+        Saved,
+        Failed,
+    };
+
+    struct Status
+    {
+        State state = State::Idle;
+        std::string path;           // file being written, or the last one written
+        double milliseconds = 0.0;  // duration of the last finished save
+        double secondsAgo = 0.0;    // time since the last save finished
+        uint32_t finishedSaves = 0; // increments whenever a save finishes, for one-shot logging
+        bool lastSucceeded = false; // result of the last finished save
+        uint32_t tag = 0;           // tag passed with the snapshot of the last finished save
+    };
+
+    // Queues the snapshot. If a save is already running the new one waits for it; an older
+    // snapshot that is still waiting is replaced, only the latest state matters. The tag is
+    // handed back in Status once this snapshot is written.
+    void saveAsync(std::unique_ptr<SceneSerializer::SceneData> scene, const std::string& path, uint32_t tag = 0);
+    Status status();
+
+    // Finishes any queued save and stops the worker.
+    void shutdown();
+}
+
+#endif // SCENE_SAVER_H
@@ -0,0 +1,732 @@
+#include "SceneSerializer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Helper function to quote strings for output
+std::string quote_if_needed(const std::string& s) {
+    // Simple check for spaces, or always quote strings
+    // For more robust quoting, you might check for other special characters too
+    // or just always quote.
+    if (s.find(' ') != std::string::npos || s.find('\t') != std::string::npos || s.find('"') != std::string::npos) {
+        std::string quoted_s = "\"";
+        for (char c : s) {
+            if (c == '"') {
+                quoted_s += "\\\""; // Escape existing quotes
+            }
+            else if (c == '\\') {
+                quoted_s += "\\\\"; // Escape backslashes
+            }
+            else {
+                quoted_s += c;
+            }
+        }
+        quoted_s += "\"";
+        return quoted_s;
+    }
+    return s;
+}
+
+// Helper function to read a potentially quoted string from an istringstream
+std::string read_quoted_string(std::istringstream& iss) {
+    std::string token;
+    iss >> token; // Read the first part
+
+    if (!token.empty() && token.front() == '"') {
+        std::string result = token.substr(1); // Remove leading quote
+        bool in_escape = false;
+        // If the token didn't end with a quote (and it wasn't an escaped quote)
+        while (result.empty() || result.back() != '"' || (result.length() > 1 && result[result.length() - 2] == '\\' && !in_escape)) {
+            if (iss.eof()) { // Reached end of stream unexpectedly
+                // Handle error: unclosed quote
+                throw std::runtime_error("Unclosed quote in input stream");
+            }
+            std::string next_part;
+            iss >> next_part;
+            if (!result.empty()) result += " "; // Add back the space delimiter
+            result += next_part;
+        }
+
+        // Remove trailing quote if it's not escaped
+        if (!result.empty() && result.back() == '"') {
+            // Check if it's an escaped quote (e.g., "abc\\\"")
+            int trailing_backslashes = 0;
+            for (auto it = result.rbegin() + 1; it != result.rend() && *it == '\\'; ++it) {
+                trailing_backslashes++;
+            }
+            if (trailing_backslashes % 2 == 0) { // Not an escaped quote
+                result.pop_back();
+            }
+        }
+
+
+        // Unescape characters
+        std::string unescaped_result;
+        unescaped_result.reserve(result.length());
+        for (size_t i = 0; i < result.length(); ++i) {
+            if (result[i] == '\\' && i + 1 < result.length()) {
+                if (result[i + 1] == '"' || result[i + 1] == '\\') {
+                    unescaped_result += result[i + 1];
+                    i++; // Skip the escaped character
+                }
+                else {
+                    unescaped_result += result[i]; // Not a recognized escape sequence, keep the backslash
+                }
+            }
+            else {
+                unescaped_result += result[i];
+            }
+        }
+        return unescaped_result;
+
+    }
+    else {
+        // Not a quoted string, or an empty string if that's how you write it
+        return token;
+    }
+}
+
+namespace
+{
+    using namespace SceneSerializer;
+
+    static_assert(std::is_trivially_copyable_v<SceneRecord>, "SceneRecord is written and mapped as raw bytes");
+
+    enum SettingsFlags : uint32_t
+    {
+        SETTINGS_DEPTH_PREPASS = 1u << 0,
+        SETTINGS_HATCH_LOD = 1u << 1,
+    };
+
+    struct BinaryHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t headerSize;
+        uint32_t recordSize;
+        uint64_t recordCount;
+        uint64_t recordsOffset;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint32_t settingsFlags;
+        float hatchLodSingleLayerPx;
+        float hatchLodToneOnlyPx;
+        uint32_t reserved;
+    };
+
+    constexpr uint64_t kRecordAlignment = 16;
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Tokenizer for one line of a text scene, reading straight from the file buffer. Mirrors
+    // the istringstream based reader it replaced: numbers stop where from_chars stops (like
+    // operator>>), a bad number reads as 0 and the rest of the line keeps the defaults.
+    class LineParser
+    {
+    public:
+        LineParser(const char* begin, const char* end) : cursor(begin), end(end) {}
+
+        bool atEnd()
+        {
+            skipSpace();
+            return cursor == end;
+        }
+
+        bool ok() const { return !failed; }
+
+        template <typename T>
+        LineParser& operator>>(T& value)
+        {
+            skipSpace();
+            if (failed || cursor == end)
+            {
+                failed = true;
+                return *this;
+            }
+            const char* first = cursor;
+            if (*first == '+' && first + 1 != end) // from_chars rejects the sign operator>> allows
+                first++;
+            T parsed{};
+            auto [ptr, ec] = std::from_chars(first, end, parsed);
+            if (ec != std::errc())
+            {
+                value = T{}; // what operator>> stores for a token that is not a number
+                failed = true;
+                return *this;
+            }
+            value = parsed;
+            cursor = ptr;
+            return *this;
+        }
+
+        // Plain token, or a "quoted string" with \" and \\ escapes. Views into the line unless the
+        // string had escapes, in which case it is unescaped into scratch.
+        std::string_view string(std::string& scratch)
+        {
+            skipSpace();
+            if (failed || cursor == end)
+                return {};
+            if (*cursor != '"')
+            {
+                const char* first = cursor;
+                while (cursor != end && !isSpace(*cursor))
+                    cursor++;
+                return std::string_view(first, size_t(cursor - first));
+            }
+
+            const char* first = ++cursor;
+            bool escaped = false;
+            while (cursor != end && *cursor != '"')
+            {
+                if (*cursor == '\\' && cursor + 1 != end && (cursor[1] == '"' || cursor[1] == '\\'))
+                {
+                    escaped = true;
+                    cursor++;
+                }
+                cursor++;
+            }
+            std::string_view result(first, size_t(cursor - first));
+            if (cursor != end)
+                cursor++; // closing quote
+            if (!escaped)
+                return result;
+
+            scratch.clear();
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                if (result[i] == '\\' && i + 1 < result.size() && (result[i + 1] == '"' || result[i + 1] == '\\'))
+                    i++;
+                scratch.push_back(result[i]);
+            }
+            return scratch;
+        }
+
+    private:
+        static bool isSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+        }
+
+        void skipSpace()
+        {
+            while (cursor != end && isSpace(*cursor))
+                cursor++;
+        }
+
+        const char* cursor;
+        const char* end;
+        bool failed = false;
+    };
+
+    bool readWholeFile(const std::string& path, std::string& buffer)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+        buffer.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(buffer.data(), std::streamsize(buffer.size()));
+        return bool(file);
+    }
+
+    bool mapFile(const std::string& path, void*& data, size_t& size, void*& handle)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file); // the mapping keeps the file open
+        if (mapping == nullptr)
+            return false;
+        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (data == nullptr)
+        {
+            CloseHandle(mapping);
+            return false;
+        }
+        size = size_t(fileSize.QuadPart);
+        handle = mapping;
+        return true;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps the file open
+        if (mapped == MAP_FAILED)
+            return false;
+        data = mapped;
+        size = size_t(st.st_size);
+        handle = nullptr;
+        return true;
+#endif
+    }
+
+    void unmapFile(void* data, size_t size, void* handle)
+    {
+#ifdef _WIN32
+        (void)size;
+        UnmapViewOfFile(data);
+        CloseHandle(handle);
+#else
+        (void)handle;
+        munmap(data, size);
+#endif
+    }
+}
+
+namespace SceneSerializer
+{
+    SceneData::~SceneData()
+    {
+        clear();
+    }
+
+    void SceneData::clear()
+    {
+        if (mappedData)
+            unmapFile(mappedData, mappedSize, mappingHandle);
+        mappedData = nullptr;
+        mappedSize = 0;
+        mappingHandle = nullptr;
+
+        records.clear();
+        strings.clear();
+        stringLookup.clear();
+        indexById.clear();
+        view = nullptr;
+        count = 0;
+        stringData = nullptr;
+        stringSize = 0;
+        settings = SceneSettings();
+    }
+
+    StringRef SceneData::addString(std::string_view s)
+    {
+        auto it = stringLookup.find(s);
+        if (it != stringLookup.end())
+            return it->second;
+
+        StringRef ref;
+        ref.offset = uint32_t(strings.size());
+        ref.length = uint32_t(s.size());
+        strings.append(s);
+        strings.push_back('\0'); // keeps every entry usable as a C string
+        stringLookup.emplace(std::string(s), ref);
+        stringData = strings.data();
+        stringSize = strings.size();
+        return ref;
+    }
+
+    void SceneData::addRecord(const SceneRecord& record)
+    {
+        SceneRecord stored = record;
+        auto parent = indexById.find(record.parentId);
+        stored.parentIndex = (record.parentId != -1 && parent != indexById.end()) ? parent->second : -1;
+        indexById[record.id] = int32_t(records.size());
+        records.push_back(stored);
+        view = records.data();
+        count = records.size();
+    }
+
+    void SceneData::resolveParents()
+    {
+        for (SceneRecord& record : records)
+        {
+            auto parent = indexById.find(record.parentId);
+            record.parentIndex = (record.parentId != -1 && parent != indexById.end()) ? parent->second : -1;
+        }
+
+        bool parentsFirst = true;
+        for (size_t i = 0; i < records.size() && parentsFirst; i++)
+            parentsFirst = records[i].parentIndex < int32_t(i);
+        if (parentsFirst)
+            return;
+
+        // Reorder so every parent comes before its children, as binary files require. A record
+        // whose parent chain loops back to itself is cut loose and becomes a root.
+        enum : uint8_t { UNVISITED, ON_PATH, PLACED };
+        std::vector<uint8_t> state(records.size(), UNVISITED);
+        std::vector<int32_t> newIndex(records.size(), -1);
+        std::vector<SceneRecord> ordered;
+        ordered.reserve(records.size());
+        std::vector<int32_t> path;
+        for (size_t start = 0; start < records.size(); start++)
+        {
+            path.clear();
+            for (int32_t at = int32_t(start); at != -1 && state[at] != PLACED; at = records[at].parentIndex)
+            {
+                if (state[at] == ON_PATH)
+                {
+                    SceneRecord& last = records[path.back()];
+                    std::cerr << "Scene record " << last.id << " is part of a parent cycle, made it a root" << std::endl;
+                    last.parentId = -1;
+                    last.parentIndex = -1;
+                    break;
+                }
+                state[at] = ON_PATH;
+                path.push_back(at);
+            }
+            for (auto it = path.rbegin(); it != path.rend(); ++it)
+            {
+                state[*it] = PLACED;
+                newIndex[*it] = int32_t(ordered.size());
+                ordered.push_back(records[*it]);
+            }
+        }
+
+        indexById.clear();
+        for (size_t i = 0; i < ordered.size(); i++)
+        {
+            SceneRecord& record = ordered[i];
+            if (record.parentIndex != -1)
+                record.parentIndex = newIndex[record.parentIndex];
+            indexById[record.id] = int32_t(i);
+        }
+        records = std::move(ordered);
+        view = records.data();
+        count = records.size();
+    }
+
+    std::string_view SceneData::string(StringRef ref) const
+    {
+        if (stringData == nullptr || uint64_t(ref.offset) + ref.length > stringSize)
+            return {};
+        return std::string_view(stringData + ref.offset, ref.length);
+    }
+
+    bool SceneData::load(const std::string& path)
+    {
+        return isBinaryScene(path) ? loadBinary(path) : loadText(path);
+    }
+
+    bool SceneData::loadText(const std::string& path)
+    {
+        clear();
+        std::string buffer;
+        if (!readWholeFile(path, buffer))
+            return false;
+
+        // One record per line, so the line count is an upper bound for every table.
+        const size_t lineCount = size_t(std::count(buffer.begin(), buffer.end(), '\n')) + 1;
+        records.reserve(lineCount);
+        indexById.reserve(lineCount);
+        stringLookup.reserve(lineCount);
+
+        std::string scratch;
+        const char* cursor = buffer.data();
+        const char* bufferEnd = cursor + buffer.size();
+        while (cursor < bufferEnd)
+        {
+            const char* lineBegin = cursor;
+            const char* lineEnd = static_cast<const char*>(std::memchr(lineBegin, '\n', size_t(bufferEnd - lineBegin)));
+            if (lineEnd == nullptr)
+                lineEnd = bufferEnd;
+            cursor = lineEnd + 1;
+
+            if (*lineBegin == '#')
+            {
+                LineParser setting(lineBegin + 1, lineEnd);
+                const std::string_view key = setting.string(scratch);
+                if (key == "depthPrepass") {
+                    int value = 0;
+                    setting >> value;
+                    settings.depthPrepass = value != 0;
+                }
+                else if (key == "hatchLod") {
+                    int value = 1;
+                    setting >> value >> settings.hatchLodSingleLayerPx >> settings.hatchLodToneOnlyPx;
+                    settings.hatchLod = value != 0;
+                }
+                else if (key == "instanceHatchLod") {
+                    int id = -1;
+                    float singleLayerPx = 0.0f, toneOnlyPx = 0.0f;
+                    setting >> id >> singleLayerPx >> toneOnlyPx;
+                    auto it = indexById.find(id);
+                    if (setting.ok() && it != indexById.end()) {
+                        SceneRecord& record = records[it->second];
+                        record.flags |= RECORD_OVERRIDE_HATCH_LOD;
+                        record.lodSingleLayerPx = singleLayerPx;
+                        record.lodToneOnlyPx = toneOnlyPx;
+                    }
+                }
+                continue;
+            }
+
+            LineParser line(lineBegin, lineEnd);
+            if (line.atEnd())
+                continue;
+
+            SceneRecord r;
+            int animationEnabled = 0;
+            line >> r.id;
+            r.type = addString(line.string(scratch));
+            r.name = addString(line.string(scratch));
+            line >> r.meshNumber
+                >> r.position[0] >> r.position[1] >> r.position[2]
+                >> r.rotation[0] >> r.rotation[1] >> r.rotation[2]
+                >> r.scale[0] >> r.scale[1] >> r.scale[2]
+                >> r.objectColor[0] >> r.objectColor[1] >> r.objectColor[2] >> r.objectColor[3];
+            r.texture = addString(line.string(scratch));
+            r.noiseTexture = addString(line.string(scratch));
+            line >> r.parentId >> r.lightType
+                >> r.lightDirection[0] >> r.lightDirection[1] >> r.lightDirection[2]
+                >> r.lightIntensity >> r.lightRange >> r.lightConeAngle
+                >> r.lightColor[0] >> r.lightColor[1] >> r.lightColor[2] >> r.lightColor[3]
+                >> r.inkColor[0] >> r.inkColor[1] >> r.inkColor[2] >> r.inkColor[3]
+                >> r.epsilonValue >> r.strokeMultiplier >> r.lineAngle1 >> r.lineAngle2
+                >> r.patternScale >> r.lineThickness >> r.transparencyValue >> r.crosshatchMode
+                >> r.layerPatternScale >> r.layerStrokeMult >> r.layerAngle >> r.layerLineThickness
+                >> r.centerX >> r.centerZ >> r.radius >> r.rotationSpeed >> r.instanceAngle
+                >> r.basePosition[0] >> r.basePosition[1] >> r.basePosition[2]
+                >> r.animAmplitude[0] >> r.animAmplitude[1] >> r.animAmplitude[2]
+                >> r.animFrequency[0] >> r.animFrequency[1] >> r.animFrequency[2]
+                >> r.animPhase[0] >> r.animPhase[1] >> r.animPhase[2]
+                >> animationEnabled;
+            r.textContent = addString(line.string(scratch));
+            if (animationEnabled)
+                r.flags |= RECORD_ANIMATION_ENABLED;
+            addRecord(r);
+        }
+
+        // Parents normally come first, but the text format never required it.
+        resolveParents();
+        return true;
+    }
+
+    bool SceneData::saveText(const std::string& path) const
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+            return false;
+
+        // Scene-wide render settings, one "# key value" line each.
+        file << "# depthPrepass " << (settings.depthPrepass ? 1 : 0) << "\n";
+        file << "# hatchLod " << (settings.hatchLod ? 1 : 0) << " " << settings.hatchLodSingleLayerPx << " " << settings.hatchLodToneOnlyPx << "\n";
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const SceneRecord& r = view[i];
+            file << r.id << " " << quote_if_needed(std::string(string(r.type))) << " " << quote_if_needed(std::string(string(r.name))) << " " << r.meshNumber << " "
+                << r.position[0] << " " << r.position[1] << " " << r.position[2] << " "
+                << r.rotation[0] << " " << r.rotation[1] << " " << r.rotation[2] << " "
+                << r.scale[0] << " " << r.scale[1] << " " << r.scale[2] << " "
+                << r.objectColor[0] << " " << r.objectColor[1] << " " << r.objectColor[2] << " " << r.objectColor[3] << " "
+                << quote_if_needed(std::string(string(r.texture))) << " " << quote_if_needed(std::string(string(r.noiseTexture))) << " " << r.parentId << " " << r.lightType << " " << r.lightDirection[0] << " "
+                << r.lightDirection[1] << " " << r.lightDirection[2] << " " << r.lightIntensity << " "
+                << r.lightRange << " " << r.lightConeAngle << " " << r.lightColor[0] << " "
+                << r.lightColor[1] << " " << r.lightColor[2] << " " << r.lightColor[3] << " "
+                << r.inkColor[0] << " " << r.inkColor[1] << " " << r.inkColor[2] << " " << r.inkColor[3] << " "
+                << r.epsilonValue << " " << r.strokeMultiplier << " " << r.lineAngle1 << " " << r.lineAngle2 << " "
+                << r.patternScale << " " << r.lineThickness << " " << r.transparencyValue << " " << r.crosshatchMode << " "
+                << r.layerPatternScale << " " << r.layerStrokeMult << " " << r.layerAngle << " " << r.layerLineThickness << " "
+                << r.centerX << " " << r.centerZ << " " << r.radius << " " << r.rotationSpeed << " " << r.instanceAngle << " "
+                << r.basePosition[0] << " " << r.basePosition[1] << " " << r.basePosition[2] << " "
+                << r.animAmplitude[0] << " " << r.animAmplitude[1] << " " << r.animAmplitude[2] << " "
+                << r.animFrequency[0] << " " << r.animFrequency[1] << " " << r.animFrequency[2] << " "
+                << r.animPhase[0] << " " << r.animPhase[1] << " " << r.animPhase[2] << " "
+                << ((r.flags & RECORD_ANIMATION_ENABLED) ? 1 : 0) << " " << quote_if_needed(std::string(string(r.textContent))) << "\n";
+        }
+
+        // Per-instance overrides go after the instances they refer to.
+        for (size_t i = 0; i < count; i++)
+        {
+            const SceneRecord& r = view[i];
+            if (r.flags & RECORD_OVERRIDE_HATCH_LOD)
+                file << "# instanceHatchLod " << r.id << " " << r.lodSingleLayerPx << " " << r.lodToneOnlyPx << "\n";
+        }
+        file.close(); // flushes, so write errors show up before the file is renamed into place
+        return !file.fail();
+    }
+
+    bool SceneData::loadBinary(const std::string& path)
+    {
+        clear();
+        if (!mapFile(path, mappedData, mappedSize, mappingHandle))
+        {
+            std::cerr << "Failed to map scene file: " << path << std::endl;
+            return false;
+        }
+
+        const char* base = static_cast<const char*>(mappedData);
+        BinaryHeader header{};
+        const size_t minimalHeader = offsetof(BinaryHeader, recordCount);
+        if (mappedSize < minimalHeader)
+        {
+            std::cerr << "Scene file too small: " << path << std::endl;
+            clear();
+            return false;
+        }
+        std::memcpy(&header, base, minimalHeader);
+        if (header.magic != kBinaryMagic || header.headerSize < sizeof(BinaryHeader) || header.headerSize > mappedSize || header.recordSize == 0)
+        {
+            std::cerr << "Not a .chscene file: " << path << std::endl;
+            clear();
+            return false;
+        }
+        std::memcpy(&header, base, sizeof(BinaryHeader));
+        if (header.version > kBinaryVersion)
+            std::cout << "Scene " << path << " was written by a newer version (" << header.version << "), unknown fields are ignored" << std::endl;
+
+        // Compared against the space left after each offset, a crafted count cannot wrap the products around.
+        if (header.recordsOffset > mappedSize || header.recordCount > (mappedSize - header.recordsOffset) / header.recordSize
+            || header.stringsOffset > mappedSize || header.stringsSize > mappedSize - header.stringsOffset)
+        {
+            std::cerr << "Truncated scene file: " << path << std::endl;
+            clear();
+            return false;
+        }
+
+        settings.depthPrepass = (header.settingsFlags & SETTINGS_DEPTH_PREPASS) != 0;
+        settings.hatchLod = (header.settingsFlags & SETTINGS_HATCH_LOD) != 0;
+        settings.hatchLodSingleLayerPx = header.hatchLodSingleLayerPx;
+        settings.hatchLodToneOnlyPx = header.hatchLodToneOnlyPx;
+
+        stringData = base + header.stringsOffset;
+        stringSize = size_t(header.stringsSize);
+        count = size_t(header.recordCount);
+
+        const char* recordBase = base + header.recordsOffset;
+        if (header.recordSize == sizeof(SceneRecord) && header.recordsOffset % alignof(SceneRecord) == 0)
+        {
+            // Current layout: the records are used straight from the mapping.
+            view = reinterpret_cast<const SceneRecord*>(recordBase);
+        }
+        else
+        {
+            // Older (shorter) or newer (longer) records: copy the common prefix over the defaults.
+            const size_t copySize = std::min<size_t>(header.recordSize, sizeof(SceneRecord));
+            records.resize(count);
+            for (size_t i = 0; i < count; i++)
+                std::memcpy(&records[i], recordBase + i * header.recordSize, copySize);
+            view = records.data();
+        }
+
+        // Parents always come first, loaders link the hierarchy in one pass relying on it.
+        for (size_t i = 0; i < count; i++)
+        {
+            if (view[i].parentIndex < -1 || view[i].parentIndex >= int64_t(i))
+            {
+                std::cerr << "Corrupt scene file (record " << i << " has parent index " << view[i].parentIndex << "): " << path << std::endl;
+                clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SceneData::saveBinary(const std::string& path) const
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        BinaryHeader header{};
+        header.magic = kBinaryMagic;
+        header.version = kBinaryVersion;
+        header.headerSize = sizeof(BinaryHeader);
+        header.recordSize = sizeof(SceneRecord);
+        header.recordCount = count;
+        header.recordsOffset = alignUp(sizeof(BinaryHeader), kRecordAlignment);
+        header.stringsOffset = header.recordsOffset + uint64_t(count) * sizeof(SceneRecord);
+        header.stringsSize = stringSize;
+        header.settingsFlags = (settings.depthPrepass ? SETTINGS_DEPTH_PREPASS : 0u) | (settings.hatchLod ? SETTINGS_HATCH_LOD : 0u);
+        header.hatchLodSingleLayerPx = settings.hatchLodSingleLayerPx;
+        header.hatchLodToneOnlyPx = settings.hatchLodToneOnlyPx;
+
+        static const char padding[kRecordAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding, std::streamsize(header.recordsOffset - sizeof(header)));
+        if (count > 0)
+            file.write(reinterpret_cast<const char*>(view), std::streamsize(count * sizeof(SceneRecord)));
+        if (stringSize > 0)
+            file.write(stringData, std::streamsize(stringSize));
+        file.close();
+        return !file.fail();
+    }
+
+    bool isBinaryScene(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        uint32_t magic = 0;
+        return file.read(reinterpret_cast<char*>(&magic), sizeof(magic)) && magic == kBinaryMagic;
+    }
+
+    bool saveSceneFile(const SceneData& scene, const std::string& path)
+    {
+        const std::filesystem::path target = path;
+        const std::filesystem::path temp = target.string() + ".tmp";
+        const bool binary = target.extension() == ".chscene";
+        if (!(binary ? scene.saveBinary(temp.string()) : scene.saveText(temp.string())))
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            return false;
+        }
+
+        // rename() replaces an existing file in one step (MoveFileEx with REPLACE_EXISTING on Windows).
+        std::error_code error;
+        std::filesystem::rename(temp, target, error);
+        if (error)
+        {
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            return false;
+        }
+        return true;
+    }
+
+    bool convertTextToBinary(const std::string& textPath, const std::string& binaryPath)
+    {
+        SceneData scene;
+        if (!scene.loadText(textPath))
+        {
+            std::cerr << "Failed to read text scene: " << textPath << std::endl;
+            return false;
+        }
+        std::string outPath = binaryPath;
+        if (outPath.empty())
+            outPath = std::filesystem::path(textPath).replace_extension(".chscene").string();
+        if (!scene.saveBinary(outPath))
+        {
+            std::cerr << "Failed to write binary scene: " << outPath << std::endl;
+            return false;
+        }
+        std::cout << "Converted " << textPath << " -> " << outPath << " (" << scene.size() << " instances)" << std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,167 @@
+#ifndef SCENE_SERIALIZER_H
+#define SCENE_SERIALIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Helpers for the whitespace separated text files (scenes, imported object maps).
+std::string quote_if_needed(const std::string& s);
+std::string read_quoted_string(std::istringstream& iss);
+
+// Scene files come in two flavours that hold the same data:
+//  - text (.txt): one line of whitespace separated fields per instance, kept as interchange format
+//  - binary (.chscene): header, fixed-size instance records and a string table, loaded by
+//    memory-mapping the file and using the records in place.
+namespace SceneSerializer
+{
+    constexpr uint32_t kBinaryMagic = 0x43534843; // "CHSC"
+    constexpr uint32_t kBinaryVersion = 1;
+
+    struct StringRef
+    {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    enum RecordFlags : uint32_t
+    {
+        RECORD_ANIMATION_ENABLED = 1u << 0,
+        RECORD_OVERRIDE_HATCH_LOD = 1u << 1,
+    };
+
+    // One instance exactly as stored in a .chscene file (little-endian). Fields are only ever
+    // appended: the header stores the record size, so files written by an older version load
+    // with the defaults below for the fields they do not have.
+    struct SceneRecord
+    {
+        int32_t id = 0;
+        int32_t parentId = -1;     // id of the parent, as written in the text format
+        int32_t parentIndex = -1;  // record index of the parent, always lower than the record's own
+        int32_t meshNumber = 0;
+        int32_t lightType = 1;     // LightType::Point
+        int32_t crosshatchMode = 3;
+        uint32_t flags = 0;        // RecordFlags
+
+        StringRef type;
+        StringRef name;
+        StringRef texture;         // "none" when unset
+        StringRef noiseTexture;    // "none" when unset
+        StringRef textContent;
+
+        float position[3] = { 0.0f, 0.0f, 0.0f };
+        float rotation[3] = { 0.0f, 0.0f, 0.0f };
+        float scale[3] = { 1.0f, 1.0f, 1.0f };
+        float objectColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        float lightDirection[3] = { 0.0f, -1.0f, 0.0f };
+        float lightIntensity = 1.0f;
+        float lightRange = 10.0f;
+        float lightConeAngle = 1.0f;
+        float lightColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        float inkColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        float epsilonValue = 0.02f;
+        float strokeMultiplier = 1.0f;
+        float lineAngle1 = 0.785398f;
+        float lineAngle2 = 0.392699f;
+        float patternScale = 0.15f;
+        float lineThickness = 0.3f;
+        float transparencyValue = 1.0f;
+        float layerPatternScale = 0.15f;
+        float layerStrokeMult = 0.25f;
+        float layerAngle = 2.983f;
+        float layerLineThickness = 10.0f;
+
+        float centerX = 0.0f;
+        float centerZ = 0.0f;
+        float radius = 5.0f;
+        float rotationSpeed = 0.5f;
+        float instanceAngle = 0.0f;
+        float basePosition[3] = { 0.0f, 0.0f, 0.0f };
+        float animAmplitude[3] = { 0.0f, 0.0f, 0.0f };
+        float animFrequency[3] = { 1.0f, 1.0f, 1.0f };
+        float animPhase[3] = { 0.0f, 0.0f, 0.0f };
+
+        float lodSingleLayerPx = 160.0f;
+        float lodToneOnlyPx = 40.0f;
+    };
+
+    // Scene-wide render settings ("#" lines in the text format, header fields in .chscene).
+    struct SceneSettings
+    {
+        bool depthPrepass = false;
+        bool hatchLod = true;
+        float hatchLodSingleLayerPx = 160.0f;
+        float hatchLodToneOnlyPx = 40.0f;
+    };
+
+    class SceneData
+    {
+    public:
+        SceneData() = default;
+        ~SceneData();
+        SceneData(const SceneData&) = delete;
+        SceneData& operator=(const SceneData&) = delete;
+
+        SceneSettings settings;
+
+        // Building a scene for saving. Records must be added parents first.
+        StringRef addString(std::string_view s);
+        void addRecord(const SceneRecord& record);
+
+        // load() picks the format from the file content.
+        bool load(const std::string& path);
+        bool loadText(const std::string& path);
+        bool loadBinary(const std::string& path);
+        bool saveText(const std::string& path) const;
+        bool saveBinary(const std::string& path) const;
+
+        size_t size() const { return count; }
+        const SceneRecord& operator[](size_t i) const { return view[i]; }
+        std::string_view string(StringRef ref) const;
+
+    private:
+        // Lets addString() look up a string_view without building a std::string first.
+        struct StringHash
+        {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        void clear();
+        void resolveParents();
+
+        // Owned storage (text files, scenes being built, or upgraded old binary records).
+        std::vector<SceneRecord> records;
+        std::string strings;
+        std::unordered_map<std::string, StringRef, StringHash, std::equal_to<>> stringLookup;
+        std::unordered_map<int32_t, int32_t> indexById;
+
+        // What size()/operator[]/string() read from: the owned storage or the mapped file.
+        const SceneRecord* view = nullptr;
+        size_t count = 0;
+        const char* stringData = nullptr;
+        size_t stringSize = 0;
+
+        void* mappedData = nullptr;
+        size_t mappedSize = 0;
+        void* mappingHandle = nullptr;
+    };
+
+    bool isBinaryScene(const std::string& path);
+
+    // Writes the scene in the format picked by the extension (.chscene or text) to a temporary
+    // file next to path and renames it over path, so a failed save never leaves half a scene.
+    bool saveSceneFile(const SceneData& scene, const std::string& path);
+
+    // Writes <textPath without extension>.chscene (or binaryPath when given).
+    bool convertTextToBinary(const std::string& textPath, const std::string& binaryPath = "");
+}
+
+#endif // SCENE_SERIALIZER_H
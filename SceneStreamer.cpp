@@ -0,0 +1,570 @@
+#include "SceneStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    using SceneStreamer::CellCoord;
+
+    constexpr int kIndexVersion = 1;
+
+    enum class CellState
+    {
+        Unloaded,
+        Queued,
+        Loading,   // being read, or read and waiting for update() to hand it over
+        Resident,  // instances live in the editor
+        Evicting,  // listed by update(), waiting for unloaded()
+    };
+
+    struct Cell
+    {
+        CellCoord coord;
+        size_t records = 0;
+        size_t bytes = 0;                  // cell file size, the estimate used for the budget
+        std::vector<std::string> types;    // imported types its records use
+        CellState state = CellState::Unloaded;
+        float distance = 0.0f;             // from the camera at the last update
+        size_t residentBytes = 0;          // bytes counted while loaded
+        std::vector<std::string> assets;   // asset paths referenced while loaded
+    };
+
+    struct LoadedAsset
+    {
+        SceneStreamer::Asset asset;
+        int cells = 0;
+    };
+
+    uint64_t cellKey(CellCoord coord)
+    {
+        return (uint64_t(uint32_t(coord.x)) << 32) | uint32_t(coord.z);
+    }
+
+    // Set up by open(), main thread only unless noted.
+    bool s_open = false;
+    std::string s_indexPath;
+    fs::path s_cellDirectory;
+    float s_cellSize = 64.0f;
+    int32_t s_maxId = 0;
+    std::unordered_map<std::string, std::string> s_assetPaths; // the loader reads it under s_mutex
+    bool s_indexDirty = false;
+    SceneStreamer::Settings s_settings;
+    SceneStreamer::AssetLoader s_loader;
+    float s_lastCamera[3] = { 0.0f, 0.0f, 0.0f };
+    bool s_replan = true;
+
+    std::thread s_worker;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    bool s_stopping = false;
+
+    // Guarded by s_mutex.
+    std::unordered_map<uint64_t, Cell> s_cells;
+    std::vector<uint64_t> s_queue; // nearest first
+    std::vector<SceneStreamer::LoadedCell> s_finished;
+    std::unordered_map<std::string, LoadedAsset> s_assets; // by path
+    size_t s_residentBytes = 0;
+
+    fs::path cellDirectoryFor(const std::string& indexPath)
+    {
+        const fs::path index = indexPath;
+        return index.parent_path() / (index.stem().string() + "_cells");
+    }
+
+    fs::path cellFile(const fs::path& directory, CellCoord coord)
+    {
+        return directory / (std::to_string(coord.x) + "_" + std::to_string(coord.z) + ".chscene");
+    }
+
+    CellCoord cellContaining(float x, float z, float cellSize)
+    {
+        return { int32_t(std::floor(x / cellSize)), int32_t(std::floor(z / cellSize)) };
+    }
+
+    // Distance on the XZ plane from a point to the closest point of the cell.
+    float distanceToCell(CellCoord coord, float x, float z)
+    {
+        const float minX = coord.x * s_cellSize, minZ = coord.z * s_cellSize;
+        const float dx = std::max({ minX - x, 0.0f, x - (minX + s_cellSize) });
+        const float dz = std::max({ minZ - z, 0.0f, z - (minZ + s_cellSize) });
+        return std::sqrt(dx * dx + dz * dz);
+    }
+
+    bool writeIndex(const std::string& path, float cellSize, int32_t maxId,
+        const std::unordered_map<std::string, std::string>& assetPaths, const std::unordered_map<uint64_t, Cell>& cells)
+    {
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath);
+            if (!file.is_open())
+                return false;
+            file << "chstream " << kIndexVersion << "\n";
+            file << "cellSize " << cellSize << "\n";
+            file << "maxId " << maxId << "\n";
+            for (const auto& [type, assetPath] : assetPaths)
+                file << "asset " << quote_if_needed(type) << " " << quote_if_needed(assetPath) << "\n";
+            for (const auto& [key, cell] : cells)
+            {
+                file << "cell " << cell.coord.x << " " << cell.coord.z << " " << cell.records << " " << cell.bytes << " " << cell.types.size();
+                for (const std::string& type : cell.types)
+                    file << " " << quote_if_needed(type);
+                file << "\n";
+            }
+            file.close();
+            if (file.fail())
+                return false;
+        }
+        std::error_code error;
+        fs::rename(tempPath, path, error);
+        return !error;
+    }
+
+    bool readIndex(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+            return false;
+        std::string line;
+        if (!std::getline(file, line) || line.rfind("chstream ", 0) != 0)
+            return false;
+        try
+        {
+            while (std::getline(file, line))
+            {
+                std::istringstream iss(line);
+                std::string key;
+                iss >> key;
+                if (key == "cellSize")
+                    iss >> s_cellSize;
+                else if (key == "maxId")
+                    iss >> s_maxId;
+                else if (key == "asset")
+                {
+                    const std::string type = read_quoted_string(iss);
+                    s_assetPaths[type] = read_quoted_string(iss);
+                }
+                else if (key == "cell")
+                {
+                    Cell cell;
+                    size_t typeCount = 0;
+                    iss >> cell.coord.x >> cell.coord.z >> cell.records >> cell.bytes >> typeCount;
+                    for (size_t i = 0; i < typeCount && iss; i++)
+                        cell.types.push_back(read_quoted_string(iss));
+                    if (iss)
+                        s_cells[cellKey(cell.coord)] = std::move(cell);
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Malformed stream index " << path << ": " << e.what() << std::endl;
+            return false;
+        }
+        return s_cellSize > 0.0f;
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return !s_queue.empty() || s_stopping; });
+            if (s_stopping)
+                return;
+
+            Cell& cell = s_cells[s_queue.front()];
+            s_queue.erase(s_queue.begin());
+            cell.state = CellState::Loading;
+            SceneStreamer::LoadedCell loaded;
+            loaded.coord = cell.coord;
+            std::vector<std::string> paths;
+            for (const std::string& type : cell.types)
+            {
+                auto it = s_assetPaths.find(type);
+                if (it != s_assetPaths.end() && std::find(paths.begin(), paths.end(), it->second) == paths.end())
+                    paths.push_back(it->second);
+            }
+            lock.unlock();
+
+            loaded.scene = std::make_unique<SceneSerializer::SceneData>();
+            if (!loaded.scene->loadBinary(cellFile(s_cellDirectory, loaded.coord).string()))
+                loaded.scene.reset();
+            for (const std::string& path : paths)
+            {
+                lock.lock();
+                auto cached = s_assets.find(path);
+                const bool resident = cached != s_assets.end();
+                SceneStreamer::Asset asset = resident ? cached->second.asset : SceneStreamer::Asset{};
+                lock.unlock();
+                // Assets shared by many cells (the same building all over a block) are parsed once.
+                if (!resident && s_loader)
+                    asset = s_loader(path);
+                loaded.assets[path] = std::move(asset);
+            }
+
+            lock.lock();
+            Cell& done = s_cells[cellKey(loaded.coord)];
+            done.residentBytes = done.bytes;
+            done.assets = paths;
+            s_residentBytes += done.bytes;
+            for (const auto& [path, asset] : loaded.assets)
+            {
+                LoadedAsset& entry = s_assets[path];
+                if (entry.cells++ == 0)
+                {
+                    entry.asset = asset;
+                    s_residentBytes += asset.bytes;
+                }
+            }
+            s_finished.push_back(std::move(loaded));
+        }
+    }
+}
+
+namespace SceneStreamer
+{
+    bool buildStream(const SceneSerializer::SceneData& scene, const std::unordered_map<std::string, std::string>& assetPaths,
+        const std::string& indexPath, float cellSize)
+    {
+        if (cellSize <= 0.0f)
+            return false;
+        const fs::path directory = cellDirectoryFor(indexPath);
+        std::error_code error;
+        fs::create_directories(directory, error);
+        if (error)
+        {
+            std::cerr << "Failed to create " << directory.string() << ": " << error.message() << std::endl;
+            return false;
+        }
+
+        // Roots decide the cell, their subtrees follow in parents-first order.
+        const size_t count = scene.size();
+        std::vector<std::vector<size_t>> children(count);
+        std::unordered_map<uint64_t, std::vector<size_t>> rootsByCell;
+        std::vector<uint64_t> cellOrder;
+        int32_t maxId = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const SceneSerializer::SceneRecord& r = scene[i];
+            maxId = std::max(maxId, r.id);
+            if (r.parentIndex >= 0 && size_t(r.parentIndex) < count && size_t(r.parentIndex) != i)
+            {
+                children[r.parentIndex].push_back(i);
+                continue;
+            }
+            const uint64_t key = cellKey(cellContaining(r.position[0], r.position[2], cellSize));
+            std::vector<size_t>& roots = rootsByCell[key];
+            if (roots.empty())
+                cellOrder.push_back(key);
+            roots.push_back(i);
+        }
+
+        std::unordered_map<uint64_t, Cell> cells;
+        std::vector<size_t> stack;
+        for (uint64_t key : cellOrder)
+        {
+            SceneSerializer::SceneData cellScene;
+            cellScene.settings = scene.settings;
+            Cell cell;
+            cell.coord = cellContaining(scene[rootsByCell[key].front()].position[0], scene[rootsByCell[key].front()].position[2], cellSize);
+            for (size_t root : rootsByCell[key])
+            {
+                stack.assign(1, root);
+                while (!stack.empty())
+                {
+                    const size_t i = stack.back();
+                    stack.pop_back();
+                    SceneSerializer::SceneRecord r = scene[i];
+                    r.type = cellScene.addString(scene.string(r.type));
+                    r.name = cellScene.addString(scene.string(r.name));
+                    r.texture = cellScene.addString(scene.string(r.texture));
+                    r.noiseTexture = cellScene.addString(scene.string(r.noiseTexture));
+                    r.textContent = cellScene.addString(scene.string(r.textContent));
+                    cellScene.addRecord(r);
+
+                    const std::string type(scene.string(scene[i].type));
+                    if (assetPaths.count(type) && std::find(cell.types.begin(), cell.types.end(), type) == cell.types.end())
+                        cell.types.push_back(type);
+                    stack.insert(stack.end(), children[i].rbegin(), children[i].rend());
+                }
+            }
+
+            const fs::path path = cellFile(directory, cell.coord);
+            if (!SceneSerializer::saveSceneFile(cellScene, path.string()))
+            {
+                std::cerr << "Failed to write cell " << path.string() << std::endl;
+                return false;
+            }
+            cell.records = cellScene.size();
+            cell.bytes = size_t(fs::file_size(path, error));
+            cells[key] = std::move(cell);
+        }
+
+        if (!writeIndex(indexPath, cellSize, maxId, assetPaths, cells))
+        {
+            std::cerr << "Failed to write stream index " << indexPath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool open(const std::string& indexPath, AssetLoader loader)
+    {
+        close();
+        if (!readIndex(indexPath))
+        {
+            std::cerr << "Failed to read stream index " << indexPath << std::endl;
+            s_cells.clear();
+            s_assetPaths.clear();
+            return false;
+        }
+        s_indexPath = indexPath;
+        s_cellDirectory = cellDirectoryFor(indexPath);
+        s_loader = std::move(loader);
+        s_replan = true;
+        s_stopping = false;
+        s_open = true;
+        s_worker = std::thread(workerLoop);
+        return true;
+    }
+
+    void close()
+    {
+        if (!s_open)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_stopping = true;
+        }
+        s_wake.notify_one();
+        s_worker.join();
+
+        if (s_indexDirty && !writeIndex(s_indexPath, s_cellSize, s_maxId, s_assetPaths, s_cells))
+            std::cerr << "Failed to update stream index " << s_indexPath << std::endl;
+
+        s_open = false;
+        s_indexDirty = false;
+        s_loader = nullptr;
+        s_cells.clear();
+        s_queue.clear();
+        s_finished.clear();
+        s_assets.clear();
+        s_assetPaths.clear();
+        s_residentBytes = 0;
+        s_maxId = 0;
+        s_indexPath.clear();
+    }
+
+    bool isOpen()
+    {
+        return s_open;
+    }
+
+    const std::string& indexPath()
+    {
+        return s_indexPath;
+    }
+
+    const std::unordered_map<std::string, std::string>& assetPaths()
+    {
+        return s_assetPaths;
+    }
+
+    int32_t maxInstanceId()
+    {
+        return s_maxId;
+    }
+
+    float cellSize()
+    {
+        return s_cellSize;
+    }
+
+    CellCoord cellAt(float x, float z)
+    {
+        return cellContaining(x, z, s_cellSize);
+    }
+
+    void setSettings(const Settings& settings)
+    {
+        s_settings = settings;
+        s_replan = true;
+    }
+
+    Settings settings()
+    {
+        return s_settings;
+    }
+
+    void update(const float cameraPosition[3], std::vector<LoadedCell>& loaded, std::vector<CellCoord>& evict)
+    {
+        if (!s_open)
+            return;
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (LoadedCell& cell : s_finished)
+        {
+            s_cells[cellKey(cell.coord)].state = CellState::Resident;
+            loaded.push_back(std::move(cell));
+        }
+        s_replan = s_replan || !s_finished.empty();
+        s_finished.clear();
+
+        // Planning walks every cell, skip it while nothing changed.
+        const float moved = std::hypot(cameraPosition[0] - s_lastCamera[0], cameraPosition[2] - s_lastCamera[2]);
+        if (!s_replan && moved < s_cellSize * 0.05f)
+            return;
+        s_replan = false;
+        std::copy(cameraPosition, cameraPosition + 3, s_lastCamera);
+
+        const float keepRadius = s_settings.loadRadius + s_settings.prefetchRadius;
+        // Half a cell of hysteresis so a camera on a boundary does not load and drop the same cell.
+        const float dropRadius = keepRadius + s_cellSize * 0.5f;
+        size_t plannedBytes = s_residentBytes;
+        std::vector<std::pair<float, uint64_t>> wanted;
+        std::vector<std::pair<float, uint64_t>> droppable;
+        for (auto& [key, cell] : s_cells)
+        {
+            cell.distance = distanceToCell(cell.coord, cameraPosition[0], cameraPosition[2]);
+            if (cell.state == CellState::Queued)
+                cell.state = CellState::Unloaded;
+            if (cell.state == CellState::Loading)
+                plannedBytes += cell.residentBytes == 0 ? cell.bytes : 0;
+
+            if (cell.state == CellState::Resident && cell.distance > dropRadius)
+            {
+                cell.state = CellState::Evicting;
+                evict.push_back(cell.coord);
+                plannedBytes -= std::min(plannedBytes, cell.residentBytes);
+            }
+            else if (cell.state == CellState::Resident && cell.distance > s_settings.loadRadius)
+                droppable.push_back({ cell.distance, key });
+            else if (cell.state == CellState::Unloaded && cell.distance <= keepRadius)
+                wanted.push_back({ cell.distance, key });
+        }
+
+        // Over budget: drop prefetched cells, farthest first. Cells inside loadRadius always stay.
+        std::sort(droppable.begin(), droppable.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (const auto& [distance, key] : droppable)
+        {
+            if (plannedBytes <= s_settings.memoryBudget)
+                break;
+            Cell& cell = s_cells[key];
+            cell.state = CellState::Evicting;
+            evict.push_back(cell.coord);
+            plannedBytes -= std::min(plannedBytes, cell.residentBytes);
+        }
+
+        std::sort(wanted.begin(), wanted.end());
+        s_queue.clear();
+        for (const auto& [distance, key] : wanted)
+        {
+            Cell& cell = s_cells[key];
+            if (distance > s_settings.loadRadius && plannedBytes + cell.bytes > s_settings.memoryBudget)
+                continue;
+            cell.state = CellState::Queued;
+            s_queue.push_back(key);
+            plannedBytes += cell.bytes;
+        }
+        const bool work = !s_queue.empty();
+        lock.unlock();
+        if (work)
+            s_wake.notify_one();
+    }
+
+    void unloaded(CellCoord coord)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_cells.find(cellKey(coord));
+        if (it == s_cells.end())
+            return;
+        Cell& cell = it->second;
+        cell.state = CellState::Unloaded;
+        s_residentBytes -= std::min(s_residentBytes, cell.residentBytes);
+        cell.residentBytes = 0;
+        for (const std::string& path : cell.assets)
+        {
+            auto asset = s_assets.find(path);
+            if (asset != s_assets.end() && --asset->second.cells == 0)
+            {
+                s_residentBytes -= std::min(s_residentBytes, asset->second.asset.bytes);
+                s_assets.erase(asset);
+            }
+        }
+        cell.assets.clear();
+        s_replan = true;
+    }
+
+    bool writeCell(CellCoord coord, const SceneSerializer::SceneData& scene, const std::unordered_map<std::string, std::string>& assetPaths)
+    {
+        if (!s_open)
+            return false;
+        const fs::path path = cellFile(s_cellDirectory, coord);
+        if (!SceneSerializer::saveSceneFile(scene, path.string()))
+        {
+            std::cerr << "Failed to write cell " << path.string() << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> types;
+        for (size_t i = 0; i < scene.size(); i++)
+        {
+            s_maxId = std::max(s_maxId, scene[i].id);
+            const std::string type(scene.string(scene[i].type));
+            if (assetPaths.count(type) && std::find(types.begin(), types.end(), type) == types.end())
+                types.push_back(type);
+        }
+        std::error_code error;
+        const size_t bytes = size_t(fs::file_size(path, error));
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        // Only resident cells are written, the loader is not reading this one.
+        for (const std::string& type : types)
+            s_assetPaths.emplace(type, assetPaths.at(type));
+        Cell& cell = s_cells[cellKey(coord)];
+        cell.coord = coord;
+        cell.records = scene.size();
+        cell.bytes = bytes;
+        cell.types = std::move(types);
+        s_indexDirty = true;
+        return true;
+    }
+
+    bool addCell(CellCoord coord)
+    {
+        if (!s_open)
+            return false;
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto [it, inserted] = s_cells.try_emplace(cellKey(coord));
+        if (!inserted)
+            return false;
+        it->second.coord = coord;
+        it->second.state = CellState::Resident;
+        return true;
+    }
+
+    Stats stats()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Stats stats;
+        stats.cellCount = s_cells.size();
+        stats.residentBytes = s_residentBytes;
+        for (const auto& [key, cell] : s_cells)
+        {
+            if (cell.state == CellState::Resident || cell.state == CellState::Evicting)
+                stats.residentCells++;
+            else if (cell.state == CellState::Queued || cell.state == CellState::Loading)
+                stats.loadingCells++;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef SCENE_STREAMER_H
+#define SCENE_STREAMER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "SceneSerializer.h"
+
+// Layouts too large to load at once are split into square grid cells on the XZ plane, each one a
+// .chscene of its own. A background thread loads the cells around the camera, and parses the mesh
+// assets they reference, so the editor only ever holds the loaded subset.
+//
+//   <name>.chstream                  index: cell size, imported asset paths, one line per cell
+//   <name>_cells/<x>_<z>.chscene     the instances whose top-level root lies in that cell
+namespace SceneStreamer
+{
+    struct CellCoord
+    {
+        int32_t x = 0;
+        int32_t z = 0;
+    };
+
+    struct Settings
+    {
+        float loadRadius = 150.0f;     // cells closer than this to the camera are always loaded
+        float prefetchRadius = 100.0f; // ring beyond loadRadius loaded ahead of time while within budget
+        size_t memoryBudget = size_t(512) * 1024 * 1024; // approximate bytes of resident cells and assets
+    };
+
+    // A mesh asset parsed on the loader thread, payload is whatever the AssetLoader returned.
+    // GPU resources are created from it on the main thread.
+    struct Asset
+    {
+        std::shared_ptr<void> payload;
+        size_t bytes = 0;
+    };
+    using AssetLoader = std::function<Asset(const std::string& path)>;
+
+    struct LoadedCell
+    {
+        CellCoord coord;
+        std::unique_ptr<SceneSerializer::SceneData> scene;
+        std::unordered_map<std::string, Asset> assets; // by path, every asset the cell references
+    };
+
+    struct Stats
+    {
+        size_t cellCount = 0;
+        size_t residentCells = 0;
+        size_t loadingCells = 0; // queued or being read
+        size_t residentBytes = 0;
+    };
+
+    // Writes indexPath and its cell directory. Instances go to the cell their top-level root sits
+    // in, children always stay with their root. assetPaths maps imported types to model files
+    // (the imported object map).
+    bool buildStream(const SceneSerializer::SceneData& scene, const std::unordered_map<std::string, std::string>& assetPaths,
+        const std::string& indexPath, float cellSize);
+
+    // Reads the index and starts the loader thread. The loader is called on that thread.
+    bool open(const std::string& indexPath, AssetLoader loader);
+    // Stops the loader and writes the index if cells were written back. Cells still resident in
+    // the editor must be written back (writeCell) before.
+    void close();
+    bool isOpen();
+
+    const std::string& indexPath();
+    const std::unordered_map<std::string, std::string>& assetPaths(); // imported type -> model file
+    int32_t maxInstanceId();
+    float cellSize();
+    CellCoord cellAt(float x, float z);
+
+    void setSettings(const Settings& settings);
+    Settings settings();
+
+    // Main thread, once per frame. Hands over the cells that finished loading and lists the ones
+    // to drop; the caller writes back and removes their instances, then calls unloaded().
+    void update(const float cameraPosition[3], std::vector<LoadedCell>& loaded, std::vector<CellCoord>& evict);
+    void unloaded(CellCoord coord);
+
+    // Saves the edited content of a resident cell. assetPaths resolves imported types the cell
+    // did not reference before.
+    bool writeCell(CellCoord coord, const SceneSerializer::SceneData& scene, const std::unordered_map<std::string, std::string>& assetPaths);
+    // Registers an empty cell, resident from the start, for instances placed where the index has
+    // none. Its file is created by the first writeCell(). False when the cell already exists.
+    bool addCell(CellCoord coord);
+
+    Stats stats();
+}
+
+#endif // SCENE_STREAMER_H
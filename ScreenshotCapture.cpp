@@ -0,0 +1,273 @@
+#include "ScreenshotCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "Logger.h"
+#include "PngEncoder.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct EncodeJob
+    {
+        std::string path;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t pitch = 0;
+        bool yflip = false;
+        std::vector<uint8_t> bgra; // as bgfx read it back, pitch bytes per row
+        Clock::time_point requestedAt;
+        Clock::time_point capturedAt;
+    };
+
+    const size_t MAX_WORKERS = 4;
+
+    std::vector<std::thread> s_workers;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    bool s_stopping = false;
+
+    // Guarded by s_mutex.
+    std::deque<EncodeJob> s_jobs;
+    std::deque<ScreenshotCapture::CapturedImage> s_finished;
+    std::unordered_map<std::string, Clock::time_point> s_requestedAt;
+    ScreenshotCapture::Stats s_stats;
+    size_t s_encoding = 0;
+    double s_totalMsSum = 0.0;
+
+    double msBetween(Clock::time_point from, Clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+
+    // bgfx reads back BGRA8 rows, bottom-up when yflip is set (OpenGL).
+    void toRgba(const EncodeJob& job, std::vector<uint8_t>& rgba)
+    {
+        rgba.resize(size_t(job.width) * job.height * 4);
+        for (uint32_t y = 0; y < job.height; ++y)
+        {
+            const uint32_t srcRow = job.yflip ? job.height - 1 - y : y;
+            const uint8_t* src = job.bgra.data() + size_t(srcRow) * job.pitch;
+            uint8_t* dst = rgba.data() + size_t(y) * job.width * 4;
+            for (uint32_t x = 0; x < job.width; ++x, src += 4, dst += 4)
+            {
+                dst[0] = src[2];
+                dst[1] = src[1];
+                dst[2] = src[0];
+                dst[3] = 255; // the back buffer alpha is whatever the last pass left there
+            }
+        }
+    }
+
+    void encode(EncodeJob& job)
+    {
+        ScreenshotCapture::CapturedImage image;
+        image.path = job.path;
+        image.width = job.width;
+        image.height = job.height;
+        toRgba(job, image.rgba);
+        job.bgra = std::vector<uint8_t>(); // release the read-back copy early
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(job.path).parent_path(), ec);
+        const bool saved = PngEncoder::write(job.path, image.rgba.data(), job.width, job.height, 4, size_t(job.width) * 4,
+            PngEncoder::Level::Fast);
+        const Clock::time_point writtenAt = Clock::now();
+
+        const double readbackMs = msBetween(job.requestedAt, job.capturedAt);
+        const double encodeMs = msBetween(job.capturedAt, writtenAt);
+        const double totalMs = msBetween(job.requestedAt, writtenAt);
+        if (saved)
+        {
+            std::cout << "[Screenshot] Saved " << job.path << " (" << job.width << "x" << job.height << ") in "
+                << totalMs << " ms (readback " << readbackMs << " ms, encode " << encodeMs << " ms)" << std::endl;
+        }
+        else
+        {
+            std::cerr << "[Screenshot] Failed to save .png: " << job.path << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (saved)
+        {
+            s_stats.saved++;
+            s_stats.lastReadbackMs = readbackMs;
+            s_stats.lastEncodeMs = encodeMs;
+            s_stats.lastTotalMs = totalMs;
+            s_stats.maxTotalMs = std::max(s_stats.maxTotalMs, totalMs);
+            s_totalMsSum += totalMs;
+            s_stats.averageTotalMs = s_totalMsSum / s_stats.saved;
+            s_finished.push_back(std::move(image));
+        }
+        else
+        {
+            s_stats.failed++;
+        }
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return !s_jobs.empty() || s_stopping; });
+            if (s_jobs.empty())
+                return; // stopping with nothing left to encode
+
+            EncodeJob job = std::move(s_jobs.front());
+            s_jobs.pop_front();
+            s_encoding++;
+            lock.unlock();
+
+            encode(job);
+
+            lock.lock();
+            s_encoding--;
+        }
+    }
+
+    // Called with s_mutex held.
+    void startWorkers()
+    {
+        if (!s_workers.empty())
+            return;
+        const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+        const size_t count = std::min(hardware - 1, MAX_WORKERS); // leave a core to the editor
+        s_stopping = false;
+        for (size_t i = 0; i < count; ++i)
+            s_workers.emplace_back(workerLoop);
+    }
+
+    // Only screenShot does real work, everything else keeps bgfx's defaults minus the file I/O.
+    class CaptureCallback : public bgfx::CallbackI
+    {
+    public:
+        ~CaptureCallback() override = default;
+
+        void fatal(const char* filePath, uint16_t line, bgfx::Fatal::Enum code, const char* str) override
+        {
+            std::cerr << "[bgfx] Fatal error 0x" << std::hex << int(code) << std::dec << " at " << filePath << "(" << line << "): " << str << std::endl;
+            if (code != bgfx::Fatal::DebugCheck)
+                std::abort();
+        }
+
+        // Any thread. bgfx traces show up in the log console as info (Logger has no debug level);
+        // the line is handed to Logger::Log() in one piece rather than through std::cout.
+        void traceVargs(const char* filePath, uint16_t line, const char* format, va_list args) override
+        {
+            char text[1024];
+            const int prefix = std::snprintf(text, sizeof(text), "[bgfx] %s(%u): ", filePath, unsigned(line));
+            if (prefix < 0 || size_t(prefix) >= sizeof(text))
+                return;
+            std::vsnprintf(text + prefix, sizeof(text) - prefix, format, args);
+            size_t length = std::strlen(text);
+            while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+                length--;
+            Logger::GetInstance().Log(Logger::Level::Info, std::string_view(text, length));
+        }
+
+        void profilerBegin(const char*, uint32_t, const char*, uint16_t) override {}
+        void profilerBeginLiteral(const char*, uint32_t, const char*, uint16_t) override {}
+        void profilerEnd() override {}
+
+        uint32_t cacheReadSize(uint64_t) override { return 0; }
+        bool cacheRead(uint64_t, void*, uint32_t) override { return false; }
+        void cacheWrite(uint64_t, const void*, uint32_t) override {}
+
+        // Called on the render thread with pixels that are only valid for the call: copy and queue.
+        void screenShot(const char* filePath, uint32_t width, uint32_t height, uint32_t pitch, const void* data, uint32_t size, bool yflip) override
+        {
+            EncodeJob job;
+            job.path = filePath;
+            job.width = width;
+            job.height = height;
+            job.pitch = pitch;
+            job.yflip = yflip;
+            job.capturedAt = Clock::now();
+            job.requestedAt = job.capturedAt;
+            job.bgra.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + std::min<size_t>(size, size_t(pitch) * height));
+            job.bgra.resize(size_t(pitch) * height);
+
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                auto requested = s_requestedAt.find(job.path);
+                if (requested != s_requestedAt.end())
+                {
+                    job.requestedAt = requested->second;
+                    s_requestedAt.erase(requested);
+                }
+                s_jobs.push_back(std::move(job));
+                startWorkers();
+            }
+            s_wake.notify_one();
+        }
+
+        void captureBegin(uint32_t, uint32_t, uint32_t, bgfx::TextureFormat::Enum, bool) override {}
+        void captureEnd() override {}
+        void captureFrame(const void*, uint32_t) override {}
+    };
+
+    CaptureCallback s_callback;
+}
+
+namespace ScreenshotCapture
+{
+    bgfx::CallbackI* callback()
+    {
+        return &s_callback;
+    }
+
+    void request(bgfx::FrameBufferHandle fb, const std::string& pngPath)
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_requestedAt[pngPath] = Clock::now();
+        }
+        bgfx::requestScreenShot(fb, pngPath.c_str());
+    }
+
+    bool popFinished(CapturedImage& image)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_finished.empty())
+            return false;
+        image = std::move(s_finished.front());
+        s_finished.pop_front();
+        return true;
+    }
+
+    Stats stats()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        Stats result = s_stats;
+        result.pending = s_jobs.size() + s_encoding;
+        return result;
+    }
+
+    void shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_workers.empty())
+                return;
+            s_stopping = true;
+        }
+        s_wake.notify_all();
+        for (std::thread& worker : s_workers)
+            worker.join();
+        s_workers.clear();
+    }
+}
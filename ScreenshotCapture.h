@@ -0,0 +1,53 @@
+#ifndef SCREENSHOT_CAPTURE_H
+#define SCREENSHOT_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+// Screenshots without going through the filesystem twice. bgfx hands the read-back pixels to
+// our CallbackI::screenShot in memory; they are copied and queued to a small worker pool that
+// converts them to RGBA and encodes the PNG. Finished images come back to the main thread through
+// a queue so the gallery can create its textures there (bgfx calls stay on the API thread).
+namespace ScreenshotCapture
+{
+    // Pass to bgfx::Init::callback. Lives for the whole program.
+    bgfx::CallbackI* callback();
+
+    // Requests a capture of fb (BGFX_INVALID_HANDLE for the back buffer) written to pngPath.
+    // The request time is kept to measure capture-to-disk latency.
+    void request(bgfx::FrameBufferHandle fb, const std::string& pngPath);
+
+    // A screenshot that was written, top row first.
+    struct CapturedImage
+    {
+        std::string path;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    // Main thread, returns false when nothing finished since the last call.
+    bool popFinished(CapturedImage& image);
+
+    struct Stats
+    {
+        uint32_t saved = 0;
+        uint32_t failed = 0;
+        size_t pending = 0;           // read back but not on disk yet
+        double lastReadbackMs = 0.0;  // request -> pixels in the callback
+        double lastEncodeMs = 0.0;    // callback -> PNG on disk
+        double lastTotalMs = 0.0;     // request -> PNG on disk
+        double averageTotalMs = 0.0;
+        double maxTotalMs = 0.0;
+    };
+    Stats stats();
+
+    // Finishes the queued encodes and stops the workers.
+    void shutdown();
+}
+
+#endif // SCREENSHOT_CAPTURE_H
@@ -0,0 +1,565 @@
+#include "SequenceExporter.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "PngEncoder.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+    const size_t MAX_QUEUED_FRAMES = 8; // read back but not encoded, bounds memory
+
+    enum class SlotState
+    {
+        Free,
+        Submitted, // drawn this frame, readback requested in submitReadback
+        Pending,   // waiting for bgfx to deliver the pixels
+    };
+
+    struct Slot
+    {
+        bgfx::FrameBufferHandle target = BGFX_INVALID_HANDLE;
+        bgfx::TextureHandle color = BGFX_INVALID_HANDLE;
+        bgfx::TextureHandle readback = BGFX_INVALID_HANDLE;
+        std::vector<uint8_t> pixels;
+        uint32_t readyFrame = 0;
+        SlotState state = SlotState::Free;
+    };
+
+    struct EncodedFrame
+    {
+        uint32_t index = 0;
+        std::vector<uint8_t> rgba; // top row first
+    };
+
+    // Main thread state.
+    bool s_active = false;
+    bool s_stopRendering = false;
+    SequenceExporter::Settings s_settings;
+    std::string s_path;
+    uint32_t s_frameCount = 0;
+    uint32_t s_nextFrame = 0;    // next frame to render
+    uint32_t s_nextCollect = 0;  // next frame to hand to the encoder
+    uint32_t s_submittedSlot = 0;
+    std::vector<Slot> s_slots;
+    Camera s_startCamera;
+    std::vector<Camera> s_pathCameras;
+    bx::Vec3 s_pivot = { 0.0f, 0.0f, 0.0f };
+    Clock::time_point s_startedAt;
+
+    // Encoder thread, guarded by s_mutex.
+    std::thread s_encoderThread;
+    std::mutex s_mutex;
+    std::condition_variable s_wake;
+    std::deque<EncodedFrame> s_queue;
+    std::vector<std::vector<uint8_t>> s_freeBuffers; // recycled frame buffers
+    bool s_lastFrameQueued = false;
+    bool s_encoderFinished = false;
+    bool s_encoderFailed = false;
+    uint32_t s_encoded = 0;
+
+    // FFmpeg state, encoder thread only.
+    AVFormatContext* s_formatCtx = nullptr;
+    AVCodecContext* s_codecCtx = nullptr;
+    AVStream* s_stream = nullptr;
+    AVFrame* s_frame = nullptr;
+    AVPacket* s_packet = nullptr;
+    SwsContext* s_swsCtx = nullptr;
+
+    // --- camera motion ---
+
+    void orientCamera(Camera& camera, const bx::Vec3& front)
+    {
+        camera.front = bx::normalize(front);
+        camera.right = bx::normalize(bx::cross(camera.front, bx::Vec3(0.0f, 1.0f, 0.0f)));
+        camera.up = bx::normalize(bx::cross(camera.right, camera.front));
+        camera.yaw = bx::toDeg(std::atan2(camera.front.z, camera.front.x));
+        camera.pitch = bx::toDeg(std::asin(std::clamp(camera.front.y, -1.0f, 1.0f)));
+    }
+
+    bx::Vec3 rotateY(const bx::Vec3& v, float angle)
+    {
+        const float c = std::cos(angle);
+        const float s = std::sin(angle);
+        return bx::Vec3(v.x * c - v.z * s, v.y, v.x * s + v.z * c);
+    }
+
+    bx::Vec3 catmullRom(const bx::Vec3& p0, const bx::Vec3& p1, const bx::Vec3& p2, const bx::Vec3& p3, float t)
+    {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+        auto axis = [&](float a, float b, float c, float d) {
+            return 0.5f * (2.0f * b + (c - a) * t + (2.0f * a - 5.0f * b + 4.0f * c - d) * t2 + (3.0f * b - a - 3.0f * c + d) * t3);
+        };
+        return bx::Vec3(axis(p0.x, p1.x, p2.x, p3.x), axis(p0.y, p1.y, p2.y, p3.y), axis(p0.z, p1.z, p2.z, p3.z));
+    }
+
+    Camera cameraAt(uint32_t frame)
+    {
+        Camera camera = s_startCamera;
+        const float t = s_frameCount > 1 ? float(frame) / float(s_frameCount - 1) : 0.0f;
+        if (s_settings.motion == SequenceExporter::CameraMotion::Turntable)
+        {
+            // Stops one step short of the end, so a whole-revolution turntable loops without a repeated frame.
+            const float turn = s_frameCount > 0 ? float(frame) / float(s_frameCount) : 0.0f;
+            // A rigid orbit keeps the framing the camera had at the start.
+            const float angle = turn * s_settings.turntableRevolutions * 2.0f * bx::kPi;
+            camera.position = bx::add(s_pivot, rotateY(bx::sub(s_startCamera.position, s_pivot), angle));
+            orientCamera(camera, rotateY(s_startCamera.front, angle));
+        }
+        else if (s_settings.motion == SequenceExporter::CameraMotion::CameraPath && s_pathCameras.size() >= 2)
+        {
+            const int last = int(s_pathCameras.size()) - 1;
+            const float segment = t * float(last);
+            const int i = std::min(int(segment), last - 1);
+            const float local = segment - float(i);
+            const Camera& a = s_pathCameras[i];
+            const Camera& b = s_pathCameras[i + 1];
+            const Camera& before = s_pathCameras[std::max(i - 1, 0)];
+            const Camera& after = s_pathCameras[std::min(i + 2, last)];
+            camera = a;
+            camera.position = catmullRom(before.position, a.position, b.position, after.position, local);
+            orientCamera(camera, bx::lerp(a.front, b.front, local));
+            camera.fov = a.fov + (b.fov - a.fov) * local;
+        }
+        return camera;
+    }
+
+    // --- encoder thread ---
+
+    void closeMovie()
+    {
+        if (s_formatCtx && s_formatCtx->pb)
+            avio_closep(&s_formatCtx->pb);
+        avformat_free_context(s_formatCtx);
+        avcodec_free_context(&s_codecCtx);
+        av_frame_free(&s_frame);
+        av_packet_free(&s_packet);
+        sws_freeContext(s_swsCtx);
+        s_formatCtx = nullptr;
+        s_stream = nullptr;
+        s_swsCtx = nullptr;
+    }
+
+    bool openMovie(const std::string& path, uint32_t width, uint32_t height, uint32_t fps, bool proRes)
+    {
+        if (avformat_alloc_output_context2(&s_formatCtx, nullptr, nullptr, path.c_str()) < 0 || !s_formatCtx)
+            return false;
+
+        const AVCodec* codec = proRes ? avcodec_find_encoder_by_name("prores_ks") : avcodec_find_encoder_by_name("libx264");
+        if (!codec)
+            codec = avcodec_find_encoder(proRes ? AV_CODEC_ID_PRORES : AV_CODEC_ID_H264);
+        if (!codec)
+        {
+            std::cerr << "[Export] FFmpeg has no " << (proRes ? "ProRes" : "H.264") << " encoder" << std::endl;
+            return false;
+        }
+
+        s_stream = avformat_new_stream(s_formatCtx, nullptr);
+        s_codecCtx = avcodec_alloc_context3(codec);
+        if (!s_stream || !s_codecCtx)
+            return false;
+        s_codecCtx->width = int(width);
+        s_codecCtx->height = int(height);
+        s_codecCtx->time_base = AVRational{ 1, int(fps) };
+        s_codecCtx->framerate = AVRational{ int(fps), 1 };
+        s_codecCtx->gop_size = int(fps);
+        s_codecCtx->pix_fmt = proRes ? AV_PIX_FMT_YUV422P10LE : AV_PIX_FMT_YUV420P;
+        if (proRes)
+            s_codecCtx->profile = 3; // 422 HQ
+        else
+        {
+            av_opt_set(s_codecCtx->priv_data, "preset", "medium", 0);
+            av_opt_set(s_codecCtx->priv_data, "crf", "18", 0); // hatching needs a high bitrate to keep its lines
+        }
+        if (s_formatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+            s_codecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+        if (avcodec_open2(s_codecCtx, codec, nullptr) < 0)
+            return false;
+        avcodec_parameters_from_context(s_stream->codecpar, s_codecCtx);
+        s_stream->time_base = s_codecCtx->time_base;
+
+        if (!(s_formatCtx->oformat->flags & AVFMT_NOFILE) && avio_open(&s_formatCtx->pb, path.c_str(), AVIO_FLAG_WRITE) < 0)
+            return false;
+        if (avformat_write_header(s_formatCtx, nullptr) < 0)
+            return false;
+
+        s_frame = av_frame_alloc();
+        s_packet = av_packet_alloc();
+        if (!s_frame || !s_packet)
+            return false;
+        s_frame->format = s_codecCtx->pix_fmt;
+        s_frame->width = s_codecCtx->width;
+        s_frame->height = s_codecCtx->height;
+        if (av_frame_get_buffer(s_frame, 0) < 0)
+            return false;
+
+        s_swsCtx = sws_getContext(int(width), int(height), AV_PIX_FMT_RGBA, int(width), int(height), s_codecCtx->pix_fmt,
+            SWS_BICUBIC, nullptr, nullptr, nullptr);
+        return s_swsCtx != nullptr;
+    }
+
+    // Sends frame (nullptr flushes) and writes every packet the encoder has ready.
+    bool encodeMovieFrame(AVFrame* frame)
+    {
+        if (avcodec_send_frame(s_codecCtx, frame) < 0)
+            return false;
+        for (;;)
+        {
+            const int result = avcodec_receive_packet(s_codecCtx, s_packet);
+            if (result == AVERROR(EAGAIN) || result == AVERROR_EOF)
+                return true;
+            if (result < 0)
+                return false;
+            av_packet_rescale_ts(s_packet, s_codecCtx->time_base, s_stream->time_base);
+            s_packet->stream_index = s_stream->index;
+            const int written = av_interleaved_write_frame(s_formatCtx, s_packet);
+            av_packet_unref(s_packet);
+            if (written < 0)
+                return false;
+        }
+    }
+
+    bool encodeFrame(const EncodedFrame& frame, const SequenceExporter::Settings& settings, const std::string& path)
+    {
+        if (settings.format == SequenceExporter::Format::PngSequence)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), "frame_%05u.png", frame.index);
+            const std::string framePath = (std::filesystem::path(path) / name).string();
+            return PngEncoder::write(framePath, frame.rgba.data(), settings.width, settings.height, 4, size_t(settings.width) * 4,
+                PngEncoder::Level::High);
+        }
+
+        if (av_frame_make_writable(s_frame) < 0)
+            return false;
+        const uint8_t* src[1] = { frame.rgba.data() };
+        const int srcStride[1] = { int(settings.width) * 4 };
+        sws_scale(s_swsCtx, src, srcStride, 0, int(settings.height), s_frame->data, s_frame->linesize);
+        s_frame->pts = frame.index;
+        return encodeMovieFrame(s_frame);
+    }
+
+    void encoderLoop(SequenceExporter::Settings settings, std::string path)
+    {
+        bool ok = true;
+        if (settings.format == SequenceExporter::Format::PngSequence)
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(path, ec);
+            ok = !ec;
+        }
+        else
+        {
+            ok = openMovie(path, settings.width, settings.height, settings.fps, settings.format == SequenceExporter::Format::ProRes);
+        }
+        if (!ok)
+            std::cerr << "[Export] Failed to open " << path << std::endl;
+
+        std::unique_lock<std::mutex> lock(s_mutex);
+        for (;;)
+        {
+            s_wake.wait(lock, [] { return !s_queue.empty() || s_lastFrameQueued; });
+            if (s_queue.empty())
+                break;
+            EncodedFrame frame = std::move(s_queue.front());
+            s_queue.pop_front();
+            lock.unlock();
+
+            // After a failure the frames are only drained, the main thread stops on s_encoderFailed.
+            if (ok)
+                ok = encodeFrame(frame, settings, path);
+
+            lock.lock();
+            s_freeBuffers.push_back(std::move(frame.rgba));
+            if (ok)
+                s_encoded++;
+            else
+                s_encoderFailed = true;
+        }
+        lock.unlock();
+
+        if (settings.format != SequenceExporter::Format::PngSequence)
+        {
+            if (ok)
+                ok = encodeMovieFrame(nullptr) && av_write_trailer(s_formatCtx) == 0;
+            closeMovie();
+        }
+
+        lock.lock();
+        s_encoderFailed = s_encoderFailed || !ok;
+        s_encoderFinished = true;
+    }
+
+    // --- main thread ---
+
+    void destroySlots()
+    {
+        for (Slot& slot : s_slots)
+        {
+            if (bgfx::isValid(slot.target))
+                bgfx::destroy(slot.target); // also destroys the attachments
+            if (bgfx::isValid(slot.readback))
+                bgfx::destroy(slot.readback);
+        }
+        s_slots.clear();
+    }
+
+    void stopEncoder()
+    {
+        if (!s_encoderThread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_lastFrameQueued = true;
+        }
+        s_wake.notify_all();
+        s_encoderThread.join();
+    }
+
+    void finish()
+    {
+        stopEncoder();
+        destroySlots();
+        s_active = false;
+
+        const SequenceExporter::Stats result = SequenceExporter::stats();
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_encoderFailed)
+            std::cerr << "[Export] Failed writing " << s_path << " after " << s_encoded << " frames" << std::endl;
+        else
+            std::cout << "[Export] Wrote " << s_encoded << "/" << s_frameCount << " frames to " << s_path << " in "
+                << result.elapsedSeconds << " s (" << result.sustainedFps << " fps sustained, rendering " << result.renderFps << " fps)" << std::endl;
+        s_freeBuffers.clear();
+    }
+
+    // Moves a delivered readback to the encoder queue, flipping bottom-up renderers.
+    bool collect(Slot& slot, uint32_t index)
+    {
+        EncodedFrame frame;
+        frame.index = index;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (s_queue.size() >= MAX_QUEUED_FRAMES)
+                return false;
+            if (!s_freeBuffers.empty())
+            {
+                frame.rgba = std::move(s_freeBuffers.back());
+                s_freeBuffers.pop_back();
+            }
+        }
+
+        const size_t rowBytes = size_t(s_settings.width) * 4;
+        frame.rgba.resize(rowBytes * s_settings.height);
+        const bool bottomUp = bgfx::getCaps()->originBottomLeft;
+        for (uint32_t y = 0; y < s_settings.height; ++y)
+        {
+            const uint32_t srcRow = bottomUp ? s_settings.height - 1 - y : y;
+            uint8_t* row = frame.rgba.data() + y * rowBytes;
+            std::memcpy(row, slot.pixels.data() + srcRow * rowBytes, rowBytes);
+            // The text pass writes alpha with blending, PNG frames would show glyph halos.
+            for (size_t x = 3; x < rowBytes; x += 4)
+                row[x] = 255;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_queue.push_back(std::move(frame));
+        }
+        s_wake.notify_one();
+        return true;
+    }
+}
+
+namespace SequenceExporter
+{
+    bool start(const std::string& path, const Settings& settings, const Camera& camera,
+        const std::vector<Camera>& pathCameras, const float pivot[3])
+    {
+        if (s_active)
+            cancel();
+        const bgfx::Caps* caps = bgfx::getCaps();
+        if ((caps->supported & (BGFX_CAPS_TEXTURE_BLIT | BGFX_CAPS_TEXTURE_READ_BACK)) != (BGFX_CAPS_TEXTURE_BLIT | BGFX_CAPS_TEXTURE_READ_BACK))
+        {
+            std::cerr << "[Export] The renderer cannot read textures back" << std::endl;
+            return false;
+        }
+
+        s_settings = settings;
+        // 4:2:0 needs even sizes.
+        s_settings.width = std::clamp<uint32_t>(settings.width & ~1u, 16, caps->limits.maxTextureSize);
+        s_settings.height = std::clamp<uint32_t>(settings.height & ~1u, 16, caps->limits.maxTextureSize);
+        s_settings.fps = std::clamp<uint32_t>(settings.fps, 1, 240);
+        s_settings.framesInFlight = std::clamp<uint32_t>(settings.framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+        s_frameCount = std::max<uint32_t>(1, uint32_t(std::lround(settings.durationSeconds * float(s_settings.fps))));
+        s_path = path;
+        s_startCamera = camera;
+        s_pathCameras = pathCameras;
+        s_pivot = bx::Vec3(pivot[0], pivot[1], pivot[2]);
+        s_nextFrame = 0;
+        s_nextCollect = 0;
+        s_stopRendering = false;
+
+        s_slots.resize(s_settings.framesInFlight);
+        for (Slot& slot : s_slots)
+        {
+            bgfx::TextureHandle attachments[2];
+            attachments[0] = bgfx::createTexture2D(uint16_t(s_settings.width), uint16_t(s_settings.height), false, 1, bgfx::TextureFormat::RGBA8,
+                BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+            attachments[1] = bgfx::createTexture2D(uint16_t(s_settings.width), uint16_t(s_settings.height), false, 1, bgfx::TextureFormat::D24S8,
+                BGFX_TEXTURE_RT_WRITE_ONLY);
+            slot.target = bgfx::createFrameBuffer(2, attachments, true);
+            slot.color = attachments[0];
+            slot.readback = bgfx::createTexture2D(uint16_t(s_settings.width), uint16_t(s_settings.height), false, 1, bgfx::TextureFormat::RGBA8,
+                BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK);
+            slot.pixels.resize(size_t(s_settings.width) * s_settings.height * 4);
+            slot.state = SlotState::Free;
+            if (!bgfx::isValid(slot.target) || !bgfx::isValid(slot.readback))
+            {
+                std::cerr << "[Export] Failed to create the render targets" << std::endl;
+                destroySlots();
+                return false;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_queue.clear();
+            s_lastFrameQueued = false;
+            s_encoderFinished = false;
+            s_encoderFailed = false;
+            s_encoded = 0;
+        }
+        s_encoderThread = std::thread(encoderLoop, s_settings, path);
+        s_active = true;
+        s_startedAt = Clock::now();
+        std::cout << "[Export] Rendering " << s_frameCount << " frames at " << s_settings.width << "x" << s_settings.height
+            << ", " << s_settings.fps << " fps, " << s_settings.framesInFlight << " in flight, to " << path << std::endl;
+        return true;
+    }
+
+    void cancel()
+    {
+        if (!s_active)
+            return;
+        s_stopRendering = true;
+        // Frames already drawn are still collected by update(), then the file is finalized.
+        s_frameCount = s_nextFrame;
+    }
+
+    bool isActive()
+    {
+        return s_active;
+    }
+
+    Stats stats()
+    {
+        Stats result;
+        result.active = s_active;
+        result.path = s_path;
+        result.frameCount = s_frameCount;
+        result.rendered = s_nextFrame;
+        result.elapsedSeconds = std::chrono::duration<double>(Clock::now() - s_startedAt).count();
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            result.encoded = s_encoded;
+            result.queued = s_queue.size();
+        }
+        if (result.elapsedSeconds > 0.0)
+        {
+            result.renderFps = result.rendered / result.elapsedSeconds;
+            result.sustainedFps = result.encoded / result.elapsedSeconds;
+        }
+        return result;
+    }
+
+    bool beginFrame(bgfx::FrameBufferHandle& target, uint16_t& width, uint16_t& height, Camera& camera, float& deltaTime)
+    {
+        deltaTime = 0.0f;
+        if (!s_active || s_stopRendering || s_nextFrame >= s_frameCount)
+            return false;
+        Slot& slot = s_slots[s_nextFrame % s_slots.size()];
+        if (slot.state != SlotState::Free)
+            return false; // every target is waiting for its readback
+
+        target = slot.target;
+        width = uint16_t(s_settings.width);
+        height = uint16_t(s_settings.height);
+        camera = cameraAt(s_nextFrame);
+        // The first frame shows the scene as it is, later ones one step further each.
+        deltaTime = s_nextFrame == 0 ? 0.0f : 1.0f / float(s_settings.fps);
+        slot.state = SlotState::Submitted;
+        s_submittedSlot = s_nextFrame % uint32_t(s_slots.size());
+        s_nextFrame++;
+        return true;
+    }
+
+    void submitReadback(bgfx::ViewId view)
+    {
+        if (!s_active || s_slots.empty())
+            return;
+        Slot& slot = s_slots[s_submittedSlot];
+        if (slot.state != SlotState::Submitted)
+            return;
+        bgfx::blit(view, slot.readback, 0, 0, slot.color);
+        slot.readyFrame = bgfx::readTexture(slot.readback, slot.pixels.data());
+        slot.state = SlotState::Pending;
+    }
+
+    void update(uint32_t frameNumber)
+    {
+        if (!s_active)
+            return;
+        // Readbacks complete in submission order, hand them over in that order.
+        while (s_nextCollect < s_nextFrame)
+        {
+            Slot& slot = s_slots[s_nextCollect % s_slots.size()];
+            if (slot.state != SlotState::Pending || frameNumber < slot.readyFrame)
+                break;
+            if (!collect(slot, s_nextCollect))
+                break; // encoder queue full, the slot stays busy and rendering waits
+            slot.state = SlotState::Free;
+            s_nextCollect++;
+        }
+
+        bool failed = false;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            failed = s_encoderFailed;
+        }
+        if (failed)
+            cancel();
+        if (s_nextCollect >= s_frameCount)
+            finish();
+    }
+
+    void shutdown()
+    {
+        if (!s_active)
+            return;
+        cancel();
+        // Readbacks still pending are dropped, the frames already queued are encoded.
+        s_frameCount = s_nextCollect;
+        finish();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef SEQUENCE_EXPORTER_H
+#define SEQUENCE_EXPORTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include "Camera.h"
+
+// Offline animation export. Simulation time advances by exactly 1 / fps per exported frame, no
+// matter how long a frame takes. Frames render into a ring of offscreen targets and are read
+// back asynchronously, several in flight, while an encoder thread turns the finished ones into a
+// PNG sequence or an H.264 / ProRes movie through FFmpeg.
+namespace SequenceExporter
+{
+    enum class Format
+    {
+        PngSequence, // <path>/frame_00000.png ...
+        H264,        // .mp4, yuv420p
+        ProRes,      // .mov, ProRes 422 HQ
+    };
+
+    enum class CameraMotion
+    {
+        Fixed,       // the camera as it was when the export started
+        Turntable,   // orbits the pivot around the world Y axis
+        CameraPath,  // passes through the editor cameras in order
+    };
+
+    struct Settings
+    {
+        Format format = Format::H264;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        uint32_t fps = 30;
+        float durationSeconds = 10.0f;
+        CameraMotion motion = CameraMotion::Turntable;
+        float turntableRevolutions = 1.0f;
+        uint32_t framesInFlight = 3; // offscreen targets waiting for their readback
+    };
+
+    struct Stats
+    {
+        bool active = false;
+        std::string path;
+        uint32_t frameCount = 0;
+        uint32_t rendered = 0;
+        uint32_t encoded = 0;
+        size_t queued = 0;             // read back, waiting for the encoder
+        double elapsedSeconds = 0.0;
+        double renderFps = 0.0;
+        double sustainedFps = 0.0;     // encoded frames over wall time, the pipeline's throughput
+    };
+
+    // camera is the starting camera, pathCameras the keyframes for CameraMotion::CameraPath and
+    // pivot the turntable centre.
+    bool start(const std::string& path, const Settings& settings, const Camera& camera,
+        const std::vector<Camera>& pathCameras, const float pivot[3]);
+    // Stops rendering; what was already rendered is still encoded and the file finalized.
+    void cancel();
+    bool isActive();
+    Stats stats();
+
+    // Main loop, before the scene views are set up. Returns true when this frame renders an
+    // export frame into target with the returned camera; deltaTime is then the fixed step,
+    // otherwise (waiting for a free target) it is 0 so the simulation holds still.
+    bool beginFrame(bgfx::FrameBufferHandle& target, uint16_t& width, uint16_t& height, Camera& camera, float& deltaTime);
+    // After the scene views of an export frame. view must come after them.
+    void submitReadback(bgfx::ViewId view);
+    // After bgfx::frame(), with its return value.
+    void update(uint32_t frameNumber);
+
+    void shutdown();
+}
+
+#endif // SEQUENCE_EXPORTER_H
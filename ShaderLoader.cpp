@@ -0,0 +1,85 @@
+#include "ShaderLoader.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct QuadVertex
+    {
+        float x, y, z;
+        float u, v;
+    };
+
+    // Contents of every shader file read so far, by path. A few KB each, and shared vertex
+    // shaders such as v_text.bin are requested by several modules.
+    std::unordered_map<std::string, std::vector<char>> s_binaries;
+
+    const std::vector<char>* readBinary(const char* shaderPath)
+    {
+        auto it = s_binaries.find(shaderPath);
+        if (it != s_binaries.end())
+            return &it->second;
+
+        std::ifstream file(shaderPath, std::ios::binary | std::ios::ate);
+        if (!file)
+            return nullptr;
+        std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(buffer.data(), buffer.size());
+        if (!file)
+            return nullptr;
+        return &s_binaries.emplace(shaderPath, std::move(buffer)).first->second;
+    }
+}
+
+namespace ShaderLoader
+{
+    bgfx::ShaderHandle loadShader(const char* shaderPath)
+    {
+        const std::vector<char>* binary = readBinary(shaderPath);
+        if (!binary)
+        {
+            std::cerr << "Failed to load shader: " << shaderPath << std::endl;
+            return BGFX_INVALID_HANDLE;
+        }
+        return bgfx::createShader(bgfx::copy(binary->data(), static_cast<uint32_t>(binary->size())));
+    }
+
+    bgfx::ProgramHandle loadProgram(const char* vsPath, const char* fsPath)
+    {
+        bgfx::ShaderHandle vsh = loadShader(vsPath);
+        bgfx::ShaderHandle fsh = loadShader(fsPath);
+        if (!bgfx::isValid(vsh) || !bgfx::isValid(fsh))
+        {
+            if (bgfx::isValid(vsh)) bgfx::destroy(vsh);
+            if (bgfx::isValid(fsh)) bgfx::destroy(fsh);
+            return BGFX_INVALID_HANDLE;
+        }
+        return bgfx::createProgram(vsh, fsh, true);
+    }
+
+    void createFullscreenQuad(bgfx::VertexBufferHandle& vbh, bgfx::IndexBufferHandle& ibh)
+    {
+        const float vTop = bgfx::getCaps()->originBottomLeft ? 1.0f : 0.0f;
+        const float vBottom = 1.0f - vTop;
+        const QuadVertex quadVertices[4] = {
+            { -1.0f,  1.0f, 0.0f, 0.0f, vTop },
+            {  1.0f,  1.0f, 0.0f, 1.0f, vTop },
+            { -1.0f, -1.0f, 0.0f, 0.0f, vBottom },
+            {  1.0f, -1.0f, 0.0f, 1.0f, vBottom },
+        };
+        static const uint16_t quadIndices[] = { 0, 2, 1, 1, 2, 3 };
+
+        bgfx::VertexLayout layout;
+        layout.begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+            .end();
+        vbh = bgfx::createVertexBuffer(bgfx::copy(quadVertices, sizeof(quadVertices)), layout);
+        ibh = bgfx::createIndexBuffer(bgfx::makeRef(quadIndices, sizeof(quadIndices)));
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef SHADER_LOADER_H
+#define SHADER_LOADER_H
+
+#include <bgfx/bgfx.h>
+
+// Compiled shader loading and the fullscreen quad, shared by the editor and the render modules.
+namespace ShaderLoader
+{
+    // Shader from a compiled .bin, or BGFX_INVALID_HANDLE when the file cannot be read. Each file
+    // is read from disk once; bgfx hands out the existing shader (with a reference added) for a
+    // binary it already knows, so the caller owns the handle either way.
+    bgfx::ShaderHandle loadShader(const char* shaderPath);
+
+    // Program owning both shaders, or BGFX_INVALID_HANDLE (and neither shader kept) when one fails.
+    bgfx::ProgramHandle loadProgram(const char* vsPath, const char* fsPath);
+
+    // Clip space quad (position, texcoord0) covering the target; v follows the render target
+    // origin of the backend. Both buffers are owned by the caller.
+    void createFullscreenQuad(bgfx::VertexBufferHandle& vbh, bgfx::IndexBufferHandle& ibh);
+}
+
+#endif // SHADER_LOADER_H
@@ -2,13 +2,18 @@
 #include "stb_truetype.h"
 #include "TextRenderer.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
-#include <windows.h> 
-#include <filesystem> 
+#include <windows.h>
+#include <filesystem>
 #include <string>
 
 std::string getExecutableDir()
@@ -23,24 +28,212 @@ std::string getExecutableDir()
 }
 
 // Helper: load entire file into memory.
-static unsigned char* loadFile(const char* fileName, int* size)
+static bool loadFile(const char* fileName, std::vector<unsigned char>& buffer)
 {
     FILE* fp = fopen(fileName, "rb");
     if (!fp) {
         std::cerr << "Failed to open file: " << fileName << std::endl;
-        return nullptr;
+        return false;
     }
     fseek(fp, 0, SEEK_END);
-    *size = ftell(fp);
+    long size = ftell(fp);
     fseek(fp, 0, SEEK_SET);
-    unsigned char* buffer = (unsigned char*)malloc(*size);
-    if (!buffer) {
-        fclose(fp);
+    buffer.resize(size > 0 ? size_t(size) : 0);
+    size_t read = fread(buffer.data(), 1, buffer.size(), fp);
+    fclose(fp);
+    return size > 0 && read == buffer.size();
+}
+
+namespace
+{
+    const int ATLAS_WIDTH = 1024;
+    const int MAX_ATLAS_HEIGHT = 4096;
+
+    struct FontFile
+    {
+        bool loaded = false;
+        std::vector<unsigned char> data;
+        stbtt_fontinfo info; // points into data
+        std::map<int, std::unique_ptr<BakedFont>> sizes;
+    };
+
+    std::unordered_map<std::string, FontFile> s_fonts;
+
+    FontFile* fontFile(const std::string& fontPath)
+    {
+        auto it = s_fonts.find(fontPath);
+        if (it == s_fonts.end())
+        {
+            // A missing file is remembered too, so it is not retried on every edit.
+            it = s_fonts.emplace(fontPath, FontFile()).first;
+            FontFile& font = it->second;
+            font.loaded = loadFile(fontPath.c_str(), font.data) &&
+                stbtt_InitFont(&font.info, font.data.data(), stbtt_GetFontOffsetForIndex(font.data.data(), 0)) != 0;
+            if (!font.loaded)
+                std::cerr << "[FontManager] Could not load font file " << fontPath << std::endl;
+        }
+        return it->second.loaded ? &it->second : nullptr;
+    }
+
+    // Bakes ASCII 32..127, doubling the atlas height until every glyph fits.
+    std::unique_ptr<BakedFont> bake(const FontFile& font, int pixelSize)
+    {
+        auto baked = std::make_unique<BakedFont>();
+        baked->pixelSize = pixelSize;
+        baked->atlasWidth = ATLAS_WIDTH;
+        stbtt_bakedchar cdata[96];
+        for (int height = 64; height <= MAX_ATLAS_HEIGHT; height *= 2)
+        {
+            baked->atlasHeight = height;
+            baked->atlas.assign(size_t(ATLAS_WIDTH) * height, 0);
+            if (stbtt_BakeFontBitmap(font.data.data(), 0, float(pixelSize), baked->atlas.data(), ATLAS_WIDTH, height, 32, 96, cdata) > 0)
+            {
+                for (int i = 0; i < 96; ++i)
+                {
+                    baked->glyphs[i] = { cdata[i].x0, cdata[i].y0, cdata[i].x1, cdata[i].y1,
+                        cdata[i].xoff, cdata[i].yoff, cdata[i].xadvance };
+                }
+                return baked;
+            }
+        }
         return nullptr;
     }
-    fread(buffer, 1, *size, fp);
-    fclose(fp);
-    return buffer;
+
+    // Shared SDF atlas state, see SdfText.
+    const int SDF_ATLAS_SIZE = 1024;
+    const float SDF_PIXEL_HEIGHT = 48.0f;    // glyph size in the atlas
+    const int SDF_PADDING = 6;               // field pixels around each glyph
+    const unsigned char SDF_ON_EDGE = 128;   // 0.5 in the shader
+    const float SDF_DISTANCE_SCALE = 128.0f / SDF_PADDING;
+    const float LAYOUT_PIXEL_HEIGHT = 64.0f; // same as createTextTexture
+    const float PIXELS_PER_UNIT = 256.0f;    // 1024 x 256 texture on the 4 x 1 text quad
+    const float QUAD_HALF_WIDTH = 2.0f;
+    const float QUAD_HALF_HEIGHT = 0.5f;
+    const uint32_t MAX_GLYPHS = 16384;       // 4 vertices each, 16-bit indices
+    const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+
+    struct TextVertex
+    {
+        float x, y, z;
+        float u, v;
+    };
+
+    struct SdfGlyph
+    {
+        uint16_t x = 0, y = 0, width = 0, height = 0; // in the atlas, 0 x 0 for blank glyphs
+        float xoff = 0.0f, yoff = 0.0f;               // bitmap offset from the pen, atlas pixels
+        float advance = 0.0f;                         // layout pixels
+    };
+
+    bool s_sdfInitialized = false;
+    bgfx::TextureHandle s_sdfAtlas = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle s_quadIndices = BGFX_INVALID_HANDLE;
+    bgfx::VertexLayout s_textLayout;
+    std::unordered_map<uint32_t, SdfGlyph> s_sdfGlyphs;
+    // Shelf packing: glyphs fill rows left to right, a new shelf starts below the tallest one.
+    int s_shelfX = 0, s_shelfY = 0, s_shelfHeight = 0;
+    bool s_atlasFullReported = false;
+
+    // Decodes the code point at s[i] and advances i. Malformed bytes come out as U+FFFD, one
+    // byte at a time, so broken input never swallows the text after it.
+    uint32_t nextCodepoint(const std::string& s, size_t& i)
+    {
+        const unsigned char lead = (unsigned char)s[i++];
+        if (lead < 0x80)
+            return lead;
+        int length = 0;
+        uint32_t codepoint = 0;
+        if ((lead & 0xE0) == 0xC0) { length = 1; codepoint = lead & 0x1F; }
+        else if ((lead & 0xF0) == 0xE0) { length = 2; codepoint = lead & 0x0F; }
+        else if ((lead & 0xF8) == 0xF0) { length = 3; codepoint = lead & 0x07; }
+        else return REPLACEMENT_CHARACTER;
+        if (i + length > s.size())
+            return REPLACEMENT_CHARACTER;
+        for (int k = 0; k < length; ++k)
+        {
+            const unsigned char next = (unsigned char)s[i + k];
+            if ((next & 0xC0) != 0x80)
+                return REPLACEMENT_CHARACTER;
+            codepoint = (codepoint << 6) | (next & 0x3F);
+        }
+        // Overlong forms, surrogates and values past U+10FFFF are not valid UTF-8.
+        static const uint32_t minimum[4] = { 0, 0x80, 0x800, 0x10000 };
+        if (codepoint < minimum[length] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+            return REPLACEMENT_CHARACTER;
+        i += length;
+        return codepoint;
+    }
+
+    // Renders the glyph into the atlas on first use. nullptr when the atlas is full.
+    const SdfGlyph* sdfGlyph(FontFile& font, uint32_t codepoint)
+    {
+        auto it = s_sdfGlyphs.find(codepoint);
+        if (it != s_sdfGlyphs.end())
+            return &it->second;
+
+        SdfGlyph glyph;
+        int advance = 0, leftSideBearing = 0;
+        stbtt_GetCodepointHMetrics(&font.info, int(codepoint), &advance, &leftSideBearing);
+        glyph.advance = advance * stbtt_ScaleForPixelHeight(&font.info, LAYOUT_PIXEL_HEIGHT);
+
+        int width = 0, height = 0, xoff = 0, yoff = 0;
+        unsigned char* field = stbtt_GetCodepointSDF(&font.info, stbtt_ScaleForPixelHeight(&font.info, SDF_PIXEL_HEIGHT), int(codepoint),
+            SDF_PADDING, SDF_ON_EDGE, SDF_DISTANCE_SCALE, &width, &height, &xoff, &yoff);
+        if (field)
+        {
+            // One texel of spacing so bilinear filtering never reads the neighbour.
+            if (s_shelfX + width + 1 > SDF_ATLAS_SIZE)
+            {
+                s_shelfX = 0;
+                s_shelfY += s_shelfHeight + 1;
+                s_shelfHeight = 0;
+            }
+            if (s_shelfY + height > SDF_ATLAS_SIZE || width + 1 > SDF_ATLAS_SIZE)
+            {
+                stbtt_FreeSDF(field, nullptr);
+                if (!s_atlasFullReported)
+                    std::cerr << "[SdfText] Glyph atlas is full, new characters are not drawn" << std::endl;
+                s_atlasFullReported = true;
+                return nullptr;
+            }
+            glyph.x = uint16_t(s_shelfX);
+            glyph.y = uint16_t(s_shelfY);
+            glyph.width = uint16_t(width);
+            glyph.height = uint16_t(height);
+            glyph.xoff = float(xoff);
+            glyph.yoff = float(yoff);
+            bgfx::updateTexture2D(s_sdfAtlas, 0, 0, glyph.x, glyph.y, glyph.width, glyph.height,
+                bgfx::copy(field, uint32_t(width * height)));
+            stbtt_FreeSDF(field, nullptr);
+            s_shelfX += width + 1;
+            s_shelfHeight = std::max(s_shelfHeight, height);
+        }
+        return &s_sdfGlyphs.emplace(codepoint, glyph).first->second;
+    }
+}
+
+namespace FontManager
+{
+    const BakedFont* bakedFont(const std::string& fontPath, int pixelSize)
+    {
+        FontFile* font = fontFile(fontPath);
+        if (!font)
+            return nullptr;
+        auto it = font->sizes.find(pixelSize);
+        if (it == font->sizes.end())
+        {
+            std::unique_ptr<BakedFont> baked = bake(*font, pixelSize);
+            if (!baked)
+                std::cerr << "[FontManager] Failed to bake " << fontPath << " at " << pixelSize << " px" << std::endl;
+            it = font->sizes.emplace(pixelSize, std::move(baked)).first;
+        }
+        return it->second.get();
+    }
+
+    void clear()
+    {
+        s_fonts.clear();
+    }
 }
 
 bgfx::TextureHandle createTextTexture(const std::string& text)
@@ -49,89 +242,52 @@ bgfx::TextureHandle createTextTexture(const std::string& text)
     const int texWidth = 1024; //512 original | texWidth = 1024;  // Wider canvas for text
     const int texHeight = 256; //512 original | texHeight = 256;  // Shorter height
     const int fontSize = 64; //32 original | 64
-    // Our temporary buffers: one for baking the atlas and one for compositing our text.
-    std::vector<unsigned char> atlas(texWidth * texHeight, 0);
-    std::vector<unsigned char> textBitmap(texWidth * texHeight, 0);
-
-    // Load the TTF font.
-    int fontBufferSize = 0;
-    //const char* fontFile = "fonts\\SF_Arch_Rival.ttf"; // Adjust the font path as needed.
-    std::string fontPath = getExecutableDir() + "/fonts/SF_Arch_Rival.ttf";
-    unsigned char* fontBuffer = loadFile(fontPath.c_str(), &fontBufferSize);
-    if (!fontBuffer) {
+
+    static const std::string fontPath = getExecutableDir() + "/" + FontManager::DEFAULT_FONT;
+    const BakedFont* font = FontManager::bakedFont(fontPath, fontSize);
+    if (!font) {
         std::cerr << "Could not load font file." << std::endl;
         return BGFX_INVALID_HANDLE;
     }
 
-    // Bake the font atlas for ASCII 32..127.
-    stbtt_bakedchar cdata[96]; // For characters 32..127.
-    if (stbtt_BakeFontBitmap(fontBuffer, 0, fontSize, atlas.data(), texWidth, texHeight, 32, 96, cdata) <= 0) {
-        std::cerr << "Failed to bake font bitmap." << std::endl;
-        free(fontBuffer);
-        return BGFX_INVALID_HANDLE;
-    }
+    // White text modulated by the glyph's alpha. In BGRA8 the layout is B, G, R, A, so a
+    // pixel is (alpha << 24) | 0xFFFFFF little-endian. Written straight into the bgfx block.
+    const bgfx::Memory* mem = bgfx::alloc(texWidth * texHeight * sizeof(uint32_t));
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(mem->data);
+    std::fill(pixels, pixels + texWidth * texHeight, 0x00FFFFFFu);
 
     // Starting drawing coordinates (with a little margin).
     float x = 0.0f;
-    float y = (float)fontSize;
+    const float y = (float)fontSize;
 
-    // For each character in the input text, compute its quad and blit it from the atlas into textBitmap.
+    // For each character, copy its rectangle from the cached atlas. The placement matches
+    // stbtt_GetBakedQuad with opengl_fillrule set.
     for (char ch : text)
     {
         if (ch < 32 || ch >= 128) continue; // skip non-printable chars
 
-        stbtt_aligned_quad q;
-        stbtt_GetBakedQuad(cdata, texWidth, texHeight, ch - 32, &x, &y, &q, 1);
-
-        // q.x0, q.y0, q.x1, q.y1 give the destination positions (in our textBitmap) for this glyph.
-        // q.s0, q.t0, q.s1, q.t1 give the corresponding texture coordinates inside the atlas.
-        int destX0 = (int)q.x0;
-        int destY0 = (int)q.y0;
-        int destX1 = (int)q.x1;
-        int destY1 = (int)q.y1;
-
-        // Compute source rect in the atlas.
-        int srcX0 = (int)(q.s0 * texWidth);
-        int srcY0 = (int)(q.t0 * texHeight);
-        int srcX1 = (int)(q.s1 * texWidth);
-        int srcY1 = (int)(q.t1 * texHeight);
-
-        int glyphW = srcX1 - srcX0;
-        int glyphH = srcY1 - srcY0;
-
-        // Blit glyph from atlas to textBitmap.
-        for (int j = 0; j < glyphH; j++) {
-            for (int i = 0; i < glyphW; i++) {
-                int destX = destX0 + i;
-                int destY = destY0 + j;
-                if (destX < 0 || destX >= texWidth || destY < 0 || destY >= texHeight)
-                    continue;
-                int srcX = srcX0 + i;
-                int srcY = srcY0 + j;
-                if (srcX < 0 || srcX >= texWidth || srcY < 0 || srcY >= texHeight)
-                    continue;
-                unsigned char value = atlas[srcY * texWidth + srcX];
+        const BakedGlyph& glyph = font->glyphs[ch - 32];
+        const int destX0 = (int)std::floor(x + glyph.xoff + 0.5f);
+        const int destY0 = (int)std::floor(y + glyph.yoff + 0.5f);
+        x += glyph.xadvance;
+
+        // Clip the glyph rectangle against the texture once instead of per pixel.
+        const int i0 = std::max(0, -destX0);
+        const int j0 = std::max(0, -destY0);
+        const int i1 = std::min(glyph.x1 - glyph.x0, texWidth - destX0);
+        const int j1 = std::min(glyph.y1 - glyph.y0, texHeight - destY0);
+        for (int j = j0; j < j1; j++) {
+            const unsigned char* src = &font->atlas[size_t(glyph.y0 + j) * font->atlasWidth + glyph.x0];
+            uint32_t* dst = &pixels[size_t(destY0 + j) * texWidth + destX0];
+            for (int i = i0; i < i1; i++) {
                 // For simplicity, we overwrite the destination pixel.
-                textBitmap[destY * texWidth + destX] = value;
+                dst[i] = (uint32_t(src[i]) << 24) | 0x00FFFFFFu;
             }
         }
     }
 
-    // Convert the 8-bit grayscale textBitmap into an RGBA buffer.
-    std::vector<uint32_t> rgbaBuffer(texWidth * texHeight, 0);
-    for (int i = 0; i < texWidth * texHeight; i++) {
-        // We want white text modulated by the glyphs alpha.
-        // In BGRA8, the layout is: B, G, R, A (little-endian packing).
-        unsigned char alpha = textBitmap[i];
-        uint32_t pixel = (alpha << 24) | (255 << 16) | (255 << 8) | 255;
-        rgbaBuffer[i] = pixel;
-    }
-
-    // Create a BGFX memory block from the RGBA buffer.
-    const bgfx::Memory* mem = bgfx::copy(rgbaBuffer.data(), texWidth * texHeight * sizeof(uint32_t));
-
     // Create a BGFX texture (using BGRA8 format).
-    bgfx::TextureHandle texHandle = bgfx::createTexture2D(
+    return bgfx::createTexture2D(
         static_cast<uint16_t>(texWidth),
         static_cast<uint16_t>(texHeight),
         false, // No mipmaps for simplicity.
@@ -140,7 +296,144 @@ bgfx::TextureHandle createTextTexture(const std::string& text)
         0,     // No special flags.
         mem
     );
+}
+
+namespace SdfText
+{
+    void initialize()
+    {
+        if (s_sdfInitialized)
+            return;
+        s_textLayout.begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+            .end();
+
+        // Mutable so glyphs can be added; starts out as "far outside" everywhere.
+        s_sdfAtlas = bgfx::createTexture2D(SDF_ATLAS_SIZE, SDF_ATLAS_SIZE, false, 1, bgfx::TextureFormat::R8,
+            BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+        const bgfx::Memory* clear = bgfx::alloc(SDF_ATLAS_SIZE * SDF_ATLAS_SIZE);
+        std::memset(clear->data, 0, clear->size);
+        bgfx::updateTexture2D(s_sdfAtlas, 0, 0, 0, 0, SDF_ATLAS_SIZE, SDF_ATLAS_SIZE, clear);
+
+        // Glyph i uses vertices 4i .. 4i + 3, the same winding as textQuadIndices.
+        const bgfx::Memory* indices = bgfx::alloc(MAX_GLYPHS * 6 * sizeof(uint16_t));
+        uint16_t* index = reinterpret_cast<uint16_t*>(indices->data);
+        for (uint32_t i = 0; i < MAX_GLYPHS; ++i)
+        {
+            const uint16_t base = uint16_t(i * 4);
+            const uint16_t quad[6] = { base, uint16_t(base + 1), uint16_t(base + 2), uint16_t(base + 1), uint16_t(base + 3), uint16_t(base + 2) };
+            std::memcpy(index + i * 6, quad, sizeof(quad));
+        }
+        s_quadIndices = bgfx::createIndexBuffer(indices);
+
+        s_sdfGlyphs.clear();
+        s_shelfX = s_shelfY = s_shelfHeight = 0;
+        s_atlasFullReported = false;
+        s_sdfInitialized = true;
+    }
+
+    void shutdown()
+    {
+        if (!s_sdfInitialized)
+            return;
+        bgfx::destroy(s_sdfAtlas);
+        bgfx::destroy(s_quadIndices);
+        s_sdfAtlas = BGFX_INVALID_HANDLE;
+        s_quadIndices = BGFX_INVALID_HANDLE;
+        s_sdfGlyphs.clear();
+        s_sdfInitialized = false;
+    }
+
+    bool isInitialized()
+    {
+        return s_sdfInitialized;
+    }
+
+    bool updateMesh(TextMesh& mesh, const std::string& utf8)
+    {
+        if (!s_sdfInitialized)
+            return false;
+        static const std::string fontPath = getExecutableDir() + "/" + FontManager::DEFAULT_FONT;
+        FontFile* font = fontFile(fontPath);
+        if (!font)
+            return false;
+
+        const float layoutScale = LAYOUT_PIXEL_HEIGHT / SDF_PIXEL_HEIGHT; // atlas pixels -> layout pixels
+        const float kernScale = stbtt_ScaleForPixelHeight(&font->info, LAYOUT_PIXEL_HEIGHT);
+        const float texel = 1.0f / SDF_ATLAS_SIZE;
+
+        // Pen in layout pixels from the top-left of the quad, baseline one line down like
+        // createTextTexture. The quad's u runs from +x to -x, so x mirrors the same way.
+        std::vector<TextVertex> vertices;
+        vertices.reserve(utf8.size() * 4);
+        float penX = 0.0f;
+        const float baseline = LAYOUT_PIXEL_HEIGHT;
+        uint32_t previous = 0;
+        for (size_t i = 0; i < utf8.size() && vertices.size() < MAX_GLYPHS * 4;)
+        {
+            uint32_t codepoint = nextCodepoint(utf8, i);
+            if (codepoint < 32 || codepoint == 127)
+                continue; // control characters
+            if (stbtt_FindGlyphIndex(&font->info, int(codepoint)) == 0)
+                codepoint = '?'; // not in the font, U+FFFD included
+            const SdfGlyph* glyph = sdfGlyph(*font, codepoint);
+            if (!glyph)
+                continue;
+            if (previous)
+                penX += kernScale * stbtt_GetCodepointKernAdvance(&font->info, int(previous), int(codepoint));
+            previous = codepoint;
+
+            if (glyph->width > 0)
+            {
+                const float x0 = penX + glyph->xoff * layoutScale;
+                const float y0 = baseline + glyph->yoff * layoutScale;
+                const float x1 = x0 + glyph->width * layoutScale;
+                const float y1 = y0 + glyph->height * layoutScale;
+                const float left = QUAD_HALF_WIDTH - x0 / PIXELS_PER_UNIT;
+                const float right = QUAD_HALF_WIDTH - x1 / PIXELS_PER_UNIT;
+                const float top = QUAD_HALF_HEIGHT - y0 / PIXELS_PER_UNIT;
+                const float bottom = QUAD_HALF_HEIGHT - y1 / PIXELS_PER_UNIT;
+                const float u0 = glyph->x * texel, u1 = (glyph->x + glyph->width) * texel;
+                const float v0 = glyph->y * texel, v1 = (glyph->y + glyph->height) * texel;
+                vertices.push_back({ left, top, 0.0f, u0, v0 });
+                vertices.push_back({ right, top, 0.0f, u1, v0 });
+                vertices.push_back({ left, bottom, 0.0f, u0, v1 });
+                vertices.push_back({ right, bottom, 0.0f, u1, v1 });
+            }
+            penX += glyph->advance;
+        }
+
+        mesh.glyphCount = uint32_t(vertices.size() / 4);
+        if (mesh.glyphCount == 0)
+        {
+            // Keep the buffer: the instance stays on the SDF path and simply draws nothing.
+            if (!bgfx::isValid(mesh.vertices))
+                mesh.vertices = bgfx::createDynamicVertexBuffer(4, s_textLayout, BGFX_BUFFER_ALLOW_RESIZE);
+            return true;
+        }
+        if (!bgfx::isValid(mesh.vertices))
+            mesh.vertices = bgfx::createDynamicVertexBuffer(uint32_t(vertices.size()), s_textLayout, BGFX_BUFFER_ALLOW_RESIZE);
+        bgfx::update(mesh.vertices, 0, bgfx::copy(vertices.data(), uint32_t(vertices.size() * sizeof(TextVertex))));
+        return true;
+    }
 
-    free(fontBuffer);
-    return texHandle;
+    void destroyMesh(TextMesh& mesh)
+    {
+        // After shutdown() bgfx is going away and frees the buffer itself.
+        if (s_sdfInitialized && bgfx::isValid(mesh.vertices))
+            bgfx::destroy(mesh.vertices);
+        mesh.vertices = BGFX_INVALID_HANDLE;
+        mesh.glyphCount = 0;
+    }
+
+    bool bind(const TextMesh& mesh, uint8_t stage, bgfx::UniformHandle sampler)
+    {
+        if (!s_sdfInitialized || !bgfx::isValid(mesh.vertices) || mesh.glyphCount == 0)
+            return false;
+        bgfx::setVertexBuffer(0, mesh.vertices, 0, mesh.glyphCount * 4);
+        bgfx::setIndexBuffer(s_quadIndices, 0, mesh.glyphCount * 6);
+        bgfx::setTexture(stage, sampler, s_sdfAtlas);
+        return true;
+    }
 }
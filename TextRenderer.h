@@ -1,13 +1,70 @@
 #ifndef TEXT_RENDERER_H
 #define TEXT_RENDERER_H
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <bgfx/bgfx.h>
 
+// Placement of one baked glyph, the same values stbtt_bakedchar holds.
+struct BakedGlyph
+{
+    unsigned short x0, y0, x1, y1; // rectangle in the atlas
+    float xoff, yoff, xadvance;
+};
+
+// An 8-bit coverage atlas of ASCII 32..127 at one pixel size.
+struct BakedFont
+{
+    int pixelSize = 0;
+    int atlasWidth = 0;
+    int atlasHeight = 0;
+    std::vector<unsigned char> atlas;
+    BakedGlyph glyphs[96];
+};
+
+// TTF files are read once and each (font, pixel size) is baked once; everything stays cached
+// until clear(). Main thread only.
+namespace FontManager
+{
+    const char* const DEFAULT_FONT = "fonts/SF_Arch_Rival.ttf"; // relative to the executable
+
+    // nullptr when the font cannot be read or baked. The pointer stays valid until clear().
+    const BakedFont* bakedFont(const std::string& fontPath, int pixelSize);
+    void clear();
+}
+
 // Creates a BGFX texture containing rendered text.
-// The implementation uses stb_truetype to bake a font atlas, then blits glyphs
-// for the given text string into an offscreen buffer that is converted to an RGBA texture.
-// Make sure you have a TTF file at the specified path (adjust as needed).
+// Glyphs are copied from the cached FontManager atlas straight into the texture memory, so
+// re-creating the texture after an edit costs one 1 MiB fill plus the glyph rectangles.
 bgfx::TextureHandle createTextTexture(const std::string& text);
 
+// Glyph quads of one text string, laid out like createTextTexture's bitmap on the 4 x 1 text
+// quad (PrimitiveObjects.h): 64 px glyphs, 256 px per unit. 20 bytes per vertex, 4 per glyph.
+struct TextMesh
+{
+    bgfx::DynamicVertexBufferHandle vertices = BGFX_INVALID_HANDLE;
+    uint32_t glyphCount = 0;
+};
+
+// Text drawn from one signed distance field atlas shared by every text instance. Glyphs are
+// rendered into the atlas the first time any text uses them (any code point the font has), so
+// an instance only owns its glyph quads and stays sharp at any zoom.
+namespace SdfText
+{
+    // Creates the atlas and the shared quad index buffer. Call after bgfx::init().
+    void initialize();
+    void shutdown();
+    bool isInitialized();
+
+    // Lays out UTF-8 text into mesh, creating or growing its vertex buffer. False when the
+    // module is not initialized or the font is missing.
+    bool updateMesh(TextMesh& mesh, const std::string& utf8);
+    void destroyMesh(TextMesh& mesh);
+
+    // Sets the mesh's vertices, the shared indices and the atlas on stage for the next submit.
+    // False when there is nothing to draw.
+    bool bind(const TextMesh& mesh, uint8_t stage, bgfx::UniformHandle sampler);
+}
+
 #endif // TEXT_RENDERER_H
@@ -0,0 +1,589 @@
+#include "TonalArtMap.h"
+
+#include <bimg/bimg.h>
+#include <bx/allocator.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct NoiseImage
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<float> red;
+    };
+
+    struct BakeJob
+    {
+        std::string key;
+        std::string noisePath;
+        TamParams params;
+    };
+
+    struct BakeResult
+    {
+        std::string key;
+        std::vector<uint8_t> data; // empty when the bake failed
+    };
+
+    enum class EntryState { Baking, Ready, Failed };
+
+    struct Entry
+    {
+        EntryState state = EntryState::Baking;
+        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+        uint64_t lastRequested = 0;
+    };
+
+    // Cache file layout: header, key string, then every layer with its full mip chain.
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t layers;
+        uint32_t mips;
+        uint32_t keyLength;
+    };
+
+    constexpr uint32_t kCacheVersion = 1;
+    // Jobs that nobody asked for in this many frames are dropped (e.g. intermediate slider values).
+    constexpr uint64_t kStaleFrames = 2;
+    // Resident arrays beyond this count are released, least recently used first. Arrays requested
+    // within the last kStaleFrames frames are kept even above it, or a busy scene would reload them
+    // every frame.
+    constexpr size_t kMaxResident = 16;
+
+    int s_toneLevels = 8;
+    int s_tileWidth = 512;
+    int s_tileHeight = 256;
+    int s_mipCount = 1;
+    std::string s_cacheDir = "tam_cache";
+    bool s_initialized = false;
+
+    std::unordered_map<uint16_t, std::string> s_noisePaths;
+
+    // Shared between the render thread and the bake thread.
+    std::mutex s_mutex;
+    std::condition_variable s_cv;
+    std::deque<BakeJob> s_jobs;
+    std::vector<BakeResult> s_results;
+    std::unordered_map<std::string, Entry> s_entries;
+    uint64_t s_frame = 0;
+    bool s_running = false;
+    std::thread s_worker;
+    std::atomic<int> s_pending{ 0 };
+
+    // Only touched by the bake thread.
+    std::unordered_map<std::string, NoiseImage> s_noiseImages;
+
+    uint64_t fnv1a(const std::string& s)
+    {
+        uint64_t hash = 1469598103934665603ull;
+        for (unsigned char c : s)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string makeKey(const std::string& noisePath, const TamParams& p)
+    {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(4)
+            << noisePath << '|' << s_toneLevels << '|' << s_tileWidth << 'x' << s_tileHeight
+            << '|' << p.strokeMultiplier << '|' << p.lineThickness << '|' << p.epsilon
+            << '|' << p.layerStrokeMult << '|' << p.layerLineThickness;
+        return oss.str();
+    }
+
+    std::string cachePath(const std::string& key)
+    {
+        std::ostringstream oss;
+        oss << s_cacheDir << "/tam_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(key) << ".bin";
+        return oss.str();
+    }
+
+    size_t layerSize()
+    {
+        size_t size = 0;
+        for (int mip = 0; mip < s_mipCount; ++mip)
+        {
+            size += size_t(std::max(1, s_tileWidth >> mip)) * size_t(std::max(1, s_tileHeight >> mip));
+        }
+        return size;
+    }
+
+    bool decodeNoise(const std::string& path, NoiseImage& out)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            std::cerr << "TAM: failed to open noise texture: " << path << std::endl;
+            return false;
+        }
+        std::vector<char> bytes(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(bytes.data(), bytes.size());
+
+        bimg::ImageContainer container;
+        bx::Error err;
+        if (!bimg::imageParse(container, bytes.data(), uint32_t(bytes.size()), &err))
+        {
+            std::cerr << "TAM: failed to parse noise texture: " << path << std::endl;
+            return false;
+        }
+
+        bimg::ImageMip mip;
+        if (!bimg::imageGetRawData(container, 0, 0, bytes.data(), uint32_t(bytes.size()), mip))
+        {
+            std::cerr << "TAM: noise texture has no data: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<uint8_t> rgba(size_t(mip.m_width) * mip.m_height * 4);
+        bx::DefaultAllocator allocator;
+        bimg::imageDecodeToRgba8(&allocator, rgba.data(), mip.m_data, mip.m_width, mip.m_height, mip.m_width * 4, mip.m_format);
+
+        out.width = int(mip.m_width);
+        out.height = int(mip.m_height);
+        out.red.resize(size_t(out.width) * out.height);
+        for (size_t i = 0; i < out.red.size(); ++i)
+        {
+            out.red[i] = rgba[i * 4] / 255.0f;
+        }
+        return true;
+    }
+
+    // Bilinear, repeating lookup - same as the default bgfx sampler used for u_noiseTex.
+    float sampleNoise(const NoiseImage& img, float u, float v)
+    {
+        float x = u * img.width - 0.5f;
+        float y = v * img.height - 0.5f;
+        float fx = std::floor(x);
+        float fy = std::floor(y);
+        float tx = x - fx;
+        float ty = y - fy;
+
+        auto wrap = [](int i, int n) { i %= n; return i < 0 ? i + n : i; };
+        int x0 = wrap(int(fx), img.width);
+        int y0 = wrap(int(fy), img.height);
+        int x1 = (x0 + 1) % img.width;
+        int y1 = (y0 + 1) % img.height;
+
+        float a = img.red[y0 * img.width + x0];
+        float b = img.red[y0 * img.width + x1];
+        float c = img.red[y1 * img.width + x0];
+        float d = img.red[y1 * img.width + x1];
+        return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * ty;
+    }
+
+    float smoothstep(float e0, float e1, float x)
+    {
+        float t = std::clamp((x - e0) / (e1 - e0), 0.0f, 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    // CPU port of texh() in f_out28.sc.
+    float texh(const NoiseImage& noise, float px, float py, float str)
+    {
+        float rz = 1.0f;
+        for (int i = 0; i < 10; i++)
+        {
+            float g = sampleNoise(noise, 0.025f * px, 0.5f * py);
+            g = smoothstep(0.0f - str * 0.1f, 2.3f - str * 0.1f, g);
+            rz = std::min(1.0f - g, rz);
+            std::swap(px, py);
+            px = (px + 0.7f) * 1.52f;
+            py = (py + 0.7f) * 1.52f;
+            if (float(i) > str)
+                break;
+        }
+        return rz * 1.05f;
+    }
+
+    // Only the first texh() octave repeats over the tile span, so the later ones are
+    // cross-faded with their neighbouring tile to make the texture wrap without a seam.
+    float texhTiled(const NoiseImage& noise, float px, float py, float str)
+    {
+        const float wx = px / TonalArtMap::kTileSpanX;
+        const float wy = py / TonalArtMap::kTileSpanY;
+        const float sx = TonalArtMap::kTileSpanX;
+        const float sy = TonalArtMap::kTileSpanY;
+        return (1.0f - wx) * (1.0f - wy) * texh(noise, px, py, str)
+            + wx * (1.0f - wy) * texh(noise, px - sx, py, str)
+            + (1.0f - wx) * wy * texh(noise, px, py - sy, str)
+            + wx * wy * texh(noise, px - sx, py - sy, str);
+    }
+
+    template <typename Fn>
+    void parallelFor(int count, Fn&& fn)
+    {
+        const int threadCount = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, count);
+        std::atomic<int> next{ 0 };
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for (int t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([&]() {
+                for (int i = next++; i < count; i = next++)
+                    fn(i);
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+    }
+
+    void bake(const NoiseImage& noise, const TamParams& p, std::vector<uint8_t>& out)
+    {
+        const int layers = s_toneLevels + 1;
+        const size_t perLayer = layerSize();
+        out.assign(perLayer * layers, 0);
+
+        // Base level: one task per row of every layer.
+        parallelFor(layers * s_tileHeight, [&](int task) {
+            const int layer = task / s_tileHeight;
+            const int y = task % s_tileHeight;
+            uint8_t* row = out.data() + perLayer * layer + size_t(y) * s_tileWidth;
+            const float py = (y + 0.5f) / s_tileHeight * TonalArtMap::kTileSpanY;
+
+            for (int x = 0; x < s_tileWidth; ++x)
+            {
+                const float px = (x + 0.5f) / s_tileWidth * TonalArtMap::kTileSpanX;
+                float r;
+                if (layer < s_toneLevels)
+                {
+                    // Same threshold as the forward shader, evaluated at this layer's tone.
+                    const float lVal = float(layer) / float(s_toneLevels - 1);
+                    const float line = texhTiled(noise, px, py, lVal * p.strokeMultiplier * p.lineThickness);
+                    r = 1.0f - smoothstep(lVal - p.epsilon, lVal + p.epsilon, line);
+                }
+                else
+                {
+                    const float line2 = texhTiled(noise, px, py, p.layerStrokeMult * p.layerLineThickness);
+                    r = line2 < 0.5f ? 1.0f : 0.0f;
+                }
+                row[x] = uint8_t(std::lround(std::clamp(r, 0.0f, 1.0f) * 255.0f));
+            }
+        });
+
+        // Box-filtered mip chain, one task per layer.
+        parallelFor(layers, [&](int layer) {
+            uint8_t* src = out.data() + perLayer * layer;
+            int srcW = s_tileWidth;
+            int srcH = s_tileHeight;
+            for (int mip = 1; mip < s_mipCount; ++mip)
+            {
+                uint8_t* dst = src + size_t(srcW) * srcH;
+                const int dstW = std::max(1, srcW >> 1);
+                const int dstH = std::max(1, srcH >> 1);
+                for (int y = 0; y < dstH; ++y)
+                {
+                    const int y0 = std::min(y * 2, srcH - 1);
+                    const int y1 = std::min(y * 2 + 1, srcH - 1);
+                    for (int x = 0; x < dstW; ++x)
+                    {
+                        const int x0 = std::min(x * 2, srcW - 1);
+                        const int x1 = std::min(x * 2 + 1, srcW - 1);
+                        const int sum = src[y0 * srcW + x0] + src[y0 * srcW + x1] + src[y1 * srcW + x0] + src[y1 * srcW + x1];
+                        dst[y * dstW + x] = uint8_t((sum + 2) / 4);
+                    }
+                }
+                src = dst;
+                srcW = dstW;
+                srcH = dstH;
+            }
+        });
+    }
+
+    bool loadFromCache(const std::string& key, std::vector<uint8_t>& out)
+    {
+        std::ifstream file(cachePath(key), std::ios::binary);
+        if (!file)
+            return false;
+
+        CacheHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || std::memcmp(header.magic, "CHTM", 4) != 0 || header.version != kCacheVersion
+            || header.width != uint32_t(s_tileWidth) || header.height != uint32_t(s_tileHeight)
+            || header.layers != uint32_t(s_toneLevels + 1) || header.mips != uint32_t(s_mipCount)
+            || header.keyLength != key.size())
+        {
+            return false;
+        }
+
+        std::string storedKey(header.keyLength, '\0');
+        file.read(storedKey.data(), storedKey.size());
+        if (storedKey != key)
+            return false;
+
+        out.resize(layerSize() * header.layers);
+        file.read(reinterpret_cast<char*>(out.data()), out.size());
+        return bool(file);
+    }
+
+    void saveToCache(const std::string& key, const std::vector<uint8_t>& data)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(s_cacheDir, ec);
+
+        const std::string path = cachePath(key);
+        const std::string tmpPath = path + ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                std::cerr << "TAM: failed to write cache file: " << tmpPath << std::endl;
+                return;
+            }
+            CacheHeader header{ { 'C', 'H', 'T', 'M' }, kCacheVersion, uint32_t(s_tileWidth), uint32_t(s_tileHeight),
+                uint32_t(s_toneLevels + 1), uint32_t(s_mipCount), uint32_t(key.size()) };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(key.data(), key.size());
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+        std::filesystem::rename(tmpPath, path, ec);
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            BakeJob job;
+            {
+                std::unique_lock<std::mutex> lock(s_mutex);
+                s_cv.wait(lock, [] { return !s_running || !s_jobs.empty(); });
+                if (!s_running)
+                    return;
+
+                // Newest first: while a slider is dragged only the latest value matters.
+                job = std::move(s_jobs.back());
+                s_jobs.pop_back();
+
+                auto it = s_entries.find(job.key);
+                if (it == s_entries.end() || s_frame - it->second.lastRequested > kStaleFrames)
+                {
+                    if (it != s_entries.end())
+                        s_entries.erase(it);
+                    --s_pending;
+                    continue;
+                }
+            }
+
+            BakeResult result;
+            result.key = job.key;
+            if (!loadFromCache(job.key, result.data))
+            {
+                auto noiseIt = s_noiseImages.find(job.noisePath);
+                if (noiseIt == s_noiseImages.end())
+                {
+                    NoiseImage image;
+                    if (decodeNoise(job.noisePath, image))
+                        noiseIt = s_noiseImages.emplace(job.noisePath, std::move(image)).first;
+                }
+
+                if (noiseIt != s_noiseImages.end())
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    bake(noiseIt->second, job.params, result.data);
+                    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+                    std::cout << "Baked tonal art map for " << job.noisePath << " in " << ms << " ms" << std::endl;
+                    saveToCache(job.key, result.data);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_results.push_back(std::move(result));
+        }
+    }
+}
+
+namespace TonalArtMap
+{
+    void initialize(int toneLevels, int tileWidth, int tileHeight, const std::string& cacheDir)
+    {
+        if (s_initialized)
+            return;
+
+        s_toneLevels = std::max(2, toneLevels);
+        s_tileWidth = tileWidth;
+        s_tileHeight = tileHeight;
+        s_cacheDir = cacheDir;
+        s_mipCount = 1;
+        while ((std::max(s_tileWidth, s_tileHeight) >> s_mipCount) > 0)
+            ++s_mipCount;
+
+        s_running = true;
+        s_worker = std::thread(workerLoop);
+        s_initialized = true;
+
+        if (!isSupported())
+            std::cout << "TAM: 2D texture arrays not supported, keeping procedural hatching" << std::endl;
+    }
+
+    void shutdown()
+    {
+        if (!s_initialized)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_running = false;
+            s_jobs.clear();
+        }
+        s_cv.notify_all();
+        if (s_worker.joinable())
+            s_worker.join();
+
+        for (auto& [key, entry] : s_entries)
+        {
+            if (bgfx::isValid(entry.handle))
+                bgfx::destroy(entry.handle);
+        }
+        s_entries.clear();
+        s_results.clear();
+        s_noiseImages.clear();
+        s_pending = 0;
+        s_initialized = false;
+    }
+
+    void registerNoiseSource(bgfx::TextureHandle noise, const std::string& ddsPath)
+    {
+        if (bgfx::isValid(noise))
+            s_noisePaths[noise.idx] = ddsPath;
+    }
+
+    bgfx::TextureHandle request(const TamParams& params)
+    {
+        if (!s_initialized || !isSupported() || !bgfx::isValid(params.noise))
+            return BGFX_INVALID_HANDLE;
+
+        auto pathIt = s_noisePaths.find(params.noise.idx);
+        if (pathIt == s_noisePaths.end())
+            return BGFX_INVALID_HANDLE;
+
+        const std::string key = makeKey(pathIt->second, params);
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_entries.find(key);
+        if (it == s_entries.end())
+        {
+            Entry entry;
+            entry.lastRequested = s_frame;
+            s_entries.emplace(key, entry);
+            s_jobs.push_back({ key, pathIt->second, params });
+            ++s_pending;
+            s_cv.notify_one();
+            return BGFX_INVALID_HANDLE;
+        }
+
+        it->second.lastRequested = s_frame;
+        return it->second.state == EntryState::Ready ? it->second.handle : bgfx::TextureHandle(BGFX_INVALID_HANDLE);
+    }
+
+    void update()
+    {
+        if (!s_initialized)
+            return;
+
+        std::vector<BakeResult> results;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            ++s_frame;
+            results.swap(s_results);
+        }
+
+        for (BakeResult& result : results)
+        {
+            --s_pending;
+
+            std::lock_guard<std::mutex> lock(s_mutex);
+            auto it = s_entries.find(result.key);
+            if (it == s_entries.end())
+                continue;
+
+            if (result.data.empty())
+            {
+                it->second.state = EntryState::Failed;
+                continue;
+            }
+
+            const bgfx::Memory* mem = bgfx::copy(result.data.data(), uint32_t(result.data.size()));
+            it->second.handle = bgfx::createTexture2D(uint16_t(s_tileWidth), uint16_t(s_tileHeight), true,
+                uint16_t(s_toneLevels + 1), bgfx::TextureFormat::R8, BGFX_TEXTURE_NONE | BGFX_SAMPLER_NONE, mem);
+            it->second.state = bgfx::isValid(it->second.handle) ? EntryState::Ready : EntryState::Failed;
+        }
+
+        // Release the least recently used arrays once too many parameter sets are resident, as long
+        // as they are no longer in use.
+        std::lock_guard<std::mutex> lock(s_mutex);
+        size_t resident = 0;
+        for (auto& [key, entry] : s_entries)
+        {
+            if (entry.state == EntryState::Ready)
+                ++resident;
+        }
+        while (resident > kMaxResident)
+        {
+            auto oldest = s_entries.end();
+            for (auto it = s_entries.begin(); it != s_entries.end(); ++it)
+            {
+                if (it->second.state == EntryState::Ready && s_frame - it->second.lastRequested > kStaleFrames
+                    && (oldest == s_entries.end() || it->second.lastRequested < oldest->second.lastRequested))
+                    oldest = it;
+            }
+            if (oldest == s_entries.end())
+                break;
+            bgfx::destroy(oldest->second.handle);
+            s_entries.erase(oldest);
+            --resident;
+        }
+    }
+
+    bool isSupported()
+    {
+        const bgfx::Caps* caps = bgfx::getCaps();
+        return caps
+            && (caps->supported & BGFX_CAPS_TEXTURE_2D_ARRAY) != 0
+            && (caps->formats[bgfx::TextureFormat::R8] & BGFX_CAPS_FORMAT_TEXTURE_2D) != 0;
+    }
+
+    int toneLevels()
+    {
+        return s_toneLevels;
+    }
+
+    int tileWidth()
+    {
+        return s_tileWidth;
+    }
+
+    int tileHeight()
+    {
+        return s_tileHeight;
+    }
+
+    int pendingBakes()
+    {
+        return s_pending;
+    }
+}
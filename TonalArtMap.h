@@ -0,0 +1,50 @@
+#ifndef TONAL_ART_MAP_H
+#define TONAL_ART_MAP_H
+
+#include <string>
+#include <bgfx/bgfx.h>
+
+// Stroke parameters that change the content of a baked tonal art map (TAM).
+// The hatch angles are deliberately not part of the key: f_out28_tam rotates the
+// lookup coordinates, so dragging an angle slider never triggers a rebake.
+struct TamParams
+{
+    bgfx::TextureHandle noise = BGFX_INVALID_HANDLE;
+    float strokeMultiplier = 1.0f;
+    float lineThickness = 0.3f;
+    float epsilon = 0.02f;
+    float layerStrokeMult = 0.25f;
+    float layerLineThickness = 10.0f;
+};
+
+// A TAM is an R8 2D texture array. Layers [0, toneLevels) hold the outer hatch coverage
+// at evenly spaced tones (layer 0 = white, last = black), layer toneLevels holds the inner
+// hatch layer used by Crosshatch Ver 1.2/1.3. Every layer is mip-mapped on the CPU so distant
+// strokes fade instead of aliasing.
+namespace TonalArtMap
+{
+    // Pattern space covered by one tile, matching the vec2(0.025, 0.5) noise lookup in texh().
+    constexpr float kTileSpanX = 40.0f;
+    constexpr float kTileSpanY = 2.0f;
+
+    void initialize(int toneLevels = 8, int tileWidth = 512, int tileHeight = 256, const std::string& cacheDir = "tam_cache");
+    void shutdown();
+
+    // Noise textures are decoded on the CPU from the same DDS file the GPU copy was loaded from.
+    void registerNoiseSource(bgfx::TextureHandle noise, const std::string& ddsPath);
+
+    // Returns the baked array for these parameters, or BGFX_INVALID_HANDLE while the bake is
+    // still running (the caller keeps using the procedural shader until then).
+    bgfx::TextureHandle request(const TamParams& params);
+
+    // Uploads finished bakes. Call once per frame from the render thread.
+    void update();
+
+    bool isSupported();
+    int toneLevels();
+    int tileWidth();
+    int tileHeight();
+    int pendingBakes();
+}
+
+#endif // TONAL_ART_MAP_H
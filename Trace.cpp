@@ -0,0 +1,263 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct Event
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    const uint32_t BLOCK_EVENTS = 4096;
+    const uint32_t MAX_BLOCKS = Trace::MAX_EVENTS_PER_THREAD / BLOCK_EVENTS;
+
+    // Written by its thread only. The count is published after the event, so the exporter
+    // reads complete events. Blocks are kept for the next capture and never freed.
+    struct ThreadBuffer
+    {
+        std::atomic<uint32_t> generation{ 0 };
+        std::atomic<uint32_t> count{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<bool> retired{ false };
+        uint32_t threadId = 0;
+        std::string name; // guarded by s_mutex
+        std::unique_ptr<Event[]> blocks[MAX_BLOCKS];
+    };
+
+    std::mutex s_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> s_buffers; // guarded by s_mutex
+    uint32_t s_nextThreadId = 1;                          // guarded by s_mutex
+    std::atomic<uint32_t> s_generation{ 0 };
+    uint64_t s_captureStart = 0;
+
+    const char* const PHASE_NAMES[] = { "Input", "ImGui", "Picking", "Light collection", "Traversal", "bgfx::frame" };
+    static_assert(std::size(PHASE_NAMES) == size_t(Trace::Phase::Count), "one name per phase");
+    uint64_t s_phaseNs[size_t(Trace::Phase::Count)] = {};
+    float s_lastFrameMs[size_t(Trace::Phase::Count)] = {};
+
+    // Hands the buffer to the next new thread once this one has exited.
+    struct BufferOwner
+    {
+        ThreadBuffer* buffer = nullptr;
+        ~BufferOwner()
+        {
+            if (buffer)
+                buffer->retired.store(true, std::memory_order_release);
+        }
+    };
+    thread_local BufferOwner t_owner;
+
+    ThreadBuffer& threadBuffer()
+    {
+        if (t_owner.buffer)
+            return *t_owner.buffer;
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const uint32_t generation = s_generation.load(std::memory_order_relaxed);
+        ThreadBuffer* buffer = nullptr;
+        // A buffer whose thread has exited can be reused once its events are out of date.
+        for (const auto& candidate : s_buffers) {
+            if (candidate->retired.load(std::memory_order_acquire) && candidate->generation.load(std::memory_order_relaxed) != generation) {
+                buffer = candidate.get();
+                break;
+            }
+        }
+        if (!buffer) {
+            s_buffers.push_back(std::make_unique<ThreadBuffer>());
+            buffer = s_buffers.back().get();
+        }
+        buffer->retired.store(false, std::memory_order_relaxed);
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_relaxed);
+        buffer->threadId = s_nextThreadId++;
+        buffer->name.clear();
+        t_owner.buffer = buffer;
+        return *buffer;
+    }
+
+    void writeJsonString(std::ostream& out, const std::string& text)
+    {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                out << ' ';
+            else
+                out << c;
+        }
+        out << '"';
+    }
+}
+
+namespace Trace
+{
+    std::atomic<bool> g_enabled{ false };
+
+    uint64_t now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void begin()
+    {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            s_captureStart = now();
+            s_generation.fetch_add(1, std::memory_order_relaxed);
+        }
+        g_enabled.store(true, std::memory_order_release);
+        std::cout << "[Trace] Capture started" << std::endl;
+    }
+
+    void end()
+    {
+        if (!g_enabled.exchange(false, std::memory_order_acq_rel))
+            return;
+        std::cout << "[Trace] Capture stopped, " << eventCount() << " zones";
+        if (const uint64_t dropped = droppedCount())
+            std::cout << " (" << dropped << " dropped)";
+        std::cout << std::endl;
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs)
+    {
+        if (!isEnabled())
+            return; // the zone outlived the capture
+
+        ThreadBuffer& buffer = threadBuffer();
+        const uint32_t generation = s_generation.load(std::memory_order_relaxed);
+        if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+            // First zone of this thread in a new capture.
+            buffer.count.store(0, std::memory_order_relaxed);
+            buffer.dropped.store(0, std::memory_order_relaxed);
+            buffer.generation.store(generation, std::memory_order_relaxed);
+        }
+
+        const uint32_t index = buffer.count.load(std::memory_order_relaxed);
+        if (index >= MAX_EVENTS_PER_THREAD) {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::unique_ptr<Event[]>& block = buffer.blocks[index / BLOCK_EVENTS];
+        if (!block)
+            block.reset(new Event[BLOCK_EVENTS]);
+        block[index % BLOCK_EVENTS] = { name, startNs, endNs };
+        buffer.count.store(index + 1, std::memory_order_release);
+    }
+
+    void setThreadName(const char* name)
+    {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(s_mutex);
+        buffer.name = name;
+    }
+
+    uint64_t eventCount()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const uint32_t generation = s_generation.load(std::memory_order_relaxed);
+        uint64_t total = 0;
+        for (const auto& buffer : s_buffers) {
+            if (buffer->generation.load(std::memory_order_relaxed) == generation)
+                total += buffer->count.load(std::memory_order_acquire);
+        }
+        return total;
+    }
+
+    uint64_t droppedCount()
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const uint32_t generation = s_generation.load(std::memory_order_relaxed);
+        uint64_t total = 0;
+        for (const auto& buffer : s_buffers) {
+            if (buffer->generation.load(std::memory_order_relaxed) == generation)
+                total += buffer->dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    bool writeChromeJson(const std::string& path)
+    {
+        end();
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[Trace] Cannot write " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+        const uint32_t generation = s_generation.load(std::memory_order_relaxed);
+        // Complete ("X") events in microseconds from the start of the capture.
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CrossHatchEditor\"}}";
+        char line[64];
+        uint64_t written = 0;
+        for (const auto& buffer : s_buffers) {
+            if (buffer->generation.load(std::memory_order_relaxed) != generation)
+                continue;
+            const uint32_t count = buffer->count.load(std::memory_order_acquire);
+            if (count == 0)
+                continue;
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+            writeJsonString(out, buffer->name.empty() ? "Thread " + std::to_string(buffer->threadId) : buffer->name);
+            out << "}}";
+            for (uint32_t i = 0; i < count; ++i) {
+                const Event& event = buffer->blocks[i / BLOCK_EVENTS][i % BLOCK_EVENTS];
+                if (event.start < s_captureStart)
+                    continue; // began before the capture
+                out << ",\n{\"name\":";
+                writeJsonString(out, event.name);
+                std::snprintf(line, sizeof(line), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                    double(event.start - s_captureStart) * 1e-3, double(event.end - event.start) * 1e-3);
+                out << line << ",\"pid\":1,\"tid\":" << buffer->threadId << '}';
+                written++;
+            }
+        }
+        out << "\n]}\n";
+        out.close();
+        if (!out) {
+            std::cerr << "[Trace] Failed writing " << path << std::endl;
+            return false;
+        }
+        std::cout << "[Trace] Wrote " << written << " zones to " << path << std::endl;
+        return true;
+    }
+
+    const char* phaseName(Phase phase)
+    {
+        return PHASE_NAMES[size_t(phase)];
+    }
+
+    void addPhaseTime(Phase phase, uint64_t startNs, uint64_t endNs)
+    {
+        s_phaseNs[size_t(phase)] += endNs - startNs;
+        if (isEnabled())
+            record(PHASE_NAMES[size_t(phase)], startNs, endNs);
+    }
+
+    void endFrame()
+    {
+        for (size_t i = 0; i < size_t(Phase::Count); ++i) {
+            s_lastFrameMs[i] = float(double(s_phaseNs[i]) * 1e-6);
+            s_phaseNs[i] = 0;
+        }
+    }
+
+    float lastFrameMs(Phase phase)
+    {
+        return s_lastFrameMs[size_t(phase)];
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timing zones for finding where a frame or an import spends its time. While a capture
+// runs, every thread appends finished zones to its own buffer without locking. The capture can
+// be saved as Chrome trace JSON and opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+// When no capture is running, a zone costs one relaxed atomic load.
+namespace Trace
+{
+    // Zones recorded per thread per capture, later ones are counted as dropped.
+    const uint32_t MAX_EVENTS_PER_THREAD = 1u << 20;
+
+    extern std::atomic<bool> g_enabled;
+    inline bool isEnabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+    // Starts a new capture, discarding the previous one.
+    void begin();
+    // Stops recording, the capture stays available for writeChromeJson().
+    void end();
+    // Stops a running capture and writes it. False when the file cannot be written.
+    bool writeChromeJson(const std::string& path);
+    uint64_t eventCount();
+    uint64_t droppedCount();
+
+    // Names the calling thread in the exported trace. The name is copied.
+    void setThreadName(const char* name);
+
+    // Monotonic nanoseconds.
+    uint64_t now();
+    // name must outlive the capture (a string literal).
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    class Zone
+    {
+    public:
+        explicit Zone(const char* name) : name(name), start(isEnabled() ? now() : 0) {}
+        ~Zone() { end(); }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        // Closes the zone before the end of the scope.
+        void end()
+        {
+            if (start != 0) {
+                record(name, start, now());
+                start = 0;
+            }
+        }
+
+    private:
+        const char* name;
+        uint64_t start;
+    };
+
+    // Main loop phases. They are timed every frame for the performance panel, and recorded as
+    // zones while a capture runs. Main thread only.
+    enum class Phase : uint8_t { Input, ImGui, Picking, Lights, Traversal, BgfxFrame, Count };
+    const char* phaseName(Phase phase);
+    void addPhaseTime(Phase phase, uint64_t startNs, uint64_t endNs);
+    // Ends the frame: the accumulated phase times become lastFrameMs() and restart from zero.
+    void endFrame();
+    float lastFrameMs(Phase phase);
+
+    class PhaseZone
+    {
+    public:
+        explicit PhaseZone(Phase phase) : phase(phase), start(now()) {}
+        ~PhaseZone() { end(); }
+        PhaseZone(const PhaseZone&) = delete;
+        PhaseZone& operator=(const PhaseZone&) = delete;
+
+        void end()
+        {
+            if (start != 0) {
+                addPhaseTime(phase, start, now());
+                start = 0;
+            }
+        }
+
+    private:
+        Phase phase;
+        uint64_t start;
+    };
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope.
+#define TRACE_ZONE(name) Trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+
+#endif // TRACE_H
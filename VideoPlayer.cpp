@@ -0,0 +1,589 @@
+#include "VideoPlayer.h"
+#include "ShaderLoader.h"
+#include "YuvConverter.h"
+
+#include <bx/math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // Frames waiting to be shown plus the ones bgfx still uploads (up to two with the render
+    // thread a frame behind). 64 MB of RGBA at 1080p, 24 MB as planes; sized for the source
+    // resolution, the largest a scaled frame gets.
+    const size_t POOL_SIZE = 8;
+
+    // Rows of the YUV -> RGB matrix for sampled values in 0..1: rgb = dot(vec4(y, u, v, 1), row).
+    void videoMatrix(bool bt709, bool fullRange, float rows[12])
+    {
+        const float kr = bt709 ? 0.2126f : 0.299f;
+        const float kb = bt709 ? 0.0722f : 0.114f;
+        const float kg = 1.0f - kr - kb;
+        // y' = ys * y + yo, c' = cs * c + co, with c' centred on zero
+        const float ys = fullRange ? 1.0f : 255.0f / 219.0f;
+        const float yo = fullRange ? 0.0f : -16.0f / 219.0f;
+        const float cs = fullRange ? 1.0f : 255.0f / 224.0f;
+        const float co = fullRange ? -128.0f / 255.0f : -128.0f / 224.0f;
+
+        const float rv = 2.0f * (1.0f - kr);
+        const float gu = -2.0f * (1.0f - kb) * kb / kg;
+        const float gv = -2.0f * (1.0f - kr) * kr / kg;
+        const float bu = 2.0f * (1.0f - kb);
+        const float r[12] = {
+            ys, 0.0f,    rv * cs, yo + rv * co,
+            ys, gu * cs, gv * cs, yo + (gu + gv) * co,
+            ys, bu * cs, 0.0f,    yo + bu * co,
+        };
+        std::memcpy(rows, r, sizeof(r));
+    }
+
+    bool isPlanar420(int format)
+    {
+        return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P;
+    }
+}
+
+VideoPlayer::~VideoPlayer()
+{
+    // The textures belong to bgfx, which is gone by the time statics are destroyed.
+    stopDecoder();
+    release();
+}
+
+bool VideoPlayer::load(const char* filename, UploadMode uploadMode, bgfx::ViewId view)
+{
+    shutdown();
+    if (avformat_open_input(&fmtCtx, filename, nullptr, nullptr) < 0)
+    {
+        std::cerr << "[VideoPlayer] Could not open " << filename << std::endl;
+        return false;
+    }
+    if (avformat_find_stream_info(fmtCtx, nullptr) < 0)
+    {
+        std::cerr << "[VideoPlayer] No stream info in " << filename << std::endl;
+        release();
+        return false;
+    }
+
+    videoStreamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (videoStreamIndex < 0)
+    {
+        std::cerr << "[VideoPlayer] No video stream in " << filename << std::endl;
+        release();
+        return false;
+    }
+    // Only the video stream is demuxed at all; audio and data packets are dropped by libavformat.
+    for (unsigned i = 0; i < fmtCtx->nb_streams; i++)
+    {
+        if (int(i) != videoStreamIndex)
+            fmtCtx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    AVStream* stream = fmtCtx->streams[videoStreamIndex];
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    codecCtx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!codecCtx || avcodec_parameters_to_context(codecCtx, stream->codecpar) < 0 || avcodec_open2(codecCtx, codec, nullptr) < 0)
+    {
+        std::cerr << "[VideoPlayer] No decoder for " << filename << std::endl;
+        release();
+        return false;
+    }
+
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!frame || !packet)
+    {
+        release();
+        return false;
+    }
+    sourceWidth = codecCtx->width;
+    sourceHeight = codecCtx->height;
+    outputWidth = sourceWidth;
+    outputHeight = sourceHeight;
+
+    timeBase = av_q2d(stream->time_base);
+    startTime = stream->start_time != AV_NOPTS_VALUE ? stream->start_time * timeBase : 0.0;
+    const AVRational rate = av_guess_frame_rate(fmtCtx, stream, nullptr);
+    frameDuration = rate.num > 0 && rate.den > 0 ? av_q2d(av_inv_q(rate)) : 1.0 / 30.0;
+    if (stream->duration != AV_NOPTS_VALUE)
+        fileDuration = stream->duration * timeBase;
+    else if (fmtCtx->duration != AV_NOPTS_VALUE)
+        fileDuration = double(fmtCtx->duration) / AV_TIME_BASE;
+
+    mode = uploadMode;
+    conversionView = view;
+    if (mode == UploadMode::YuvPlanes && !createConversion())
+    {
+        std::cout << "[VideoPlayer] YUV shader not found, uploading RGBA" << std::endl;
+        destroyTextures();
+        mode = UploadMode::Rgba;
+    }
+    createTextures(sourceWidth, sourceHeight);
+
+    const size_t frameSize = uploadBytes();
+    for (size_t i = 0; i < POOL_SIZE; ++i)
+    {
+        Frame* slot = new Frame();
+        slot->pixels = static_cast<uint8_t*>(av_malloc(frameSize));
+        slot->size = frameSize;
+        pool.push_back(slot);
+    }
+    ready.clear();
+    stopping = false;
+    atEnd = false;
+    seekPending = false;
+    seekSerial = 0;
+    clockStarted = false;
+    clockSerial = 0;
+    shownPosition = 0.0;
+    dropped = 0;
+
+    decoder = std::thread(&VideoPlayer::decodeLoop, this);
+    return true;
+}
+
+uint32_t VideoPlayer::uploadBytes() const
+{
+    if (mode == UploadMode::YuvPlanes)
+        return uint32_t(width * height + 2 * chromaWidth * chromaHeight);
+    return uint32_t(width * height * 4);
+}
+
+bool VideoPlayer::createConversion()
+{
+    yuvProgram = ShaderLoader::loadProgram("shaders\\v_text.bin", "shaders\\f_video_yuv.bin");
+    if (!bgfx::isValid(yuvProgram))
+        return false;
+    u_videoY = bgfx::createUniform("u_videoY", bgfx::UniformType::Sampler);
+    u_videoU = bgfx::createUniform("u_videoU", bgfx::UniformType::Sampler);
+    u_videoV = bgfx::createUniform("u_videoV", bgfx::UniformType::Sampler);
+    u_videoMatrix = bgfx::createUniform("u_videoMatrix", bgfx::UniformType::Vec4, 3);
+
+    // Fullscreen quad, so the UI samples the converted frame the right way up.
+    ShaderLoader::createFullscreenQuad(quadVbh, quadIbh);
+    return true;
+}
+
+// (Re)creates the textures frames are uploaded to, at the size of the frames.
+void VideoPlayer::createTextures(int textureWidth, int textureHeight)
+{
+    if (bgfx::isValid(target)) bgfx::destroy(target);
+    if (bgfx::isValid(texture)) bgfx::destroy(texture);
+    for (bgfx::TextureHandle& plane : planes)
+    {
+        if (bgfx::isValid(plane)) bgfx::destroy(plane);
+        plane = BGFX_INVALID_HANDLE;
+    }
+    target = BGFX_INVALID_HANDLE;
+    width = textureWidth;
+    height = textureHeight;
+    chromaWidth = (width + 1) / 2;
+    chromaHeight = (height + 1) / 2;
+
+    if (mode == UploadMode::Rgba)
+    {
+        texture = bgfx::createTexture2D((uint16_t)width, (uint16_t)height, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, nullptr);
+        return;
+    }
+    const uint64_t planeFlags = BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP;
+    planes[0] = bgfx::createTexture2D((uint16_t)width, (uint16_t)height, false, 1, bgfx::TextureFormat::R8, planeFlags);
+    planes[1] = bgfx::createTexture2D((uint16_t)chromaWidth, (uint16_t)chromaHeight, false, 1, bgfx::TextureFormat::R8, planeFlags);
+    planes[2] = bgfx::createTexture2D((uint16_t)chromaWidth, (uint16_t)chromaHeight, false, 1, bgfx::TextureFormat::R8, planeFlags);
+    texture = bgfx::createTexture2D((uint16_t)width, (uint16_t)height, false, 1, bgfx::TextureFormat::RGBA8,
+        BGFX_TEXTURE_RT | BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+    target = bgfx::createFrameBuffer(1, &texture, false);
+}
+
+void VideoPlayer::destroyTextures()
+{
+    auto destroyIfValid = [](auto& handle) {
+        if (bgfx::isValid(handle))
+            bgfx::destroy(handle);
+        handle = BGFX_INVALID_HANDLE;
+    };
+    destroyIfValid(target);
+    destroyIfValid(texture);
+    for (bgfx::TextureHandle& plane : planes)
+        destroyIfValid(plane);
+    destroyIfValid(yuvProgram);
+    destroyIfValid(u_videoY);
+    destroyIfValid(u_videoU);
+    destroyIfValid(u_videoV);
+    destroyIfValid(u_videoMatrix);
+    destroyIfValid(quadVbh);
+    destroyIfValid(quadIbh);
+}
+
+void VideoPlayer::shutdown()
+{
+    stopDecoder();
+    release();
+    destroyTextures();
+}
+
+void VideoPlayer::stopDecoder()
+{
+    if (!decoder.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    decoder.join();
+}
+
+void VideoPlayer::release()
+{
+    if (packet) av_packet_free(&packet);
+    if (frame) av_frame_free(&frame);
+    if (codecCtx) avcodec_free_context(&codecCtx);
+    if (fmtCtx) avformat_close_input(&fmtCtx);
+    if (swsCtx) sws_freeContext(swsCtx);
+    swsCtx = nullptr;
+    // Frames bgfx still reads are freed by their release callback instead.
+    for (Frame* slot : pool)
+        unref(slot);
+    pool.clear();
+    ready.clear();
+}
+
+void VideoPlayer::unref(Frame* slot)
+{
+    if (slot->refs.fetch_sub(1) == 1)
+    {
+        av_free(slot->pixels);
+        delete slot;
+    }
+}
+
+// bgfx is done with an upload, may run on the render thread.
+void VideoPlayer::releaseUpload(void* /*ptr*/, void* userData)
+{
+    unref(static_cast<Frame*>(userData));
+}
+
+void VideoPlayer::setPaused(bool pause)
+{
+    if (pause == paused)
+        return;
+    const Clock::time_point now = Clock::now();
+    if (pause)
+        pausedAt = now;
+    else
+        clockStart += now - pausedAt; // the clock stood still while paused
+    paused = pause;
+}
+
+void VideoPlayer::setLooping(bool loop)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        looping = loop;
+    }
+    wake.notify_all();
+}
+
+void VideoPlayer::setDisplaySize(int displayWidth, int displayHeight)
+{
+    if (sourceWidth <= 0 || sourceHeight <= 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    outputWidth = std::clamp(displayWidth, 1, sourceWidth);
+    outputHeight = std::clamp(displayHeight, 1, sourceHeight);
+}
+
+void VideoPlayer::seek(double seconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seekTarget = std::max(0.0, seconds);
+        seekSerial++;
+        seekPending = true;
+    }
+    wake.notify_all();
+}
+
+double VideoPlayer::playbackClock(Clock::time_point now) const
+{
+    const Clock::time_point at = paused ? pausedAt : now;
+    return clockBase + std::chrono::duration<double>(at - clockStart).count();
+}
+
+void VideoPlayer::update()
+{
+    if (!bgfx::isValid(texture))
+        return;
+
+    const Clock::time_point now = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // Frames decoded before the latest seek are of no use any more.
+    while (!ready.empty() && ready.front()->serial != seekSerial)
+    {
+        ready.front()->busy = false;
+        ready.pop_front();
+    }
+
+    Frame* show = nullptr;
+    if (!ready.empty() && (!clockStarted || clockSerial != ready.front()->serial))
+    {
+        // First frame after loading or seeking: the clock starts at its time.
+        clockBase = ready.front()->time;
+        clockStart = now;
+        pausedAt = now;
+        clockSerial = ready.front()->serial;
+        clockStarted = true;
+        show = ready.front();
+    }
+    else if (!ready.empty() && !paused)
+    {
+        // The newest frame that is due; older due frames were late and are skipped.
+        const double clock = playbackClock(now);
+        size_t due = 0;
+        while (due < ready.size() && ready[due]->time <= clock)
+            due++;
+        for (; due > 1; --due, ++dropped)
+        {
+            ready.front()->busy = false;
+            ready.pop_front();
+        }
+        if (due == 1)
+            show = ready.front();
+    }
+
+    if (show)
+    {
+        // bgfx's references keep the decoder away from the pixels until they are released.
+        show->refs.fetch_add(mode == UploadMode::YuvPlanes ? 3 : 1);
+        show->busy = false;
+        shownPosition = show->position;
+        ready.pop_front();
+    }
+    lock.unlock();
+    // Also wakes the decoder for buffers bgfx released since the last frame.
+    wake.notify_all();
+
+    if (show)
+        upload(*show);
+}
+
+void VideoPlayer::upload(Frame& shown)
+{
+    // The display size changed since the last shown frame.
+    if (shown.width != width || shown.height != height)
+        createTextures(shown.width, shown.height);
+
+    if (mode == UploadMode::Rgba)
+    {
+        bgfx::updateTexture2D(texture, 0, 0, 0, 0, (uint16_t)width, (uint16_t)height,
+            bgfx::makeRef(shown.pixels, uploadBytes(), releaseUpload, &shown));
+        return;
+    }
+
+    const uint32_t lumaSize = uint32_t(width * height);
+    const uint32_t chromaSize = uint32_t(chromaWidth * chromaHeight);
+    bgfx::updateTexture2D(planes[0], 0, 0, 0, 0, (uint16_t)width, (uint16_t)height,
+        bgfx::makeRef(shown.pixels, lumaSize, releaseUpload, &shown));
+    bgfx::updateTexture2D(planes[1], 0, 0, 0, 0, (uint16_t)chromaWidth, (uint16_t)chromaHeight,
+        bgfx::makeRef(shown.pixels + lumaSize, chromaSize, releaseUpload, &shown));
+    bgfx::updateTexture2D(planes[2], 0, 0, 0, 0, (uint16_t)chromaWidth, (uint16_t)chromaHeight,
+        bgfx::makeRef(shown.pixels + lumaSize + chromaSize, chromaSize, releaseUpload, &shown));
+
+    bgfx::setViewName(conversionView, "Video YUV");
+    bgfx::setViewFrameBuffer(conversionView, target);
+    bgfx::setViewRect(conversionView, 0, 0, (uint16_t)width, (uint16_t)height);
+    bgfx::setViewTransform(conversionView, nullptr, nullptr);
+    bgfx::setViewClear(conversionView, BGFX_CLEAR_NONE);
+
+    float rows[12];
+    videoMatrix(shown.bt709, shown.fullRange, rows);
+    bgfx::setUniform(u_videoMatrix, rows, 3);
+    bgfx::setTexture(0, u_videoY, planes[0]);
+    bgfx::setTexture(1, u_videoU, planes[1]);
+    bgfx::setTexture(2, u_videoV, planes[2]);
+
+    float identity[16];
+    bx::mtxIdentity(identity);
+    bgfx::setTransform(identity);
+    bgfx::setVertexBuffer(0, quadVbh);
+    bgfx::setIndexBuffer(quadIbh);
+    bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A);
+    bgfx::submit(conversionView, yuvProgram);
+}
+
+// Decoder thread. Waits while every buffer is queued or uploading, and, without looping, at
+// the end of the file.
+void VideoPlayer::decodeLoop()
+{
+    uint32_t serial = 0;
+    double skipUntil = -1.0;  // after a seek, frames before the target are decoded but not shown
+    double loopOffset = 0.0;  // added to file time so the timeline keeps growing across loops
+    double lastPosition = 0.0;
+
+    auto freeFrame = [this]() -> Frame* {
+        for (Frame* slot : pool)
+        {
+            if (!slot->busy && slot->refs.load() == 1)
+                return slot;
+        }
+        return nullptr;
+    };
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || seekPending || ((!atEnd || looping) && freeFrame()); });
+            if (stopping)
+                return;
+            if (seekPending)
+            {
+                seekPending = false;
+                serial = seekSerial;
+                skipUntil = seekTarget;
+                atEnd = false;
+                lock.unlock();
+                rewind(skipUntil);
+                loopOffset = 0.0;
+                continue;
+            }
+        }
+
+        if (atEnd)
+        {
+            // End of the file with looping on: the timeline continues from the start.
+            loopOffset += lastPosition + frameDuration;
+            rewind(0.0);
+            std::lock_guard<std::mutex> lock(mutex);
+            atEnd = false;
+            continue;
+        }
+
+        if (!decodeNext())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            atEnd = true;
+            continue;
+        }
+
+        const int64_t pts = frame->best_effort_timestamp;
+        const double position = pts != AV_NOPTS_VALUE ? pts * timeBase - startTime : lastPosition + frameDuration;
+        lastPosition = position;
+        if (position + frameDuration * 0.5 < skipUntil)
+            continue;
+        skipUntil = -1.0;
+
+        // Only this thread takes free frames, so the one seen by the wait is still there.
+        Frame* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot = freeFrame();
+            slot->busy = true;
+            slot->width = outputWidth;
+            slot->height = outputHeight;
+        }
+        const bool converted = convert(*slot);
+        slot->time = position + loopOffset;
+        slot->position = position;
+        slot->serial = serial;
+        av_frame_unref(frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (converted)
+            ready.push_back(slot);
+        else
+            slot->busy = false;
+    }
+}
+
+// Turns the decoded frame into the slot's upload layout, scaled to the slot's size.
+bool VideoPlayer::convert(Frame& slot)
+{
+    const AVPixelFormat format = AVPixelFormat(frame->format);
+    if (frame->colorspace == AVCOL_SPC_BT709)
+        slot.bt709 = true;
+    else if (frame->colorspace == AVCOL_SPC_BT470BG || frame->colorspace == AVCOL_SPC_SMPTE170M)
+        slot.bt709 = false;
+    else
+        slot.bt709 = frame->height >= 720; // untagged: HD material is almost always BT.709
+    slot.fullRange = frame->color_range == AVCOL_RANGE_JPEG || format == AV_PIX_FMT_YUVJ420P;
+
+    if (isPlanar420(format))
+    {
+        YuvConverter::Planes source;
+        for (int p = 0; p < 3; ++p)
+        {
+            source.data[p] = frame->data[p];
+            source.stride[p] = frame->linesize[p];
+        }
+        source.width = frame->width;
+        source.height = frame->height;
+        if (mode == UploadMode::YuvPlanes)
+            YuvConverter::scalePlanes(source, slot.pixels, slot.width, slot.height);
+        else
+            YuvConverter::toRgba(source, slot.bt709, slot.fullRange, slot.pixels, slot.width, slot.height);
+        return true;
+    }
+
+    const AVPixelFormat target = mode == UploadMode::YuvPlanes ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_RGBA;
+    swsCtx = sws_getCachedContext(swsCtx, frame->width, frame->height, format, slot.width, slot.height, target, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!swsCtx)
+        return false;
+    uint8_t* dst[4] = { slot.pixels, nullptr, nullptr, nullptr };
+    int dstStride[4] = { slot.width * 4, 0, 0, 0 };
+    if (mode == UploadMode::YuvPlanes)
+    {
+        // Other formats are resampled to limited range 4:2:0 first.
+        const int slotChromaWidth = (slot.width + 1) / 2;
+        const int slotChromaHeight = (slot.height + 1) / 2;
+        dst[1] = slot.pixels + size_t(slot.width) * slot.height;
+        dst[2] = dst[1] + size_t(slotChromaWidth) * slotChromaHeight;
+        dstStride[0] = slot.width;
+        dstStride[1] = slotChromaWidth;
+        dstStride[2] = slotChromaWidth;
+        slot.fullRange = false;
+    }
+    else
+    {
+        // Same matrix the shader path would use.
+        const int* coefficients = sws_getCoefficients(slot.bt709 ? SWS_CS_ITU709 : SWS_CS_ITU601);
+        sws_setColorspaceDetails(swsCtx, coefficients, slot.fullRange ? 1 : 0, sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+    }
+    sws_scale(swsCtx, frame->data, frame->linesize, 0, frame->height, dst, dstStride);
+    return true;
+}
+
+// Next decoded frame into frame. False at the end of the file (after draining the decoder) or
+// on a decode error.
+bool VideoPlayer::decodeNext()
+{
+    for (;;)
+    {
+        int response = avcodec_receive_frame(codecCtx, frame);
+        if (response >= 0)
+            return true;
+        if (response != AVERROR(EAGAIN))
+            return false;
+
+        if (av_read_frame(fmtCtx, packet) < 0)
+        {
+            avcodec_send_packet(codecCtx, nullptr); // drain the frames still in the decoder
+            continue;
+        }
+        if (packet->stream_index == videoStreamIndex)
+            avcodec_send_packet(codecCtx, packet);
+        av_packet_unref(packet);
+    }
+}
+
+void VideoPlayer::rewind(double seconds)
+{
+    const int64_t timestamp = int64_t(std::llround((seconds + startTime) / timeBase));
+    if (av_seek_frame(fmtCtx, videoStreamIndex, timestamp, AVSEEK_FLAG_BACKWARD) < 0)
+        std::cerr << "[VideoPlayer] Seek to " << seconds << " s failed" << std::endl;
+    avcodec_flush_buffers(codecCtx);
+}
@@ -7,97 +7,147 @@ extern "C" {
 }
 #include <bgfx/bgfx.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Plays a video into a bgfx texture. A decode thread reads and decodes packets and converts the
+// frames into a small pool of upload buffers; update() on the main thread shows the frame whose
+// presentation time matches the playback clock, so playback speed no longer depends on the
+// frame rate and a slow decode never blocks rendering (the last frame just stays up).
+//
+// Shown frames go to bgfx through makeRef without a copy. A buffer returns to the pool only
+// from the release callback, once bgfx no longer reads it, so the decoder never overwrites
+// pixels that are still being uploaded.
+//
+// Frames are scaled on the decode thread to the size they are displayed at (never above the
+// source), so a 4K file shown in a 1080p window uploads and converts a quarter of the pixels.
+// 4:2:0 sources go through YuvConverter; other formats through swscale.
 class VideoPlayer
 {
 public:
-    AVFormatContext* fmtCtx = nullptr;
-    AVCodecContext* codecCtx = nullptr;
-    AVFrame* frame = nullptr;
-    AVFrame* rgbFrame = nullptr;
-    AVPacket* packet = nullptr;
-    SwsContext* swsCtx = nullptr;
-    int videoStreamIndex = -1;
-    bgfx::TextureHandle texture = BGFX_INVALID_HANDLE;
-    int width = 0, height = 0;
-    uint8_t* buffer = nullptr;
-
-    bool load(const char* filename)
+    enum class UploadMode
     {
-        avformat_open_input(&fmtCtx, filename, nullptr, nullptr);
-        avformat_find_stream_info(fmtCtx, nullptr);
+        Rgba,      // converted to RGBA on the decode thread, 4 bytes per pixel
+        YuvPlanes, // Y, U and V as R8 textures, 1.5 bytes per pixel, converted by a shader pass
+    };
+
+    bgfx::TextureHandle texture = BGFX_INVALID_HANDLE; // RGBA result, what the UI draws
+    int width = 0, height = 0;                         // of texture, follows setDisplaySize
 
-        videoStreamIndex = -1;
-        for (unsigned i = 0; i < fmtCtx->nb_streams; i++)
-        {
-            if (fmtCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
-            {
-                videoStreamIndex = i;
-                break;
-            }
-        }
-        if (videoStreamIndex == -1) return false;
+    VideoPlayer() = default;
+    ~VideoPlayer();
+    VideoPlayer(const VideoPlayer&) = delete;
+    VideoPlayer& operator=(const VideoPlayer&) = delete;
 
-        AVCodec* codec = const_cast<AVCodec*>(avcodec_find_decoder(fmtCtx->streams[videoStreamIndex]->codecpar->codec_id));
-        codecCtx = avcodec_alloc_context3(codec);
-        avcodec_parameters_to_context(codecCtx, fmtCtx->streams[videoStreamIndex]->codecpar);
-        avcodec_open2(codecCtx, codec, nullptr);
+    // YuvPlanes renders the conversion in conversionView (before the UI view) and falls back to
+    // Rgba when the shader is missing.
+    bool load(const char* filename, UploadMode mode = UploadMode::Rgba, bgfx::ViewId conversionView = 0);
+    // Main thread, once per frame.
+    void update();
+    // Stops the decode thread, frees the decoder and the textures. Call before bgfx::shutdown().
+    void shutdown();
 
-        frame = av_frame_alloc();
-        rgbFrame = av_frame_alloc();
-        packet = av_packet_alloc();
+    void setPaused(bool paused);
+    bool isPaused() const { return paused; }
+    void setLooping(bool looping);
+    // Size the video is drawn at in pixels; frames decoded from now on are scaled to it.
+    void setDisplaySize(int displayWidth, int displayHeight);
+    // Seconds from the start of the file. The frame at that time is shown even while paused.
+    void seek(double seconds);
+    double position() const { return shownPosition; }
+    double duration() const { return fileDuration; }
+    uint32_t droppedFrames() const { return dropped; }
+    UploadMode uploadMode() const { return mode; }
+    // Bytes handed to bgfx per shown frame.
+    uint32_t uploadBytes() const;
 
-        width = codecCtx->width;
-        height = codecCtx->height;
+private:
+    using Clock = std::chrono::steady_clock;
 
-        swsCtx = sws_getContext(width, height, codecCtx->pix_fmt, width, height, AV_PIX_FMT_RGBA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    struct Frame
+    {
+        uint8_t* pixels = nullptr; // RGBA, or the Y, U and V planes one after the other
+        size_t size = 0;
+        double time = 0.0;     // on the playback timeline, keeps growing across loops
+        double position = 0.0; // in the file
+        int width = 0, height = 0;
+        uint32_t serial = 0;   // seek generation it was decoded for
+        bool bt709 = true;
+        bool fullRange = false;
+        bool busy = false;     // being decoded into or waiting in ready, guarded by mutex
+        // One reference for the player plus one per bgfx upload still using the pixels. The
+        // last one to let go frees the frame, so shutting down while bgfx holds a buffer is safe.
+        std::atomic<int> refs{ 1 };
+    };
 
-        int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGBA, width, height, 1);
-        buffer = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
-        av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, buffer, AV_PIX_FMT_RGBA, width, height, 1);
+    static void releaseUpload(void* ptr, void* userData);
+    static void unref(Frame* frame);
 
-        // Create bgfx texture
-        texture = bgfx::createTexture2D((uint16_t)width, (uint16_t)height, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, nullptr);
+    void decodeLoop();
+    bool decodeNext();
+    bool convert(Frame& slot);
+    void rewind(double seconds);
+    void stopDecoder();
+    void release();
+    bool createConversion();
+    void createTextures(int textureWidth, int textureHeight);
+    void destroyTextures();
+    void upload(Frame& shown);
+    double playbackClock(Clock::time_point now) const;
 
-        return true;
-    }
+    AVFormatContext* fmtCtx = nullptr;
+    AVCodecContext* codecCtx = nullptr;
+    AVFrame* frame = nullptr;
+    AVPacket* packet = nullptr;
+    SwsContext* swsCtx = nullptr;
+    int videoStreamIndex = -1;
+    double timeBase = 0.0;
+    double startTime = 0.0;
+    double frameDuration = 1.0 / 30.0;
+    double fileDuration = 0.0;
+    int sourceWidth = 0, sourceHeight = 0;
 
-    void update()
-    {
-        if (av_read_frame(fmtCtx, packet) >= 0)
-        {
-            if (packet->stream_index == videoStreamIndex)
-            {
-                int response = avcodec_send_packet(codecCtx, packet);
-                if (response >= 0)
-                {
-                    response = avcodec_receive_frame(codecCtx, frame);
-                    if (response >= 0)
-                    {
-                        sws_scale(swsCtx, frame->data, frame->linesize, 0, codecCtx->height, rgbFrame->data, rgbFrame->linesize);
+    UploadMode mode = UploadMode::Rgba;
+    bgfx::ViewId conversionView = 0;
+    int chromaWidth = 0, chromaHeight = 0;
+    bgfx::TextureHandle planes[3] = { BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE, BGFX_INVALID_HANDLE };
+    bgfx::FrameBufferHandle target = BGFX_INVALID_HANDLE;
+    bgfx::ProgramHandle yuvProgram = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_videoY = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_videoU = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_videoV = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle u_videoMatrix = BGFX_INVALID_HANDLE;
+    bgfx::VertexBufferHandle quadVbh = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle quadIbh = BGFX_INVALID_HANDLE;
 
-                        const bgfx::Memory* mem = bgfx::makeRef(buffer, width * height * 4);
-                        bgfx::updateTexture2D(texture, 0, 0, 0, 0, (uint16_t)width, (uint16_t)height, mem);
-                    }
-                }
-            }
-            av_packet_unref(packet);
-        }
-        else
-        {
-            // Loop video: seek back to start
-            av_seek_frame(fmtCtx, videoStreamIndex, 0, AVSEEK_FLAG_BACKWARD);
-        }
-    }
+    // Upload buffer pool. The decode thread takes a frame that is neither busy nor referenced by
+    // bgfx, fills it and appends it to ready; update() takes frames from the front.
+    std::vector<Frame*> pool;
+    std::deque<Frame*> ready;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread decoder;
+    bool stopping = false;
+    bool looping = true;
+    bool atEnd = false;
+    bool seekPending = false;
+    double seekTarget = 0.0;
+    uint32_t seekSerial = 0;
+    int outputWidth = 0, outputHeight = 0; // what the decoder scales to
 
-    void shutdown()
-    {
-        if (texture.idx != bgfx::kInvalidHandle) bgfx::destroy(texture);
-        if (packet) av_packet_free(&packet);
-        if (frame) av_frame_free(&frame);
-        if (rgbFrame) av_frame_free(&rgbFrame);
-        if (codecCtx) avcodec_free_context(&codecCtx);
-        if (fmtCtx) avformat_close_input(&fmtCtx);
-        if (buffer) av_free(buffer);
-        if (swsCtx) sws_freeContext(swsCtx);
-    }
-};
\ No newline at end of file
+    // Main thread playback clock.
+    bool paused = false;
+    bool clockStarted = false;
+    uint32_t clockSerial = 0;
+    double clockBase = 0.0;
+    Clock::time_point clockStart;
+    Clock::time_point pausedAt;
+    double shownPosition = 0.0;
+    uint32_t dropped = 0;
+};
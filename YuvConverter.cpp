@@ -0,0 +1,469 @@
+#include "YuvConverter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "ParallelFor.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define YUV_CONVERTER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles every intrinsic regardless of /arch, the CPU check happens at runtime.
+#define YUV_TARGET_SSE41
+#define YUV_TARGET_AVX2
+#else
+#define YUV_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define YUV_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    const int MIN_SLICE_ROWS = 16;
+    const int COEFFICIENT_BITS = 13;
+
+    // R = (y * Y + rv * V + r0) >> 13, G = (y * Y + gu * U + gv * V + g0) >> 13,
+    // B = (y * Y + bu * U + b0) >> 13 on the raw 8-bit samples; offsets include the rounding.
+    struct Coefficients
+    {
+        int16_t y, rv, gu, gv, bu;
+        int32_t r0, g0, b0;
+    };
+
+    Coefficients coefficients(bool bt709, bool fullRange)
+    {
+        const double kr = bt709 ? 0.2126 : 0.299;
+        const double kb = bt709 ? 0.0722 : 0.114;
+        const double kg = 1.0 - kr - kb;
+        const double ys = fullRange ? 1.0 : 255.0 / 219.0;
+        const double yOffset = fullRange ? 0.0 : -16.0 * ys;
+        const double cs = fullRange ? 1.0 : 255.0 / 224.0;
+
+        const double rv = 2.0 * (1.0 - kr) * cs;
+        const double gu = -2.0 * (1.0 - kb) * kb / kg * cs;
+        const double gv = -2.0 * (1.0 - kr) * kr / kg * cs;
+        const double bu = 2.0 * (1.0 - kb) * cs;
+        const double one = double(1 << COEFFICIENT_BITS);
+        const double round = double(1 << (COEFFICIENT_BITS - 1));
+
+        Coefficients c;
+        c.y = int16_t(std::lround(ys * one));
+        c.rv = int16_t(std::lround(rv * one));
+        c.gu = int16_t(std::lround(gu * one));
+        c.gv = int16_t(std::lround(gv * one));
+        c.bu = int16_t(std::lround(bu * one));
+        c.r0 = int32_t(std::lround((yOffset - 128.0 * rv) * one + round));
+        c.g0 = int32_t(std::lround((yOffset - 128.0 * (gu + gv)) * one + round));
+        c.b0 = int32_t(std::lround((yOffset - 128.0 * bu) * one + round));
+        return c;
+    }
+
+    uint8_t clampToByte(int value)
+    {
+        return uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    // One output row to RGBA. u and v hold one sample per two pixels, like the source rows, so
+    // at 1:1 the kernels read the decoded planes directly.
+    void convertRowScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgba, int width, const Coefficients& c)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            const int luma = y[x] * c.y;
+            const int cb = u[x >> 1];
+            const int cr = v[x >> 1];
+            rgba[x * 4 + 0] = clampToByte((luma + cr * c.rv + c.r0) >> COEFFICIENT_BITS);
+            rgba[x * 4 + 1] = clampToByte((luma + cb * c.gu + cr * c.gv + c.g0) >> COEFFICIENT_BITS);
+            rgba[x * 4 + 2] = clampToByte((luma + cb * c.bu + c.b0) >> COEFFICIENT_BITS);
+            rgba[x * 4 + 3] = 255;
+        }
+    }
+
+    // out = (top * (256 - weight) + bottom * weight + 128) >> 8, the vertical half of the bilinear filter.
+    void blendRowsScalar(const uint8_t* top, const uint8_t* bottom, int weight, uint8_t* out, int width)
+    {
+        const int keep = 256 - weight;
+        for (int x = 0; x < width; ++x)
+            out[x] = uint8_t((top[x] * keep + bottom[x] * weight + 128) >> 8);
+    }
+
+#ifdef YUV_CONVERTER_X86
+    // Two 16-bit coefficients per 32-bit lane for _mm_madd_epi16: low * first + high * second.
+    int32_t pair(int16_t low, int16_t high)
+    {
+        return int32_t(uint32_t(uint16_t(low)) | (uint32_t(uint16_t(high)) << 16));
+    }
+
+    // 4 chroma samples, each repeated for its two pixels.
+    YUV_TARGET_SSE41 __m128i doubleSamples(const uint8_t* samples)
+    {
+        int32_t packed;
+        std::memcpy(&packed, samples, sizeof(packed));
+        const __m128i c = _mm_cvtsi32_si128(packed);
+        return _mm_unpacklo_epi8(c, c);
+    }
+
+    // 8 chroma samples, each repeated for its two pixels.
+    YUV_TARGET_SSE41 __m128i doubleSamples8(const uint8_t* samples)
+    {
+        const __m128i c = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(samples));
+        return _mm_unpacklo_epi8(c, c);
+    }
+
+    YUV_TARGET_SSE41 void convertRowSse41(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgba, int width, const Coefficients& c)
+    {
+        const __m128i yr = _mm_set1_epi32(pair(c.y, c.rv));
+        const __m128i yg = _mm_set1_epi32(pair(c.y, c.gu));
+        const __m128i vg = _mm_set1_epi32(pair(c.gv, 0));
+        const __m128i yb = _mm_set1_epi32(pair(c.y, c.bu));
+        const __m128i r0 = _mm_set1_epi32(c.r0);
+        const __m128i g0 = _mm_set1_epi32(c.g0);
+        const __m128i b0 = _mm_set1_epi32(c.b0);
+        const __m128i alpha = _mm_set1_epi16(255);
+        const __m128i zero = _mm_setzero_si128();
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m128i y16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)));
+            const __m128i u16 = _mm_cvtepu8_epi16(doubleSamples(u + x / 2));
+            const __m128i v16 = _mm_cvtepu8_epi16(doubleSamples(v + x / 2));
+
+            const __m128i yvLo = _mm_unpacklo_epi16(y16, v16), yvHi = _mm_unpackhi_epi16(y16, v16);
+            const __m128i yuLo = _mm_unpacklo_epi16(y16, u16), yuHi = _mm_unpackhi_epi16(y16, u16);
+            const __m128i v0Lo = _mm_unpacklo_epi16(v16, zero), v0Hi = _mm_unpackhi_epi16(v16, zero);
+
+            const __m128i rLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvLo, yr), r0), COEFFICIENT_BITS);
+            const __m128i rHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yvHi, yr), r0), COEFFICIENT_BITS);
+            const __m128i gLo = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, yg), _mm_madd_epi16(v0Lo, vg)), g0), COEFFICIENT_BITS);
+            const __m128i gHi = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, yg), _mm_madd_epi16(v0Hi, vg)), g0), COEFFICIENT_BITS);
+            const __m128i bLo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuLo, yb), b0), COEFFICIENT_BITS);
+            const __m128i bHi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(yuHi, yb), b0), COEFFICIENT_BITS);
+
+            // Saturate to bytes and interleave: [R0..7 B0..7] + [G0..7 A0..7] -> RGBA pixels.
+            const __m128i rb = _mm_packus_epi16(_mm_packs_epi32(rLo, rHi), _mm_packs_epi32(bLo, bHi));
+            const __m128i ga = _mm_packus_epi16(_mm_packs_epi32(gLo, gHi), alpha);
+            const __m128i rg = _mm_unpacklo_epi8(rb, ga);
+            const __m128i ba = _mm_unpackhi_epi8(rb, ga);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + x * 4), _mm_unpacklo_epi16(rg, ba));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + x * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+        }
+        convertRowScalar(y + x, u + x / 2, v + x / 2, rgba + x * 4, width - x, c);
+    }
+
+    // The sums stay below 65536, so plain 16-bit multiplies and a logical shift are exact.
+    YUV_TARGET_SSE41 void blendRowsSse41(const uint8_t* top, const uint8_t* bottom, int weight, uint8_t* out, int width)
+    {
+        const __m128i keep = _mm_set1_epi16(short(256 - weight));
+        const __m128i take = _mm_set1_epi16(short(weight));
+        const __m128i round = _mm_set1_epi16(128);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + x)));
+            const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bottom + x)));
+            const __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(a, keep), _mm_mullo_epi16(b, take)), round);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(_mm_srli_epi16(sum, 8), _mm_setzero_si128()));
+        }
+        blendRowsScalar(top + x, bottom + x, weight, out + x, width - x);
+    }
+
+    YUV_TARGET_AVX2 void blendRowsAvx2(const uint8_t* top, const uint8_t* bottom, int weight, uint8_t* out, int width)
+    {
+        const __m256i keep = _mm256_set1_epi16(short(256 - weight));
+        const __m256i take = _mm256_set1_epi16(short(weight));
+        const __m256i round = _mm256_set1_epi16(128);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + x)));
+            const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + x)));
+            const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, keep), _mm256_mullo_epi16(b, take)), round);
+            const __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(sum, 8), _mm256_setzero_si256());
+            // packus works per 128-bit half, the 8 result bytes of each half go next to each other
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08)));
+        }
+        blendRowsSse41(top + x, bottom + x, weight, out + x, width - x);
+    }
+
+    // Same as the SSE4.1 kernel on 16 pixels. The unpacks and packs work inside each 128-bit
+    // half, which puts pixels 0-3/8-11 and 4-7/12-15 together; only the stores need a permute.
+    YUV_TARGET_AVX2 void convertRowAvx2(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgba, int width, const Coefficients& c)
+    {
+        const __m256i yr = _mm256_set1_epi32(pair(c.y, c.rv));
+        const __m256i yg = _mm256_set1_epi32(pair(c.y, c.gu));
+        const __m256i vg = _mm256_set1_epi32(pair(c.gv, 0));
+        const __m256i yb = _mm256_set1_epi32(pair(c.y, c.bu));
+        const __m256i r0 = _mm256_set1_epi32(c.r0);
+        const __m256i g0 = _mm256_set1_epi32(c.g0);
+        const __m256i b0 = _mm256_set1_epi32(c.b0);
+        const __m256i alpha = _mm256_set1_epi16(255);
+        const __m256i zero = _mm256_setzero_si256();
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+            const __m256i u16 = _mm256_cvtepu8_epi16(doubleSamples8(u + x / 2));
+            const __m256i v16 = _mm256_cvtepu8_epi16(doubleSamples8(v + x / 2));
+
+            const __m256i yvLo = _mm256_unpacklo_epi16(y16, v16), yvHi = _mm256_unpackhi_epi16(y16, v16);
+            const __m256i yuLo = _mm256_unpacklo_epi16(y16, u16), yuHi = _mm256_unpackhi_epi16(y16, u16);
+            const __m256i v0Lo = _mm256_unpacklo_epi16(v16, zero), v0Hi = _mm256_unpackhi_epi16(v16, zero);
+
+            const __m256i rLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yvLo, yr), r0), COEFFICIENT_BITS);
+            const __m256i rHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yvHi, yr), r0), COEFFICIENT_BITS);
+            const __m256i gLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuLo, yg), _mm256_madd_epi16(v0Lo, vg)), g0), COEFFICIENT_BITS);
+            const __m256i gHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuHi, yg), _mm256_madd_epi16(v0Hi, vg)), g0), COEFFICIENT_BITS);
+            const __m256i bLo = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuLo, yb), b0), COEFFICIENT_BITS);
+            const __m256i bHi = _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(yuHi, yb), b0), COEFFICIENT_BITS);
+
+            const __m256i rb = _mm256_packus_epi16(_mm256_packs_epi32(rLo, rHi), _mm256_packs_epi32(bLo, bHi));
+            const __m256i ga = _mm256_packus_epi16(_mm256_packs_epi32(gLo, gHi), alpha);
+            const __m256i rg = _mm256_unpacklo_epi8(rb, ga);
+            const __m256i ba = _mm256_unpackhi_epi8(rb, ga);
+            const __m256i first = _mm256_unpacklo_epi16(rg, ba);  // pixels 0-3 | 8-11
+            const __m256i second = _mm256_unpackhi_epi16(rg, ba); // pixels 4-7 | 12-15
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + x * 4), _mm256_permute2x128_si256(first, second, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + x * 4 + 32), _mm256_permute2x128_si256(first, second, 0x31));
+        }
+        convertRowSse41(y + x, u + x / 2, v + x / 2, rgba + x * 4, width - x, c);
+    }
+
+    bool cpuHasSse41()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+#else
+        return __builtin_cpu_supports("sse4.1");
+#endif
+    }
+
+    bool cpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    YuvConverter::Kernel bestKernel()
+    {
+#ifdef YUV_CONVERTER_X86
+        static const YuvConverter::Kernel best = cpuHasAvx2() ? YuvConverter::Kernel::Avx2
+            : (cpuHasSse41() ? YuvConverter::Kernel::Sse41 : YuvConverter::Kernel::Scalar);
+        return best;
+#else
+        return YuvConverter::Kernel::Scalar;
+#endif
+    }
+
+    std::atomic<YuvConverter::Kernel> s_requestedKernel{ YuvConverter::Kernel::Auto };
+
+    struct RowKernels
+    {
+        void (*convert)(const uint8_t* y, const uint8_t* u, const uint8_t* v, uint8_t* rgba, int width, const Coefficients& c);
+        void (*blend)(const uint8_t* top, const uint8_t* bottom, int weight, uint8_t* out, int width);
+    };
+
+    RowKernels rowKernels(YuvConverter::Kernel kernel)
+    {
+#ifdef YUV_CONVERTER_X86
+        if (kernel == YuvConverter::Kernel::Avx2)
+            return { convertRowAvx2, blendRowsAvx2 };
+        if (kernel == YuvConverter::Kernel::Sse41)
+            return { convertRowSse41, blendRowsSse41 };
+#endif
+        (void)kernel;
+        return { convertRowScalar, blendRowsScalar };
+    }
+
+    // Bilinear sampling positions along one axis, weights in 1/256 towards index + 1. Source
+    // and destination pixel centres line up, so chroma stays centred on its luma block.
+    struct Axis
+    {
+        std::vector<int> index;
+        std::vector<int> next;  // index + 1, clamped to the last sample
+        std::vector<uint16_t> weight;
+        bool identity = false;
+    };
+
+    Axis makeAxis(int sourceSize, int destinationSize)
+    {
+        Axis axis;
+        axis.identity = sourceSize == destinationSize;
+        if (axis.identity)
+            return axis;
+        axis.index.resize(destinationSize);
+        axis.next.resize(destinationSize);
+        axis.weight.resize(destinationSize);
+        const double step = double(sourceSize) / double(destinationSize);
+        for (int i = 0; i < destinationSize; ++i)
+        {
+            const double position = std::clamp((i + 0.5) * step - 0.5, 0.0, double(sourceSize - 1));
+            int index = int(position);
+            int weight = int(std::lround((position - index) * 256.0));
+            if (weight == 256)
+            {
+                index++;
+                weight = 0;
+            }
+            if (index >= sourceSize - 1)
+            {
+                index = sourceSize - 1;
+                weight = 0;
+            }
+            axis.index[i] = index;
+            axis.next[i] = std::min(index + 1, sourceSize - 1);
+            axis.weight[i] = uint16_t(weight);
+        }
+        return axis;
+    }
+
+    // One output row of a plane, either straight from the source or resampled into out.
+    // scratch holds the vertically blended source row, sourceWidth bytes.
+    const uint8_t* sampleRow(const RowKernels& kernels, const uint8_t* plane, int stride, int sourceWidth, const Axis& rows,
+        const Axis& columns, int row, int outWidth, uint8_t* out, uint8_t* scratch)
+    {
+        const uint8_t* source = plane + size_t(rows.identity ? row : rows.index[row]) * stride;
+        const int rowWeight = rows.identity ? 0 : rows.weight[row];
+        if (rowWeight != 0)
+        {
+            kernels.blend(source, source + stride, rowWeight, scratch, sourceWidth);
+            source = scratch;
+        }
+        if (columns.identity)
+            return source;
+
+        const int* index = columns.index.data();
+        const int* next = columns.next.data();
+        const uint16_t* weight = columns.weight.data();
+        for (int x = 0; x < outWidth; ++x)
+            out[x] = uint8_t((source[index[x]] * (256 - weight[x]) + source[next[x]] * weight[x] + 128) >> 8);
+        return out;
+    }
+
+    size_t sliceCount(int rows)
+    {
+        const size_t wanted = ParallelFor::threadCount() * 2;
+        return std::max<size_t>(1, std::min<size_t>(wanted, size_t(rows / MIN_SLICE_ROWS)));
+    }
+}
+
+namespace YuvConverter
+{
+    void toRgba(const Planes& src, bool bt709, bool fullRange, uint8_t* rgba, int dstWidth, int dstHeight)
+    {
+        const Coefficients c = coefficients(bt709, fullRange);
+        const RowKernels kernels = rowKernels(activeKernel());
+        const int chromaWidth = (src.width + 1) / 2;
+        const int chromaHeight = (src.height + 1) / 2;
+        const Axis lumaColumns = makeAxis(src.width, dstWidth);
+        const Axis lumaRows = makeAxis(src.height, dstHeight);
+        const int outChromaWidth = (dstWidth + 1) / 2;
+        const Axis chromaColumns = makeAxis(chromaWidth, outChromaWidth);
+        const Axis chromaRows = makeAxis(chromaHeight, (dstHeight + 1) / 2);
+
+        const size_t slices = sliceCount(dstHeight);
+        ParallelFor::run(slices, [&](size_t slice) {
+            // Per plane: the resampled output row and the vertically blended source row
+            thread_local std::vector<uint8_t> lines;
+            const size_t lineSize = size_t(std::max(dstWidth, src.width)) + 64;
+            lines.resize(lineSize * 6);
+            uint8_t* line[3];
+            uint8_t* scratch[3];
+            for (int p = 0; p < 3; ++p)
+            {
+                line[p] = lines.data() + lineSize * p;
+                scratch[p] = lines.data() + lineSize * (3 + p);
+            }
+
+            const int first = int(size_t(dstHeight) * slice / slices);
+            const int last = int(size_t(dstHeight) * (slice + 1) / slices);
+            const uint8_t* u = nullptr;
+            const uint8_t* v = nullptr;
+            for (int row = first; row < last; ++row)
+            {
+                const uint8_t* y = sampleRow(kernels, src.data[0], src.stride[0], src.width, lumaRows, lumaColumns, row, dstWidth, line[0], scratch[0]);
+                // A chroma row serves two output rows.
+                if (row == first || (row & 1) == 0)
+                {
+                    u = sampleRow(kernels, src.data[1], src.stride[1], chromaWidth, chromaRows, chromaColumns, row / 2, outChromaWidth, line[1], scratch[1]);
+                    v = sampleRow(kernels, src.data[2], src.stride[2], chromaWidth, chromaRows, chromaColumns, row / 2, outChromaWidth, line[2], scratch[2]);
+                }
+                kernels.convert(y, u, v, rgba + size_t(row) * dstWidth * 4, dstWidth, c);
+            }
+        });
+    }
+
+    void scalePlanes(const Planes& src, uint8_t* dst, int dstWidth, int dstHeight)
+    {
+        const int sourceWidth[3] = { src.width, (src.width + 1) / 2, (src.width + 1) / 2 };
+        const int sourceHeight[3] = { src.height, (src.height + 1) / 2, (src.height + 1) / 2 };
+        const int outWidth[3] = { dstWidth, (dstWidth + 1) / 2, (dstWidth + 1) / 2 };
+        const int outHeight[3] = { dstHeight, (dstHeight + 1) / 2, (dstHeight + 1) / 2 };
+        uint8_t* outPlane[3];
+        outPlane[0] = dst;
+        outPlane[1] = outPlane[0] + size_t(outWidth[0]) * outHeight[0];
+        outPlane[2] = outPlane[1] + size_t(outWidth[1]) * outHeight[1];
+
+        const RowKernels kernels = rowKernels(activeKernel());
+        for (int p = 0; p < 3; ++p)
+        {
+            const Axis columns = makeAxis(sourceWidth[p], outWidth[p]);
+            const Axis rows = makeAxis(sourceHeight[p], outHeight[p]);
+            const size_t slices = sliceCount(outHeight[p]);
+            ParallelFor::run(slices, [&](size_t slice) {
+                thread_local std::vector<uint8_t> scratch;
+                scratch.resize(size_t(sourceWidth[p]) + 64);
+                const int first = int(size_t(outHeight[p]) * slice / slices);
+                const int last = int(size_t(outHeight[p]) * (slice + 1) / slices);
+                for (int row = first; row < last; ++row)
+                {
+                    uint8_t* out = outPlane[p] + size_t(row) * outWidth[p];
+                    const uint8_t* line = sampleRow(kernels, src.data[p], src.stride[p], sourceWidth[p], rows, columns, row, outWidth[p], out, scratch.data());
+                    if (line != out)
+                        std::memcpy(out, line, size_t(outWidth[p]));
+                }
+            });
+        }
+    }
+
+    void setKernel(Kernel kernel)
+    {
+        s_requestedKernel = kernel;
+    }
+
+    Kernel activeKernel()
+    {
+        const Kernel requested = s_requestedKernel.load();
+        const Kernel best = bestKernel();
+        if (requested == Kernel::Auto || int(requested) > int(best))
+            return best;
+        return requested;
+    }
+
+    const char* kernelName(Kernel kernel)
+    {
+        switch (kernel)
+        {
+        case Kernel::Scalar: return "scalar";
+        case Kernel::Sse41: return "SSE4.1";
+        case Kernel::Avx2: return "AVX2";
+        default: return "auto";
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef YUV_CONVERTER_H
+#define YUV_CONVERTER_H
+
+#include <cstdint>
+
+// 8-bit 4:2:0 video frames to RGBA, scaled straight to the size they are shown at. Rows are
+// resampled (bilinear) into line buffers and converted by a fixed-point kernel picked for the
+// CPU at startup (AVX2, SSE4.1 or plain C++); slices of rows run on the ParallelFor pool.
+namespace YuvConverter
+{
+    enum class Kernel
+    {
+        Auto,   // best the CPU supports
+        Scalar,
+        Sse41,
+        Avx2,
+    };
+
+    struct Planes
+    {
+        const uint8_t* data[3] = { nullptr, nullptr, nullptr }; // Y, U, V
+        int stride[3] = { 0, 0, 0 };
+        int width = 0;  // luma size, chroma planes are (width + 1) / 2 x (height + 1) / 2
+        int height = 0;
+    };
+
+    // rgba: dstWidth * dstHeight * 4 bytes, tightly packed. fullRange for JPEG-range sources.
+    void toRgba(const Planes& src, bool bt709, bool fullRange, uint8_t* rgba, int dstWidth, int dstHeight);
+    // Scales the planes for a GPU-side conversion. dst holds the Y, U and V planes one after the
+    // other, tightly packed, chroma at (dstWidth + 1) / 2 x (dstHeight + 1) / 2.
+    void scalePlanes(const Planes& src, uint8_t* dst, int dstWidth, int dstHeight);
+
+    // For benchmarks: a kernel the CPU does not support falls back to the best one it does.
+    void setKernel(Kernel kernel);
+    Kernel activeKernel();
+    const char* kernelName(Kernel kernel);
+}
+
+#endif // YUV_CONVERTER_H
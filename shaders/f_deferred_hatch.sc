@@ -0,0 +1,307 @@
+#ifdef GL_ES
+precision mediump float;
+varying vec2 v_texcoord0;
+#else
+in vec2 v_texcoord0;
+#endif
+
+#include <bgfx_shader.sh>
+
+// Fullscreen lighting + crosshatch pass of the deferred path. Same math as f_out28.sc,
+// but the per-object uniforms come from a parameter texture row stored in the G-buffer.
+
+// ----- Lighting uniforms -----
+uniform vec4 u_lights[64];
+uniform vec4 u_numLights; // x component holds the number of lights.
+uniform vec4 u_cameraPos;
+uniform sampler2D u_noiseTex; // Noise texture for crosshatching
+
+// ----- G-buffer -----
+uniform sampler2D u_gbufAlbedo;     // rgb = textured albedo
+uniform sampler2D u_gbufNormal;     // xyz = world normal, w = parameter row
+uniform sampler2D u_gbufDepth;
+uniform sampler2D u_objectParamTex; // one row per object, see DeferredObjectParams
+uniform mat4 u_gbufInvViewProj;
+
+// u_deferredParams.x = homogeneous depth (1.0 on OpenGL)
+// u_deferredParams.y = rows in the parameter texture
+// u_deferredParams.z = render target origin is bottom left
+// u_deferredParams.w = columns in the parameter texture
+uniform vec4 u_deferredParams;
+
+vec4 objectParam(float row, float column) {
+    vec2 uv = vec2((column + 0.5) / u_deferredParams.w, (row + 0.5) / u_deferredParams.y);
+    return texture2DLod(u_objectParamTex, uv, 0.0);
+}
+
+// ----- Helper functions for crosshatching -----
+float luma(vec3 color) {
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 blendDarken(vec3 base, vec3 ink, float opacity) {
+    return mix(base, min(base, ink), opacity);
+}
+
+float aastep(float threshold, float value) {
+#ifdef GL_OES_standard_derivatives
+    float afwidth = length(vec2(dFdx(value), dFdy(value))) * 0.70710678;
+    return smoothstep(threshold - afwidth, threshold + afwidth, value);
+#else
+    return step(threshold, value);
+#endif  
+}
+
+float texh(in vec2 p, in float str) {
+    float rz = 1.0;
+    for (int i = 0; i < 10; i++) {
+        float g = texture2D(u_noiseTex, vec2(0.025, 0.5) * p).r;
+        g = smoothstep(0.0 - str * 0.1, 2.3 - str * 0.1, g);
+        rz = min(1.0 - g, rz);
+        p = p.yx;
+        p += 0.7;
+        p *= 1.52;
+        if (float(i) > str)
+            break;
+    }
+    return rz * 1.05;
+}
+
+float texcube(in vec3 p, in vec3 n, in float str, float a) {
+    float s = sin(a);
+    float c = cos(a);
+    mat2 rot = mat2(c, -s, s, c);
+    vec3 v;
+    v.x = texh(rot * p.yz, str);
+    v.y = texh(rot * p.zx, str);
+    v.z = texh(rot * p.xy, str);
+    return dot(v, n * n);
+}
+
+void main()
+{
+    float depth = texture2D(u_gbufDepth, v_texcoord0).r;
+    if (depth >= 1.0)
+        discard;
+
+    vec4 normalRow = texture2D(u_gbufNormal, v_texcoord0);
+    vec3 tintedBase = texture2D(u_gbufAlbedo, v_texcoord0).rgb;
+    vec3 N = normalize(normalRow.xyz);
+    float row = floor(normalRow.w + 0.5);
+
+    vec4 objectColor = objectParam(row, 0.0);
+    vec4 tint        = objectParam(row, 1.0);
+    vec4 inkColor    = objectParam(row, 2.0);
+    vec4 hatch       = objectParam(row, 3.0); // epsilon, stroke multiplier, angle 1, angle 2
+    vec4 extraParams = objectParam(row, 4.0);
+    vec4 paramsLayer = objectParam(row, 5.0);
+
+    // --- Reconstruct the world position from depth ---
+    vec2 ndcXY = v_texcoord0 * 2.0 - 1.0;
+    if (u_deferredParams.z < 0.5)
+        ndcXY.y = -ndcXY.y;
+    float ndcZ = (u_deferredParams.x > 0.5) ? depth * 2.0 - 1.0 : depth;
+    vec4 worldPos = mul(u_gbufInvViewProj, vec4(ndcXY, ndcZ, 1.0));
+    vec3 v_pos = worldPos.xyz / worldPos.w;
+
+    // --- Lighting Calculation ---
+    vec3 lighting = vec3(0.0);
+    int numLights = int(u_numLights.x);
+    for (int i = 0; i < numLights; i++) {
+        int offset = i * 4;
+        float lightType = u_lights[offset].x; // 0: directional, 1: point, 2: spot.
+        float intensity = u_lights[offset].y;
+        vec3 lightPos = u_lights[offset+1].xyz;
+        vec3 lightDir = normalize(u_lights[offset+2].xyz);
+        float coneAngle = u_lights[offset+2].w; // For spotlights if needed
+        vec3 lightColor = u_lights[offset+3].rgb;
+        float range = u_lights[offset+3].w; // For attenuation if needed
+        
+        vec3 L;
+        if (lightType == 0.0) { // directional
+            L = -lightDir;
+        } else {
+            L = normalize(lightPos - v_pos);
+        }
+        float diff = max(dot(N, L), 0.0);
+
+        // For point and spot lights, apply attenuation.
+        if (lightType != 0.0) {
+            float distance = length(lightPos - v_pos);
+            // Simple linear attenuation (clamped)
+            float attenuation = clamp(1.0 - distance / range, 0.0, 1.0);
+            diff *= attenuation;
+        }
+
+        // If this is a spot light, apply a cutoff and smooth falloff.
+        if (lightType == 2.0) {
+            // Compute the angle between the light's direction and the direction from light to fragment.
+            // Here, lightDir should be the direction the spotlight is facing.
+            float theta = dot(normalize(-L), lightDir);
+            float cutoff = cos(coneAngle);
+            if (theta < cutoff) {
+                diff = 0.0;
+            } else {
+                // Optionally smooth the edge of the spotlight.
+                //float epsilon = 0.1; // adjust as needed for softness
+                //diff *= smoothstep(cutoff, cutoff + epsilon, theta);
+                diff *= smoothstep(cutoff, 1.0, theta);
+            }
+        }
+
+        lighting += lightColor * intensity * diff;
+    }
+    
+    vec3 litColor = tintedBase * lighting;
+
+    // --- Crosshatch Effect Selection ---
+    int mode = int(extraParams.w);
+    vec3 crossColor;
+
+    //mode 0 is original
+    if(mode == 0){
+        // --- Crosshatch Effect ---
+        float lumVal = luma(litColor);
+        float lVal = 1.0 - lumVal;
+        float darks = 1.0 - 2.0 * lumVal;
+
+        // Use the stroke multiplier and angle factors from u_params:
+        float strokeMult = hatch.y;
+        float angle1 = hatch.z;
+        float angle2 = hatch.w;
+
+        // Scale the world position by the pattern scale (extraParams.x)
+        vec3 p_scaled = v_pos * extraParams.x;
+
+        // Multiply the stroke multiplier by the line thickness factor (extraParams.y)
+        float line = texcube(p_scaled, N, lVal * strokeMult * extraParams.y, angle1);
+        float lineDark = texcube(p_scaled, N, darks * strokeMult * extraParams.y, angle2);
+        
+        float epsilon = hatch.x;
+        float r = 1.0 - smoothstep(lVal - epsilon, lVal + epsilon, line);
+        float rDark = 1.0 - smoothstep(lVal - epsilon, lVal + epsilon, lineDark);
+        
+        //mix(litColor, inkColor.xyz, r);
+        vec3 inkedColor = blendDarken(litColor, inkColor.xyz, 0.5 * r);
+        //vec3 crossColor = mix(inkedColor, inkColor.xyz, rDark);
+        crossColor = mix(inkedColor, inkColor.xyz, rDark);
+
+    }
+    else if (mode == 1){
+        // --- Modified Crosshatch Effect ---
+        float lumVal = luma(litColor);
+        float lVal = 1.0 - lumVal;
+
+        // Use the stroke multiplier and angle factors from u_params:
+        float strokeMult = hatch.y;
+        float angle1 = hatch.z;
+
+        // Scale the world position by the pattern scale (extraParams.x)
+        vec3 p_scaled = v_pos * extraParams.x;
+
+        // Multiply the stroke multiplier by the line thickness factor (extraParams.y)
+        float line = texcube(p_scaled, N, lVal * strokeMult * extraParams.y, angle1);
+        
+        float epsilon = hatch.x;
+        float r = 1.0 - smoothstep(lVal - epsilon, lVal + epsilon, line);
+        
+        crossColor = mix(litColor, inkColor.xyz, r);
+
+    }else if(mode == 2){
+        // --- Another Modified Crosshatch Effect ---
+
+        // --- Layer 1 ---
+        // Partial distance compensation:
+        // 1. measure distance from camera to fragment
+        float dist = length(u_cameraPos.xyz - v_pos);
+
+        // 2. pick a "referenceDist" so that if dist >= referenceDist, the pattern doesn't shrink further
+        float referenceDist = 2.0;  // e.g. 5.0 or 10.0
+
+        // 3. compute a factor that is 1.0 when dist <= referenceDist, and smaller if you come closer
+        float factor = referenceDist / max(dist, referenceDist);
+
+        // 4. combine with your usual crosshatch scale
+        float finalScale = extraParams.x * factor;
+
+        // anchor in world space
+        vec3 p_scaled = v_pos * finalScale;
+
+        float lumVal = luma(litColor);
+        float lVal   = 1.0 - lumVal;
+
+        float strokeMult = hatch.y;
+        float angle1     = hatch.z;
+        
+        float line    = texcube(p_scaled, N, lVal * strokeMult * extraParams.y, angle1);
+        float epsilon = hatch.x;
+        float r = 1.0 - smoothstep(lVal - epsilon, lVal + epsilon, line);
+        // Force a minimum hatch effect regardless of brightness:
+        // r = max(r, 0.2);
+
+        // --- Layer 2 ---
+        // strokeMult2 = 0.3, angle1test = 2.983, thickness 10.0, p_scaled2 = v_pos * 0.3
+
+        float layerPatternScale = paramsLayer.x;
+        float layerStrokeMult = paramsLayer.y;
+        float layerAngle = paramsLayer.z;
+
+        float finalScale2 = layerPatternScale * factor;
+        vec3 p_scaled2 = v_pos * finalScale2;
+
+        float line2 = texcube(p_scaled2, N, layerStrokeMult * paramsLayer.w, layerAngle);
+        float r2 = 1.0 - step(0.5, line2);
+        
+        vec3 crosshatch = mix(litColor, inkColor.xyz, r);
+
+        crossColor =  mix(crosshatch, inkColor.xyz, r2);
+
+    }else if(mode == 3){
+        // --- Layer 1 ---
+        // anchor in world space
+        vec3 p_scaled = v_pos * extraParams.x;
+
+        float lumVal = luma(litColor);
+        float lVal   = 1.0 - lumVal;
+
+        float strokeMult = hatch.y;
+        float angle1     = hatch.z;
+        
+        float line    = texcube(p_scaled, N, lVal * strokeMult * extraParams.y, angle1);
+        float epsilon = hatch.x;
+        float r = 1.0 - smoothstep(lVal - epsilon, lVal + epsilon, line);
+
+        // --- Layer 2 ---
+        // strokeMult2 = 0.3, angle1test = 2.983, thickness 10.0, p_scaled2 = v_pos * 0.3
+        float layerPatternScale = paramsLayer.x;
+        float layerStrokeMult = paramsLayer.y;
+        float layerAngle = paramsLayer.z;
+
+        vec3 p_scaled2 = v_pos * layerPatternScale;
+
+        float line2 = texcube(p_scaled2, N, layerStrokeMult * paramsLayer.w, layerAngle);
+        float r2 = 1.0 - step(0.5, line2);
+        
+        vec3 crosshatch = mix(litColor, inkColor.xyz, r);
+
+        crossColor =  mix(crosshatch, inkColor.xyz, r2);
+    }else if(mode == 4){
+        //default/simple lighting system
+        crossColor = litColor;
+    }else if(mode == 5){
+        // Tone-only hatch LOD (set by the editor for tiny objects): strokes this small would
+        // alias into grey anyway, so apply their average ink coverage without any noise lookups.
+        float lVal = 1.0 - luma(litColor);
+        crossColor = mix(litColor, inkColor.xyz, lVal * lVal);
+    }
+    
+    // Blend the crosshatch with the lit color (adjust blend factor as desired)
+    vec3 finalColor = mix(litColor, crossColor, extraParams.z);
+    
+    // --- Apply the object color override:
+    finalColor *= objectColor.rgb;
+    
+    vec4 finalColor4 = vec4(finalColor, 1.0);
+    gl_FragColor = mix(finalColor4, tint, tint.a);
+    gl_FragDepth = depth;
+}
\ No newline at end of file
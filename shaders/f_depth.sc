@@ -0,0 +1,7 @@
+#include <bgfx_shader.sh>
+
+// Depth pre-pass: color writes are disabled, only depth matters.
+void main()
+{
+    gl_FragColor = vec4_splat(0.0);
+}
@@ -0,0 +1,29 @@
+#ifdef GL_ES
+precision mediump float;
+varying vec3 v_normal;
+varying vec3 v_pos;
+varying vec2 v_texcoord0;
+#else
+in vec3 v_normal;
+in vec3 v_pos;
+in vec2 v_texcoord0;
+#endif
+
+#include <bgfx_shader.sh>
+
+// G-buffer fill for the deferred crosshatch path (see f_deferred_hatch.sc).
+// Target 0 = albedo, target 1 = world normal + row in the per-object parameter texture.
+
+uniform sampler2D u_diffuseTex;
+uniform vec4 u_uvTransform;   // (tilingU, tilingV, offsetU, offsetV)
+uniform vec4 u_albedoFactor;  // (r, g, b, a) color tint
+uniform vec4 u_objectParams;  // x = parameter row of this draw
+
+void main()
+{
+    vec2 uvScaled = v_texcoord0 * u_uvTransform.xy + u_uvTransform.zw;
+    vec3 tintedBase = texture2D(u_diffuseTex, uvScaled).rgb * u_albedoFactor.rgb;
+
+    gl_FragData[0] = vec4(tintedBase, 1.0);
+    gl_FragData[1] = vec4(normalize(v_normal), u_objectParams.x);
+}
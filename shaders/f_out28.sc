@@ -304,6 +304,11 @@ void main()
     }else if(mode == 4){
         //default/simple lighting system
         crossColor = litColor;
+    }else if(mode == 5){
+        // Tone-only hatch LOD (set by the editor for tiny objects): strokes this small would
+        // alias into grey anyway, so apply their average ink coverage without any noise lookups.
+        float lVal = 1.0 - luma(litColor);
+        crossColor = mix(litColor, u_inkColor.xyz, lVal * lVal);
     }
     
     // Blend the crosshatch with the lit color (adjust blend factor as desired)
@@ -0,0 +1,24 @@
+#ifdef GL_ES
+precision mediump float;
+varying vec2 v_texcoord0;
+#else
+in vec2 v_texcoord0;
+#endif
+
+#include <bgfx_shader.sh>
+
+// Shared signed distance field atlas (SdfText), 0.5 on the glyph outline.
+uniform sampler2D u_diffuseTex;
+uniform vec4 u_comicColor;      // User-controlled text color.
+
+void main()
+{
+    float distance = texture2D(u_diffuseTex, v_texcoord0).x;
+
+    // Antialias over one screen pixel whatever the zoom, so glyphs never blur or alias.
+    float width = max(fwidth(distance), 0.0001);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+
+    // Same result as f_text: white glyph coverage times the comic color.
+    gl_FragColor = vec4(u_comicColor.rgb, u_comicColor.a * alpha);
+}
@@ -0,0 +1,36 @@
+#ifdef GL_ES
+precision mediump float;
+varying vec2 v_texcoord0;
+#else
+in vec2 v_texcoord0;
+#endif
+
+#include <bgfx_shader.sh>
+
+// Scene rendered at the dynamic resolution.
+uniform sampler2D u_sceneColor;
+
+// u_upscaleParams.xy = texel size of u_sceneColor
+// u_upscaleParams.z  = sharpness (0..1)
+uniform vec4 u_upscaleParams;
+
+void main()
+{
+    vec2 texel = u_upscaleParams.xy;
+    vec3 c  = texture2D(u_sceneColor, v_texcoord0).rgb;
+    vec3 cN = texture2D(u_sceneColor, v_texcoord0 + vec2(0.0, -texel.y)).rgb;
+    vec3 cS = texture2D(u_sceneColor, v_texcoord0 + vec2(0.0,  texel.y)).rgb;
+    vec3 cE = texture2D(u_sceneColor, v_texcoord0 + vec2( texel.x, 0.0)).rgb;
+    vec3 cW = texture2D(u_sceneColor, v_texcoord0 + vec2(-texel.x, 0.0)).rgb;
+
+    // Contrast-adaptive sharpening: the amount drops where the neighbourhood already spans
+    // a large range (ink strokes on paper), so stroke edges get crisper without ringing.
+    vec3 mn = min(c, min(min(cN, cS), min(cE, cW)));
+    vec3 mx = max(c, max(max(cN, cS), max(cE, cW)));
+    vec3 amp = sqrt(clamp(min(mn, 1.0 - mx) / max(mx, vec3_splat(0.0001)), 0.0, 1.0));
+    float peak = -1.0 / mix(8.0, 5.0, clamp(u_upscaleParams.z, 0.0, 1.0));
+    vec3 w = amp * peak * step(0.001, u_upscaleParams.z);
+
+    vec3 result = (c + (cN + cS + cE + cW) * w) / (1.0 + 4.0 * w);
+    gl_FragColor = vec4(clamp(result, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,27 @@
+#ifdef GL_ES
+precision mediump float;
+varying vec2 v_texcoord0;
+#else
+in vec2 v_texcoord0;
+#endif
+
+#include <bgfx_shader.sh>
+
+// Video frame uploaded as three R8 planes (4:2:0, chroma at half resolution).
+uniform sampler2D u_videoY;
+uniform sampler2D u_videoU;
+uniform sampler2D u_videoV;
+
+// One row per output channel: rgb = dot(vec4(y, u, v, 1.0), row). Range expansion and the
+// BT.601 / BT.709 matrix are folded in on the CPU.
+uniform vec4 u_videoMatrix[3];
+
+void main()
+{
+    vec4 yuv = vec4(texture2D(u_videoY, v_texcoord0).x,
+                    texture2D(u_videoU, v_texcoord0).x,
+                    texture2D(u_videoV, v_texcoord0).x,
+                    1.0);
+    vec3 rgb = vec3(dot(yuv, u_videoMatrix[0]), dot(yuv, u_videoMatrix[1]), dot(yuv, u_videoMatrix[2]));
+    gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,16 @@
+#ifdef GL_ES
+precision mediump float;
+attribute vec3 a_position;
+#else
+in vec3 a_position;
+#endif
+
+#include <bgfx_shader.sh>
+
+// Depth pre-pass: position-only stream. The transform must stay identical to v_out21
+// (model first, then view-projection) so the main pass can use a depth-equal test.
+void main()
+{
+    vec4 worldPos = u_model[0] * vec4(a_position, 1.0);
+    gl_Position = u_viewProj * worldPos;
+}
@@ -0,0 +1,733 @@
+// Headless benchmark of the editor's per-frame CPU work. Runs bgfx with the Noop renderer, so it
+// needs no window or GPU and builds on a plain Linux box.
+//
+//   CrossHatchBench [scene | directory]... [--frames N] [--warmup N] [--out results.json]
+//
+// Every scene (default: the ones in saves/) is flown along scripted camera paths. Each frame does
+// what the main loop does for the scene: light collection, hierarchy traversal, the hatch LOD
+// selection, draw submission and bgfx::frame(). Per-phase percentiles are written as JSON to
+// stdout or --out, progress goes to stderr.
+//
+// Built-in primitives get the editor's meshes. Imported models and the OBJ based types (teapot,
+// comic elements...) need Assimp, so they are drawn with a stand-in cube and reported as such.
+
+#include "../SceneSerializer.h"
+#include "../FrameMath.h"
+#include "../Light.h"
+#include "../PrimitiveObjects.h"
+
+#include <bgfx/bgfx.h>
+#include <bx/math.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace SceneSerializer;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint16_t WIDTH = 1920;
+    const uint16_t HEIGHT = 1080;
+    const float FOV = 60.0f;
+    const bgfx::ViewId VIEW_SCENE = 0;
+
+    enum Phase { PHASE_LIGHTS, PHASE_TRAVERSAL, PHASE_CULLING, PHASE_SUBMISSION, PHASE_FRAME, PHASE_COUNT };
+    const char* PHASE_NAMES[PHASE_COUNT] = { "light_collection", "traversal", "culling", "submission", "bgfx_frame" };
+
+    struct Mesh
+    {
+        bgfx::VertexBufferHandle vbh = BGFX_INVALID_HANDLE;
+        bgfx::IndexBufferHandle ibh = BGFX_INVALID_HANDLE;
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float radius = 0.0f;
+        uint32_t triangles = 0;
+    };
+
+    // The parts of an editor Instance the frame loop reads.
+    struct Node
+    {
+        std::string type;
+        const Mesh* mesh = nullptr;
+        bool isLight = false;
+        bool animated = false;
+        bool overrideHatchLod = false;
+        LightProperties light;
+        float position[3], rotation[3], scale[3];
+        float basePosition[3], animAmplitude[3], animFrequency[3], animPhase[3];
+        float objectColor[4], inkColor[4];
+        float hatch[4], extra[4], layer[4];  // u_e.x/u_params.yzw, u_extraParams, u_paramsLayer
+        float lodSingleLayerPx, lodToneOnlyPx;
+        std::vector<int> children;
+    };
+
+    struct Scene
+    {
+        std::string path;
+        SceneSettings settings;
+        std::vector<Node> nodes;
+        std::vector<int> roots;
+        uint32_t lights = 0;
+        uint32_t standIns = 0;
+        uint64_t triangles = 0;
+        float center[3] = { 0.0f, 0.0f, 0.0f };
+        float radius = 1.0f;
+    };
+
+    // What the traversal leaves for the later phases, in draw order.
+    struct Draw
+    {
+        const Node* node;
+        float world[16];
+        float color[4];
+        float extra[4];
+        float layer[4];
+        float hatch[4];
+        int lod;
+        bool visible;
+    };
+
+    struct Uniforms
+    {
+        bgfx::UniformHandle lights, numLights, objectColor, albedoFactor, tint, inkColor, e, params, extraParams, paramsLayer, uvTransform, comicColor, noiseTex, diffuseTex;
+    };
+
+    struct Options
+    {
+        std::vector<std::string> inputs;
+        int frames = 600;
+        int warmup = 60;
+        std::string out;
+    };
+
+    bgfx::VertexLayout s_layout;
+    std::unordered_map<std::string, Mesh> s_meshes;
+
+    Mesh createMesh(const PosColorVertex* vertices, size_t vertexCount, const uint16_t* indices, size_t indexCount)
+    {
+        Mesh mesh;
+        mesh.vbh = bgfx::createVertexBuffer(bgfx::copy(vertices, uint32_t(vertexCount * sizeof(PosColorVertex))), s_layout);
+        mesh.ibh = bgfx::createIndexBuffer(bgfx::copy(indices, uint32_t(indexCount * sizeof(uint16_t))));
+        mesh.triangles = uint32_t(indexCount / 3);
+        // Same bounds as the editor's registerMeshGeometry(): box center, farthest vertex.
+        float minimum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        float maximum[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+        for (size_t i = 1; i < vertexCount; i++) {
+            const float p[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+            for (int a = 0; a < 3; a++) {
+                minimum[a] = std::min(minimum[a], p[a]);
+                maximum[a] = std::max(maximum[a], p[a]);
+            }
+        }
+        for (int a = 0; a < 3; a++)
+            mesh.center[a] = (minimum[a] + maximum[a]) * 0.5f;
+        for (size_t i = 0; i < vertexCount; i++) {
+            const float dx = vertices[i].x - mesh.center[0], dy = vertices[i].y - mesh.center[1], dz = vertices[i].z - mesh.center[2];
+            mesh.radius = std::max(mesh.radius, std::sqrt(dx * dx + dy * dy + dz * dz));
+        }
+        return mesh;
+    }
+
+    template <size_t V, size_t I>
+    Mesh createMesh(PosColorVertex (&vertices)[V], const uint16_t (&indices)[I])
+    {
+        return createMesh(vertices, V, indices, I);
+    }
+
+    Mesh createMesh(const std::vector<PosColorVertex>& vertices, const std::vector<uint16_t>& indices)
+    {
+        return createMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // The editor's bufferMap, with the same generator parameters.
+    void createBuiltInMeshes()
+    {
+        s_layout.begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .add(bgfx::Attrib::Normal, 3, bgfx::AttribType::Float)
+            .add(bgfx::Attrib::Color0, 4, bgfx::AttribType::Uint8, true)
+            .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float)
+            .end();
+
+        std::vector<PosColorVertex> vertices;
+        std::vector<uint16_t> indices;
+        s_meshes["cube"] = createMesh(cubeVertices, cubeIndices);
+        s_meshes["plane"] = createMesh(planeVertices, planeIndices);
+        s_meshes["arrow"] = createMesh(arrowVertices, arrowIndices);
+        s_meshes["text"] = createMesh(textQuadVertices, textQuadIndices);
+        s_meshes["cornell_box"] = createMesh(cornellBoxVertices, cornellBoxIndices);
+        s_meshes["innerCube"] = createMesh(innerCubeVertices, innerCubeIndices);
+        s_meshes["floor"] = createMesh(cornellBoxFloorVertices, cornellBoxFloorIndices);
+        s_meshes["ceiling"] = createMesh(cornellBoxCeilingVertices, cornellBoxCeilingIndices);
+        s_meshes["back"] = createMesh(cornellBoxBackVertices, cornellBoxBackIndices);
+        s_meshes["left"] = createMesh(cornellBoxLeftVertices, cornellBoxLeftIndices);
+        s_meshes["right"] = createMesh(cornellBoxRightVertices, cornellBoxRightIndices);
+        generateCapsule(1.0f, 1.5f, 20, 20, vertices, indices);
+        s_meshes["capsule"] = createMesh(vertices, indices);
+        vertices.clear(); indices.clear();
+        generateCylinder(1.0f, 2.0f, 20, vertices, indices);
+        s_meshes["cylinder"] = createMesh(vertices, indices);
+        vertices.clear(); indices.clear();
+        generateCone(1.0f, 2.0f, 20, vertices, indices);
+        s_meshes["cone"] = createMesh(vertices, indices);
+        vertices.clear(); indices.clear();
+        generateSphere(1.0f, 20, 20, vertices, indices);
+        s_meshes["sphere"] = createMesh(vertices, indices);
+    }
+
+    void destroyBuiltInMeshes()
+    {
+        for (auto& [type, mesh] : s_meshes) {
+            bgfx::destroy(mesh.vbh);
+            bgfx::destroy(mesh.ibh);
+        }
+        s_meshes.clear();
+    }
+
+    bool isSceneFile(const fs::path& path)
+    {
+        // saves/ also holds the "<scene>_imp_obj_map.txt" side files.
+        const std::string name = path.filename().string();
+        if (name.find("_imp_obj_map") != std::string::npos)
+            return false;
+        return path.extension() == ".txt" || path.extension() == ".chscene";
+    }
+
+    bool loadScene(const std::string& path, Scene& scene)
+    {
+        SceneData data;
+        if (!data.load(path))
+            return false;
+
+        scene.path = path;
+        scene.settings = data.settings;
+        scene.nodes.resize(data.size());
+        for (size_t i = 0; i < data.size(); i++) {
+            const SceneRecord& r = data[i];
+            Node& node = scene.nodes[i];
+            node.type = std::string(data.string(r.type));
+            node.isLight = node.type == "light";
+            node.animated = (r.flags & RECORD_ANIMATION_ENABLED) != 0;
+            node.overrideHatchLod = (r.flags & RECORD_OVERRIDE_HATCH_LOD) != 0;
+            node.light.type = static_cast<LightType>(r.lightType);
+            std::copy(r.lightDirection, r.lightDirection + 3, node.light.direction);
+            node.light.intensity = r.lightIntensity;
+            node.light.range = r.lightRange;
+            node.light.coneAngle = r.lightConeAngle;
+            std::copy(r.lightColor, r.lightColor + 4, node.light.color);
+            std::copy(r.position, r.position + 3, node.position);
+            std::copy(r.rotation, r.rotation + 3, node.rotation);
+            std::copy(r.scale, r.scale + 3, node.scale);
+            std::copy(r.basePosition, r.basePosition + 3, node.basePosition);
+            std::copy(r.animAmplitude, r.animAmplitude + 3, node.animAmplitude);
+            std::copy(r.animFrequency, r.animFrequency + 3, node.animFrequency);
+            std::copy(r.animPhase, r.animPhase + 3, node.animPhase);
+            std::copy(r.objectColor, r.objectColor + 4, node.objectColor);
+            std::copy(r.inkColor, r.inkColor + 4, node.inkColor);
+            const float hatch[4] = { r.epsilonValue, r.strokeMultiplier, r.lineAngle1, r.lineAngle2 };
+            const float extra[4] = { r.patternScale, r.lineThickness, r.transparencyValue, float(r.crosshatchMode) };
+            const float layer[4] = { r.layerPatternScale, r.layerStrokeMult, r.layerAngle, r.layerLineThickness };
+            std::copy(hatch, hatch + 4, node.hatch);
+            std::copy(extra, extra + 4, node.extra);
+            std::copy(layer, layer + 4, node.layer);
+            node.lodSingleLayerPx = r.lodSingleLayerPx;
+            node.lodToneOnlyPx = r.lodToneOnlyPx;
+
+            // Spot and directional lights draw as cones, like createInstanceFromRecord().
+            std::string meshType = node.type;
+            if (node.isLight)
+                meshType = (node.light.type == LightType::Point) ? "sphere" : "cone";
+            auto mesh = s_meshes.find(meshType);
+            if (mesh != s_meshes.end()) {
+                node.mesh = &mesh->second;
+            }
+            else if (node.type != "empty") {
+                node.mesh = &s_meshes["cube"];
+                scene.standIns++;
+            }
+            if (node.mesh)
+                scene.triangles += node.mesh->triangles;
+            if (node.isLight)
+                scene.lights++;
+
+            if (r.parentIndex >= 0 && size_t(r.parentIndex) < i)
+                scene.nodes[r.parentIndex].children.push_back(int(i));
+            else
+                scene.roots.push_back(int(i));
+        }
+
+        // Paths are framed on the bounds of the world positions. Records come parents first.
+        float minimum[3] = { 1e30f, 1e30f, 1e30f };
+        float maximum[3] = { -1e30f, -1e30f, -1e30f };
+        std::vector<const float*> parents(scene.nodes.size(), nullptr);
+        std::vector<std::array<float, 16>> worlds(scene.nodes.size());
+        for (size_t i = 0; i < scene.nodes.size(); i++) {
+            const Node& node = scene.nodes[i];
+            FrameMath::worldMatrix(worlds[i].data(), node.scale, node.rotation, node.position, parents[i]);
+            for (int child : node.children)
+                parents[child] = worlds[i].data();
+            for (int a = 0; a < 3; a++) {
+                minimum[a] = std::min(minimum[a], worlds[i][12 + a]);
+                maximum[a] = std::max(maximum[a], worlds[i][12 + a]);
+            }
+        }
+        if (!scene.nodes.empty()) {
+            float extent = 0.0f;
+            for (int a = 0; a < 3; a++) {
+                scene.center[a] = (minimum[a] + maximum[a]) * 0.5f;
+                extent = std::max(extent, maximum[a] - minimum[a]);
+            }
+            scene.radius = std::max(extent * 0.5f, 2.0f);
+        }
+        return true;
+    }
+
+    // Scripted camera: eye and target at t in [0, 1].
+    struct CameraPath
+    {
+        const char* name;
+        void (*at)(const Scene& scene, float t, float* eye, float* target);
+    };
+
+    const CameraPath PATHS[] = {
+        // One turn around the scene from a little above.
+        { "orbit", [](const Scene& s, float t, float* eye, float* target) {
+            const float angle = t * 2.0f * bx::kPi;
+            eye[0] = s.center[0] + std::cos(angle) * s.radius * 1.5f;
+            eye[1] = s.center[1] + s.radius * 0.4f;
+            eye[2] = s.center[2] + std::sin(angle) * s.radius * 1.5f;
+            std::copy(s.center, s.center + 3, target);
+        } },
+        // Straight through the middle along x, looking ahead, objects pass on both sides.
+        { "flythrough", [](const Scene& s, float t, float* eye, float* target) {
+            eye[0] = s.center[0] + (t * 2.4f - 1.2f) * s.radius;
+            eye[1] = s.center[1] + s.radius * 0.05f;
+            eye[2] = s.center[2] + s.radius * 0.1f;
+            target[0] = eye[0] + 1.0f;
+            target[1] = eye[1];
+            target[2] = eye[2];
+        } },
+        // From far away into the center, every object crosses the LOD thresholds.
+        { "dolly", [](const Scene& s, float t, float* eye, float* target) {
+            const float distance = s.radius * (4.0f - 3.9f * t);
+            eye[0] = s.center[0];
+            eye[1] = s.center[1] + distance * 0.3f;
+            eye[2] = s.center[2] + distance;
+            std::copy(s.center, s.center + 3, target);
+        } },
+    };
+
+    struct Camera
+    {
+        float eye[3];
+        float view[16];
+        float proj[16];
+        float planes[6][4];    // frustum planes (xyz inward normal, w distance)
+        float pixelsPerUnit;
+    };
+
+    void setupCamera(Camera& camera, const float* eye, const float* target, float farClip)
+    {
+        std::copy(eye, eye + 3, camera.eye);
+        bx::mtxLookAt(camera.view, bx::Vec3(eye[0], eye[1], eye[2]), bx::Vec3(target[0], target[1], target[2]));
+        bx::mtxProj(camera.proj, FOV, float(WIDTH) / float(HEIGHT), 0.1f, farClip, bgfx::getCaps()->homogeneousDepth);
+        camera.pixelsPerUnit = camera.proj[5] * float(HEIGHT) * 0.5f;
+
+        // Gribb/Hartmann planes from the column major view-projection.
+        float vp[16];
+        bx::mtxMul(vp, camera.view, camera.proj);
+        const float signs[6][2] = { { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { 2, 1 }, { 2, -1 } };
+        for (int p = 0; p < 6; p++) {
+            const int row = int(signs[p][0]);
+            const float sign = signs[p][1];
+            float length = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                camera.planes[p][c] = vp[c * 4 + 3] + sign * vp[c * 4 + row];
+                if (c < 3)
+                    length += camera.planes[p][c] * camera.planes[p][c];
+            }
+            length = std::sqrt(length);
+            for (float& v : camera.planes[p])
+                v /= length;
+        }
+    }
+
+    bool isWhite(const float* color)
+    {
+        return color[0] == 1.0f && color[1] == 1.0f && color[2] == 1.0f && color[3] == 1.0f;
+    }
+
+    // collectLights() of the editor.
+    void collectLights(const Scene& scene, int index, float* lightsData, int& numLights, const float* parentWorld)
+    {
+        const Node& node = scene.nodes[index];
+        float world[16];
+        FrameMath::worldMatrix(world, node.scale, node.rotation, node.position, parentWorld);
+        if (node.isLight) {
+            if (numLights >= MAX_LIGHTS)
+                return;
+            packLight(node.light, world, lightsData + numLights * 16);
+            numLights++;
+        }
+        for (int child : node.children) {
+            if (numLights >= MAX_LIGHTS)
+                break;
+            collectLights(scene, child, lightsData, numLights, world);
+        }
+    }
+
+    // The world matrix and inherited color part of drawInstance().
+    void traverse(const Scene& scene, int index, const float* parentWorld, const float* parentColor, std::vector<Draw>& draws)
+    {
+        const Node& node = scene.nodes[index];
+        Draw& draw = draws.emplace_back();
+        draw.node = &node;
+        FrameMath::worldMatrix(draw.world, node.scale, node.rotation, node.position, parentWorld);
+        const float* color = (parentColor && !isWhite(parentColor)) ? parentColor : node.objectColor;
+        std::copy(color, color + 4, draw.color);
+        std::copy(node.hatch, node.hatch + 4, draw.hatch);
+        std::copy(node.extra, node.extra + 4, draw.extra);
+        std::copy(node.layer, node.layer + 4, draw.layer);
+
+        // draws may grow below, keep what the children need on the stack.
+        float world[16], childColor[4];
+        std::copy(draw.world, draw.world + 16, world);
+        std::copy(color, color + 4, childColor);
+        const bool passColor = !isWhite(childColor);
+        for (int child : node.children)
+            traverse(scene, child, world, passColor ? childColor : nullptr, draws);
+    }
+
+    // applyHatchLod() of the editor, plus the frustum test the editor does not have yet: it only
+    // counts what a culling pass would skip, every draw is still submitted.
+    void selectLod(Draw& draw, const Camera& camera, const SceneSettings& settings)
+    {
+        const Node& node = *draw.node;
+        draw.lod = FrameMath::HATCH_LOD_FULL;
+        draw.visible = true;
+        if (!node.mesh)
+            return;
+
+        float center[3];
+        const float radius = FrameMath::worldSphere(node.mesh->center, node.mesh->radius, draw.world, center);
+        for (const float* plane : camera.planes) {
+            if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius) {
+                draw.visible = false;
+                break;
+            }
+        }
+
+        if (!settings.hatchLod || node.isLight || node.type == "text"
+            || node.type == "comicborder" || node.type.rfind("comicbubble", 0) == 0)
+            return;
+        const float singleLayerPx = node.overrideHatchLod ? node.lodSingleLayerPx : settings.hatchLodSingleLayerPx;
+        const float toneOnlyPx = node.overrideHatchLod ? node.lodToneOnlyPx : settings.hatchLodToneOnlyPx;
+        draw.lod = FrameMath::hatchLod(node.mesh->center, node.mesh->radius, draw.world, camera.eye, camera.pixelsPerUnit,
+            singleLayerPx, toneOnlyPx, draw.hatch, draw.extra, draw.layer);
+    }
+
+    // The uniform, texture, state and submit calls of drawInstance(). The Noop renderer has no
+    // shaders, so the draws go to an invalid program: bgfx still records them in the encoder and
+    // sorts them in frame(), it only skips the backend.
+    void submit(const Draw& draw, const Uniforms& u, bgfx::TextureHandle white)
+    {
+        const Node& node = *draw.node;
+        const float tint[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+        const float albedo[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        const float uvTransform[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+        const float epsilon[4] = { draw.hatch[0], 0.0f, 0.0f, 0.0f };
+        const float params[4] = { 0.0f, draw.hatch[1], draw.hatch[2], draw.hatch[3] };
+        bgfx::setUniform(u.uvTransform, uvTransform);
+        bgfx::setUniform(u.objectColor, draw.color);
+        bgfx::setUniform(u.albedoFactor, albedo);
+        bgfx::setUniform(u.tint, tint);
+        bgfx::setUniform(u.inkColor, node.inkColor);
+        bgfx::setUniform(u.e, epsilon);
+        bgfx::setUniform(u.params, params);
+        bgfx::setUniform(u.extraParams, draw.extra);
+        bgfx::setUniform(u.paramsLayer, draw.layer);
+        if (!node.mesh)
+            return;
+
+        bgfx::setTransform(draw.world);
+        bgfx::setVertexBuffer(0, node.mesh->vbh);
+        bgfx::setIndexBuffer(node.mesh->ibh);
+        bgfx::setTexture(1, u.diffuseTex, white);
+        bgfx::setTexture(0, u.noiseTex, white);
+        if (node.type == "text" || node.type == "comicborder" || node.type == "comicbubble") {
+            bgfx::setUniform(u.comicColor, draw.color);
+            bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A |
+                BGFX_STATE_BLEND_FUNC(BGFX_STATE_BLEND_SRC_ALPHA, BGFX_STATE_BLEND_INV_SRC_ALPHA));
+        }
+        else {
+            bgfx::setState(BGFX_STATE_DEFAULT);
+        }
+        bgfx::submit(VIEW_SCENE, BGFX_INVALID_HANDLE);
+    }
+
+    struct PathResult
+    {
+        const char* path;
+        std::vector<double> phaseMs[PHASE_COUNT];
+        std::vector<double> totalMs;
+        double visibleFraction = 0.0;
+        uint32_t lodCounts[FrameMath::HATCH_LOD_COUNT] = {};  // of the last frame
+    };
+
+    PathResult runPath(Scene& scene, const CameraPath& path, const Options& options, const Uniforms& u, bgfx::TextureHandle white)
+    {
+        PathResult result;
+        result.path = path.name;
+        const float frameTime = 1.0f / 60.0f;
+        const float farClip = scene.radius * 10.0f + 100.0f;
+        std::vector<Draw> draws;
+        draws.reserve(scene.nodes.size());
+        uint64_t visible = 0, counted = 0;
+
+        for (int frame = -options.warmup; frame < options.frames; frame++) {
+            const bool measured = frame >= 0;
+            const float t = float(std::max(frame, 0)) / float(std::max(options.frames - 1, 1));
+            const float time = float(frame + options.warmup) * frameTime;
+            Clock::time_point marks[PHASE_COUNT + 1];
+
+            float eye[3], target[3];
+            path.at(scene, t, eye, target);
+            Camera camera;
+            setupCamera(camera, eye, target, farClip);
+            bgfx::setViewRect(VIEW_SCENE, 0, 0, WIDTH, HEIGHT);
+            bgfx::setViewTransform(VIEW_SCENE, camera.view, camera.proj);
+            bgfx::touch(VIEW_SCENE);
+
+            marks[PHASE_LIGHTS] = Clock::now();
+            float lightsData[MAX_LIGHTS * 16];
+            int numLights = 0;
+            for (int root : scene.roots) {
+                if (numLights >= MAX_LIGHTS)
+                    break;
+                collectLights(scene, root, lightsData, numLights, nullptr);
+            }
+            bgfx::setUniform(u.lights, lightsData, uint16_t(numLights * 4));
+            const float numLightsArr[4] = { float(numLights), 0.0f, 0.0f, 0.0f };
+            bgfx::setUniform(u.numLights, numLightsArr);
+
+            marks[PHASE_TRAVERSAL] = Clock::now();
+            draws.clear();
+            for (int root : scene.roots) {
+                Node& node = scene.nodes[root];
+                if (node.isLight && node.animated) {
+                    for (int a = 0; a < 3; a++)
+                        node.position[a] = node.basePosition[a] + node.animAmplitude[a] * std::sin(time * node.animFrequency[a] + node.animPhase[a]);
+                }
+                traverse(scene, root, nullptr, node.objectColor, draws);
+            }
+
+            marks[PHASE_CULLING] = Clock::now();
+            for (Draw& draw : draws)
+                selectLod(draw, camera, scene.settings);
+
+            marks[PHASE_SUBMISSION] = Clock::now();
+            for (const Draw& draw : draws)
+                submit(draw, u, white);
+
+            marks[PHASE_FRAME] = Clock::now();
+            bgfx::frame();
+            marks[PHASE_COUNT] = Clock::now();
+
+            if (!measured)
+                continue;
+            for (int p = 0; p < PHASE_COUNT; p++)
+                result.phaseMs[p].push_back(std::chrono::duration<double, std::milli>(marks[p + 1] - marks[p]).count());
+            result.totalMs.push_back(std::chrono::duration<double, std::milli>(marks[PHASE_COUNT] - marks[0]).count());
+            for (const Draw& draw : draws) {
+                if (!draw.node->mesh)
+                    continue;
+                counted++;
+                visible += draw.visible ? 1 : 0;
+            }
+        }
+        result.visibleFraction = counted ? double(visible) / double(counted) : 0.0;
+        for (const Draw& draw : draws) {
+            if (!draw.node->mesh)
+                continue;
+            result.lodCounts[draw.lod]++;
+        }
+        return result;
+    }
+
+    void writeStats(FILE* out, const char* name, std::vector<double> ms, bool last)
+    {
+        std::sort(ms.begin(), ms.end());
+        auto percentile = [&](double p) {
+            return ms.empty() ? 0.0 : ms[std::min(ms.size() - 1, size_t(p * double(ms.size() - 1) + 0.5))];
+        };
+        double sum = 0.0;
+        for (double v : ms)
+            sum += v;
+        std::fprintf(out, "          \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+            name, ms.empty() ? 0.0 : sum / double(ms.size()), percentile(0.5), percentile(0.9), percentile(0.99),
+            ms.empty() ? 0.0 : ms.back(), last ? "" : ",");
+    }
+
+    std::string jsonEscape(const std::string& s)
+    {
+        std::string escaped;
+        for (char c : s) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            const std::string arg = argv[i];
+            if ((arg == "--frames" || arg == "--warmup" || arg == "--out") && i + 1 < argc) {
+                const char* value = argv[++i];
+                if (arg == "--frames")
+                    options.frames = std::max(std::atoi(value), 1);
+                else if (arg == "--warmup")
+                    options.warmup = std::max(std::atoi(value), 0);
+                else
+                    options.out = value;
+            }
+            else if (!arg.empty() && arg[0] == '-') {
+                return false;
+            }
+            else {
+                options.inputs.push_back(arg);
+            }
+        }
+        if (options.inputs.empty())
+            options.inputs.push_back("saves");
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "usage: CrossHatchBench [scene | directory]... [--frames N] [--warmup N] [--out results.json]" << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> scenePaths;
+    for (const std::string& input : options.inputs) {
+        if (fs::is_directory(input)) {
+            std::vector<std::string> found;
+            for (const auto& entry : fs::directory_iterator(input)) {
+                if (entry.is_regular_file() && isSceneFile(entry.path()))
+                    found.push_back(entry.path().string());
+            }
+            std::sort(found.begin(), found.end());
+            scenePaths.insert(scenePaths.end(), found.begin(), found.end());
+        }
+        else {
+            scenePaths.push_back(input);
+        }
+    }
+    if (scenePaths.empty()) {
+        std::cerr << "[Bench] No scenes found" << std::endl;
+        return 1;
+    }
+
+    // Calling renderFrame() before init keeps bgfx on this thread, the Noop renderer needs no window.
+    bgfx::renderFrame();
+    bgfx::Init init;
+    init.type = bgfx::RendererType::Noop;
+    init.resolution.width = WIDTH;
+    init.resolution.height = HEIGHT;
+    init.resolution.reset = BGFX_RESET_NONE;
+    if (!bgfx::init(init)) {
+        std::cerr << "[Bench] bgfx::init failed" << std::endl;
+        return 1;
+    }
+
+    createBuiltInMeshes();
+    Uniforms u;
+    u.lights = bgfx::createUniform("u_lights", bgfx::UniformType::Vec4, MAX_LIGHTS * 4);
+    u.numLights = bgfx::createUniform("u_numLights", bgfx::UniformType::Vec4);
+    u.objectColor = bgfx::createUniform("u_objectColor", bgfx::UniformType::Vec4);
+    u.albedoFactor = bgfx::createUniform("u_albedoFactor", bgfx::UniformType::Vec4);
+    u.tint = bgfx::createUniform("u_tint", bgfx::UniformType::Vec4);
+    u.inkColor = bgfx::createUniform("u_inkColor", bgfx::UniformType::Vec4);
+    u.e = bgfx::createUniform("u_e", bgfx::UniformType::Vec4);
+    u.params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4);
+    u.extraParams = bgfx::createUniform("u_extraParams", bgfx::UniformType::Vec4);
+    u.paramsLayer = bgfx::createUniform("u_paramsLayer", bgfx::UniformType::Vec4);
+    u.uvTransform = bgfx::createUniform("u_uvTransform", bgfx::UniformType::Vec4);
+    u.comicColor = bgfx::createUniform("u_comicColor", bgfx::UniformType::Vec4);
+    u.noiseTex = bgfx::createUniform("s_noiseTex", bgfx::UniformType::Sampler);
+    u.diffuseTex = bgfx::createUniform("s_diffuseTex", bgfx::UniformType::Sampler);
+    const uint32_t whitePixel = 0xffffffff;
+    bgfx::TextureHandle white = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, 0, bgfx::copy(&whitePixel, sizeof(whitePixel)));
+
+    FILE* out = stdout;
+    if (!options.out.empty()) {
+        out = std::fopen(options.out.c_str(), "w");
+        if (!out) {
+            std::cerr << "[Bench] Cannot write " << options.out << std::endl;
+            return 1;
+        }
+    }
+
+    std::fprintf(out, "{\n  \"renderer\": \"%s\",\n  \"frames\": %d,\n  \"warmup\": %d,\n  \"resolution\": [%u, %u],\n  \"scenes\": [",
+        bgfx::getRendererName(bgfx::getRendererType()), options.frames, options.warmup, WIDTH, HEIGHT);
+    int failed = 0;
+    bool firstScene = true;
+    for (const std::string& path : scenePaths) {
+        Scene scene;
+        if (!loadScene(path, scene)) {
+            std::cerr << "[Bench] Failed to load " << path << std::endl;
+            failed++;
+            continue;
+        }
+        std::cerr << "[Bench] " << path << ": " << scene.nodes.size() << " instances, " << scene.lights << " lights, "
+            << scene.standIns << " stand-in meshes" << std::endl;
+
+        std::fprintf(out, "%s\n    {\n      \"scene\": \"%s\",\n      \"instances\": %zu,\n      \"lights\": %u,\n"
+            "      \"triangles\": %llu,\n      \"standInMeshes\": %u,\n      \"paths\": [",
+            firstScene ? "" : ",", jsonEscape(path).c_str(), scene.nodes.size(), scene.lights,
+            static_cast<unsigned long long>(scene.triangles), scene.standIns);
+        firstScene = false;
+
+        bool firstPath = true;
+        for (const CameraPath& cameraPath : PATHS) {
+            // Every path starts from the scene as saved.
+            Scene run = scene;
+            const PathResult result = runPath(run, cameraPath, options, u, white);
+            std::fprintf(out, "%s\n        { \"path\": \"%s\", \"visibleFraction\": %.3f, \"lastFrameLod\": { \"full\": %u, \"singleLayer\": %u, \"toneOnly\": %u },\n        \"phases\": {\n",
+                firstPath ? "" : ",", result.path, result.visibleFraction, result.lodCounts[0], result.lodCounts[1], result.lodCounts[2]);
+            firstPath = false;
+            for (int p = 0; p < PHASE_COUNT; p++)
+                writeStats(out, PHASE_NAMES[p], result.phaseMs[p], false);
+            writeStats(out, "total", result.totalMs, true);
+            std::fprintf(out, "        } }");
+        }
+        std::fprintf(out, "\n      ]\n    }");
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        std::fclose(out);
+
+    bgfx::destroy(white);
+    for (bgfx::UniformHandle uniform : { u.lights, u.numLights, u.objectColor, u.albedoFactor, u.tint, u.inkColor, u.e, u.params,
+        u.extraParams, u.paramsLayer, u.uvTransform, u.comicColor, u.noiseTex, u.diffuseTex })
+        bgfx::destroy(uniform);
+    destroyBuiltInMeshes();
+    bgfx::shutdown();
+    return failed == 0 ? 0 : 1;
+}
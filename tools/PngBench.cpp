@@ -0,0 +1,199 @@
+// PNG encoder benchmark: stb_image_write against PngEncoder's fast and high levels, on
+// synthetic hatched captures at 4K and 8K or on existing screenshots.
+//
+//   PngBench                   3840x2160 and 7680x4320 synthetic captures
+//   PngBench <image.png>...    real captures, e.g. screenshots/*.png
+//
+// Every PngEncoder result is decoded again and compared with the source pixels, and the CRC of
+// every chunk is checked (stb_image ignores them, libpng does not).
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../stb_image_write.h"
+
+#include "../PngEncoder.h"
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr int kRuns = 3;
+
+    struct Image
+    {
+        std::string name;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> rgba;
+    };
+
+    double msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Paper white with hatch strokes whose density follows a lit sphere-ish gradient, plus a
+    // flat UI-coloured band, close to what the editor's captures contain.
+    Image buildCapture(uint32_t width, uint32_t height)
+    {
+        Image image;
+        image.name = "synthetic " + std::to_string(width) + "x" + std::to_string(height);
+        image.width = width;
+        image.height = height;
+        image.rgba.resize(size_t(width) * height * 4);
+        uint32_t noise = 12345;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const float u = float(x) / float(width) - 0.5f;
+                const float v = float(y) / float(height) - 0.5f;
+                const float shade = std::clamp(std::sqrt(u * u + v * v) * 2.2f, 0.0f, 1.0f);
+                const uint32_t period = 4 + uint32_t(shade * 12.0f);
+                bool ink = (x + y) % period == 0;
+                if (shade < 0.5f)
+                    ink = ink || (x + height - y) % period == 0;
+                noise = noise * 1664525u + 1013904223u;
+                uint8_t value = ink ? uint8_t(40 + (noise >> 28)) : 250;
+                uint8_t* pixel = &image.rgba[(size_t(y) * width + x) * 4];
+                if (y < height / 24)
+                {
+                    pixel[0] = 37; pixel[1] = 37; pixel[2] = 38; // toolbar
+                }
+                else
+                {
+                    pixel[0] = value; pixel[1] = value; pixel[2] = uint8_t(std::min(255, value + 3));
+                }
+                pixel[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    bool loadCapture(const char* path, Image& image)
+    {
+        int w = 0, h = 0, n = 0;
+        uint8_t* data = stbi_load(path, &w, &h, &n, 4);
+        if (!data)
+            return false;
+        image.name = path;
+        image.width = uint32_t(w);
+        image.height = uint32_t(h);
+        image.rgba.assign(data, data + size_t(w) * h * 4);
+        stbi_image_free(data);
+        return true;
+    }
+
+    void appendToVector(void* context, void* data, int size)
+    {
+        std::vector<uint8_t>& png = *static_cast<std::vector<uint8_t>*>(context);
+        png.insert(png.end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+    }
+
+    bool matches(const Image& image, const std::vector<uint8_t>& png)
+    {
+        int w = 0, h = 0, n = 0;
+        uint8_t* decoded = stbi_load_from_memory(png.data(), int(png.size()), &w, &h, &n, 4);
+        const bool same = decoded && uint32_t(w) == image.width && uint32_t(h) == image.height &&
+            std::memcmp(decoded, image.rgba.data(), image.rgba.size()) == 0;
+        stbi_image_free(decoded);
+        return same;
+    }
+
+    uint32_t readBigEndian32(const uint8_t* p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    // Signature, then length/type/data/CRC chunks up to and including IEND.
+    bool chunksValid(const std::vector<uint8_t>& png)
+    {
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if (png.size() < 8 || std::memcmp(png.data(), signature, 8) != 0)
+            return false;
+        size_t offset = 8;
+        while (png.size() - offset >= 12)
+        {
+            const uint32_t length = readBigEndian32(&png[offset]);
+            if (png.size() - offset - 12 < length)
+                return false;
+            const uint8_t* type = &png[offset + 4];
+            const uLong crc = crc32(0, type, uInt(4 + length));
+            if (readBigEndian32(type + 4 + length) != uint32_t(crc))
+                return false;
+            offset += 12 + size_t(length);
+            if (std::memcmp(type, "IEND", 4) == 0)
+                return offset == png.size();
+        }
+        return false;
+    }
+
+    bool bench(const Image& image)
+    {
+        const double megapixels = double(image.width) * image.height / 1e6;
+        std::printf("%s (%.1f MP), %zu thread(s)\n", image.name.c_str(), megapixels, PngEncoder::threadCount());
+
+        std::vector<uint8_t> png;
+        double best = 1e30;
+        for (int run = 0; run < kRuns; ++run)
+        {
+            png.clear();
+            const auto start = std::chrono::steady_clock::now();
+            stbi_write_png_to_func(appendToVector, &png, int(image.width), int(image.height), 4, image.rgba.data(), int(image.width) * 4);
+            best = std::min(best, msSince(start));
+        }
+        const double stbMs = best;
+        std::printf("  stb      : %9.1f ms  %8.2f MB\n", stbMs, double(png.size()) / (1024.0 * 1024.0));
+
+        bool ok = true;
+        const PngEncoder::Level levels[] = { PngEncoder::Level::Fast, PngEncoder::Level::High };
+        for (PngEncoder::Level level : levels)
+        {
+            best = 1e30;
+            for (int run = 0; run < kRuns; ++run)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                PngEncoder::encode(png, image.rgba.data(), image.width, image.height, 4, size_t(image.width) * 4, level);
+                best = std::min(best, msSince(start));
+            }
+            const bool valid = matches(image, png) && chunksValid(png);
+            ok = ok && valid;
+            std::printf("  %-9s: %9.1f ms  %8.2f MB  %.1fx%s\n", level == PngEncoder::Level::Fast ? "fast" : "high",
+                best, double(png.size()) / (1024.0 * 1024.0), stbMs / std::max(best, 1e-3), valid ? "" : "  MISMATCH");
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool ok = true;
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            Image image;
+            if (!loadCapture(argv[i], image))
+            {
+                std::fprintf(stderr, "could not load %s\n", argv[i]);
+                ok = false;
+                continue;
+            }
+            ok = bench(image) && ok;
+        }
+    }
+    else
+    {
+        ok = bench(buildCapture(3840, 2160)) && ok;
+        ok = bench(buildCapture(7680, 4320)) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+// Command line companion for scene files, builds without bgfx so it also runs on headless machines.
+//
+//   SceneTool convert <scene.txt | directory>...   writes a .chscene next to every text scene
+//   SceneTool bench [instances]                    save/load timings and text parse throughput (default 100000)
+//   SceneTool stream <scene> <out.chstream> [cell]  splits a scene into streamed grid cells (default 64 units)
+//   SceneTool generate <out name> [options]         procedural stress scene as <out name>.txt and .chscene
+
+#include "../SceneSerializer.h"
+#include "../SceneGenerator.h"
+#include "../SceneStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace fs = std::filesystem;
+using namespace SceneSerializer;
+
+namespace
+{
+    constexpr int kParseRuns = 5;
+
+    bool isTextScene(const fs::path& path)
+    {
+        // saves/ also holds the "<scene>_imp_obj_map.txt" side files.
+        const std::string name = path.filename().string();
+        return path.extension() == ".txt" && name.find("_imp_obj_map") == std::string::npos;
+    }
+
+    int convert(int argc, char** argv)
+    {
+        int converted = 0, failed = 0;
+        for (int i = 2; i < argc; i++)
+        {
+            const fs::path input = argv[i];
+            if (fs::is_directory(input))
+            {
+                for (const auto& entry : fs::directory_iterator(input))
+                {
+                    if (entry.is_regular_file() && isTextScene(entry.path()))
+                        (convertTextToBinary(entry.path().string()) ? converted : failed)++;
+                }
+            }
+            else
+            {
+                (convertTextToBinary(input.string()) ? converted : failed)++;
+            }
+        }
+        std::cout << converted << " scene(s) converted, " << failed << " failed" << std::endl;
+        return failed == 0 ? 0 : 1;
+    }
+
+    // Roughly what a big city scene looks like: groups of ten with shared type/texture names.
+    void buildSyntheticScene(SceneData& scene, int instanceCount)
+    {
+        static const char* types[] = { "cube", "sphere", "cylinder", "capsule", "plane", "gameready-city-building_0" };
+        const StringRef none = scene.addString("none");
+        const StringRef noise = scene.addString("Noise1(Default)");
+        const StringRef empty = scene.addString("");
+        for (int i = 0; i < instanceCount; i++)
+        {
+            SceneRecord r;
+            r.id = i + 1;
+            r.parentId = (i % 10 == 0) ? -1 : (i / 10) * 10 + 1;
+            r.type = scene.addString(types[i % 6]);
+            r.name = scene.addString("instance_" + std::to_string(r.id));
+            r.texture = none;
+            r.noiseTexture = noise;
+            r.textContent = empty;
+            for (int a = 0; a < 3; a++)
+            {
+                r.position[a] = float((i * 7 + a * 13) % 1000) * 0.137f - 60.0f;
+                r.rotation[a] = float((i + a) % 628) * 0.01f;
+                r.basePosition[a] = r.position[a];
+            }
+            scene.addRecord(r);
+        }
+    }
+
+    double msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Touches every record and string so lazily mapped pages are counted in the load time.
+    double checksum(const SceneData& scene)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < scene.size(); i++)
+        {
+            const SceneRecord& r = scene[i];
+            sum += r.position[0] + r.position[1] + r.position[2] + r.parentIndex;
+            sum += double(scene.string(r.name).size());
+        }
+        return sum;
+    }
+
+    int stream(int argc, char** argv)
+    {
+        const std::string scenePath = argv[2];
+        const std::string indexPath = argv[3];
+        const float cellSize = argc > 4 ? float(std::atof(argv[4])) : 64.0f;
+
+        SceneData scene;
+        if (!scene.load(scenePath))
+        {
+            std::cerr << "Failed to load " << scenePath << std::endl;
+            return 1;
+        }
+
+        // Imported types resolve to model files through the scene's side file.
+        std::unordered_map<std::string, std::string> assetPaths;
+        const fs::path mapPath = fs::path(scenePath).parent_path() / (fs::path(scenePath).stem().string() + "_imp_obj_map.txt");
+        std::ifstream map(mapPath);
+        std::string line;
+        while (std::getline(map, line))
+        {
+            std::istringstream iss(line);
+            const std::string type = read_quoted_string(iss);
+            const std::string path = read_quoted_string(iss);
+            if (!type.empty() && !path.empty())
+                assetPaths[type] = path;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        if (!SceneStreamer::buildStream(scene, assetPaths, indexPath, cellSize))
+            return 1;
+        std::printf("%zu instances streamed to %s (%.0f unit cells) in %.1f ms\n", scene.size(), indexPath.c_str(), cellSize, msSince(start));
+        return 0;
+    }
+
+    int generate(int argc, char** argv)
+    {
+        SceneGenerator::Params params;
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            const std::string option = argv[i];
+            const char* value = argv[i + 1];
+            if (option == "--seed")
+                params.seed = uint32_t(std::strtoul(value, nullptr, 10));
+            else if (option == "--instances")
+                params.instances = uint32_t(std::max(0, std::atoi(value)));
+            else if (option == "--depth")
+                params.depth = uint32_t(std::max(1, std::atoi(value)));
+            else if (option == "--fanout")
+                params.fanOut = uint32_t(std::max(1, std::atoi(value)));
+            else if (option == "--lights")
+                params.lights = uint32_t(std::max(0, std::atoi(value)));
+            else if (option == "--animated")
+                params.animatedFraction = float(std::atof(value));
+            else if (option == "--text")
+                params.textBubbles = uint32_t(std::max(0, std::atoi(value)));
+            else if (option == "--imported")
+            {
+                // <type>=<model path>[:<mesh count>], as in the editor's _imp_obj_map files
+                const std::string spec = value;
+                const size_t equals = spec.find('=');
+                if (equals == std::string::npos)
+                {
+                    std::cerr << "--imported expects <type>=<model path>[:<mesh count>]" << std::endl;
+                    return 1;
+                }
+                params.importedType = spec.substr(0, equals);
+                params.importedPath = spec.substr(equals + 1);
+                const size_t colon = params.importedPath.rfind(':');
+                if (colon != std::string::npos && colon > 1 && params.importedPath.find_first_not_of("0123456789", colon + 1) == std::string::npos)
+                {
+                    params.importedMeshes = uint32_t(std::max(1, std::atoi(params.importedPath.c_str() + colon + 1)));
+                    params.importedPath.resize(colon);
+                }
+            }
+            else if (option == "--spacing")
+                params.spacing = float(std::atof(value));
+            else
+            {
+                std::cerr << "Unknown option " << option << std::endl;
+                return 1;
+            }
+        }
+        return SceneGenerator::write(params, argv[2]) ? 0 : 1;
+    }
+
+    int bench(int argc, char** argv)
+    {
+        const int instanceCount = argc > 2 ? std::max(1, std::atoi(argv[2])) : 100000;
+        const fs::path dir = fs::temp_directory_path();
+        const std::string textPath = (dir / "scenetool_bench.txt").string();
+        const std::string binaryPath = (dir / "scenetool_bench.chscene").string();
+
+        SceneData source;
+        buildSyntheticScene(source, instanceCount);
+        const double reference = checksum(source);
+
+        auto start = std::chrono::steady_clock::now();
+        source.saveText(textPath);
+        const double saveTextMs = msSince(start);
+
+        start = std::chrono::steady_clock::now();
+        source.saveBinary(binaryPath);
+        const double saveBinaryMs = msSince(start);
+
+        // Best of a few runs, the first one also pays for reading the file from disk.
+        SceneData text;
+        double loadTextMs = 0.0;
+        double textSum = 0.0;
+        for (int run = 0; run < kParseRuns; run++)
+        {
+            start = std::chrono::steady_clock::now();
+            text.loadText(textPath);
+            textSum = checksum(text);
+            const double ms = msSince(start);
+            loadTextMs = run == 0 ? ms : std::min(loadTextMs, ms);
+        }
+
+        SceneData binary;
+        start = std::chrono::steady_clock::now();
+        binary.loadBinary(binaryPath);
+        const double binarySum = checksum(binary);
+        const double loadBinaryMs = msSince(start);
+
+        std::printf("%d instances\n", instanceCount);
+        std::printf("  text    : save %9.2f ms  load %9.2f ms  %8.2f MB\n", saveTextMs, loadTextMs, double(fs::file_size(textPath)) / (1024.0 * 1024.0));
+        std::printf("  binary  : save %9.2f ms  load %9.2f ms  %8.2f MB\n", saveBinaryMs, loadBinaryMs, double(fs::file_size(binaryPath)) / (1024.0 * 1024.0));
+        std::printf("  text parse: %.1f MB/s, %.0f lines/s\n",
+            double(fs::file_size(textPath)) / (1024.0 * 1024.0) / (loadTextMs / 1000.0), double(instanceCount) / (loadTextMs / 1000.0));
+        std::printf("  load speed-up: %.1fx\n", loadTextMs / std::max(loadBinaryMs, 1e-3));
+
+        // Text goes through %g formatting, so only the binary copy has to match exactly.
+        const bool ok = text.size() == source.size() && binary.size() == source.size() && binarySum == reference;
+        if (!ok)
+            std::printf("  MISMATCH: text %zu / binary %zu records, checksum %f vs %f (text %f)\n", text.size(), binary.size(), binarySum, reference, textSum);
+
+        fs::remove(textPath);
+        fs::remove(binaryPath);
+        return ok ? 0 : 1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string command = argc > 1 ? argv[1] : "";
+    if (command == "convert" && argc > 2)
+        return convert(argc, argv);
+    if (command == "bench")
+        return bench(argc, argv);
+    if (command == "stream" && argc > 3)
+        return stream(argc, argv);
+    if (command == "generate" && argc > 2)
+        return generate(argc, argv);
+
+    std::cout << "usage: SceneTool convert <scene.txt | directory>...\n"
+                 "       SceneTool bench [instances]\n"
+                 "       SceneTool stream <scene> <out.chstream> [cell size]\n"
+                 "       SceneTool generate <out name> [--seed N] [--instances N] [--depth N] [--fanout N] [--lights N]\n"
+                 "                          [--animated fraction] [--text N] [--imported type=model[:meshes]] [--spacing units]" << std::endl;
+    return 1;
+}
@@ -0,0 +1,198 @@
+// Video background conversion benchmark: swscale (bilinear, YUV420P -> RGBA) against the
+// YuvConverter kernels, for 1080p and 4K sources shown at their own size and scaled down to
+// common window sizes.
+//
+//   YuvBench
+//
+// Every kernel must produce the same pixels as the scalar one. The difference to swscale is
+// only reported: the filters and chroma siting differ slightly, so a few levels are expected.
+
+extern "C" {
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+}
+
+#include "../ParallelFor.h"
+#include "../YuvConverter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    constexpr int kRuns = 10;
+
+    struct Frame
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> planes[3];
+    };
+
+    struct Size
+    {
+        int width;
+        int height;
+    };
+
+    double msSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Limited range gradients with some grain, roughly what a decoded trailer frame holds.
+    Frame buildFrame(int width, int height)
+    {
+        Frame frame;
+        frame.width = width;
+        frame.height = height;
+        const int chromaWidth = (width + 1) / 2;
+        const int chromaHeight = (height + 1) / 2;
+        frame.planes[0].resize(size_t(width) * height);
+        frame.planes[1].resize(size_t(chromaWidth) * chromaHeight);
+        frame.planes[2].resize(size_t(chromaWidth) * chromaHeight);
+        uint32_t noise = 12345;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                noise = noise * 1664525u + 1013904223u;
+                const int value = 16 + (x * 219) / width + int(noise >> 29) - 4;
+                frame.planes[0][size_t(y) * width + x] = uint8_t(std::clamp(value, 16, 235));
+            }
+        }
+        for (int y = 0; y < chromaHeight; ++y)
+        {
+            for (int x = 0; x < chromaWidth; ++x)
+            {
+                frame.planes[1][size_t(y) * chromaWidth + x] = uint8_t(16 + (y * 224) / chromaHeight);
+                frame.planes[2][size_t(y) * chromaWidth + x] = uint8_t(240 - (x * 224) / chromaWidth);
+            }
+        }
+        return frame;
+    }
+
+    YuvConverter::Planes planesOf(const Frame& frame)
+    {
+        YuvConverter::Planes planes;
+        const int chromaWidth = (frame.width + 1) / 2;
+        for (int p = 0; p < 3; ++p)
+        {
+            planes.data[p] = frame.planes[p].data();
+            planes.stride[p] = p == 0 ? frame.width : chromaWidth;
+        }
+        planes.width = frame.width;
+        planes.height = frame.height;
+        return planes;
+    }
+
+    double benchSwscale(const Frame& frame, Size display, std::vector<uint8_t>& rgba)
+    {
+        SwsContext* context = sws_getContext(frame.width, frame.height, AV_PIX_FMT_YUV420P,
+            display.width, display.height, AV_PIX_FMT_RGBA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!context)
+            return -1.0;
+        sws_setColorspaceDetails(context, sws_getCoefficients(SWS_CS_ITU709), 0, sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+
+        const int chromaWidth = (frame.width + 1) / 2;
+        const uint8_t* src[4] = { frame.planes[0].data(), frame.planes[1].data(), frame.planes[2].data(), nullptr };
+        const int srcStride[4] = { frame.width, chromaWidth, chromaWidth, 0 };
+        uint8_t* dst[4] = { rgba.data(), nullptr, nullptr, nullptr };
+        const int dstStride[4] = { display.width * 4, 0, 0, 0 };
+
+        double best = 1e30;
+        for (int run = 0; run < kRuns; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            sws_scale(context, src, srcStride, 0, frame.height, dst, dstStride);
+            best = std::min(best, msSince(start));
+        }
+        sws_freeContext(context);
+        return best;
+    }
+
+    double benchKernel(const Frame& frame, Size display, std::vector<uint8_t>& rgba)
+    {
+        const YuvConverter::Planes planes = planesOf(frame);
+        double best = 1e30;
+        for (int run = 0; run < kRuns; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            YuvConverter::toRgba(planes, true, false, rgba.data(), display.width, display.height);
+            best = std::min(best, msSince(start));
+        }
+        return best;
+    }
+
+    void difference(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int& maxDiff, double& meanDiff)
+    {
+        maxDiff = 0;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            const int d = std::abs(int(a[i]) - int(b[i]));
+            maxDiff = std::max(maxDiff, d);
+            sum += uint64_t(d);
+        }
+        meanDiff = a.empty() ? 0.0 : double(sum) / double(a.size());
+    }
+
+    bool bench(const Frame& frame, Size display)
+    {
+        std::printf("%dx%d -> %dx%d, %zu thread(s)\n", frame.width, frame.height, display.width, display.height, ParallelFor::threadCount());
+        const size_t rgbaSize = size_t(display.width) * display.height * 4;
+        std::vector<uint8_t> reference(rgbaSize);
+        const double swsMs = benchSwscale(frame, display, reference);
+        if (swsMs < 0.0)
+        {
+            std::printf("  swscale  : no context\n");
+            return false;
+        }
+        std::printf("  swscale  : %8.2f ms\n", swsMs);
+
+        bool ok = true;
+        std::vector<uint8_t> scalar(rgbaSize);
+        const YuvConverter::Kernel kernels[] = { YuvConverter::Kernel::Scalar, YuvConverter::Kernel::Sse41, YuvConverter::Kernel::Avx2 };
+        for (YuvConverter::Kernel kernel : kernels)
+        {
+            YuvConverter::setKernel(kernel);
+            if (YuvConverter::activeKernel() != kernel)
+            {
+                std::printf("  %-9s: not supported\n", YuvConverter::kernelName(kernel));
+                continue;
+            }
+            std::vector<uint8_t> rgba(rgbaSize);
+            const double ms = benchKernel(frame, display, rgba);
+            if (kernel == YuvConverter::Kernel::Scalar)
+                scalar = rgba;
+            const bool same = rgba == scalar;
+            ok = ok && same;
+
+            int maxDiff = 0;
+            double meanDiff = 0.0;
+            difference(rgba, reference, maxDiff, meanDiff);
+            std::printf("  %-9s: %8.2f ms  %.1fx  vs swscale max %d mean %.2f%s\n", YuvConverter::kernelName(kernel), ms,
+                swsMs / std::max(ms, 1e-3), maxDiff, meanDiff, same ? "" : "  MISMATCH");
+        }
+        YuvConverter::setKernel(YuvConverter::Kernel::Auto);
+        return ok;
+    }
+}
+
+int main()
+{
+    bool ok = true;
+    const Frame hd = buildFrame(1920, 1080);
+    ok = bench(hd, { 1920, 1080 }) && ok;
+    ok = bench(hd, { 1280, 720 }) && ok;
+
+    const Frame uhd = buildFrame(3840, 2160);
+    ok = bench(uhd, { 3840, 2160 }) && ok;
+    ok = bench(uhd, { 2560, 1440 }) && ok;
+    ok = bench(uhd, { 1920, 1080 }) && ok;
+    return ok ? 0 : 1;
+}